@@ -0,0 +1,176 @@
+/*
+ * array.c - general arrays for shardjs
+ *
+ * an array is a length and its elements, the first ARRAY_INLINE_CAPACITY
+ * of them inside the object and past that in a separate buffer that
+ * doubles in size when it fills up. an array starts out holding raw
+ * doubles and switches to values, in place, the first time something
+ * other than a number is stored in it. it never switches back.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "include/object.h"
+
+Value array_create(size_t capacity) {
+    if (capacity > SIZE_MAX / sizeof(ArrayElement)) {
+        return VALUE_NULL;
+    }
+
+    ArrayElement *buffer = NULL;
+    if (capacity > ARRAY_INLINE_CAPACITY) {
+        buffer = malloc(capacity * sizeof(ArrayElement));
+        if (!buffer) {
+            return VALUE_NULL;
+        }
+    } else {
+        capacity = ARRAY_INLINE_CAPACITY;
+    }
+
+    ArrayObject *array = heap_allocate(OBJ_ARRAY, sizeof(ArrayObject));
+    if (!array) {
+        free(buffer);
+        return VALUE_NULL;
+    }
+    array->kind = ARRAY_NUMBERS;
+    array->capacity = capacity;
+    array->buffer = buffer;
+    return value_from_pointer(array);
+}
+
+// box every number where it lies - called with the array locked. none
+// of the values made is a pointer, so no barrier is needed.
+static void hold_values(ArrayObject *array) {
+    ArrayElement *elements = array_elements(array);
+    for (size_t i = 0; i < array->length; i++) {
+        elements[i].value = value_from_number(elements[i].number);
+    }
+    array->kind = ARRAY_VALUES;
+}
+
+// room for one more element - called with the array locked
+static int reserve(ArrayObject *array) {
+    if (array->length < array->capacity) {
+        return 1;
+    }
+    size_t capacity = array->capacity * 2;
+    if (capacity > SIZE_MAX / sizeof(ArrayElement)) {
+        return 0;
+    }
+    ArrayElement *buffer;
+    if (array->buffer) {
+        buffer = realloc(array->buffer, capacity * sizeof(ArrayElement));
+    } else {
+        buffer = malloc(capacity * sizeof(ArrayElement));
+        if (buffer) {
+            memcpy(buffer, array->inline_elements, sizeof(array->inline_elements));
+        }
+    }
+    if (!buffer) {
+        return 0;
+    }
+    array->buffer = buffer;
+    array->capacity = capacity;
+    return 1;
+}
+
+int array_append(Value value, Value item) {
+    ArrayObject *array = value_as_array(value);
+    heap_lock_object(&array->header);
+    if (!reserve(array)) {
+        heap_unlock_object(&array->header);
+        return 0;
+    }
+    if (array->kind == ARRAY_NUMBERS && !value_is_number(item)) {
+        hold_values(array);
+    }
+    ArrayElement *element = &array_elements(array)[array->length];
+    if (array->kind == ARRAY_NUMBERS) {
+        element->number = value_as_number(item);
+    } else {
+        element->value = item;
+        array_write_barrier(array, array->length, item);
+    }
+    array->length++;
+    heap_unlock_object(&array->header);
+    return 1;
+}
+
+void array_set(Value value, size_t index, Value item) {
+    ArrayObject *array = value_as_array(value);
+    if (array->kind == ARRAY_NUMBERS && value_is_number(item)) {
+        array_elements(array)[index].number = value_as_number(item);
+        return;
+    }
+    if (array->kind == ARRAY_VALUES) {
+        heap_overwrite_barrier(&array->header, array_elements(array)[index].value);
+    }
+    heap_lock_object(&array->header);
+    if (array->kind == ARRAY_NUMBERS) {
+        hold_values(array);
+    }
+    array_elements(array)[index].value = item;
+    heap_unlock_object(&array->header);
+    array_write_barrier(array, index, item);
+}
+
+int array_pop(Value value, Value *item) {
+    ArrayObject *array = value_as_array(value);
+    if (array->length == 0) {
+        return 0;
+    }
+    *item = array_get(value, array->length - 1);
+    // the marker may not have reached it, and the array no longer holds it
+    if (array->kind == ARRAY_VALUES) {
+        heap_overwrite_barrier(&array->header, *item);
+    }
+    heap_lock_object(&array->header);
+    array->length--;
+    heap_unlock_object(&array->header);
+    return 1;
+}
+
+void array_release(ArrayObject *array) {
+    free(array->buffer);
+}
+
+int array_take_numbers(Value value, ArrayElement **buffer, size_t *length, size_t *capacity) {
+    ArrayObject *array = value_as_array(value);
+    *length = array->length;
+    *capacity = array->capacity;
+    *buffer = array->buffer;
+    if (!array->buffer && array->length > 0) {
+        // the elements are inline, so they go in a buffer of their own
+        *buffer = malloc(ARRAY_INLINE_CAPACITY * sizeof(ArrayElement));
+        if (!*buffer) {
+            return 0;
+        }
+        memcpy(*buffer, array->inline_elements, sizeof(array->inline_elements));
+        *capacity = ARRAY_INLINE_CAPACITY;
+    }
+    heap_lock_object(&array->header);
+    array->buffer = NULL;
+    array->capacity = ARRAY_INLINE_CAPACITY;
+    array->length = 0;
+    heap_unlock_object(&array->header);
+    if (*length == 0) {
+        free(*buffer);
+        *buffer = NULL;
+    }
+    return 1;
+}
+
+Value array_adopt_numbers(ArrayElement *buffer, size_t length, size_t capacity) {
+    Value value = array_create(0);
+    if (value_is_null(value)) {
+        return VALUE_NULL;
+    }
+    if (buffer) {
+        ArrayObject *array = value_as_array(value);
+        array->buffer = buffer;
+        array->capacity = capacity;
+        array->length = length;
+    }
+    return value;
+}
@@ -2,12 +2,14 @@
  * ast.c - abstract syntax tree nodes for shardjs
  * 
  * creates and manages ast nodes for different language constructs.
- * handles memory allocation and cleanup for the parse tree.
+ * handles memory allocation and cleanup for the parse tree, and
+ * hash-conses pure expression nodes so identical subtrees are shared.
  */
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "include/runtime.h"
 
@@ -16,6 +18,7 @@ ASTNode* ast_create_number(double value) {
     if (!node) return NULL;
     
     node->type = AST_NUMBER;
+    node->refcount = 1;
     node->data.number = value;
     return node;
 }
@@ -25,6 +28,7 @@ ASTNode* ast_create_identifier(const char *name) {
     if (!node) return NULL;
     
     node->type = AST_IDENTIFIER;
+    node->refcount = 1;
     node->data.identifier = strdup(name);
     if (!node->data.identifier) {
         free(node);
@@ -33,14 +37,31 @@ ASTNode* ast_create_identifier(const char *name) {
     return node;
 }
 
+ASTNode* ast_create_string(const char *chars) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_STRING;
+    node->refcount = 1;
+    node->data.string.chars = strdup(chars);
+    node->data.string.interned = VALUE_NULL;
+    if (!node->data.string.chars) {
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
 ASTNode* ast_create_binary_op(ASTNode *left, char operator, ASTNode *right) {
     ASTNode *node = malloc(sizeof(ASTNode));
     if (!node) return NULL;
     
     node->type = AST_BINARY_OP;
+    node->refcount = 1;
     node->data.binary.left = left;
     node->data.binary.right = right;
     node->data.binary.operator = operator;
+    node->data.binary.quick = NULL;
     return node;
 }
 
@@ -49,6 +70,7 @@ ASTNode* ast_create_let_decl(const char *name, ASTNode *value) {
     if (!node) return NULL;
     
     node->type = AST_LET_DECL;
+    node->refcount = 1;
     node->data.let_decl.name = strdup(name);
     node->data.let_decl.value = value;
     if (!node->data.let_decl.name) {
@@ -63,6 +85,7 @@ ASTNode* ast_create_print_call(ASTNode *arg) {
     if (!node) return NULL;
     
     node->type = AST_PRINT_CALL;
+    node->refcount = 1;
     node->data.print_arg = arg;
     return node;
 }
@@ -72,6 +95,7 @@ ASTNode* ast_create_program(void) {
     if (!node) return NULL;
     
     node->type = AST_PROGRAM;
+    node->refcount = 1;
     node->data.program.statements = NULL;
     node->data.program.count = 0;
     node->data.program.capacity = 0;
@@ -83,12 +107,130 @@ ASTNode* ast_create_if_stmt(ASTNode *condition, ASTNode *if_branch, ASTNode *els
     if (!node) return NULL;
     
     node->type = AST_IF_STMT;
+    node->refcount = 1;
     node->data.if_stmt.condition = condition;
     node->data.if_stmt.if_branch = if_branch;
     node->data.if_stmt.else_branch = else_branch;
     return node;
 }
 
+// copies the argument pointers, taking over the caller's references
+ASTNode* ast_create_call(const char *name, ASTNode **args, int count) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_CALL;
+    node->refcount = 1;
+    node->data.call.name = strdup(name);
+    node->data.call.args = count > 0 ? malloc(count * sizeof(ASTNode*)) : NULL;
+    node->data.call.count = count;
+    node->data.call.builtin = NULL;
+    if (!node->data.call.name || (count > 0 && !node->data.call.args)) {
+        free(node->data.call.name);
+        free(node->data.call.args);
+        free(node);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        node->data.call.args[i] = args[i];
+    }
+    return node;
+}
+
+// takes over the caller's references to the arguments
+ASTNode* ast_create_intrinsic(const Intrinsic *intrinsic, ASTNode **args, int count) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_INTRINSIC;
+    node->refcount = 1;
+    node->data.intrinsic.intrinsic = intrinsic;
+    node->data.intrinsic.count = count;
+    for (int i = 0; i < INTRINSIC_MAX_ARGS; i++) {
+        node->data.intrinsic.args[i] = i < count ? args[i] : NULL;
+    }
+    return node;
+}
+
+ASTNode* ast_create_index(ASTNode *object, ASTNode *index) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_INDEX;
+    node->refcount = 1;
+    node->data.index.object = object;
+    node->data.index.index = index;
+    node->data.index.value = NULL;
+    return node;
+}
+
+ASTNode* ast_create_index_assign(ASTNode *object, ASTNode *index, ASTNode *value) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_INDEX_ASSIGN;
+    node->refcount = 1;
+    node->data.index.object = object;
+    node->data.index.index = index;
+    node->data.index.value = value;
+    return node;
+}
+
+// takes over the elements array itself, which must come from malloc
+ASTNode* ast_create_array(ASTNode **elements, int count) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_ARRAY;
+    node->refcount = 1;
+    node->data.array.elements = elements;
+    node->data.array.count = count;
+    return node;
+}
+
+// takes over both arrays and the key strings, which must come from malloc
+ASTNode* ast_create_object(char **keys, ASTNode **values, int count) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = AST_OBJECT;
+    node->refcount = 1;
+    node->data.object.keys = keys;
+    node->data.object.values = values;
+    node->data.object.count = count;
+    node->data.object.shape = NULL;
+    node->data.object.slots = NULL;
+    return node;
+}
+
+static ASTNode* create_property(ASTNodeType type, ASTNode *object, const char *name, ASTNode *value) {
+    ASTNode *node = malloc(sizeof(ASTNode));
+    if (!node) return NULL;
+    
+    node->type = type;
+    node->refcount = 1;
+    node->data.property.object = object;
+    node->data.property.name = strdup(name);
+    node->data.property.key = VALUE_NULL;
+    node->data.property.value = value;
+    node->data.property.cache = calloc(1, sizeof(PropertyCache));
+    if (!node->data.property.name || !node->data.property.cache) {
+        free(node->data.property.name);
+        free(node->data.property.cache);
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+ASTNode* ast_create_property(ASTNode *object, const char *name) {
+    return create_property(AST_PROPERTY, object, name, NULL);
+}
+
+ASTNode* ast_create_property_assign(ASTNode *object, const char *name, ASTNode *value) {
+    return create_property(AST_PROPERTY_ASSIGN, object, name, value);
+}
+
 // add statement to program node - grows array as needed
 int ast_program_add_statement(ASTNode *program, ASTNode *statement) {
     if (!program || program->type != AST_PROGRAM || !statement) {
@@ -112,14 +254,30 @@ int ast_program_add_statement(ASTNode *program, ASTNode *statement) {
     return 1;
 }
 
-// recursively free ast node and all children
+// take another reference to a node that is shared between parents
+ASTNode* ast_retain(ASTNode *node) {
+    if (node) {
+        node->refcount++;
+    }
+    return node;
+}
+
+// drop a reference - frees the node and its children once unshared
 void ast_destroy(ASTNode *node) {
     if (!node) return;
     
+    if (--node->refcount > 0) {
+        return;
+    }
+    
     switch (node->type) {
         case AST_IDENTIFIER:
             free(node->data.identifier);
             break;
+        case AST_STRING:
+            // the interned value belongs to the heap
+            free(node->data.string.chars);
+            break;
         case AST_BINARY_OP:
             ast_destroy(node->data.binary.left);
             ast_destroy(node->data.binary.right);
@@ -142,10 +300,327 @@ void ast_destroy(ASTNode *node) {
             ast_destroy(node->data.if_stmt.if_branch);
             ast_destroy(node->data.if_stmt.else_branch);  // handles NULL gracefully
             break;
+        case AST_CALL:
+            free(node->data.call.name);
+            for (int i = 0; i < node->data.call.count; i++) {
+                ast_destroy(node->data.call.args[i]);
+            }
+            free(node->data.call.args);
+            break;
+        case AST_INTRINSIC:
+            for (int i = 0; i < node->data.intrinsic.count; i++) {
+                ast_destroy(node->data.intrinsic.args[i]);
+            }
+            break;
+        case AST_ARRAY:
+            for (int i = 0; i < node->data.array.count; i++) {
+                ast_destroy(node->data.array.elements[i]);
+            }
+            free(node->data.array.elements);
+            break;
+        case AST_INDEX:
+        case AST_INDEX_ASSIGN:
+            ast_destroy(node->data.index.object);
+            ast_destroy(node->data.index.index);
+            ast_destroy(node->data.index.value);  // NULL for plain reads
+            break;
+        case AST_OBJECT:
+            for (int i = 0; i < node->data.object.count; i++) {
+                free(node->data.object.keys[i]);
+                ast_destroy(node->data.object.values[i]);
+            }
+            free(node->data.object.keys);
+            free(node->data.object.values);
+            free(node->data.object.slots);   // the shape belongs to the heap
+            break;
+        case AST_PROPERTY:
+        case AST_PROPERTY_ASSIGN:
+            ast_destroy(node->data.property.object);
+            free(node->data.property.name);
+            ast_destroy(node->data.property.value);  // NULL for plain reads
+            free(node->data.property.cache);
+            break;
         case AST_NUMBER:
             // numbers don't need cleanup
             break;
     }
     
     free(node);
-}
\ No newline at end of file
+}
+
+// hash-consing table for pure expression nodes. holds one reference
+// to every node it has handed out so lookups never see freed memory.
+struct ASTConsTable {
+    ASTNode **slots;
+    size_t capacity;    // always a power of two
+    size_t count;
+    size_t requested;   // expression nodes asked for, shared or not
+    size_t probes;      // occupied slots lookups stepped past
+};
+
+#define CONS_INITIAL_CAPACITY 64
+
+static uint64_t cons_mix(uint64_t hash, uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+// children are already hash-consed, so structural identity of a binary
+// node is just its operator plus the identity of its children
+static uint64_t cons_hash(ASTNode *node) {
+    uint64_t hash = (uint64_t)node->type;
+    switch (node->type) {
+        case AST_NUMBER: {
+            uint64_t bits;
+            memcpy(&bits, &node->data.number, sizeof(bits));
+            return cons_mix(hash, bits);
+        }
+        case AST_IDENTIFIER:
+            for (const char *p = node->data.identifier; *p; p++) {
+                hash = cons_mix(hash, (unsigned char)*p);
+            }
+            return hash;
+        case AST_STRING:
+            for (const char *p = node->data.string.chars; *p; p++) {
+                hash = cons_mix(hash, (unsigned char)*p);
+            }
+            return hash;
+        case AST_BINARY_OP:
+            hash = cons_mix(hash, (uint64_t)(uintptr_t)node->data.binary.left);
+            hash = cons_mix(hash, (uint64_t)(uintptr_t)node->data.binary.right);
+            return cons_mix(hash, (unsigned char)node->data.binary.operator);
+        case AST_PROPERTY:
+            hash = cons_mix(hash, (uint64_t)(uintptr_t)node->data.property.object);
+            for (const char *p = node->data.property.name; *p; p++) {
+                hash = cons_mix(hash, (unsigned char)*p);
+            }
+            return hash;
+        default:
+            return hash;
+    }
+}
+
+static int cons_equal(ASTNode *a, ASTNode *b) {
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+        case AST_NUMBER:
+            // bitwise so 0 and -0 stay distinct nodes
+            return memcmp(&a->data.number, &b->data.number, sizeof(double)) == 0;
+        case AST_IDENTIFIER:
+            return strcmp(a->data.identifier, b->data.identifier) == 0;
+        case AST_STRING:
+            return strcmp(a->data.string.chars, b->data.string.chars) == 0;
+        case AST_BINARY_OP:
+            return a->data.binary.operator == b->data.binary.operator &&
+                   a->data.binary.left == b->data.binary.left &&
+                   a->data.binary.right == b->data.binary.right;
+        case AST_PROPERTY:
+            return a->data.property.object == b->data.property.object &&
+                   strcmp(a->data.property.name, b->data.property.name) == 0;
+        default:
+            return 0;
+    }
+}
+
+// the splitmix64 finalizer. the slot comes from the low bits, and the
+// bits of small whole numbers like 3 or 3.5 are all zero down there
+static uint64_t cons_finish(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// the slot holding probe's twin or the empty one it would go in,
+// counting the occupied slots stepped past into probes when given
+static ASTNode** cons_slot(ASTNode **slots, size_t capacity, ASTNode *probe, size_t *probes) {
+    size_t mask = capacity - 1;
+    size_t index = (size_t)cons_finish(cons_hash(probe)) & mask;
+    while (slots[index] && !cons_equal(slots[index], probe)) {
+        index = (index + 1) & mask;
+        if (probes) {
+            (*probes)++;
+        }
+    }
+    return &slots[index];
+}
+
+static int cons_grow(ASTConsTable *table) {
+    size_t new_capacity = table->capacity * 2;
+    ASTNode **new_slots = calloc(new_capacity, sizeof(ASTNode*));
+    if (!new_slots) {
+        return 0;
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i]) {
+            *cons_slot(new_slots, new_capacity, table->slots[i], NULL) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots = new_slots;
+    table->capacity = new_capacity;
+    return 1;
+}
+
+ASTConsTable* ast_cons_table_create(void) {
+    ASTConsTable *table = malloc(sizeof(ASTConsTable));
+    if (!table) return NULL;
+    
+    table->slots = calloc(CONS_INITIAL_CAPACITY, sizeof(ASTNode*));
+    if (!table->slots) {
+        free(table);
+        return NULL;
+    }
+    table->capacity = CONS_INITIAL_CAPACITY;
+    table->count = 0;
+    table->requested = 0;
+    table->probes = 0;
+    return table;
+}
+
+// release the table's references - nodes still in an ast live on
+void ast_cons_table_destroy(ASTConsTable *table) {
+    if (!table) return;
+    
+    for (size_t i = 0; i < table->capacity; i++) {
+        ast_destroy(table->slots[i]);
+    }
+    free(table->slots);
+    free(table);
+}
+
+// return the shared twin of probe if one exists, NULL otherwise
+static ASTNode* cons_lookup(ASTConsTable *table, ASTNode *probe) {
+    table->requested++;
+    return *cons_slot(table->slots, table->capacity, probe, &table->probes);
+}
+
+// remember a freshly created node. if the table can't grow the node is
+// simply left unshared, which is still correct.
+static void cons_insert(ASTConsTable *table, ASTNode *node) {
+    if ((table->count + 1) * 10 > table->capacity * 7 && !cons_grow(table)) {
+        return;
+    }
+    *cons_slot(table->slots, table->capacity, node, NULL) = ast_retain(node);
+    table->count++;
+}
+
+ASTNode* ast_cons_number(ASTConsTable *table, double value) {
+    if (!table) return ast_create_number(value);
+    
+    ASTNode probe;
+    probe.type = AST_NUMBER;
+    probe.data.number = value;
+    
+    ASTNode *existing = cons_lookup(table, &probe);
+    if (existing) {
+        return ast_retain(existing);
+    }
+    
+    ASTNode *node = ast_create_number(value);
+    if (node) {
+        cons_insert(table, node);
+    }
+    return node;
+}
+
+ASTNode* ast_cons_identifier(ASTConsTable *table, const char *name) {
+    if (!table) return ast_create_identifier(name);
+    
+    ASTNode probe;
+    probe.type = AST_IDENTIFIER;
+    probe.data.identifier = (char*)name;
+    
+    ASTNode *existing = cons_lookup(table, &probe);
+    if (existing) {
+        return ast_retain(existing);
+    }
+    
+    ASTNode *node = ast_create_identifier(name);
+    if (node) {
+        cons_insert(table, node);
+    }
+    return node;
+}
+
+ASTNode* ast_cons_string(ASTConsTable *table, const char *chars) {
+    if (!table) return ast_create_string(chars);
+    
+    ASTNode probe;
+    probe.type = AST_STRING;
+    probe.data.string.chars = (char*)chars;
+    
+    ASTNode *existing = cons_lookup(table, &probe);
+    if (existing) {
+        return ast_retain(existing);
+    }
+    
+    ASTNode *node = ast_create_string(chars);
+    if (node) {
+        cons_insert(table, node);
+    }
+    return node;
+}
+
+// takes over the caller's references to left and right on success
+ASTNode* ast_cons_binary_op(ASTConsTable *table, ASTNode *left, char operator, ASTNode *right) {
+    if (!table) return ast_create_binary_op(left, operator, right);
+    
+    ASTNode probe;
+    probe.type = AST_BINARY_OP;
+    probe.data.binary.left = left;
+    probe.data.binary.right = right;
+    probe.data.binary.operator = operator;
+    
+    ASTNode *existing = cons_lookup(table, &probe);
+    if (existing) {
+        // the twin already holds its own references to both children
+        ast_destroy(left);
+        ast_destroy(right);
+        return ast_retain(existing);
+    }
+    
+    ASTNode *node = ast_create_binary_op(left, operator, right);
+    if (node) {
+        cons_insert(table, node);
+    }
+    return node;
+}
+
+// reads of the same property of the same expression share one node, and
+// with it one inline cache. takes over the caller's reference to object
+// on success.
+ASTNode* ast_cons_property(ASTConsTable *table, ASTNode *object, const char *name) {
+    if (!table) return ast_create_property(object, name);
+    
+    ASTNode probe;
+    probe.type = AST_PROPERTY;
+    probe.data.property.object = object;
+    probe.data.property.name = (char*)name;
+    
+    ASTNode *existing = cons_lookup(table, &probe);
+    if (existing) {
+        ast_destroy(object);
+        return ast_retain(existing);
+    }
+    
+    ASTNode *node = ast_create_property(object, name);
+    if (node) {
+        cons_insert(table, node);
+    }
+    return node;
+}
+
+ASTConsStats ast_cons_table_stats(ASTConsTable *table) {
+    ASTConsStats stats = {0, 0, 0};
+    if (table) {
+        stats.requested = table->requested;
+        stats.unique = table->count;
+        stats.probes = table->probes;
+    }
+    return stats;
+}
@@ -0,0 +1,120 @@
+/*
+ * bench_csv.c - csv column reader benchmark for shardjs
+ *
+ * writes a large numeric csv and reads two of its four columns the
+ * way a quick c program would - fgets, strtok and strtod - then with
+ * csv_read_columns on one thread and on as many as it likes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/csv.h"
+
+#define BENCH_ROWS 1000000
+
+static const char *bench_path = "/tmp/shardjs_bench.csv";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// keeps the compiler from dropping results nobody reads
+static volatile double sink;
+
+static size_t write_sample(void) {
+    FILE *file = fopen(bench_path, "wb");
+    if (!file) {
+        perror(bench_path);
+        exit(1);
+    }
+    fputs("id,price,qty,ratio\n", file);
+    unsigned state = 12345;
+    for (int i = 0; i < BENCH_ROWS; i++) {
+        state = state * 1103515245u + 12345u;
+        fprintf(file, "%d,%.2f,%u,%.6g\n", i, (state >> 8) % 100000 / 100.0, state >> 24,
+                (double)(state >> 4) / 3e8);
+    }
+    long size = ftell(file);
+    fclose(file);
+    return (size_t)size;
+}
+
+// price and qty, by field position
+static size_t naive_read(double *price, double *qty) {
+    FILE *file = fopen(bench_path, "rb");
+    if (!file) {
+        perror(bench_path);
+        exit(1);
+    }
+    char line[256];
+    size_t rows = 0;
+    if (!fgets(line, sizeof(line), file)) {
+        fclose(file);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        char *saved;
+        strtok_r(line, ",\n", &saved);
+        price[rows] = strtod(strtok_r(NULL, ",\n", &saved), NULL);
+        qty[rows] = strtod(strtok_r(NULL, ",\n", &saved), NULL);
+        rows++;
+    }
+    fclose(file);
+    return rows;
+}
+
+static void report(const char *name, size_t threads, size_t bytes, size_t rows, double seconds) {
+    printf("  %-10s %zu thread%s %8zu rows  %8.3f ms  %7.1f MB/s\n", name, threads,
+           threads == 1 ? " " : "s", rows, seconds * 1e3, (double)bytes / seconds / 1e6);
+}
+
+int main(void) {
+    printf("csv columns - the simd reader should beat fgets/strtod, threads more so\n");
+
+    size_t bytes = write_sample();
+    double *price = malloc(BENCH_ROWS * sizeof(double));
+    double *qty = malloc(BENCH_ROWS * sizeof(double));
+    if (!price || !qty) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    double start = now_seconds();
+    size_t rows = naive_read(price, qty);
+    report("naive", 1, bytes, rows, now_seconds() - start);
+    sink = price[rows / 2] + qty[rows / 2];
+
+    const char *names[] = { "price", "qty" };
+    size_t thread_counts[] = { 1, 0 };
+    for (size_t i = 0; i < 2; i++) {
+        double *columns[2];
+        CsvResult result;
+        char error[256];
+        start = now_seconds();
+        if (!csv_read_columns(bench_path, names, 2, thread_counts[i], columns, &result, error, sizeof(error))) {
+            fprintf(stderr, "%s\n", error);
+            return 1;
+        }
+        report("simd", result.threads, bytes, result.rows, now_seconds() - start);
+
+        // both readers have to agree before the numbers mean anything
+        if (result.rows != rows || memcmp(columns[0], price, rows * sizeof(double)) != 0 ||
+            memcmp(columns[1], qty, rows * sizeof(double)) != 0) {
+            fprintf(stderr, "csv_read_columns disagrees with strtod\n");
+            return 1;
+        }
+        free(columns[0]);
+        free(columns[1]);
+    }
+
+    free(price);
+    free(qty);
+    unlink(bench_path);
+    return 0;
+}
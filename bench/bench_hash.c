@@ -0,0 +1,129 @@
+/*
+ * bench_hash.c - hashing and shard assignment benchmarks for shardjs
+ *
+ * hashes a column of numeric ids one at a time and through the vector
+ * kernels on each instruction set, short string keys, and then places
+ * the hashed ids on shards by jump hashing, by rendezvous hashing and,
+ * for comparison, by a plain modulo that moves nearly every key when
+ * the shard count changes.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/hash.h"
+#include "../include/kernels.h"
+
+#define KEYS 4000000
+#define NODES 16
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-32s %10.3f ms  %8.2f ns/key\n", name, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static volatile uint64_t sink;
+
+static void bench_numbers(const double *ids, uint64_t *hashes, size_t n) {
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = hash_number(ids[i], 0);
+    }
+    report("numbers, one at a time", n, now_seconds() - start);
+
+    KernelIsa isas[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            continue;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "numbers, %s kernel", kernel_isa_name(isas[k]));
+        start = now_seconds();
+        hash_numbers(ids, n, 0, hashes);
+        report(name, n, now_seconds() - start);
+    }
+    kernel_use_isa(kernel_best_isa());
+}
+
+static void bench_strings(size_t n) {
+    char (*keys)[24] = malloc(n * sizeof(*keys));
+    int *lengths = malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; i++) {
+        lengths[i] = snprintf(keys[i], sizeof(keys[i]), "user:%zu", i * 7919);
+    }
+    uint64_t total = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        total += hash_bytes(keys[i], (size_t)lengths[i], 0);
+    }
+    report("strings like \"user:123456\"", n, now_seconds() - start);
+    sink = total;
+    free(keys);
+    free(lengths);
+}
+
+static void bench_placement(const uint64_t *hashes, size_t n) {
+    uint64_t total = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        total += hashes[i] % NODES;
+    }
+    report("modulo 16", n, now_seconds() - start);
+
+    start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        total += hash_jump(hashes[i], NODES);
+    }
+    report("jump hash, 16 buckets", n, now_seconds() - start);
+
+    start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        total += hash_jump(hashes[i], 1000);
+    }
+    report("jump hash, 1000 buckets", n, now_seconds() - start);
+
+    uint64_t nodes[NODES];
+    for (int i = 0; i < NODES; i++) {
+        char name[16];
+        int length = snprintf(name, sizeof(name), "db%d", i);
+        nodes[i] = hash_bytes(name, (size_t)length, 0);
+    }
+    start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        total += hash_rendezvous(hashes[i], nodes, NODES);
+    }
+    report("rendezvous, 16 nodes", n, now_seconds() - start);
+    sink = total;
+
+    // what growing to 17 shards costs each way
+    size_t moved_modulo = 0, moved_jump = 0;
+    for (size_t i = 0; i < n; i++) {
+        moved_modulo += hashes[i] % NODES != hashes[i] % (NODES + 1);
+        moved_jump += hash_jump(hashes[i], NODES) != hash_jump(hashes[i], NODES + 1);
+    }
+    printf("  going to 17 shards moves %.1f%% of keys by modulo, %.1f%% by jump hash\n",
+           100.0 * (double)moved_modulo / (double)n, 100.0 * (double)moved_jump / (double)n);
+}
+
+int main(void) {
+    double *ids = malloc(KEYS * sizeof(double));
+    uint64_t *hashes = malloc(KEYS * sizeof(uint64_t));
+    for (size_t i = 0; i < KEYS; i++) {
+        ids[i] = (double)(i * 2654435761u % 1000000007u);
+        hashes[i] = 0;
+    }
+
+    printf("hashing %d keys (%s kernels)\n", KEYS, kernel_isa_name(kernel_current_isa()));
+    bench_numbers(ids, hashes, KEYS);
+    bench_strings(KEYS);
+    bench_placement(hashes, KEYS);
+    free(ids);
+    free(hashes);
+    return 0;
+}
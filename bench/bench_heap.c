@@ -0,0 +1,149 @@
+/*
+ * bench_heap.c - allocation benchmarks for shardjs
+ *
+ * makes short strings that die at once, the way expression temporaries
+ * do, through the nursery and through calloc and free one at a time.
+ * then keeps a share of them alive to show what promotion costs, and
+ * times the pauses of full collections over a big old generation.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/object.h"
+
+#define BENCH_ALLOCATIONS 5000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// keeps the compiler from dropping results nobody reads
+static volatile size_t sink;
+
+static void report(const char *name, double seconds) {
+    printf("  %-22s %8.3f ms  %6.1f ns/allocation\n", name, seconds * 1e3,
+           seconds * 1e9 / BENCH_ALLOCATIONS);
+}
+
+static double bench_nursery(void) {
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ALLOCATIONS; i++) {
+        sink += string_length(string_from_chars("temporary", 9));
+    }
+    double elapsed = now_seconds() - start;
+    heap_destroy();
+    return elapsed;
+}
+
+// one malloc'd object per allocation, freed as soon as it dies
+static double bench_calloc(void) {
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ALLOCATIONS; i++) {
+        StringObject *string = calloc(1, sizeof(StringObject));
+        if (!string) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        string->length = 9;
+        sink += string->length;
+        free(string);
+    }
+    return now_seconds() - start;
+}
+
+// every keep_every'th string is stored in a rooted array
+static double bench_survivors(int keep_every) {
+    Value kept = array_create(0);
+    heap_push_root(&kept);
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ALLOCATIONS; i++) {
+        Value string = string_from_chars("temporary", 9);
+        if (i % keep_every == 0) {
+            array_append(kept, string);
+        }
+    }
+    double elapsed = now_seconds() - start;
+    sink += value_as_array(kept)->length;
+    heap_pop_roots(1);
+    heap_destroy();
+    return elapsed;
+}
+
+#define PAUSE_PAIRS 500000
+
+// a rooted array of [string, string] pairs, all promoted
+static Value build_old_generation(void) {
+    heap_set_nursery_size(64u << 20);
+    Value list = array_create(0);
+    heap_push_root(&list);
+    for (int i = 0; i < PAUSE_PAIRS; i++) {
+        Value pair = array_create(2);
+        heap_push_root(&pair);
+        array_append(pair, string_from_chars("key", 3));
+        array_append(pair, string_from_chars("value", 5));
+        array_append(list, pair);
+        heap_pop_roots(1);
+    }
+    heap_collect_minor();
+    return list;
+}
+
+// the pause of a stop-the-world full collection
+static void bench_major_pause(size_t threads) {
+    Value list = build_old_generation();
+    heap_set_mark_threads(threads);
+    double start = now_seconds();
+    heap_collect_major();
+    double pause = now_seconds() - start;
+    printf("  %-22s %8.3f ms pause, %zu threads\n", "stop the world", pause * 1e3,
+           heap_get_stats().mark_threads);
+    sink += value_as_array(list)->length;
+    heap_pop_roots(1);
+    heap_destroy();
+}
+
+// the pauses around background marking - seeding it from the roots,
+// then the allocation that finishes it and sweeps - and how long it took
+static void bench_concurrent_pause(size_t threads) {
+    Value list = build_old_generation();
+    heap_set_mark_threads(threads);
+    heap_set_concurrent_marking(1);
+    size_t majors = heap_get_stats().major_collections;
+    double start = now_seconds();
+    heap_start_major();
+    double first = now_seconds() - start;
+    double longest = 0;
+    while (heap_get_stats().major_collections == majors) {
+        // a program allocating meanwhile
+        double before = now_seconds();
+        sink += string_length(string_from_chars("temporary", 9));
+        double step = now_seconds() - before;
+        longest = step > longest ? step : longest;
+    }
+    double elapsed = now_seconds() - start;
+    printf("  %-22s %8.3f ms to start, %.3f ms to finish, %.3f ms in all, %zu threads\n", "concurrent",
+           first * 1e3, longest * 1e3, elapsed * 1e3, heap_get_stats().mark_threads);
+    sink += value_as_array(list)->length;
+    heap_pop_roots(1);
+    heap_destroy();
+}
+
+int main(void) {
+    printf("allocation - dead nursery objects should cost less than calloc and free\n");
+
+    report("nursery, all die", bench_nursery());
+    report("calloc and free", bench_calloc());
+    report("nursery, 1% survive", bench_survivors(100));
+    report("nursery, 10% survive", bench_survivors(10));
+
+    printf("full collection of %d old pairs - more threads and marking in the background should pause less\n",
+           PAUSE_PAIRS);
+    bench_major_pause(1);
+    bench_major_pause(4);
+    bench_concurrent_pause(4);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * bench_kernels.c - array kernel benchmarks for shardjs
+ *
+ * runs each kernel over arrays that fit in cache and arrays that don't,
+ * once per instruction set this cpu supports, next to the plain one
+ * accumulator loop a compiler would write for the same reduction.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/kernels.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// keeps the compiler from dropping results nobody reads
+static volatile double sink;
+
+static double naive_sum(const double *x, size_t n) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+static double* aligned_array(size_t n) {
+    void *memory;
+    if (posix_memalign(&memory, 32, n * sizeof(double)) != 0) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    double *x = memory;
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (double)(i % 1000) * 0.001;
+    }
+    return x;
+}
+
+static void report(const char *name, const char *isa, size_t n, int repeats, double seconds) {
+    double elements = (double)n * repeats;
+    printf("  %-6s %-7s %9zu elements  %8.3f ms  %6.3f ns/element\n",
+           name, isa, n, seconds * 1e3, seconds * 1e9 / elements);
+}
+
+static void bench_size(size_t n) {
+    double *x = aligned_array(n);
+    double *y = aligned_array(n);
+    int repeats = (int)(50000000 / n);
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    double start = now_seconds();
+    for (int r = 0; r < repeats; r++) {
+        sink = naive_sum(x, n);
+    }
+    report("sum", "naive", n, repeats, now_seconds() - start);
+
+    for (int isa = KERNEL_SCALAR; isa <= KERNEL_AVX2; isa++) {
+        if (!kernel_use_isa((KernelIsa)isa)) {
+            continue;
+        }
+        const char *name = kernel_isa_name((KernelIsa)isa);
+
+        start = now_seconds();
+        for (int r = 0; r < repeats; r++) {
+            sink = kernel_sum(x, n);
+        }
+        report("sum", name, n, repeats, now_seconds() - start);
+
+        start = now_seconds();
+        for (int r = 0; r < repeats; r++) {
+            sink = kernel_dot(x, y, n);
+        }
+        report("dot", name, n, repeats, now_seconds() - start);
+
+        start = now_seconds();
+        for (int r = 0; r < repeats; r++) {
+            sink = kernel_max(x, n);
+        }
+        report("max", name, n, repeats, now_seconds() - start);
+
+        // alternate signs so y stays bounded
+        start = now_seconds();
+        for (int r = 0; r < repeats; r++) {
+            kernel_axpy(r % 2 ? -0.5 : 0.5, x, y, n);
+        }
+        report("axpy", name, n, repeats, now_seconds() - start);
+    }
+
+    free(x);
+    free(y);
+}
+
+int main(void) {
+    printf("array kernels - simd paths should beat the naive loop in cache\n");
+
+    bench_size(4096);
+    bench_size(4 * 1024 * 1024);
+
+    kernel_use_isa(kernel_best_isa());
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * bench_linalg.c - matrix benchmarks for shardjs
+ *
+ * multiplies square matrices with the plain triple loop, through the
+ * blocked kernels on each instruction set on one thread, and split
+ * across threads. transpose and matvec are timed at the largest size.
+ * each time is the best of three runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../include/linalg.h"
+#include "../include/kernels.h"
+
+#define RUNS 3
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double flops, double seconds) {
+    printf("  %-28s %10.3f ms  %8.2f gflop/s\n", name, seconds * 1e3, flops / seconds / 1e9);
+}
+
+static volatile double sink;
+
+// i-k-j order, so the inner loop runs along rows of b and c
+static void naive_matmul(const double *a, const double *b, double *c, size_t n) {
+    for (size_t i = 0; i < n * n; i++) {
+        c[i] = 0.0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (size_t p = 0; p < n; p++) {
+            double x = a[i * n + p];
+            for (size_t j = 0; j < n; j++) {
+                c[i * n + j] += x * b[p * n + j];
+            }
+        }
+    }
+}
+
+static void bench_size(size_t n) {
+    double *a = malloc(n * n * sizeof(double));
+    double *b = malloc(n * n * sizeof(double));
+    double *c = malloc(n * n * sizeof(double));
+    for (size_t i = 0; i < n * n; i++) {
+        a[i] = (double)(i % 17) - 8.0;
+        b[i] = (double)(i % 13) * 0.25;
+    }
+    double flops = 2.0 * (double)n * (double)n * (double)n;
+    printf("%zux%zu matmul\n", n, n);
+
+    double best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        naive_matmul(a, b, c, n);
+        best = fmin(best, now_seconds() - start);
+    }
+    report("triple loop", flops, best);
+    sink = c[n];
+
+    KernelIsa isas[] = { KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            continue;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "blocked, %s", kernel_isa_name(isas[k]));
+        best = INFINITY;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now_seconds();
+            linalg_matmul(a, b, c, n, n, n, 1);
+            best = fmin(best, now_seconds() - start);
+        }
+        report(name, flops, best);
+        sink = c[n];
+    }
+    kernel_use_isa(kernel_best_isa());
+
+    size_t threads = 0;
+    best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        threads = linalg_matmul(a, b, c, n, n, n, 0);
+        best = fmin(best, now_seconds() - start);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "blocked, %zu thread%s", threads, threads == 1 ? "" : "s");
+    report(name, flops, best);
+    sink = c[n];
+
+    free(a);
+    free(b);
+    free(c);
+}
+
+static void bench_others(size_t n) {
+    double *a = malloc(n * n * sizeof(double));
+    double *out = malloc(n * n * sizeof(double));
+    for (size_t i = 0; i < n * n; i++) {
+        a[i] = (double)i;
+    }
+    printf("%zux%zu others\n", n, n);
+
+    double best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                out[j * n + i] = a[i * n + j];
+            }
+        }
+        best = fmin(best, now_seconds() - start);
+    }
+    printf("  %-28s %10.3f ms\n", "transpose, plain loops", best * 1e3);
+    sink = out[n];
+
+    best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        linalg_transpose(a, out, n, n);
+        best = fmin(best, now_seconds() - start);
+    }
+    printf("  %-28s %10.3f ms\n", "transpose, blocked", best * 1e3);
+    sink = out[n];
+
+    best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        linalg_matvec(a, a, out, n, n);
+        best = fmin(best, now_seconds() - start);
+    }
+    report("matvec", 2.0 * (double)n * (double)n, best);
+    sink = out[1];
+
+    free(a);
+    free(out);
+}
+
+int main(void) {
+    printf("matrices (%s kernels)\n", kernel_isa_name(kernel_current_isa()));
+    size_t sizes[] = { 64, 256, 1024 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_size(sizes[i]);
+    }
+    bench_others(2048);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * bench_map.c - map benchmarks for shardjs
+ *
+ * sets and then looks up n string keys in a Map and in an Environment,
+ * whose variables are found by a linear scan over their names. the
+ * scan's cost grows with n while the table's stays flat. then numeric
+ * keys at sizes the scan could never reach, and the mapAdd step of a
+ * group-by over a million rows.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/runtime.h"
+#include "../include/object.h"
+
+#define BENCH_LOOKUPS 20000
+#define BENCH_ROWS 1000000
+#define BENCH_GROUPS 50000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t n, const char *what, size_t operations, double seconds) {
+    printf("  %-10s n=%-8zu %8zu %-7s %10.3f ms  %8.1f ns/op\n",
+           name, n, operations, what, seconds * 1e3, seconds * 1e9 / (double)operations);
+}
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "map benchmark failed: %s\n", what);
+        exit(1);
+    }
+}
+
+static void bench_strings(size_t n) {
+    char (*names)[24] = malloc(n * sizeof(*names));
+    check(names != NULL, "out of memory");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(names[i], sizeof(names[i]), "key%zu", i);
+    }
+
+    // the environment - every set scans for the name first
+    Environment *env = env_create();
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        check(env_set_value(env, names[i], value_from_int((int32_t)i)), "env set");
+    }
+    report("env", n, "sets", n, now_seconds() - start);
+    start = now_seconds();
+    long sum = 0;
+    Value value;
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++) {
+        check(env_get_value(env, names[i % n], &value), "env get");
+        sum += value_as_int(value);
+    }
+    report("env", n, "lookups", BENCH_LOOKUPS, now_seconds() - start);
+    env_destroy(env);
+
+    // the same names as string keys, made up front and kept rooted
+    Value keys = array_create(n);
+    heap_push_root(&keys);
+    for (size_t i = 0; i < n; i++) {
+        Value key = string_from_chars(names[i], strlen(names[i]));
+        array_append(keys, key);
+    }
+    Value map = map_create();
+    heap_push_root(&map);
+    start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        check(map_set(map, array_get(keys, i), value_from_int((int32_t)i)), "map set");
+    }
+    report("Map", n, "sets", n, now_seconds() - start);
+    start = now_seconds();
+    long map_sum = 0;
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++) {
+        check(map_get(map, array_get(keys, i % n), &value), "map get");
+        map_sum += value_as_int(value);
+    }
+    report("Map", n, "lookups", BENCH_LOOKUPS, now_seconds() - start);
+    check(sum == map_sum, "lookups disagree");
+
+    heap_pop_roots(2);
+    heap_destroy();
+    free(names);
+}
+
+static void bench_numbers(size_t n) {
+    Value map = map_create();
+    heap_push_root(&map);
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        check(map_set(map, value_from_number((double)i * 3.5), value_from_int((int32_t)i)), "map set");
+    }
+    report("Map", n, "sets", n, now_seconds() - start);
+
+    start = now_seconds();
+    long sum = 0;
+    Value value;
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++) {
+        size_t k = (i * 7919) % n;
+        check(map_get(map, value_from_number((double)k * 3.5), &value), "map get");
+        sum += value_as_int(value);
+    }
+    report("Map", n, "lookups", BENCH_LOOKUPS, now_seconds() - start);
+    check(sum > 0, "lookups found nothing");
+    heap_pop_roots(1);
+    heap_destroy();
+}
+
+// sum a column by group - one mapAdd per row
+static void bench_group_by(void) {
+    Value map = map_create();
+    heap_push_root(&map);
+    uint64_t state = 1;
+    Value total;
+    double start = now_seconds();
+    for (size_t i = 0; i < BENCH_ROWS; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        int32_t group = (int32_t)((state >> 33) % BENCH_GROUPS);
+        check(map_add(map, value_from_int(group), 1.0, &total) == 1, "map add");
+    }
+    report("mapAdd", BENCH_GROUPS, "rows", BENCH_ROWS, now_seconds() - start);
+    check(value_as_map(map)->count == BENCH_GROUPS, "groups missing");
+    heap_pop_roots(1);
+    heap_destroy();
+}
+
+int main(void) {
+    printf("string keys - Map against the environment's linear scan\n");
+    bench_strings(100);
+    bench_strings(1000);
+    bench_strings(10000);
+
+    printf("number keys\n");
+    bench_numbers(1000);
+    bench_numbers(100000);
+    bench_numbers(1000000);
+
+    printf("group by\n");
+    bench_group_by();
+    return 0;
+}
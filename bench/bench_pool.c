@@ -0,0 +1,78 @@
+/*
+ * bench_pool.c - thread pool benchmarks for shardjs
+ *
+ * sums ten million doubles with the kernel on one thread and through
+ * the pool on one thread and on all of them, then tabulates sqrt over
+ * the same range both ways. each time is the best of five runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../include/pool.h"
+#include "../include/vecmath.h"
+#include "../include/kernels.h"
+
+#define COUNT 10000000
+#define RUNS 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-24s %10.3f ms  %8.2f ns/element\n", name, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static volatile double sink;
+
+int main(void) {
+    double *x = malloc(COUNT * sizeof(double));
+    double *out = malloc(COUNT * sizeof(double));
+    for (size_t i = 0; i < COUNT; i++) {
+        x[i] = (double)(i % 1000) * 0.5;
+    }
+    printf("pool over %d doubles (%s kernels)\n", COUNT, kernel_isa_name(kernel_current_isa()));
+
+    double best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        sink = kernel_sum(x, COUNT);
+        best = fmin(best, now_seconds() - start);
+    }
+    report("kernel_sum", COUNT, best);
+
+    size_t threads[] = { 1, 0 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        best = INFINITY;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now_seconds();
+            sink = pool_reduce(POOL_SUM, x, COUNT, threads[t]);
+            best = fmin(best, now_seconds() - start);
+        }
+        report(threads[t] ? "pool_reduce, 1 thread" : "pool_reduce, all threads", COUNT, best);
+    }
+
+    size_t used = 1;
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        best = INFINITY;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now_seconds();
+            used = pool_tabulate(vecmath_sqrt, 0.0, out, COUNT, threads[t]);
+            best = fmin(best, now_seconds() - start);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "tabulate sqrt, %zu thread%s", used, used == 1 ? "" : "s");
+        report(name, COUNT, best);
+        sink = out[COUNT / 2];
+    }
+    printf("  %zu steals\n", pool_steals());
+
+    free(x);
+    free(out);
+    return 0;
+}
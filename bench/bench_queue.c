@@ -0,0 +1,92 @@
+/*
+ * bench_queue.c - message queue benchmarks for shardjs
+ *
+ * one consumer takes a million messages posted by one, two and four
+ * producers through a ring the size workers use, and then through a
+ * ring of 16 where producers keep waiting for room. each time is the
+ * best of five runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "../include/queue.h"
+
+#define COUNT 1000000
+#define RUNS 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    MessageQueue *queue;
+    size_t count;
+} Producer;
+
+static void* produce(void *argument) {
+    Producer *producer = argument;
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.kind = MESSAGE_NUMBER;
+    for (size_t i = 0; i < producer->count; i++) {
+        message.number = (double)i;
+        queue_post(producer->queue, &message);
+    }
+    queue_remove_sender(producer->queue);
+    return NULL;
+}
+
+static volatile double sink;
+
+static double run(size_t capacity, size_t producers) {
+    MessageQueue *queue = queue_create(capacity);
+    Producer work[4];
+    pthread_t threads[4];
+    double start = now_seconds();
+    for (size_t p = 0; p < producers; p++) {
+        work[p].queue = queue;
+        work[p].count = COUNT / producers;
+        queue_add_sender(queue);
+    }
+    for (size_t p = 0; p < producers; p++) {
+        pthread_create(&threads[p], NULL, produce, &work[p]);
+    }
+    Message message;
+    double total = 0.0;
+    while (queue_take(queue, &message)) {
+        total += message.number;
+    }
+    for (size_t p = 0; p < producers; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    double elapsed = now_seconds() - start;
+    sink = total;
+    queue_release(queue);
+    return elapsed;
+}
+
+int main(void) {
+    printf("queue, %d messages\n", COUNT);
+    size_t capacities[] = { 1024, 16 };
+    size_t producer_counts[] = { 1, 2, 4 };
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        for (size_t p = 0; p < sizeof(producer_counts) / sizeof(producer_counts[0]); p++) {
+            double best = INFINITY;
+            for (int r = 0; r < RUNS; r++) {
+                best = fmin(best, run(capacities[c], producer_counts[p]));
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%zu slots, %zu producer%s", capacities[c], producer_counts[p],
+                     producer_counts[p] == 1 ? "" : "s");
+            printf("  %-24s %10.3f ms  %8.2f ns/message\n", name, best * 1e3, best * 1e9 / COUNT);
+        }
+    }
+    return 0;
+}
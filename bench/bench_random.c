@@ -0,0 +1,81 @@
+/*
+ * bench_random.c - random number benchmarks for shardjs
+ *
+ * fills ten million doubles one random_double at a time, then through
+ * the four-stream fill on each instruction set on one thread and split
+ * across threads. each time is the best of five runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../include/random.h"
+#include "../include/kernels.h"
+
+#define COUNT 10000000
+#define RUNS 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-24s %10.3f ms  %8.2f ns/element\n", name, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static volatile double sink;
+
+int main(void) {
+    double *out = malloc(COUNT * sizeof(double));
+    RandomState state;
+    random_seed(&state, 42);
+    printf("random fill of %d doubles (%s kernels)\n", COUNT, kernel_isa_name(kernel_current_isa()));
+
+    double best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = random_double(&state);
+        }
+        best = fmin(best, now_seconds() - start);
+    }
+    report("one at a time", COUNT, best);
+    sink = out[COUNT / 2];
+
+    KernelIsa isas[] = { KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            continue;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s fill", kernel_isa_name(isas[k]));
+        best = INFINITY;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now_seconds();
+            random_fill(&state, out, COUNT, 1);
+            best = fmin(best, now_seconds() - start);
+        }
+        report(name, COUNT, best);
+        sink = out[COUNT / 2];
+    }
+    kernel_use_isa(kernel_best_isa());
+
+    size_t threads = 0;
+    best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        threads = random_fill(&state, out, COUNT, 0);
+        best = fmin(best, now_seconds() - start);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "fill, %zu thread%s", threads, threads == 1 ? "" : "s");
+    report(name, COUNT, best);
+    sink = out[COUNT / 2];
+
+    free(out);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * bench_records.c - property access benchmarks for shardjs
+ *
+ * runs one property read node over and over against objects of one,
+ * four and eight shapes. with one or four the inline cache answers
+ * every read with a shape compare and a load; eight is more than a
+ * cache holds, so the site goes megamorphic and half its reads walk the
+ * shape chain, which is what every read would cost without the caches.
+ * each read also rebinds the variable, which costs the same throughout.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/runtime.h"
+#include "../include/object.h"
+
+#define BENCH_READS 2000000
+#define BENCH_OBJECTS 8
+
+static const char *property_names[] = {"a", "b", "c", "d", "e", "f", "g", "h"};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static StringObject* name(const char *chars) {
+    return value_as_string(string_intern(chars, strlen(chars)));
+}
+
+// objects with properties a to h after a different leading property for
+// each shape, so reading a walks eight shapes back on a lookup. the
+// objects are left rooted.
+static void build_objects(Value *objects, int shapes) {
+    char pad[16];
+    for (int i = 0; i < BENCH_OBJECTS; i++) {
+        objects[i] = record_create(shape_empty());
+        heap_push_root(&objects[i]);
+        snprintf(pad, sizeof(pad), "pad%d", i % shapes);
+        record_put(objects[i], name(pad), value_from_int(0));
+        for (int j = 0; j < 8; j++) {
+            record_put(objects[i], name(property_names[j]), value_from_int(i + j));
+        }
+    }
+}
+
+static double bench_site(int shapes, long *checksum) {
+    Value objects[BENCH_OBJECTS];
+    build_objects(objects, shapes);
+    Environment *env = env_create();
+    ASTNode *read = ast_create_property(ast_create_identifier("p"), "a");
+
+    double start = now_seconds();
+    long sum = 0;
+    for (int i = 0; i < BENCH_READS; i++) {
+        env_set_value(env, "p", objects[i % BENCH_OBJECTS]);
+        sum += value_as_int(interpret_value(read, env));
+    }
+    double elapsed = now_seconds() - start;
+    if (interpreter_has_error()) {
+        fprintf(stderr, "property benchmark failed: %s\n", interpreter_get_error());
+        exit(1);
+    }
+    *checksum = sum;
+
+    ast_destroy(read);
+    env_destroy(env);
+    heap_pop_roots(BENCH_OBJECTS);
+    heap_destroy();
+    return elapsed;
+}
+
+// the same objects read straight through the shape chain, no site at all
+static double bench_lookup(long *checksum) {
+    Value objects[BENCH_OBJECTS];
+    build_objects(objects, BENCH_OBJECTS);
+    StringObject *key = name("a");
+
+    double start = now_seconds();
+    long sum = 0;
+    for (int i = 0; i < BENCH_READS; i++) {
+        sum += value_as_int(record_get(objects[i % BENCH_OBJECTS], key));
+    }
+    double elapsed = now_seconds() - start;
+    *checksum = sum;
+    heap_pop_roots(BENCH_OBJECTS);
+    heap_destroy();
+    return elapsed;
+}
+
+static void report(const char *name, double seconds, long checksum, long expected) {
+    if (checksum != expected) {
+        fprintf(stderr, "%s read the wrong values\n", name);
+        exit(1);
+    }
+    printf("  %-14s %8d reads  %10.3f ms  %8.1f ns/read\n",
+           name, BENCH_READS, seconds * 1e3, seconds * 1e9 / BENCH_READS);
+}
+
+int main(void) {
+    printf("property reads - cached shapes should cost the same at 1 and 4\n");
+
+    long expected = 0;
+    for (int i = 0; i < BENCH_READS; i++) {
+        expected += i % BENCH_OBJECTS;
+    }
+    long checksum;
+    double seconds = bench_site(1, &checksum);
+    report("monomorphic", seconds, checksum, expected);
+    seconds = bench_site(4, &checksum);
+    report("polymorphic", seconds, checksum, expected);
+    seconds = bench_site(8, &checksum);
+    report("megamorphic", seconds, checksum, expected);
+    seconds = bench_lookup(&checksum);
+    report("chain lookup", seconds, checksum, expected);
+
+    PropertyCacheStats stats = interpreter_get_property_cache_stats();
+    printf("  inline caches: %zu hits, %zu misses, %zu megamorphic sites\n",
+           stats.hits, stats.misses, stats.megamorphic);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * bench_sort.c - sorting benchmarks for shardjs
+ *
+ * sorts the same doubles with sort_doubles and with the c library's
+ * qsort, at sizes either side of the radix cutoff, on random input and
+ * on input that is already nearly in order. then a large array on one
+ * thread and on as many as the machine offers.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/sort.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    uint64_t x = sort_key(*(const double*)a);
+    uint64_t y = sort_key(*(const double*)b);
+    return (x > y) - (x < y);
+}
+
+static uint64_t state = 2463534242ULL;
+
+static double random_double(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (double)(int64_t)state / 1e12;
+}
+
+static void fill(double *data, size_t n, int nearly_sorted) {
+    for (size_t i = 0; i < n; i++) {
+        data[i] = nearly_sorted ? (double)i : random_double();
+    }
+    if (nearly_sorted) {
+        for (size_t i = 0; i < n / 100 + 1; i++) {
+            size_t a = (size_t)(random_double() * 1e3) % n;
+            size_t b = (size_t)(random_double() * 1e3) % n;
+            double swap = data[a];
+            data[a] = data[b];
+            data[b] = swap;
+        }
+    }
+}
+
+static void check_sorted(const double *data, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        if (compare_doubles(&data[i - 1], &data[i]) > 0) {
+            fprintf(stderr, "sort benchmark produced unsorted output\n");
+            exit(1);
+        }
+    }
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-24s n=%-9zu %10.3f ms  %8.1f ns/element\n", name, n, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static void bench_size(size_t n, int nearly_sorted, int repeats) {
+    double *input = malloc(n * sizeof(double));
+    double *data = malloc(n * sizeof(double));
+    fill(input, n, nearly_sorted);
+
+    double sorted = 0.0, library = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        memcpy(data, input, n * sizeof(double));
+        double start = now_seconds();
+        sort_doubles(data, n, 0, 1);
+        sorted += now_seconds() - start;
+        check_sorted(data, n);
+
+        memcpy(data, input, n * sizeof(double));
+        start = now_seconds();
+        qsort(data, n, sizeof(double), compare_doubles);
+        library += now_seconds() - start;
+    }
+    const char *what = nearly_sorted ? "nearly sorted" : "random";
+    char name[64];
+    snprintf(name, sizeof(name), "sort %s", what);
+    report(name, n, sorted / repeats);
+    snprintf(name, sizeof(name), "qsort %s", what);
+    report(name, n, library / repeats);
+    free(input);
+    free(data);
+}
+
+static void bench_threads(size_t n) {
+    double *input = malloc(n * sizeof(double));
+    double *data = malloc(n * sizeof(double));
+    fill(input, n, 0);
+
+    memcpy(data, input, n * sizeof(double));
+    double start = now_seconds();
+    sort_doubles(data, n, 0, 1);
+    report("sort, 1 thread", n, now_seconds() - start);
+
+    memcpy(data, input, n * sizeof(double));
+    start = now_seconds();
+    size_t threads = sort_doubles(data, n, 0, 0);
+    char name[64];
+    snprintf(name, sizeof(name), "sort, %zu thread%s", threads, threads == 1 ? "" : "s");
+    report(name, n, now_seconds() - start);
+    check_sorted(data, n);
+    free(input);
+    free(data);
+}
+
+int main(void) {
+    printf("sorting doubles - pdqsort below %d elements, radix sort above\n", SORT_RADIX_MIN);
+    bench_size(500, 0, 200);
+    bench_size(500, 1, 200);
+    bench_size(100000, 0, 5);
+    bench_size(100000, 1, 5);
+    bench_size(2000000, 0, 1);
+
+    printf("large arrays across threads\n");
+    bench_threads(8000000);
+    return 0;
+}
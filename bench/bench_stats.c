@@ -0,0 +1,167 @@
+/*
+ * bench_stats.c - streaming accumulator benchmarks for shardjs
+ *
+ * feeds the same column of doubles to each accumulator one value at a
+ * time and as whole arrays, the way statsAdd gets them from a script,
+ * and compares the quantile sketch with sorting a copy to read exact
+ * quantiles off it. the histogram gets the same values in microseconds,
+ * and its encoded size is reported beside the size of its counts.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/stats.h"
+#include "../include/kernels.h"
+
+#define VALUES 4000000
+#define BATCH 65536
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t state = 2463534242ULL;
+
+static uint64_t next_random(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-32s %10.3f ms  %8.2f ns/value\n", name, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static volatile double sink;
+
+static void bench_moments(const double *x, size_t n) {
+    StatsMoments moments;
+    stats_moments_init(&moments);
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        stats_moments_add(&moments, x[i]);
+    }
+    report("moments, one at a time", n, now_seconds() - start);
+    sink = stats_moments_variance(&moments);
+
+    stats_moments_init(&moments);
+    start = now_seconds();
+    for (size_t i = 0; i < n; i += BATCH) {
+        stats_moments_add_batch(&moments, x + i, n - i < BATCH ? n - i : BATCH);
+    }
+    report("moments, batches", n, now_seconds() - start);
+    sink = stats_moments_variance(&moments);
+}
+
+static void bench_quantiles(const double *x, size_t n) {
+    StatsQuantiles *sketch = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        stats_quantiles_add(sketch, x[i]);
+    }
+    report("quantiles, one at a time", n, now_seconds() - start);
+    stats_quantiles_free(sketch);
+
+    sketch = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    start = now_seconds();
+    for (size_t i = 0; i < n; i += BATCH) {
+        stats_quantiles_add_batch(sketch, x + i, n - i < BATCH ? n - i : BATCH);
+    }
+    sink = stats_quantiles_quantile(sketch, 0.99);
+    report("quantiles, batches", n, now_seconds() - start);
+    stats_quantiles_free(sketch);
+
+    double *copy = malloc(n * sizeof(double));
+    start = now_seconds();
+    memcpy(copy, x, n * sizeof(double));
+    qsort(copy, n, sizeof(double), compare_doubles);
+    sink = copy[(size_t)(0.99 * (double)(n - 1))];
+    report("exact, copy and qsort", n, now_seconds() - start);
+    free(copy);
+}
+
+static void bench_distinct(const double *x, size_t n) {
+    StatsDistinct *distinct = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        stats_distinct_add_hash(distinct, stats_hash_number(x[i]));
+    }
+    report("distinct, one at a time", n, now_seconds() - start);
+    stats_distinct_free(distinct);
+
+    distinct = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    start = now_seconds();
+    for (size_t i = 0; i < n; i += BATCH) {
+        stats_distinct_add_numbers(distinct, x + i, n - i < BATCH ? n - i : BATCH);
+    }
+    sink = stats_distinct_estimate(distinct);
+    report("distinct, batches", n, now_seconds() - start);
+    printf("  estimate %.0f, with %d possible values\n", sink, VALUES / 4);
+    stats_distinct_free(distinct);
+}
+
+static void bench_histogram(const double *x, size_t n) {
+    double *micros = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++) {
+        micros[i] = x[i] * 1000.0;
+    }
+    StatsHistogram *histogram = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, STATS_HISTOGRAM_DEFAULT_DIGITS);
+    double start = now_seconds();
+    for (size_t i = 0; i < n; i++) {
+        stats_histogram_add(histogram, micros[i]);
+    }
+    report("histogram, one at a time", n, now_seconds() - start);
+    stats_histogram_free(histogram);
+
+    histogram = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, STATS_HISTOGRAM_DEFAULT_DIGITS);
+    start = now_seconds();
+    for (size_t i = 0; i < n; i += BATCH) {
+        stats_histogram_add_batch(histogram, micros + i, n - i < BATCH ? n - i : BATCH);
+    }
+    sink = stats_histogram_quantile(histogram, 0.99);
+    report("histogram, batches", n, now_seconds() - start);
+
+    size_t length;
+    start = now_seconds();
+    char *text = stats_histogram_encode(histogram, &length);
+    double encode = now_seconds() - start;
+    start = now_seconds();
+    StatsHistogram *back = stats_histogram_decode(text, length);
+    double decode = now_seconds() - start;
+    printf("  encoded in %.3f ms, decoded in %.3f ms: %zu characters for %zu bytes of counts\n",
+           encode * 1e3, decode * 1e3, length, histogram->length * sizeof(uint64_t));
+    stats_histogram_free(back);
+    free(text);
+    stats_histogram_free(histogram);
+    free(micros);
+}
+
+int main(void) {
+    // latencies with a tail a hundred times longer for one in seven,
+    // drawn from a quarter as many values as there are
+    double *x = malloc(VALUES * sizeof(double));
+    for (size_t i = 0; i < VALUES; i++) {
+        uint64_t r = next_random() % (VALUES / 4);
+        x[i] = (double)r * (r % 7 == 0 ? 0.1 : 0.001);
+    }
+
+    printf("streaming accumulators over %d values (%s kernels)\n", VALUES, kernel_isa_name(kernel_current_isa()));
+    bench_moments(x, VALUES);
+    bench_quantiles(x, VALUES);
+    bench_distinct(x, VALUES);
+    bench_histogram(x, VALUES);
+    free(x);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * bench_strings.c - string building benchmarks for shardjs
+ *
+ * appends short pieces to a growing string, the way reporting scripts
+ * build their output. rope concatenation should cost the same per
+ * append at every size, while copying the whole string on each append
+ * (what flat strings would do) grows with the length.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/runtime.h"
+#include "../include/object.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// append pieces through the runtime string api, then flatten once
+static double bench_rope(int appends) {
+    Value piece = string_intern("piece-", 6);
+    double start = now_seconds();
+
+    Value built = string_from_chars("", 0);
+    heap_push_root(&built);
+    for (int i = 0; i < appends; i++) {
+        built = string_concat(built, piece);
+    }
+    const char *chars = string_chars(built);
+    heap_pop_roots(1);
+
+    double elapsed = now_seconds() - start;
+    if (!chars || string_length(built) != (size_t)appends * 6) {
+        fprintf(stderr, "rope benchmark built the wrong string\n");
+        exit(1);
+    }
+    heap_destroy();
+    return elapsed;
+}
+
+// the same work with a fresh copy of the whole string on every append
+static double bench_copying(int appends) {
+    double start = now_seconds();
+
+    char *built = calloc(1, 1);
+    size_t length = 0;
+    for (int i = 0; i < appends; i++) {
+        char *next = malloc(length + 7);
+        if (!next) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        memcpy(next, built, length);
+        memcpy(next + length, "piece-", 7);
+        length += 6;
+        free(built);
+        built = next;
+    }
+
+    double elapsed = now_seconds() - start;
+    free(built);
+    return elapsed;
+}
+
+// run a generated script of repeated let s = s + "piece-"; statements
+static double bench_script(int appends) {
+    const char *header = "let s = \"\";\n";
+    const char *line = "let s = s + \"piece-\";\n";
+    const char *footer = "let n = 0;\n";
+    size_t size = strlen(header) + (size_t)appends * strlen(line) + strlen(footer) + 1;
+    char *source = malloc(size);
+    if (!source) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    char *cursor = source;
+    cursor += sprintf(cursor, "%s", header);
+    for (int i = 0; i < appends; i++) {
+        cursor += sprintf(cursor, "%s", line);
+    }
+    sprintf(cursor, "%s", footer);
+
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    ASTNode *program = parser_parse(parser);
+    Environment *env = env_create();
+    if (!program || parser_has_error(parser) || !env) {
+        fprintf(stderr, "script benchmark failed to parse\n");
+        exit(1);
+    }
+
+    double start = now_seconds();
+    interpret_value(program, env);
+    Value built;
+    int ok = !interpreter_has_error() && env_get_value(env, "s", &built) && string_chars(built);
+    double elapsed = now_seconds() - start;
+    if (!ok || string_length(built) != (size_t)appends * 6) {
+        fprintf(stderr, "script benchmark built the wrong string\n");
+        exit(1);
+    }
+
+    env_destroy(env);
+    ast_destroy(program);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    free(source);
+    heap_destroy();
+    return elapsed;
+}
+
+static void report(const char *name, int appends, double seconds) {
+    printf("  %-10s %8d appends  %10.3f ms  %8.1f ns/append\n",
+           name, appends, seconds * 1e3, seconds * 1e9 / appends);
+}
+
+int main(void) {
+    printf("string building - time per append should stay flat for ropes\n");
+
+    for (int appends = 12500; appends <= 200000; appends *= 2) {
+        report("rope", appends, bench_rope(appends));
+    }
+    // quadratic, so stop before it takes seconds
+    for (int appends = 12500; appends <= 100000; appends *= 2) {
+        report("copying", appends, bench_copying(appends));
+    }
+    for (int appends = 12500; appends <= 200000; appends *= 2) {
+        report("script", appends, bench_script(appends));
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * bench_vecmath.c - vectorized math benchmarks for shardjs
+ *
+ * times each function over a column of a million numbers calling libm
+ * once per element, then through the vector versions on each
+ * instruction set. each time is the best of five runs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../include/vecmath.h"
+#include "../include/kernels.h"
+
+#define COUNT 1000000
+#define RUNS 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t n, double seconds) {
+    printf("  %-24s %10.3f ms  %8.2f ns/element\n", name, seconds * 1e3, seconds * 1e9 / (double)n);
+}
+
+static volatile double sink;
+
+typedef struct {
+    const char *name;
+    double (*libm)(double x);
+    void (*vector)(const double *x, double *out, size_t n);
+    double low, high;   // the inputs are spread over this range
+} MathBench;
+
+static double pow_one(double x) {
+    return pow(x, 2.5);
+}
+
+static void pow_vector(const double *x, double *out, size_t n) {
+    double exponent = 2.5;
+    vecmath_pow(x, 1, &exponent, 0, out, n);
+}
+
+static void bench_function(const MathBench *bench, double *x, double *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        x[i] = bench->low + (bench->high - bench->low) * (double)((i * 2654435761u) % n) / (double)n;
+    }
+    printf("%s\n", bench->name);
+
+    double best = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now_seconds();
+        for (size_t i = 0; i < n; i++) {
+            out[i] = bench->libm(x[i]);
+        }
+        best = fmin(best, now_seconds() - start);
+    }
+    report("libm, one at a time", n, best);
+    sink = out[n / 2];
+
+    KernelIsa isas[] = { KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            continue;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s vectors", kernel_isa_name(isas[k]));
+        best = INFINITY;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now_seconds();
+            bench->vector(x, out, n);
+            best = fmin(best, now_seconds() - start);
+        }
+        report(name, n, best);
+        sink = out[n / 2];
+    }
+    kernel_use_isa(kernel_best_isa());
+}
+
+int main(void) {
+    double *x = malloc(COUNT * sizeof(double));
+    double *out = malloc(COUNT * sizeof(double));
+    for (size_t i = 0; i < COUNT; i++) {
+        out[i] = 0.0;
+    }
+
+    MathBench benches[] = {
+        { "sqrt", sqrt, vecmath_sqrt, 0.0, 1e6 },
+        { "exp", exp, vecmath_exp, -50.0, 50.0 },
+        { "log", log, vecmath_log, 1e-3, 1e6 },
+        { "sin", sin, vecmath_sin, -100.0, 100.0 },
+        { "cos", cos, vecmath_cos, -100.0, 100.0 },
+        { "pow(x, 2.5)", pow_one, pow_vector, 0.0, 1e3 },
+    };
+    printf("math over %d numbers (%s kernels)\n", COUNT, kernel_isa_name(kernel_current_isa()));
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        bench_function(&benches[i], x, out, COUNT);
+    }
+    free(x);
+    free(out);
+    return 0;
+}
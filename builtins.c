@@ -0,0 +1,1975 @@
+/*
+ * builtins.c - functions callable from shardjs scripts
+ *
+ * the array builtins check their arguments and lengths once per call,
+ * then hand the whole array to a kernel. no element goes through the
+ * interpreter, and the kernels themselves never bounds check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "include/runtime.h"
+#include "include/object.h"
+#include "include/kernels.h"
+#include "include/csv.h"
+#include "include/sort.h"
+#include "include/hash.h"
+#include "include/vecmath.h"
+#include "include/linalg.h"
+#include "include/random.h"
+#include "include/pool.h"
+#include "include/worker.h"
+
+// report a builtin error and give back the null the caller returns
+static Value builtin_error(const char *message) {
+    interpreter_set_error(message);
+    return VALUE_NULL;
+}
+
+// the array in argument position, or NULL after reporting a type error
+static Float64ArrayObject* array_argument(const char *name, Value *args, int position) {
+    if (!value_is_float64_array(args[position])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Float64Array as argument %d, got %s",
+                 name, position + 1, value_type_name(args[position]));
+        interpreter_set_error(error_msg);
+        return NULL;
+    }
+    return value_as_float64_array(args[position]);
+}
+
+// arrays mapped from files can be read but never written
+static int writable(const char *name, Float64ArrayObject *array) {
+    if (array->mapped) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s cannot modify a Float64Array mapped from a file", name);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+static int number_argument(const char *name, Value *args, int position, double *number) {
+    if (!value_is_number(args[position])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s expects a number as argument %d, got %s",
+                 name, position + 1, value_type_name(args[position]));
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    *number = value_to_number(args[position]);
+    return 1;
+}
+
+// the doubles of a Float64Array or of an array holding only numbers,
+// which keeps them unboxed. 0 after reporting a type error.
+static int numbers_argument(const char *name, Value *args, int position, const double **data, size_t *length) {
+    if (value_is_array(args[position]) && value_as_array(args[position])->kind == ARRAY_NUMBERS) {
+        ArrayObject *array = value_as_array(args[position]);
+        *data = &array_elements(array)->number;
+        *length = array->length;
+        return 1;
+    }
+    if (value_is_float64_array(args[position])) {
+        Float64ArrayObject *array = value_as_float64_array(args[position]);
+        *data = array->data;
+        *length = array->length;
+        return 1;
+    }
+    char error_msg[256];
+    if (value_is_array(args[position])) {
+        snprintf(error_msg, sizeof(error_msg), "%s expects an array of numbers as argument %d, got one holding other values",
+                 name, position + 1);
+    } else {
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Float64Array or an array of numbers as argument %d, got %s",
+                 name, position + 1, value_type_name(args[position]));
+    }
+    interpreter_set_error(error_msg);
+    return 0;
+}
+
+static int same_lengths(const char *name, size_t x, size_t y) {
+    if (x != y) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s needs arrays of the same length, got %zu and %zu",
+                 name, x, y);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+static Value builtin_float64_array(Value *args, int count) {
+    (void)count;
+    double length;
+    if (!number_argument("Float64Array", args, 0, &length)) {
+        return VALUE_NULL;
+    }
+    if (!(length >= 0.0 && length <= (double)UINT32_MAX) || length != (double)(uint32_t)length) {
+        return builtin_error("Float64Array length must be a non-negative integer");
+    }
+
+    Value array = float64_array_create((size_t)length);
+    if (value_is_null(array)) {
+        return builtin_error("Out of memory allocating Float64Array");
+    }
+    return array;
+}
+
+// mapFloat64(path) exposes a file of doubles as a read-only array
+static Value builtin_map_float64(Value *args, int count) {
+    (void)count;
+    if (!value_is_string(args[0])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "mapFloat64 expects a string as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    const char *path = string_chars(args[0]);
+    if (!path) {
+        return builtin_error("Out of memory reading path");
+    }
+
+    char reason[200];
+    Value array = float64_array_map(path, reason, sizeof(reason));
+    if (value_is_null(array)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "mapFloat64 %s", reason);
+        return builtin_error(error_msg);
+    }
+    return array;
+}
+
+// readCsvColumns(path, ["a", "b"]) gives [Float64Array, Float64Array]
+static Value builtin_read_csv_columns(Value *args, int count) {
+    (void)count;
+    char error_msg[256];
+    if (!value_is_string(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "readCsvColumns expects a string as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    if (!value_is_array(args[1])) {
+        snprintf(error_msg, sizeof(error_msg), "readCsvColumns expects an array of names as argument 2, got %s",
+                 value_type_name(args[1]));
+        return builtin_error(error_msg);
+    }
+
+    // the result is allocated before any characters are borrowed, since
+    // an allocation can move the strings they live in
+    size_t columns = value_as_array(args[1])->length;
+    const char **names = malloc((columns + 1) * sizeof(char*));
+    double **data = malloc((columns + 1) * sizeof(double*));
+    Value result = array_create(columns);
+    if (!names || !data || value_is_null(result)) {
+        free(names);
+        free(data);
+        return builtin_error("Out of memory reading CSV");
+    }
+    for (size_t i = 0; i < columns; i++) {
+        Value wanted = array_get(args[1], i);
+        names[i] = value_is_string(wanted) ? string_chars(wanted) : NULL;
+        if (!names[i]) {
+            free(names);
+            free(data);
+            return builtin_error("readCsvColumns column names must be strings");
+        }
+    }
+
+    const char *path = string_chars(args[0]);
+    char reason[200];
+    CsvResult read;
+    if (!path || !csv_read_columns(path, names, columns, 0, data, &read, reason, sizeof(reason))) {
+        free(names);
+        free(data);
+        snprintf(error_msg, sizeof(error_msg), "readCsvColumns %s", path ? reason : "out of memory");
+        return builtin_error(error_msg);
+    }
+
+    int ok = 1;
+    heap_push_root(&result);
+    for (size_t i = 0; i < columns; i++) {
+        Value column = ok ? float64_array_adopt(data[i], read.rows) : VALUE_NULL;
+        if (value_is_null(column)) {
+            free(data[i]);
+            ok = 0;
+            continue;
+        }
+        array_append(result, column);
+    }
+    heap_pop_roots(1);
+    free(names);
+    free(data);
+    return ok ? result : builtin_error("Out of memory reading CSV");
+}
+
+static Value builtin_length(Value *args, int count) {
+    (void)count;
+    if (value_is_string(args[0])) {
+        return value_from_number((double)string_length(args[0]));
+    }
+    if (value_is_array(args[0])) {
+        return value_from_number((double)value_as_array(args[0])->length);
+    }
+    if (value_is_map(args[0])) {
+        return value_from_number((double)value_as_map(args[0])->count);
+    }
+    if (value_is_shared_array(args[0])) {
+        return value_from_number((double)value_as_shared_array(args[0])->buffer->length);
+    }
+    Float64ArrayObject *array = array_argument("length", args, 0);
+    return array ? value_from_number((double)array->length) : VALUE_NULL;
+}
+
+static Value builtin_sum(Value *args, int count) {
+    (void)count;
+    const double *data;
+    size_t length;
+    if (!numbers_argument("sum", args, 0, &data, &length)) {
+        return VALUE_NULL;
+    }
+    return value_from_double(kernel_sum(data, length));
+}
+
+// min and max of an empty array follow Math.min() and Math.max()
+static Value builtin_min(Value *args, int count) {
+    (void)count;
+    const double *data;
+    size_t length;
+    if (!numbers_argument("min", args, 0, &data, &length)) {
+        return VALUE_NULL;
+    }
+    return value_from_double(length ? kernel_min(data, length) : INFINITY);
+}
+
+static Value builtin_max(Value *args, int count) {
+    (void)count;
+    const double *data;
+    size_t length;
+    if (!numbers_argument("max", args, 0, &data, &length)) {
+        return VALUE_NULL;
+    }
+    return value_from_double(length ? kernel_max(data, length) : -INFINITY);
+}
+
+static Value builtin_dot(Value *args, int count) {
+    (void)count;
+    const double *x, *y;
+    size_t x_length, y_length;
+    if (!numbers_argument("dot", args, 0, &x, &x_length) || !numbers_argument("dot", args, 1, &y, &y_length) ||
+        !same_lengths("dot", x_length, y_length)) {
+        return VALUE_NULL;
+    }
+    return value_from_double(kernel_dot(x, y, x_length));
+}
+
+// scale(x, factor) multiplies x in place and returns it
+static Value builtin_scale(Value *args, int count) {
+    (void)count;
+    double factor;
+    Float64ArrayObject *x = array_argument("scale", args, 0);
+    if (!x || !writable("scale", x) || !number_argument("scale", args, 1, &factor)) {
+        return VALUE_NULL;
+    }
+    kernel_scale(x->data, factor, x->length);
+    return args[0];
+}
+
+// axpy(alpha, x, y) adds alpha * x to y in place and returns y
+static Value builtin_axpy(Value *args, int count) {
+    (void)count;
+    double alpha;
+    if (!number_argument("axpy", args, 0, &alpha)) {
+        return VALUE_NULL;
+    }
+    Float64ArrayObject *x = array_argument("axpy", args, 1);
+    Float64ArrayObject *y = x ? array_argument("axpy", args, 2) : NULL;
+    if (!y || !writable("axpy", y) || !same_lengths("axpy", x->length, y->length)) {
+        return VALUE_NULL;
+    }
+    kernel_axpy(alpha, x->data, y->data, x->length);
+    return args[2];
+}
+
+// push(a, x) appends x and gives the new length
+static Value builtin_push(Value *args, int count) {
+    (void)count;
+    if (!value_is_array(args[0])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "push expects an array as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    if (!array_append(args[0], args[1])) {
+        return builtin_error("Out of memory growing array");
+    }
+    return value_from_number((double)value_as_array(args[0])->length);
+}
+
+// pop(a) takes off the last element, null when there is none
+static Value builtin_pop(Value *args, int count) {
+    (void)count;
+    if (!value_is_array(args[0])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "pop expects an array as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    Value item;
+    return array_pop(args[0], &item) ? item : VALUE_NULL;
+}
+
+// the optional order argument of sort and sortBy - 1 for descending,
+// -1 after an error
+static int sort_order(const char *name, Value *args, int count, int position) {
+    if (count <= position) {
+        return 0;
+    }
+    if (value_is_string(args[position])) {
+        const char *order = string_chars(args[position]);
+        if (order && strcmp(order, "asc") == 0) {
+            return 0;
+        }
+        if (order && strcmp(order, "desc") == 0) {
+            return 1;
+        }
+    }
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg), "%s order must be \"asc\" or \"desc\"", name);
+    interpreter_set_error(error_msg);
+    return -1;
+}
+
+// a record for one sort key, or 0 after reporting a type error. text
+// is flattened here, so nothing allocates once the sorting starts.
+static int sort_record(const char *name, Value key, size_t index, SortRecord *record) {
+    record->index = index;
+    if (value_is_number(key)) {
+        record->is_text = 0;
+        record->key = sort_key(value_to_number(key));
+        return 1;
+    }
+    if (value_is_string(key)) {
+        record->is_text = 1;
+        record->chars = string_chars(key);
+        record->length = string_length(key);
+        if (!record->chars) {
+            interpreter_set_error("Out of memory sorting");
+            return 0;
+        }
+        return 1;
+    }
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg), "%s can only order numbers and strings, got %s at index %zu",
+             name, value_type_name(key), index);
+    interpreter_set_error(error_msg);
+    return 0;
+}
+
+// sort the elements of an array of values by key - their own value, or
+// the property field of each when by_field is set. field is NULL when no
+// record can have it, so every key is null.
+static int sort_values(const char *name, Value array, int by_field, const StringObject *field,
+                       int descending) {
+    size_t n = value_as_array(array)->length;
+    SortRecord *records = malloc((n ? n : 1) * sizeof(SortRecord));
+    Value *items = malloc((n ? n : 1) * sizeof(Value));
+    if (!records || !items) {
+        free(records);
+        free(items);
+        interpreter_set_error("Out of memory sorting");
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        items[i] = array_get(array, i);
+        Value key = items[i];
+        if (by_field) {
+            if (!value_is_record(key)) {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg), "%s expects an array of objects, got %s at index %zu",
+                         name, value_type_name(key), i);
+                interpreter_set_error(error_msg);
+                break;
+            }
+            key = field ? record_get(key, field) : VALUE_NULL;
+        }
+        if (!sort_record(name, key, i, &records[i])) {
+            break;
+        }
+    }
+    int ok = !interpreter_has_error();
+    if (ok) {
+        sort_records(records, n, descending);
+        for (size_t i = 0; i < n; i++) {
+            array_set(array, i, items[records[i].index]);
+        }
+    }
+    free(records);
+    free(items);
+    return ok;
+}
+
+// sort(a) or sort(a, "desc") orders numbers, NaN last, or strings byte
+// by byte, in place, and returns a. numbers come before strings.
+static Value builtin_sort(Value *args, int count) {
+    int descending = sort_order("sort", args, count, 1);
+    if (descending < 0) {
+        return VALUE_NULL;
+    }
+    double *data = NULL;
+    size_t length = 0;
+    if (value_is_float64_array(args[0])) {
+        Float64ArrayObject *array = value_as_float64_array(args[0]);
+        if (!writable("sort", array)) {
+            return VALUE_NULL;
+        }
+        data = array->data;
+        length = array->length;
+    } else if (value_is_array(args[0]) && value_as_array(args[0])->kind == ARRAY_NUMBERS) {
+        ArrayObject *array = value_as_array(args[0]);
+        data = &array_elements(array)->number;
+        length = array->length;
+    } else if (value_is_array(args[0])) {
+        return sort_values("sort", args[0], 0, NULL, descending) ? args[0] : VALUE_NULL;
+    } else {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "sort expects an array as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    if (length > 1 && !sort_doubles(data, length, descending, 0)) {
+        return builtin_error("Out of memory sorting");
+    }
+    return args[0];
+}
+
+// sortBy(a, "field") orders an array of objects by one property, keeping
+// the order of objects whose keys are equal
+static Value builtin_sort_by(Value *args, int count) {
+    char error_msg[256];
+    int descending = sort_order("sortBy", args, count, 2);
+    if (descending < 0) {
+        return VALUE_NULL;
+    }
+    if (!value_is_array(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "sortBy expects an array as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    if (!value_is_string(args[1])) {
+        snprintf(error_msg, sizeof(error_msg), "sortBy expects a property name as argument 2, got %s",
+                 value_type_name(args[1]));
+        return builtin_error(error_msg);
+    }
+    // property names are interned literals, so a name nothing interned is
+    // on no record - looking it up rather than interning it keeps names
+    // built at runtime out of the pinned table
+    const char *chars = string_chars(args[1]);
+    if (!chars) {
+        return builtin_error("Out of memory sorting");
+    }
+    Value field = string_find_interned(chars, string_length(args[1]));
+    if (!sort_values("sortBy", args[0], 1, value_is_null(field) ? NULL : value_as_string(field),
+                     descending)) {
+        return VALUE_NULL;
+    }
+    return args[0];
+}
+
+// maps - the map comes first, then the key
+static int map_arguments(const char *name, Value *args) {
+    char error_msg[256];
+    if (!value_is_map(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Map as argument 1, got %s",
+                 name, value_type_name(args[0]));
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    if (!map_key_valid(args[1])) {
+        snprintf(error_msg, sizeof(error_msg), "%s keys must be numbers or strings, got %s",
+                 name, value_type_name(args[1]));
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+static Value builtin_map(Value *args, int count) {
+    (void)args;
+    (void)count;
+    Value map = map_create();
+    return value_is_null(map) ? builtin_error("Out of memory creating Map") : map;
+}
+
+static Value builtin_map_get(Value *args, int count) {
+    (void)count;
+    Value value;
+    if (!map_arguments("mapGet", args)) {
+        return VALUE_NULL;
+    }
+    return map_get(args[0], args[1], &value) ? value : VALUE_NULL;
+}
+
+static Value builtin_map_has(Value *args, int count) {
+    (void)count;
+    Value value;
+    if (!map_arguments("mapHas", args)) {
+        return VALUE_NULL;
+    }
+    return value_from_bool(map_get(args[0], args[1], &value));
+}
+
+static Value builtin_map_set(Value *args, int count) {
+    (void)count;
+    if (!map_arguments("mapSet", args)) {
+        return VALUE_NULL;
+    }
+    return map_set(args[0], args[1], args[2]) ? args[0] : builtin_error("Out of memory growing Map");
+}
+
+static Value builtin_map_delete(Value *args, int count) {
+    (void)count;
+    if (!map_arguments("mapDelete", args)) {
+        return VALUE_NULL;
+    }
+    return value_from_bool(map_delete(args[0], args[1]));
+}
+
+// mapAdd(m, key, x) - the aggregation step, m[key] = (m[key] or 0) + x
+static Value builtin_map_add(Value *args, int count) {
+    (void)count;
+    double amount;
+    if (!map_arguments("mapAdd", args) || !number_argument("mapAdd", args, 2, &amount)) {
+        return VALUE_NULL;
+    }
+    Value total;
+    int result = map_add(args[0], args[1], amount, &total);
+    if (result < 0) {
+        return builtin_error("mapAdd can only add to a number");
+    }
+    return result ? total : builtin_error("Out of memory growing Map");
+}
+
+// the keys or values of a map as an array, in insertion order
+static Value map_column(const char *name, Value *args, int values) {
+    if (!value_is_map(args[0])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Map, got %s", name, value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    Value array = array_create(value_as_map(args[0])->count);
+    if (value_is_null(array)) {
+        return builtin_error("Out of memory listing Map");
+    }
+    // the map may have moved while the array was allocated
+    MapObject *map = value_as_map(args[0]);
+    for (size_t i = 0; i < map->entry_count; i++) {
+        MapEntry *entry = &map->entries[i];
+        if (!value_is_null(entry->key)) {
+            array_append(array, values ? entry->value : entry->key);
+        }
+    }
+    return array;
+}
+
+static Value builtin_map_keys(Value *args, int count) {
+    (void)count;
+    return map_column("mapKeys", args, 0);
+}
+
+static Value builtin_map_values(Value *args, int count) {
+    (void)count;
+    return map_column("mapValues", args, 1);
+}
+
+// accumulators - Stats(), Quantiles([accuracy]), Distinct([precision])
+// and Histogram([highest[, digits]]) are fed with statsAdd and read with
+// the other stats builtins. kinds is a mask of the SketchKinds the
+// builtin takes, described by expected.
+#define ALL_SKETCHES ((1u << SKETCH_STATS) | (1u << SKETCH_QUANTILES) | (1u << SKETCH_DISTINCT) | \
+                      (1u << SKETCH_HISTOGRAM))
+#define ALL_SKETCH_NAMES "a Stats, Quantiles, Distinct or Histogram"
+
+static SketchObject* sketch_argument(const char *name, Value *args, unsigned kinds, const char *expected) {
+    if (!value_is_sketch(args[0]) || !(kinds & (1u << value_as_sketch(args[0])->kind))) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s expects %s as argument 1, got %s",
+                 name, expected, value_type_name(args[0]));
+        interpreter_set_error(error_msg);
+        return NULL;
+    }
+    return value_as_sketch(args[0]);
+}
+
+static Value new_sketch(SketchKind kind, double setting) {
+    Value sketch = sketch_create(kind, setting);
+    if (value_is_null(sketch)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "Out of memory creating %s", sketch_kind_name(kind));
+        return builtin_error(error_msg);
+    }
+    return sketch;
+}
+
+static Value builtin_stats(Value *args, int count) {
+    (void)args;
+    (void)count;
+    return new_sketch(SKETCH_STATS, 0.0);
+}
+
+// Quantiles(0.01) answers within 1% of the true value
+static Value builtin_quantiles(Value *args, int count) {
+    double accuracy = STATS_SKETCH_DEFAULT_ACCURACY;
+    if (count > 0 && !number_argument("Quantiles", args, 0, &accuracy)) {
+        return VALUE_NULL;
+    }
+    if (!(accuracy >= STATS_SKETCH_MIN_ACCURACY && accuracy <= STATS_SKETCH_MAX_ACCURACY)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "Quantiles accuracy must be between %g and %g",
+                 STATS_SKETCH_MIN_ACCURACY, STATS_SKETCH_MAX_ACCURACY);
+        return builtin_error(error_msg);
+    }
+    return new_sketch(SKETCH_QUANTILES, accuracy);
+}
+
+// Distinct(14) keeps 2^14 registers
+static Value builtin_distinct(Value *args, int count) {
+    double precision = STATS_DISTINCT_DEFAULT_PRECISION;
+    if (count > 0 && !number_argument("Distinct", args, 0, &precision)) {
+        return VALUE_NULL;
+    }
+    if (!(precision >= STATS_DISTINCT_MIN_PRECISION && precision <= STATS_DISTINCT_MAX_PRECISION) ||
+        precision != (double)(int)precision) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "Distinct precision must be an integer from %d to %d",
+                 STATS_DISTINCT_MIN_PRECISION, STATS_DISTINCT_MAX_PRECISION);
+        return builtin_error(error_msg);
+    }
+    return new_sketch(SKETCH_DISTINCT, precision);
+}
+
+// Histogram(3600000000, 3) records whole numbers up to an hour in
+// microseconds, telling apart values that differ in 3 significant digits
+static Value builtin_histogram(Value *args, int count) {
+    double highest = STATS_HISTOGRAM_DEFAULT_HIGHEST;
+    double digits = STATS_HISTOGRAM_DEFAULT_DIGITS;
+    if (count > 0 && !number_argument("Histogram", args, 0, &highest)) {
+        return VALUE_NULL;
+    }
+    if (count > 1 && !number_argument("Histogram", args, 1, &digits)) {
+        return VALUE_NULL;
+    }
+    char error_msg[256];
+    if (!(highest >= 2.0 && highest <= STATS_HISTOGRAM_MAX_HIGHEST)) {
+        snprintf(error_msg, sizeof(error_msg), "Histogram highest value must be between 2 and %.0f",
+                 STATS_HISTOGRAM_MAX_HIGHEST);
+        return builtin_error(error_msg);
+    }
+    if (!(digits >= STATS_HISTOGRAM_MIN_DIGITS && digits <= STATS_HISTOGRAM_MAX_DIGITS) ||
+        digits != (double)(int)digits) {
+        snprintf(error_msg, sizeof(error_msg), "Histogram digits must be an integer from %d to %d",
+                 STATS_HISTOGRAM_MIN_DIGITS, STATS_HISTOGRAM_MAX_DIGITS);
+        return builtin_error(error_msg);
+    }
+    StatsHistogram *histogram = stats_histogram_create(highest, (int)digits);
+    Value sketch = histogram ? sketch_from_histogram(histogram) : VALUE_NULL;
+    if (value_is_null(sketch)) {
+        return builtin_error("Out of memory creating Histogram");
+    }
+    return sketch;
+}
+
+// a value a Quantiles or Histogram would not take
+static Value refused(const SketchObject *sketch, double x, size_t index, int batch) {
+    char text[32], wanted[64], error_msg[256];
+    value_format(value_from_double(x), text, sizeof(text));
+    if (sketch->kind == SKETCH_HISTOGRAM) {
+        snprintf(wanted, sizeof(wanted), "numbers from 0 to %lld to a Histogram",
+                 (long long)sketch->as.histogram->highest);
+    } else {
+        snprintf(wanted, sizeof(wanted), "finite numbers to Quantiles");
+    }
+    if (batch) {
+        snprintf(error_msg, sizeof(error_msg), "statsAdd can only add %s, got %s at index %zu", wanted, text, index);
+    } else {
+        snprintf(error_msg, sizeof(error_msg), "statsAdd can only add %s, got %s", wanted, text);
+    }
+    return builtin_error(error_msg);
+}
+
+// a Distinct counts numbers and strings, from any kind of array
+static Value distinct_add(SketchObject *sketch, Value *args) {
+    StatsDistinct *distinct = sketch->as.distinct;
+    Value x = args[1];
+    if (value_is_number(x)) {
+        stats_distinct_add_hash(distinct, stats_hash_number(value_as_number(x)));
+        return args[0];
+    }
+    if (value_is_string(x)) {
+        const char *chars = string_chars(x);
+        if (!chars) {
+            return builtin_error("Out of memory reading string");
+        }
+        stats_distinct_add_hash(distinct, stats_hash_bytes(chars, string_length(x)));
+        return args[0];
+    }
+    if (value_is_array(x) && value_as_array(x)->kind == ARRAY_VALUES) {
+        // checked whole before anything is counted
+        ArrayObject *array = value_as_array(x);
+        ArrayElement *elements = array_elements(array);
+        for (size_t i = 0; i < array->length; i++) {
+            if (!map_key_valid(elements[i].value)) {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg), "statsAdd can only count numbers and strings, got %s at index %zu",
+                         value_type_name(elements[i].value), i);
+                return builtin_error(error_msg);
+            }
+        }
+        for (size_t i = 0; i < array->length; i++) {
+            Value element = elements[i].value;
+            if (value_is_number(element)) {
+                stats_distinct_add_hash(distinct, stats_hash_number(value_as_number(element)));
+                continue;
+            }
+            const char *chars = string_chars(element);
+            if (!chars) {
+                return builtin_error("Out of memory reading string");
+            }
+            stats_distinct_add_hash(distinct, stats_hash_bytes(chars, string_length(element)));
+        }
+        return args[0];
+    }
+    if (!value_is_array(x) && !value_is_float64_array(x)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "statsAdd expects a number, a string or an array as argument 2, got %s",
+                 value_type_name(x));
+        return builtin_error(error_msg);
+    }
+    const double *data;
+    size_t length;
+    numbers_argument("statsAdd", args, 1, &data, &length);
+    stats_distinct_add_numbers(distinct, data, length);
+    return args[0];
+}
+
+// statsAdd(acc, x) adds a number, or every element of an array at once,
+// and returns acc
+static Value builtin_stats_add(Value *args, int count) {
+    (void)count;
+    SketchObject *sketch = sketch_argument("statsAdd", args, ALL_SKETCHES, ALL_SKETCH_NAMES);
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    if (sketch->kind == SKETCH_DISTINCT) {
+        return distinct_add(sketch, args);
+    }
+
+    if (value_is_number(args[1])) {
+        double x = value_as_number(args[1]);
+        if (sketch->kind == SKETCH_STATS) {
+            stats_moments_add(&sketch->as.moments, x);
+        } else if (sketch->kind == SKETCH_HISTOGRAM ? !stats_histogram_add(sketch->as.histogram, x) :
+                   !stats_quantiles_add(sketch->as.quantiles, x)) {
+            return refused(sketch, x, 0, 0);
+        }
+        return args[0];
+    }
+    if (!value_is_array(args[1]) && !value_is_float64_array(args[1])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "statsAdd expects a number or an array of numbers as argument 2, got %s",
+                 value_type_name(args[1]));
+        return builtin_error(error_msg);
+    }
+    const double *data;
+    size_t length;
+    if (!numbers_argument("statsAdd", args, 1, &data, &length)) {
+        return VALUE_NULL;
+    }
+    if (sketch->kind == SKETCH_STATS) {
+        stats_moments_add_batch(&sketch->as.moments, data, length);
+        return args[0];
+    }
+    size_t added = sketch->kind == SKETCH_HISTOGRAM ? stats_histogram_add_batch(sketch->as.histogram, data, length) :
+                   stats_quantiles_add_batch(sketch->as.quantiles, data, length);
+    return added == length ? args[0] : refused(sketch, data[added], added, 1);
+}
+
+// how many values went in - an estimate of the different ones for a
+// Distinct
+static Value builtin_stats_count(Value *args, int count) {
+    (void)count;
+    SketchObject *sketch = sketch_argument("statsCount", args, ALL_SKETCHES, ALL_SKETCH_NAMES);
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    switch (sketch->kind) {
+        case SKETCH_STATS:
+            return value_from_number((double)sketch->as.moments.count);
+        case SKETCH_QUANTILES:
+            return value_from_number((double)sketch->as.quantiles->count);
+        case SKETCH_HISTOGRAM:
+            return value_from_number((double)sketch->as.histogram->count);
+        default: {
+            double estimate = stats_distinct_estimate(sketch->as.distinct);
+            return value_from_number((double)(uint64_t)(estimate + 0.5));
+        }
+    }
+}
+
+// the readings are null until enough values have been added to give one.
+// a Histogram's mean is of the whole numbers it recorded.
+static Value builtin_stats_mean(Value *args, int count) {
+    (void)count;
+    unsigned kinds = (1u << SKETCH_STATS) | (1u << SKETCH_HISTOGRAM);
+    SketchObject *sketch = sketch_argument("statsMean", args, kinds, "a Stats or Histogram");
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    if (sketch->kind == SKETCH_HISTOGRAM) {
+        StatsHistogram *histogram = sketch->as.histogram;
+        return histogram->count ? value_from_double(histogram->sum / (double)histogram->count) : VALUE_NULL;
+    }
+    return sketch->as.moments.count ? value_from_double(sketch->as.moments.mean) : VALUE_NULL;
+}
+
+static Value builtin_stats_variance(Value *args, int count) {
+    (void)count;
+    SketchObject *sketch = sketch_argument("statsVariance", args, 1u << SKETCH_STATS, "a Stats");
+    if (!sketch || sketch->as.moments.count < 2) {
+        return VALUE_NULL;
+    }
+    return value_from_double(stats_moments_variance(&sketch->as.moments));
+}
+
+static Value stats_bound(const char *name, Value *args, int highest) {
+    unsigned kinds = (1u << SKETCH_STATS) | (1u << SKETCH_QUANTILES) | (1u << SKETCH_HISTOGRAM);
+    SketchObject *sketch = sketch_argument(name, args, kinds, "a Stats, Quantiles or Histogram");
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    if (sketch->kind == SKETCH_STATS) {
+        StatsMoments *moments = &sketch->as.moments;
+        return moments->count ? value_from_double(highest ? moments->max : moments->min) : VALUE_NULL;
+    }
+    if (sketch->kind == SKETCH_HISTOGRAM) {
+        StatsHistogram *histogram = sketch->as.histogram;
+        return histogram->count ? value_from_number((double)(highest ? histogram->max : histogram->min)) : VALUE_NULL;
+    }
+    StatsQuantiles *quantiles = sketch->as.quantiles;
+    return quantiles->count ? value_from_double(highest ? quantiles->max : quantiles->min) : VALUE_NULL;
+}
+
+static Value builtin_stats_min(Value *args, int count) {
+    (void)count;
+    return stats_bound("statsMin", args, 0);
+}
+
+static Value builtin_stats_max(Value *args, int count) {
+    (void)count;
+    return stats_bound("statsMax", args, 1);
+}
+
+// statsQuantile(q, 0.99) - within the sketch's accuracy of the value
+// 99% of the way through the ones added. a Histogram answers with the
+// top of the bucket holding that value.
+static Value builtin_stats_quantile(Value *args, int count) {
+    (void)count;
+    double fraction;
+    unsigned kinds = (1u << SKETCH_QUANTILES) | (1u << SKETCH_HISTOGRAM);
+    SketchObject *sketch = sketch_argument("statsQuantile", args, kinds, "a Quantiles or Histogram");
+    if (!sketch || !number_argument("statsQuantile", args, 1, &fraction)) {
+        return VALUE_NULL;
+    }
+    if (!(fraction >= 0.0 && fraction <= 1.0)) {
+        return builtin_error("statsQuantile fraction must be between 0 and 1");
+    }
+    if (sketch->kind == SKETCH_HISTOGRAM) {
+        StatsHistogram *histogram = sketch->as.histogram;
+        return histogram->count ? value_from_number(stats_histogram_quantile(histogram, fraction)) : VALUE_NULL;
+    }
+    if (sketch->as.quantiles->count == 0) {
+        return VALUE_NULL;
+    }
+    return value_from_double(stats_quantiles_quantile(sketch->as.quantiles, fraction));
+}
+
+// statsMerge(a, b) adds everything b has seen to a, which it returns. b
+// must be the same kind as a; sketches need the same settings, and a
+// Histogram has to reach b's largest value.
+static Value builtin_stats_merge(Value *args, int count) {
+    (void)count;
+    SketchObject *sketch = sketch_argument("statsMerge", args, ALL_SKETCHES, ALL_SKETCH_NAMES);
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    const char *name = sketch_kind_name((SketchKind)sketch->kind);
+    char error_msg[256];
+    if (!value_is_sketch_kind(args[1], (SketchKind)sketch->kind)) {
+        snprintf(error_msg, sizeof(error_msg), "statsMerge expects another %s as argument 2, got %s",
+                 name, value_type_name(args[1]));
+        return builtin_error(error_msg);
+    }
+    SketchObject *other = value_as_sketch(args[1]);
+    switch (sketch->kind) {
+        case SKETCH_STATS:
+            stats_moments_merge(&sketch->as.moments, &other->as.moments);
+            return args[0];
+        case SKETCH_QUANTILES:
+            if (stats_quantiles_merge(sketch->as.quantiles, other->as.quantiles)) {
+                return args[0];
+            }
+            return builtin_error("statsMerge can only merge Quantiles with the same accuracy");
+        case SKETCH_DISTINCT:
+            if (stats_distinct_merge(sketch->as.distinct, other->as.distinct)) {
+                return args[0];
+            }
+            return builtin_error("statsMerge can only merge Distinct with the same precision");
+        default:
+            if (stats_histogram_merge(sketch->as.histogram, other->as.histogram)) {
+                return args[0];
+            }
+            snprintf(error_msg, sizeof(error_msg), "statsMerge got values up to %lld for a Histogram reaching %lld",
+                     (long long)other->as.histogram->max, (long long)sketch->as.histogram->highest);
+            return builtin_error(error_msg);
+    }
+}
+
+// histogramEncode(h) gives a short printable string that
+// histogramDecode turns back into the same Histogram, to store or send
+static Value builtin_histogram_encode(Value *args, int count) {
+    (void)count;
+    SketchObject *sketch = sketch_argument("histogramEncode", args, 1u << SKETCH_HISTOGRAM, "a Histogram");
+    if (!sketch) {
+        return VALUE_NULL;
+    }
+    size_t length;
+    char *text = stats_histogram_encode(sketch->as.histogram, &length);
+    Value string = text ? string_from_chars(text, length) : VALUE_NULL;
+    free(text);
+    if (value_is_null(string)) {
+        return builtin_error("Out of memory encoding Histogram");
+    }
+    return string;
+}
+
+static Value builtin_histogram_decode(Value *args, int count) {
+    (void)count;
+    if (!value_is_string(args[0])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "histogramDecode expects a string as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    const char *chars = string_chars(args[0]);
+    if (!chars) {
+        return builtin_error("Out of memory reading string");
+    }
+    StatsHistogram *histogram = stats_histogram_decode(chars, string_length(args[0]));
+    if (!histogram) {
+        return builtin_error("histogramDecode could not read a histogram from that string");
+    }
+    Value sketch = sketch_from_histogram(histogram);
+    if (value_is_null(sketch)) {
+        return builtin_error("Out of memory creating Histogram");
+    }
+    return sketch;
+}
+
+// hashing and shard assignment - hash(key[, seed]), jumpHash(key,
+// buckets) and rendezvousHash(key, nodes). keys are numbers or strings,
+// or an array of them to place all at once. hashes are the top 53 bits
+// of the 64-bit hash, so they are whole numbers a double holds exactly.
+#define HASH_CHUNK 256
+
+static int hash_value(const char *name, Value key, uint64_t seed, uint64_t *hash) {
+    if (value_is_number(key)) {
+        *hash = hash_number(value_as_number(key), seed);
+        return 1;
+    }
+    if (!value_is_string(key)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s can only hash numbers and strings, got %s",
+                 name, value_type_name(key));
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    const char *chars = string_chars(key);
+    if (!chars) {
+        interpreter_set_error("Out of memory reading string");
+        return 0;
+    }
+    *hash = hash_bytes(chars, string_length(key), seed);
+    return 1;
+}
+
+static int is_key_array(Value value) {
+    return value_is_array(value) || value_is_float64_array(value);
+}
+
+// the 64-bit hashes of keys[start, start + n) into hashes - numbers
+// stored unboxed go through the vector kernel
+static int hash_keys(const char *name, Value keys, size_t start, size_t n, uint64_t seed, uint64_t *hashes) {
+    if (value_is_float64_array(keys)) {
+        hash_numbers(value_as_float64_array(keys)->data + start, n, seed, hashes);
+        return 1;
+    }
+    ArrayObject *array = value_as_array(keys);
+    if (array->kind == ARRAY_NUMBERS) {
+        hash_numbers(&array_elements(array)[start].number, n, seed, hashes);
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!hash_value(name, array_elements(array)[start + i].value, seed, &hashes[i])) {
+            return 0;
+        }
+        // reading a rope flattens it, which can move the array
+        array = value_as_array(keys);
+    }
+    return 1;
+}
+
+static size_t key_count(Value keys) {
+    return value_is_float64_array(keys) ? value_as_float64_array(keys)->length : value_as_array(keys)->length;
+}
+
+// a Float64Array holding place(hash) for each key, filled a chunk at a
+// time. args[0] holds the keys and stays rooted while the result is
+// allocated.
+static Value place_keys(const char *name, Value *args, uint64_t seed, double (*place)(uint64_t hash, uint32_t setting),
+                        uint32_t setting) {
+    Value result = float64_array_create(key_count(args[0]));
+    if (value_is_null(result)) {
+        return builtin_error("Out of memory allocating Float64Array");
+    }
+    heap_push_root(&result);
+    size_t length = key_count(args[0]);
+    uint64_t hashes[HASH_CHUNK];
+    for (size_t start = 0; start < length; start += HASH_CHUNK) {
+        size_t n = length - start < HASH_CHUNK ? length - start : HASH_CHUNK;
+        if (!hash_keys(name, args[0], start, n, seed, hashes)) {
+            heap_pop_roots(1);
+            return VALUE_NULL;
+        }
+        double *out = value_as_float64_array(result)->data + start;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = place(hashes[i], setting);
+        }
+    }
+    heap_pop_roots(1);
+    return result;
+}
+
+static double hash_top_bits(uint64_t hash, uint32_t setting) {
+    (void)setting;
+    return (double)(hash >> 11);
+}
+
+static double jump_bucket(uint64_t hash, uint32_t buckets) {
+    return (double)hash_jump(hash, buckets);
+}
+
+// hash("user:42") or hash(ids, 7) for a whole array under seed 7
+static Value builtin_hash(Value *args, int count) {
+    double seed = 0.0;
+    if (count > 1) {
+        if (!number_argument("hash", args, 1, &seed)) {
+            return VALUE_NULL;
+        }
+        if (!(seed >= 0.0 && seed <= 9007199254740992.0) || seed != (double)(uint64_t)seed) {
+            return builtin_error("hash seed must be a non-negative integer");
+        }
+    }
+    if (is_key_array(args[0])) {
+        return place_keys("hash", args, (uint64_t)seed, hash_top_bits, 0);
+    }
+    uint64_t hash;
+    if (!hash_value("hash", args[0], (uint64_t)seed, &hash)) {
+        return VALUE_NULL;
+    }
+    return value_from_number(hash_top_bits(hash, 0));
+}
+
+// jumpHash(id, 16) is the shard from 0 to 15 for id. going to 17 shards
+// moves a seventeenth of the ids, all onto the new one.
+static Value builtin_jump_hash(Value *args, int count) {
+    (void)count;
+    double buckets;
+    if (!number_argument("jumpHash", args, 1, &buckets)) {
+        return VALUE_NULL;
+    }
+    if (!(buckets >= 1.0 && buckets <= (double)INT32_MAX) || buckets != (double)(int32_t)buckets) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "jumpHash buckets must be an integer from 1 to %d", INT32_MAX);
+        return builtin_error(error_msg);
+    }
+    if (is_key_array(args[0])) {
+        return place_keys("jumpHash", args, 0, jump_bucket, (uint32_t)buckets);
+    }
+    uint64_t hash;
+    if (!hash_value("jumpHash", args[0], 0, &hash)) {
+        return VALUE_NULL;
+    }
+    return value_from_number(jump_bucket(hash, (uint32_t)buckets));
+}
+
+// rendezvousHash(id, ["db1", "db2", "db3"]) is the node id belongs on.
+// dropping a node moves only its own keys, spread over the rest.
+static Value builtin_rendezvous_hash(Value *args, int count) {
+    (void)count;
+    if (!is_key_array(args[1]) || key_count(args[1]) == 0) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "rendezvousHash expects a non-empty array of nodes as argument 2, got %s",
+                 is_key_array(args[1]) ? "an empty one" : value_type_name(args[1]));
+        return builtin_error(error_msg);
+    }
+    uint64_t key;
+    if (!hash_value("rendezvousHash", args[0], 0, &key)) {
+        return VALUE_NULL;
+    }
+    size_t length = key_count(args[1]);
+    uint64_t hashes[HASH_CHUNK];
+    uint64_t *nodes = length <= HASH_CHUNK ? hashes : malloc(length * sizeof(uint64_t));
+    if (!nodes) {
+        return builtin_error("Out of memory hashing nodes");
+    }
+    int ok = hash_keys("rendezvousHash", args[1], 0, length, 0, nodes);
+    size_t best = ok ? hash_rendezvous(key, nodes, length) : 0;
+    if (nodes != hashes) {
+        free(nodes);
+    }
+    if (!ok) {
+        return VALUE_NULL;
+    }
+    if (value_is_float64_array(args[1])) {
+        return value_from_double(value_as_float64_array(args[1])->data[best]);
+    }
+    return array_get(args[1], best);
+}
+
+// the matrix in argument position, or NULL after reporting a type error
+static MatrixObject* matrix_argument(const char *name, Value *args, int position) {
+    if (!value_is_matrix(args[position])) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Matrix as argument %d, got %s",
+                 name, position + 1, value_type_name(args[position]));
+        interpreter_set_error(error_msg);
+        return NULL;
+    }
+    return value_as_matrix(args[position]);
+}
+
+// a count of rows or columns
+static int dimension_argument(const char *name, Value *args, int position, size_t *size) {
+    double number;
+    if (!number_argument(name, args, position, &number)) {
+        return 0;
+    }
+    if (!(number >= 0.0 && number <= (double)UINT32_MAX) || number != (double)(uint32_t)number) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s rows and columns must be non-negative integers", name);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    *size = (size_t)number;
+    return 1;
+}
+
+// the doubles of a Float64Array or an array of numbers held as a value
+// rather than an argument - 0 for anything else
+static int row_numbers(Value row, const double **data, size_t *length) {
+    if (value_is_float64_array(row)) {
+        *data = value_as_float64_array(row)->data;
+        *length = value_as_float64_array(row)->length;
+        return 1;
+    }
+    if (value_is_array(row) && value_as_array(row)->kind == ARRAY_NUMBERS) {
+        *data = &array_elements(value_as_array(row))->number;
+        *length = value_as_array(row)->length;
+        return 1;
+    }
+    return 0;
+}
+
+static Value new_matrix(size_t rows, size_t cols) {
+    Value matrix = matrix_create(rows, cols);
+    if (value_is_null(matrix)) {
+        return builtin_error("Out of memory allocating Matrix");
+    }
+    return matrix;
+}
+
+// Matrix([[1, 2], [3, 4]]) - a row from each array
+static Value matrix_from_rows(Value *args) {
+    char error_msg[256];
+    if (!value_is_array(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "Matrix expects an array of rows as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    size_t rows = value_as_array(args[0])->length;
+    size_t cols = 0;
+    for (size_t i = 0; i < rows; i++) {
+        const double *data;
+        size_t length;
+        if (!row_numbers(array_get(args[0], i), &data, &length)) {
+            snprintf(error_msg, sizeof(error_msg), "Matrix row %zu is not an array of numbers", i);
+            return builtin_error(error_msg);
+        }
+        if (i > 0 && length != cols) {
+            snprintf(error_msg, sizeof(error_msg), "Matrix rows must have the same length, got %zu and %zu",
+                     cols, length);
+            return builtin_error(error_msg);
+        }
+        cols = length;
+    }
+
+    Value matrix = new_matrix(rows, cols);
+    if (value_is_null(matrix)) {
+        return VALUE_NULL;
+    }
+    // the rows may have moved while the matrix was allocated
+    double *out = value_as_matrix(matrix)->data;
+    for (size_t i = 0; i < rows && cols > 0; i++) {
+        const double *data;
+        size_t length;
+        row_numbers(array_get(args[0], i), &data, &length);
+        memcpy(out + i * cols, data, cols * sizeof(double));
+    }
+    return matrix;
+}
+
+// Matrix(rows, cols) is all zeros, Matrix(rows, cols, values) takes the
+// values a row after another, and Matrix([[1, 2], [3, 4]]) a row from
+// each array
+static Value builtin_matrix(Value *args, int count) {
+    if (count == 1) {
+        return matrix_from_rows(args);
+    }
+    size_t rows, cols;
+    if (!dimension_argument("Matrix", args, 0, &rows) || !dimension_argument("Matrix", args, 1, &cols)) {
+        return VALUE_NULL;
+    }
+    const double *values;
+    size_t length;
+    if (count == 3) {
+        if (!numbers_argument("Matrix", args, 2, &values, &length)) {
+            return VALUE_NULL;
+        }
+        if (length != rows * cols) {
+            char error_msg[256];
+            snprintf(error_msg, sizeof(error_msg), "Matrix needs %zu values for %zux%zu, got %zu",
+                     rows * cols, rows, cols, length);
+            return builtin_error(error_msg);
+        }
+    }
+
+    Value matrix = new_matrix(rows, cols);
+    if (value_is_null(matrix) || count < 3 || length == 0) {
+        return matrix;
+    }
+    numbers_argument("Matrix", args, 2, &values, &length);
+    memcpy(value_as_matrix(matrix)->data, values, length * sizeof(double));
+    return matrix;
+}
+
+// matmul(a, b) is the product of a and b, which must have as many rows
+// as a has columns. large products are split across threads.
+static Value builtin_matmul(Value *args, int count) {
+    (void)count;
+    MatrixObject *a = matrix_argument("matmul", args, 0);
+    MatrixObject *b = a ? matrix_argument("matmul", args, 1) : NULL;
+    if (!b) {
+        return VALUE_NULL;
+    }
+    if (a->cols != b->rows) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "matmul needs as many rows in argument 2 as columns in argument 1, got %zux%zu and %zux%zu",
+                 a->rows, a->cols, b->rows, b->cols);
+        return builtin_error(error_msg);
+    }
+
+    Value result = new_matrix(a->rows, b->cols);
+    if (value_is_null(result)) {
+        return VALUE_NULL;
+    }
+    a = value_as_matrix(args[0]);
+    b = value_as_matrix(args[1]);
+    if (!linalg_matmul(a->data, b->data, value_as_matrix(result)->data, a->rows, a->cols, b->cols, 0)) {
+        return builtin_error("Out of memory multiplying matrices");
+    }
+    return result;
+}
+
+// matvec(a, x) is a times the column x, as a Float64Array
+static Value builtin_matvec(Value *args, int count) {
+    (void)count;
+    MatrixObject *a = matrix_argument("matvec", args, 0);
+    const double *x;
+    size_t length;
+    if (!a || !numbers_argument("matvec", args, 1, &x, &length)) {
+        return VALUE_NULL;
+    }
+    if (length != a->cols) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "matvec needs %zu numbers for a %zux%zu Matrix, got %zu",
+                 a->cols, a->rows, a->cols, length);
+        return builtin_error(error_msg);
+    }
+
+    Value result = float64_array_create(a->rows);
+    if (value_is_null(result)) {
+        return builtin_error("Out of memory allocating Float64Array");
+    }
+    a = value_as_matrix(args[0]);
+    numbers_argument("matvec", args, 1, &x, &length);
+    linalg_matvec(a->data, x, value_as_float64_array(result)->data, a->rows, a->cols);
+    return result;
+}
+
+static Value builtin_transpose(Value *args, int count) {
+    (void)count;
+    MatrixObject *a = matrix_argument("transpose", args, 0);
+    if (!a) {
+        return VALUE_NULL;
+    }
+    Value result = new_matrix(a->cols, a->rows);
+    if (value_is_null(result)) {
+        return VALUE_NULL;
+    }
+    a = value_as_matrix(args[0]);
+    linalg_transpose(a->data, value_as_matrix(result)->data, a->rows, a->cols);
+    return result;
+}
+
+// matrixAdd(a, b) and the others work element by element on matrices of
+// the same shape, or a matrix and a number used for every element
+static Value matrix_elementwise(const char *name, char op, Value *args) {
+    char error_msg[256];
+    MatrixObject *shape = NULL;
+    for (int i = 0; i < 2; i++) {
+        if (value_is_number(args[i])) {
+            continue;
+        }
+        if (!value_is_matrix(args[i])) {
+            snprintf(error_msg, sizeof(error_msg), "%s expects a Matrix or a number as argument %d, got %s",
+                     name, i + 1, value_type_name(args[i]));
+            return builtin_error(error_msg);
+        }
+        MatrixObject *matrix = value_as_matrix(args[i]);
+        if (shape && (matrix->rows != shape->rows || matrix->cols != shape->cols)) {
+            snprintf(error_msg, sizeof(error_msg), "%s needs matrices of the same shape, got %zux%zu and %zux%zu",
+                     name, shape->rows, shape->cols, matrix->rows, matrix->cols);
+            return builtin_error(error_msg);
+        }
+        shape = matrix;
+    }
+    if (!shape) {
+        snprintf(error_msg, sizeof(error_msg), "%s expects a Matrix as argument 1 or 2, got two numbers", name);
+        return builtin_error(error_msg);
+    }
+
+    Value result = new_matrix(shape->rows, shape->cols);
+    if (value_is_null(result)) {
+        return VALUE_NULL;
+    }
+    // the arguments may have moved while the result was allocated
+    double numbers[2];
+    const double *operands[2];
+    size_t steps[2];
+    size_t length = 0;
+    for (int i = 0; i < 2; i++) {
+        if (value_is_number(args[i])) {
+            numbers[i] = value_to_number(args[i]);
+            operands[i] = &numbers[i];
+            steps[i] = 0;
+        } else {
+            MatrixObject *matrix = value_as_matrix(args[i]);
+            operands[i] = matrix->data;
+            steps[i] = 1;
+            length = matrix->rows * matrix->cols;
+        }
+    }
+    linalg_elementwise(op, operands[0], steps[0], operands[1], steps[1], value_as_matrix(result)->data, length);
+    return result;
+}
+
+static Value builtin_matrix_add(Value *args, int count) {
+    (void)count;
+    return matrix_elementwise("matrixAdd", '+', args);
+}
+
+static Value builtin_matrix_sub(Value *args, int count) {
+    (void)count;
+    return matrix_elementwise("matrixSub", '-', args);
+}
+
+static Value builtin_matrix_mul(Value *args, int count) {
+    (void)count;
+    return matrix_elementwise("matrixMul", '*', args);
+}
+
+static Value builtin_matrix_div(Value *args, int count) {
+    (void)count;
+    return matrix_elementwise("matrixDiv", '/', args);
+}
+
+// where row i, column j of the matrix in argument 1 is, from arguments 2
+// and 3. 0 after reporting an error.
+static int matrix_element(const char *name, Value *args, MatrixObject **matrix, size_t *offset) {
+    double row, col;
+    *matrix = matrix_argument(name, args, 0);
+    if (!*matrix || !number_argument(name, args, 1, &row) || !number_argument(name, args, 2, &col)) {
+        return 0;
+    }
+    if (!(row >= 0.0 && row < (double)(*matrix)->rows && row == (double)(size_t)row) ||
+        !(col >= 0.0 && col < (double)(*matrix)->cols && col == (double)(size_t)col)) {
+        char error_msg[256], row_text[64], col_text[64];
+        value_format(args[1], row_text, sizeof(row_text));
+        value_format(args[2], col_text, sizeof(col_text));
+        snprintf(error_msg, sizeof(error_msg), "%s index %s, %s out of range for Matrix(%zux%zu)",
+                 name, row_text, col_text, (*matrix)->rows, (*matrix)->cols);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    *offset = (size_t)row * (*matrix)->cols + (size_t)col;
+    return 1;
+}
+
+static Value builtin_matrix_get(Value *args, int count) {
+    (void)count;
+    MatrixObject *matrix;
+    size_t offset;
+    if (!matrix_element("matrixGet", args, &matrix, &offset)) {
+        return VALUE_NULL;
+    }
+    return value_from_double(matrix->data[offset]);
+}
+
+// matrixSet(m, i, j, x) stores x and gives back m
+static Value builtin_matrix_set(Value *args, int count) {
+    (void)count;
+    MatrixObject *matrix;
+    size_t offset;
+    double number;
+    if (!matrix_element("matrixSet", args, &matrix, &offset) || !number_argument("matrixSet", args, 3, &number)) {
+        return VALUE_NULL;
+    }
+    matrix->data[offset] = number;
+    return args[0];
+}
+
+static Value builtin_matrix_rows(Value *args, int count) {
+    (void)count;
+    MatrixObject *matrix = matrix_argument("matrixRows", args, 0);
+    return matrix ? value_from_number((double)matrix->rows) : VALUE_NULL;
+}
+
+static Value builtin_matrix_cols(Value *args, int count) {
+    (void)count;
+    MatrixObject *matrix = matrix_argument("matrixCols", args, 0);
+    return matrix ? value_from_number((double)matrix->cols) : VALUE_NULL;
+}
+
+// the generator behind random() and fillRandom, seeded with 0 until a
+// script picks a seed, so runs repeat
+static __thread RandomState generator;
+static __thread int generator_seeded = 0;
+
+static RandomState* script_generator(void) {
+    if (!generator_seeded) {
+        random_seed(&generator, 0);
+        generator_seeded = 1;
+    }
+    return &generator;
+}
+
+// random() is uniform in [0, 1)
+static Value builtin_random(Value *args, int count) {
+    (void)args;
+    (void)count;
+    return value_from_double(random_double(script_generator()));
+}
+
+// randomSeed(n) starts the numbers over from a whole-number seed
+static Value builtin_random_seed(Value *args, int count) {
+    (void)count;
+    double seed;
+    if (!number_argument("randomSeed", args, 0, &seed)) {
+        return VALUE_NULL;
+    }
+    if (!(seed >= -0x1p63 && seed < 0x1p63) || seed != (double)(int64_t)seed) {
+        return builtin_error("randomSeed needs a whole number as its seed");
+    }
+    random_seed(&generator, (uint64_t)(int64_t)seed);
+    generator_seeded = 1;
+    return VALUE_NULL;
+}
+
+// fillRandom(a) overwrites a Float64Array or an array of numbers with
+// numbers as random() gives them, in place, and returns a. the numbers
+// are the same whether or not the fill is split across threads.
+static Value builtin_fill_random(Value *args, int count) {
+    (void)count;
+    double *data = NULL;
+    size_t length = 0;
+    if (value_is_float64_array(args[0])) {
+        Float64ArrayObject *array = value_as_float64_array(args[0]);
+        if (!writable("fillRandom", array)) {
+            return VALUE_NULL;
+        }
+        data = array->data;
+        length = array->length;
+    } else if (value_is_array(args[0]) && value_as_array(args[0])->kind == ARRAY_NUMBERS) {
+        ArrayObject *array = value_as_array(args[0]);
+        data = &array_elements(array)->number;
+        length = array->length;
+    } else {
+        // which reports why the argument will not do
+        const double *numbers;
+        numbers_argument("fillRandom", args, 0, &numbers, &length);
+        return VALUE_NULL;
+    }
+    random_fill(script_generator(), data, length, 0);
+    return args[0];
+}
+
+// an intrinsic's argument - a number, which goes with every element, or
+// a Float64Array or array of numbers, whose numbers and length are set
+static int math_argument(const char *name, Value *args, int position, const double **data, size_t *length) {
+    if (value_is_number(args[position])) {
+        *data = NULL;
+        return 1;
+    }
+    if (value_is_float64_array(args[position]) || value_is_array(args[position])) {
+        return numbers_argument(name, args, position, data, length);
+    }
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg), "%s expects a number or an array of numbers as argument %d, got %s",
+             name, position + 1, value_type_name(args[position]));
+    interpreter_set_error(error_msg);
+    return 0;
+}
+
+static const Intrinsic intrinsics[] = {
+    {"sqrt", INTRINSIC_SQRT, 1},
+    {"exp",  INTRINSIC_EXP,  1},
+    {"log",  INTRINSIC_LOG,  1},
+    {"sin",  INTRINSIC_SIN,  1},
+    {"cos",  INTRINSIC_COS,  1},
+    {"pow",  INTRINSIC_POW,  2},
+};
+
+const Intrinsic* intrinsic_lookup(const char *name) {
+    for (size_t i = 0; i < sizeof(intrinsics) / sizeof(intrinsics[0]); i++) {
+        if (strcmp(intrinsics[i].name, name) == 0) {
+            return &intrinsics[i];
+        }
+    }
+    return NULL;
+}
+
+// one number - sqrt is a single instruction, the rest are libm's
+double intrinsic_number(IntrinsicKind kind, double x, double y) {
+    switch (kind) {
+        case INTRINSIC_SQRT: return vecmath_sqrt_scalar(x);
+        case INTRINSIC_EXP:  return exp(x);
+        case INTRINSIC_LOG:  return log(x);
+        case INTRINSIC_SIN:  return sin(x);
+        case INTRINSIC_COS:  return cos(x);
+        case INTRINSIC_POW:  return pow(x, y);
+    }
+    return NAN;
+}
+
+// sqrt([1, 4, 9]) or pow(prices, 2) - a new Float64Array holding the
+// function of each element, through the vector versions. arrays given
+// together must have the same length.
+Value intrinsic_apply(const Intrinsic *intrinsic, Value *args) {
+    const char *name = intrinsic->name;
+    const double *data[INTRINSIC_MAX_ARGS] = {NULL};
+    size_t length = 0;
+    int arrays = 0;
+    for (int i = 0; i < intrinsic->args; i++) {
+        size_t arg_length = 0;
+        if (!math_argument(name, args, i, &data[i], &arg_length)) {
+            return VALUE_NULL;
+        }
+        if (data[i]) {
+            if (arrays++ > 0 && !same_lengths(name, length, arg_length)) {
+                return VALUE_NULL;
+            }
+            length = arg_length;
+        }
+    }
+    double numbers[INTRINSIC_MAX_ARGS] = {0.0};
+    for (int i = 0; i < intrinsic->args; i++) {
+        if (!data[i]) {
+            numbers[i] = value_to_number(args[i]);
+        }
+    }
+    if (arrays == 0) {
+        return value_from_number(intrinsic_number(intrinsic->kind, numbers[0], numbers[1]));
+    }
+
+    // args stay rooted by the caller but may move while the result is
+    // allocated, so their numbers are found again afterwards
+    Value result = float64_array_create(length);
+    if (value_is_null(result)) {
+        return builtin_error("Out of memory allocating Float64Array");
+    }
+    size_t steps[INTRINSIC_MAX_ARGS];
+    for (int i = 0; i < intrinsic->args; i++) {
+        if (data[i]) {
+            math_argument(name, args, i, &data[i], &length);
+            steps[i] = 1;
+        } else {
+            data[i] = &numbers[i];
+            steps[i] = 0;
+        }
+    }
+    double *out = value_as_float64_array(result)->data;
+    switch (intrinsic->kind) {
+        case INTRINSIC_SQRT: vecmath_sqrt(data[0], out, length); break;
+        case INTRINSIC_EXP:  vecmath_exp(data[0], out, length); break;
+        case INTRINSIC_LOG:  vecmath_log(data[0], out, length); break;
+        case INTRINSIC_SIN:  vecmath_sin(data[0], out, length); break;
+        case INTRINSIC_COS:  vecmath_cos(data[0], out, length); break;
+        case INTRINSIC_POW:  vecmath_pow(data[0], steps[0], data[1], steps[1], out, length); break;
+    }
+    return result;
+}
+
+// parallelReduce(a, op) folds an array of numbers with "+", "*", "min"
+// or "max" on the runtime's threads. the array is cut into chunks by its
+// length alone and the chunks' results combined in order, so the answer
+// is the same however many threads there are.
+static Value builtin_parallel_reduce(Value *args, int count) {
+    (void)count;
+    static const struct {
+        const char *name;
+        PoolReduction op;
+    } ops[] = {
+        {"+", POOL_SUM}, {"*", POOL_PRODUCT}, {"min", POOL_MIN}, {"max", POOL_MAX},
+    };
+    const double *data;
+    size_t length;
+    if (!numbers_argument("parallelReduce", args, 0, &data, &length)) {
+        return VALUE_NULL;
+    }
+    const char *name = value_is_string(args[1]) ? string_chars(args[1]) : NULL;
+    for (size_t i = 0; name && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strcmp(name, ops[i].name) == 0) {
+            return value_from_double(pool_reduce(ops[i].op, data, length, 0));
+        }
+    }
+    return builtin_error("parallelReduce op must be \"+\", \"*\", \"min\" or \"max\"");
+}
+
+typedef void (*ArrayMath)(const double *x, double *out, size_t n);
+
+// parallelFor(lo, hi, "fn") is a Float64Array of fn(i) for each whole i
+// from lo up to hi, fn one of the one-argument math functions. scripts
+// have no functions of their own, so naming one stands in for a closure,
+// and the threads run only its native code.
+static Value builtin_parallel_for(Value *args, int count) {
+    (void)count;
+    double lo, hi;
+    if (!number_argument("parallelFor", args, 0, &lo) || !number_argument("parallelFor", args, 1, &hi)) {
+        return VALUE_NULL;
+    }
+    if (!(lo <= hi && hi - lo <= (double)UINT32_MAX) || lo != floor(lo) || hi != floor(hi)) {
+        return builtin_error("parallelFor needs whole numbers with lo no greater than hi");
+    }
+    const Intrinsic *intrinsic = value_is_string(args[2]) ? intrinsic_lookup(string_chars(args[2])) : NULL;
+    ArrayMath fn = NULL;
+    if (intrinsic) {
+        switch (intrinsic->kind) {
+            case INTRINSIC_SQRT: fn = vecmath_sqrt; break;
+            case INTRINSIC_EXP:  fn = vecmath_exp; break;
+            case INTRINSIC_LOG:  fn = vecmath_log; break;
+            case INTRINSIC_SIN:  fn = vecmath_sin; break;
+            case INTRINSIC_COS:  fn = vecmath_cos; break;
+            case INTRINSIC_POW:  break;
+        }
+    }
+    if (!fn) {
+        return builtin_error("parallelFor expects the name of a one-argument math function as argument 3, like \"sqrt\"");
+    }
+
+    size_t length = (size_t)(hi - lo);
+    Value result = float64_array_create(length);
+    if (value_is_null(result)) {
+        return builtin_error("Out of memory allocating Float64Array");
+    }
+    pool_tabulate(fn, lo, value_as_float64_array(result)->data, length, 0);
+    return result;
+}
+
+// Worker("script.js") runs the script on a thread of its own
+static Value builtin_worker(Value *args, int count) {
+    (void)count;
+    char error_msg[512];
+    if (!value_is_string(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "Worker expects a script path as argument 1, got %s",
+                 value_type_name(args[0]));
+        return builtin_error(error_msg);
+    }
+    const char *path = string_chars(args[0]);
+    if (!path) {
+        return builtin_error("Out of memory reading path");
+    }
+    char reason[300];
+    Value worker = worker_create(path, reason, sizeof(reason));
+    if (value_is_null(worker)) {
+        snprintf(error_msg, sizeof(error_msg), "Worker %s", reason);
+        return builtin_error(error_msg);
+    }
+    return worker;
+}
+
+// postMessage(worker, value) sends to a worker and, inside a worker,
+// postMessage(value) to the script that started it. arrays of numbers
+// move rather than copy, so the sender's array is empty afterwards.
+static Value builtin_post_message(Value *args, int count) {
+    char error_msg[256];
+    int sent;
+    if (count == 2) {
+        if (!value_is_worker(args[0])) {
+            snprintf(error_msg, sizeof(error_msg), "postMessage expects a Worker as argument 1, got %s",
+                     value_type_name(args[0]));
+            return builtin_error(error_msg);
+        }
+        sent = worker_post(args[0], args[1], error_msg, sizeof(error_msg));
+    } else {
+        if (!worker_is_worker()) {
+            return builtin_error("postMessage needs a Worker to send to outside a worker");
+        }
+        sent = worker_post_parent(args[0], error_msg, sizeof(error_msg));
+    }
+    return sent ? VALUE_NULL : builtin_error(error_msg);
+}
+
+// receiveMessage() waits for the next message to this script. scripts
+// have no functions to give as an onmessage handler, so they ask.
+static Value builtin_receive_message(Value *args, int count) {
+    (void)args;
+    (void)count;
+    char error_msg[512];
+    Value message;
+    if (!worker_receive(&message, error_msg, sizeof(error_msg))) {
+        return builtin_error(error_msg);
+    }
+    return message;
+}
+
+static Value shared_array_create(const char *name, SharedKind kind, Value *args) {
+    double length;
+    char error_msg[256];
+    if (!number_argument(name, args, 0, &length)) {
+        return VALUE_NULL;
+    }
+    if (!(length >= 0.0 && length <= (double)UINT32_MAX) || length != (double)(uint32_t)length) {
+        snprintf(error_msg, sizeof(error_msg), "%s length must be a non-negative integer", name);
+        return builtin_error(error_msg);
+    }
+    SharedBuffer *buffer = shared_buffer_create(kind, (size_t)length);
+    Value array = buffer ? shared_array_adopt(buffer) : VALUE_NULL;
+    if (value_is_null(array)) {
+        if (buffer) {
+            shared_buffer_release(buffer);
+        }
+        snprintf(error_msg, sizeof(error_msg), "Out of memory allocating %s", name);
+        return builtin_error(error_msg);
+    }
+    return array;
+}
+
+// SharedFloat64Array(n) and SharedInt64Array(n) are zero-filled, and
+// posting one to a worker shares it instead of moving it
+static Value builtin_shared_float64_array(Value *args, int count) {
+    (void)count;
+    return shared_array_create("SharedFloat64Array", SHARED_FLOAT64, args);
+}
+
+static Value builtin_shared_int64_array(Value *args, int count) {
+    (void)count;
+    return shared_array_create("SharedInt64Array", SHARED_INT64, args);
+}
+
+// the buffer and element the first two arguments of an atomics builtin
+// name. 0 after reporting an error.
+static int atomic_element(const char *name, Value *args, SharedBuffer **buffer, size_t *index) {
+    char error_msg[256];
+    if (!value_is_shared_array(args[0])) {
+        snprintf(error_msg, sizeof(error_msg), "%s expects a SharedFloat64Array or SharedInt64Array as argument 1, got %s",
+                 name, value_type_name(args[0]));
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    double position;
+    if (!number_argument(name, args, 1, &position)) {
+        return 0;
+    }
+    *buffer = value_as_shared_array(args[0])->buffer;
+    if (!(position >= 0.0 && position < (double)(*buffer)->length && position == (double)(size_t)position)) {
+        char index_text[64];
+        value_format(args[1], index_text, sizeof(index_text));
+        snprintf(error_msg, sizeof(error_msg), "%s index %s out of range for %s(%zu)",
+                 name, index_text, value_type_name(args[0]), (*buffer)->length);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    *index = (size_t)position;
+    return 1;
+}
+
+// a number argument the buffer can hold - int64 elements take only
+// whole numbers in their range
+static int atomic_operand(const char *name, Value *args, int position, SharedBuffer *buffer, double *number) {
+    if (!number_argument(name, args, position, number)) {
+        return 0;
+    }
+    if (!shared_fits(buffer, *number)) {
+        char error_msg[256], number_text[64];
+        value_format(args[position], number_text, sizeof(number_text));
+        snprintf(error_msg, sizeof(error_msg), "%s expects a whole number for a SharedInt64Array as argument %d, got %s",
+                 name, position + 1, number_text);
+        interpreter_set_error(error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+// atomicsAdd(a, i, x) adds x to a[i] and gives back the old value
+static Value builtin_atomics_add(Value *args, int count) {
+    (void)count;
+    SharedBuffer *buffer;
+    size_t index;
+    double number;
+    if (!atomic_element("atomicsAdd", args, &buffer, &index) ||
+        !atomic_operand("atomicsAdd", args, 2, buffer, &number)) {
+        return VALUE_NULL;
+    }
+    return value_from_number(shared_add(buffer, index, number));
+}
+
+// atomicsCompareExchange(a, i, expected, x) stores x in a[i] if it holds
+// expected, and gives back what a[i] held either way
+static Value builtin_atomics_compare_exchange(Value *args, int count) {
+    (void)count;
+    SharedBuffer *buffer;
+    size_t index;
+    double expected, replacement;
+    if (!atomic_element("atomicsCompareExchange", args, &buffer, &index) ||
+        !atomic_operand("atomicsCompareExchange", args, 2, buffer, &expected) ||
+        !atomic_operand("atomicsCompareExchange", args, 3, buffer, &replacement)) {
+        return VALUE_NULL;
+    }
+    return value_from_number(shared_compare_exchange(buffer, index, expected, replacement));
+}
+
+static Value builtin_atomics_load(Value *args, int count) {
+    (void)count;
+    SharedBuffer *buffer;
+    size_t index;
+    if (!atomic_element("atomicsLoad", args, &buffer, &index)) {
+        return VALUE_NULL;
+    }
+    return value_from_number(shared_load(buffer, index));
+}
+
+// atomicsStore(a, i, x) gives back x
+static Value builtin_atomics_store(Value *args, int count) {
+    (void)count;
+    SharedBuffer *buffer;
+    size_t index;
+    double number;
+    if (!atomic_element("atomicsStore", args, &buffer, &index) ||
+        !atomic_operand("atomicsStore", args, 2, buffer, &number)) {
+        return VALUE_NULL;
+    }
+    shared_store(buffer, index, number);
+    return value_from_number(number);
+}
+
+static const Builtin builtins[] = {
+    {"Float64Array",   1, 1, builtin_float64_array},
+    {"mapFloat64",     1, 1, builtin_map_float64},
+    {"readCsvColumns", 2, 2, builtin_read_csv_columns},
+    {"length",         1, 1, builtin_length},
+    {"sum",            1, 1, builtin_sum},
+    {"min",            1, 1, builtin_min},
+    {"max",            1, 1, builtin_max},
+    {"dot",            2, 2, builtin_dot},
+    {"scale",          2, 2, builtin_scale},
+    {"axpy",           3, 3, builtin_axpy},
+    {"push",           2, 2, builtin_push},
+    {"pop",            1, 1, builtin_pop},
+    {"sort",           1, 2, builtin_sort},
+    {"sortBy",         2, 3, builtin_sort_by},
+    {"Map",            0, 0, builtin_map},
+    {"mapGet",         2, 2, builtin_map_get},
+    {"mapHas",         2, 2, builtin_map_has},
+    {"mapSet",         3, 3, builtin_map_set},
+    {"mapDelete",      2, 2, builtin_map_delete},
+    {"mapAdd",         3, 3, builtin_map_add},
+    {"mapKeys",        1, 1, builtin_map_keys},
+    {"mapValues",      1, 1, builtin_map_values},
+    {"Stats",          0, 0, builtin_stats},
+    {"Quantiles",      0, 1, builtin_quantiles},
+    {"Distinct",       0, 1, builtin_distinct},
+    {"Histogram",      0, 2, builtin_histogram},
+    {"statsAdd",       2, 2, builtin_stats_add},
+    {"statsCount",     1, 1, builtin_stats_count},
+    {"statsMean",      1, 1, builtin_stats_mean},
+    {"statsVariance",  1, 1, builtin_stats_variance},
+    {"statsMin",       1, 1, builtin_stats_min},
+    {"statsMax",       1, 1, builtin_stats_max},
+    {"statsQuantile",  2, 2, builtin_stats_quantile},
+    {"statsMerge",     2, 2, builtin_stats_merge},
+    {"histogramEncode", 1, 1, builtin_histogram_encode},
+    {"histogramDecode", 1, 1, builtin_histogram_decode},
+    {"hash",           1, 2, builtin_hash},
+    {"jumpHash",       2, 2, builtin_jump_hash},
+    {"rendezvousHash", 2, 2, builtin_rendezvous_hash},
+    {"Matrix",         1, 3, builtin_matrix},
+    {"matmul",         2, 2, builtin_matmul},
+    {"matvec",         2, 2, builtin_matvec},
+    {"transpose",      1, 1, builtin_transpose},
+    {"matrixAdd",      2, 2, builtin_matrix_add},
+    {"matrixSub",      2, 2, builtin_matrix_sub},
+    {"matrixMul",      2, 2, builtin_matrix_mul},
+    {"matrixDiv",      2, 2, builtin_matrix_div},
+    {"matrixGet",      3, 3, builtin_matrix_get},
+    {"matrixSet",      4, 4, builtin_matrix_set},
+    {"matrixRows",     1, 1, builtin_matrix_rows},
+    {"matrixCols",     1, 1, builtin_matrix_cols},
+    {"random",         0, 0, builtin_random},
+    {"randomSeed",     1, 1, builtin_random_seed},
+    {"fillRandom",     1, 1, builtin_fill_random},
+    {"parallelReduce", 2, 2, builtin_parallel_reduce},
+    {"parallelFor",    3, 3, builtin_parallel_for},
+    {"Worker",         1, 1, builtin_worker},
+    {"postMessage",    1, 2, builtin_post_message},
+    {"receiveMessage", 0, 0, builtin_receive_message},
+    {"SharedFloat64Array", 1, 1, builtin_shared_float64_array},
+    {"SharedInt64Array", 1, 1, builtin_shared_int64_array},
+    {"atomicsAdd",     3, 3, builtin_atomics_add},
+    {"atomicsCompareExchange", 4, 4, builtin_atomics_compare_exchange},
+    {"atomicsLoad",    2, 2, builtin_atomics_load},
+    {"atomicsStore",   3, 3, builtin_atomics_store},
+};
+
+// linear search - calls cache the result, so this runs once per call site
+const Builtin* builtin_lookup(const char *name) {
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
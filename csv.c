@@ -0,0 +1,535 @@
+/*
+ * csv.c - numeric column reader for shardjs
+ *
+ * the file is mapped rather than read. commas and newlines are located
+ * 64 bytes at a time as a bitmask (avx2 or sse2 compares where the cpu
+ * has them) and the parser jumps from one set bit to the next instead
+ * of looking at every byte. numbers with at most 19 significant digits
+ * and a small exponent are converted exactly with one multiply or
+ * divide; anything else falls back to strtod.
+ *
+ * big files are cut into chunks at line boundaries. each thread counts
+ * the rows in its chunk, the counts give every chunk its first row, and
+ * then each thread parses its rows straight into the shared columns.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/csv.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CSV_X86 1
+#include <immintrin.h>
+#endif
+
+#define BLOCK 64
+#define COLUMN_ALIGNMENT 32
+
+// bit i is set when p[i] is a comma or a newline
+typedef uint64_t (*ScanBlock)(const char *p);
+
+static uint64_t scan_block_scalar(const char *p) {
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        if (p[i] == ',' || p[i] == '\n') {
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// the same for the last partial block, which must not read past the end
+static uint64_t scan_tail(const char *p, size_t length) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (p[i] == ',' || p[i] == '\n') {
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef CSV_X86
+
+__attribute__((target("sse2")))
+static uint64_t scan_block_sse2(const char *p) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; k++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(p + 16 * k));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, newline));
+        mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(hits) << (16 * k);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scan_block_avx2(const char *p) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i low = _mm256_loadu_si256((const __m256i*)p);
+    __m256i high = _mm256_loadu_si256((const __m256i*)(p + 32));
+    uint32_t low_mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(low, comma), _mm256_cmpeq_epi8(low, newline)));
+    uint32_t high_mask = (uint32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(high, comma), _mm256_cmpeq_epi8(high, newline)));
+    return (uint64_t)high_mask << 32 | low_mask;
+}
+
+#endif
+
+static ScanBlock best_scanner(void) {
+#ifdef CSV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_block_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return scan_block_sse2;
+    }
+#endif
+    return scan_block_scalar;
+}
+
+static int lowest_bit(uint64_t mask) {
+#ifdef __GNUC__
+    return __builtin_ctzll(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// numbers
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// strtod on a copy, since fields aren't nul-terminated
+static double parse_slow(const char *start, const char *end) {
+    char local[128];
+    size_t length = (size_t)(end - start);
+    char *copy = length < sizeof(local) ? local : malloc(length + 1);
+    if (!copy) {
+        return NAN;
+    }
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+
+    char *stop;
+    double value = strtod(copy, &stop);
+    if (stop != copy + length) {
+        value = NAN;
+    }
+    if (copy != local) {
+        free(copy);
+    }
+    return value;
+}
+
+double csv_parse_number(const char *start, const char *end) {
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end--;
+    }
+    if (start == end) {
+        return NAN;
+    }
+
+    const char *p = start;
+    int negative = 0;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+
+    // up to 19 significant digits fit in the mantissa; later ones only
+    // matter if they aren't zero
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int digits = 0;
+    int exponent = 0;
+    int dropped = 0;
+    for (; p < end && is_digit(*p); p++, digits++) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            significant += mantissa != 0;
+        } else {
+            exponent++;
+            dropped |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++, digits++) {
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                significant += mantissa != 0;
+                exponent--;
+            } else {
+                dropped |= *p != '0';
+            }
+        }
+    }
+    if (digits == 0) {
+        return parse_slow(start, end);   // inf, nan or not a number
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exponent_sign = 1;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponent_sign = *p == '-' ? -1 : 1;
+            p++;
+        }
+        if (p == end || !is_digit(*p)) {
+            return NAN;
+        }
+        int written = 0;
+        for (; p < end && is_digit(*p); p++) {
+            if (written < 100000) {
+                written = written * 10 + (*p - '0');
+            }
+        }
+        exponent += exponent_sign * written;
+    }
+    if (p != end) {
+        return NAN;
+    }
+
+    if (mantissa == 0) {
+        return negative ? -0.0 : 0.0;
+    }
+    // both operands are exact doubles, so one correctly rounded
+    // operation gives the correctly rounded result
+    if (!dropped && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / exact_powers[-exponent] : value * exact_powers[exponent];
+        return negative ? -value : value;
+    }
+    return parse_slow(start, end);
+}
+
+// rows and chunks
+typedef struct {
+    const char *begin;         // chunk of whole lines
+    const char *end;
+    size_t first_row;
+    size_t rows;
+    const int *slots;          // header field -> output column, or -1
+    size_t fields;             // header field count
+    size_t last_wanted;        // highest field that has a slot
+    double **columns;
+    ScanBlock scan;
+} CsvChunk;
+
+// a line counts as a row unless it is empty or just a carriage return
+static int has_content(const char *line, const char *newline) {
+    return newline - line > 1 || (newline - line == 1 && *line != '\r');
+}
+
+static void count_rows(CsvChunk *chunk) {
+    size_t rows = 0;
+    const char *line = chunk->begin;
+    for (const char *block = chunk->begin; block < chunk->end; block += BLOCK) {
+        size_t available = (size_t)(chunk->end - block);
+        uint64_t mask = available >= BLOCK ? chunk->scan(block) : scan_tail(block, available);
+        while (mask) {
+            const char *p = block + lowest_bit(mask);
+            mask &= mask - 1;
+            if (*p == '\n') {
+                rows += has_content(line, p);
+                line = p + 1;
+            }
+        }
+    }
+    if (line < chunk->end && has_content(line, chunk->end)) {
+        rows++;
+    }
+    chunk->rows = rows;
+}
+
+static void store_field(CsvChunk *chunk, size_t field, size_t row, const char *start, const char *end) {
+    if (field < chunk->fields && chunk->slots[field] >= 0) {
+        chunk->columns[chunk->slots[field]][row] = csv_parse_number(start, end);
+    }
+}
+
+// short rows leave their missing columns as NaN
+static void finish_row(CsvChunk *chunk, size_t fields_seen, size_t row) {
+    for (size_t field = fields_seen; field <= chunk->last_wanted; field++) {
+        if (chunk->slots[field] >= 0) {
+            chunk->columns[chunk->slots[field]][row] = NAN;
+        }
+    }
+}
+
+static void parse_rows(CsvChunk *chunk) {
+    size_t row = chunk->first_row;
+    size_t field = 0;
+    const char *line = chunk->begin;
+    const char *field_start = chunk->begin;
+
+    for (const char *block = chunk->begin; block < chunk->end; block += BLOCK) {
+        size_t available = (size_t)(chunk->end - block);
+        uint64_t mask = available >= BLOCK ? chunk->scan(block) : scan_tail(block, available);
+        while (mask) {
+            const char *p = block + lowest_bit(mask);
+            mask &= mask - 1;
+            if (*p == ',') {
+                store_field(chunk, field++, row, field_start, p);
+                field_start = p + 1;
+                continue;
+            }
+            if (has_content(line, p)) {
+                store_field(chunk, field++, row, field_start, p);
+                finish_row(chunk, field, row);
+                row++;
+            }
+            field = 0;
+            line = field_start = p + 1;
+        }
+    }
+    if (line < chunk->end && has_content(line, chunk->end)) {
+        store_field(chunk, field++, row, field_start, chunk->end);
+        finish_row(chunk, field, row);
+    }
+}
+
+static void* count_rows_thread(void *chunk) {
+    count_rows(chunk);
+    return NULL;
+}
+
+static void* parse_rows_thread(void *chunk) {
+    parse_rows(chunk);
+    return NULL;
+}
+
+// run work over every chunk, the first on this thread
+static void run_chunks(CsvChunk *chunks, size_t count, void *(*work)(void*)) {
+    pthread_t threads[CSV_MAX_THREADS];
+    int started[CSV_MAX_THREADS] = {0};
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, work, &chunks[i]) == 0;
+        if (!started[i]) {
+            work(&chunks[i]);
+        }
+    }
+    work(&chunks[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+// header
+static void trim_field(const char **start, const char **end) {
+    while (*start < *end && (**start == ' ' || **start == '\t')) {
+        (*start)++;
+    }
+    while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r')) {
+        (*end)--;
+    }
+    if (*end - *start >= 2 && **start == '"' && (*end)[-1] == '"') {
+        (*start)++;
+        (*end)--;
+    }
+}
+
+// give each requested name its header position - 0 with an error if any is missing
+static int match_header(const char *header, const char *header_end, const char **names, size_t count,
+                        int **slots_out, size_t *fields_out, size_t *last_wanted,
+                        char *error, size_t error_size) {
+    size_t fields = 1;
+    for (const char *p = header; p < header_end; p++) {
+        fields += *p == ',';
+    }
+    int *slots = malloc(fields * sizeof(int));
+    if (!slots) {
+        snprintf(error, error_size, "out of memory");
+        return 0;
+    }
+
+    size_t field = 0;
+    *last_wanted = 0;
+    const char *start = header;
+    for (const char *p = header; ; p++) {
+        if (p < header_end && *p != ',') {
+            continue;
+        }
+        const char *name_start = start;
+        const char *name_end = p;
+        trim_field(&name_start, &name_end);
+        slots[field] = -1;
+        for (size_t i = 0; i < count; i++) {
+            if (strlen(names[i]) == (size_t)(name_end - name_start) &&
+                memcmp(names[i], name_start, (size_t)(name_end - name_start)) == 0) {
+                slots[field] = (int)i;
+                *last_wanted = field;
+                break;
+            }
+        }
+        field++;
+        start = p + 1;
+        if (p == header_end) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int found = 0;
+        for (size_t f = 0; f < fields; f++) {
+            found |= slots[f] == (int)i;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(names[i], names[j]) == 0) {
+                snprintf(error, error_size, "column '%s' was requested twice", names[i]);
+                free(slots);
+                return 0;
+            }
+        }
+        if (!found) {
+            snprintf(error, error_size, "no column named '%s'", names[i]);
+            free(slots);
+            return 0;
+        }
+    }
+
+    *slots_out = slots;
+    *fields_out = fields;
+    return 1;
+}
+
+static size_t pick_threads(size_t bytes, size_t requested) {
+    if (requested == 0) {
+        if (bytes < CSV_PARALLEL_MIN_BYTES) {
+            return 1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cpus > 0 ? (size_t)cpus : 1;
+        // keep every chunk worth a thread
+        if (requested > bytes / (CSV_PARALLEL_MIN_BYTES / 4)) {
+            requested = bytes / (CSV_PARALLEL_MIN_BYTES / 4);
+        }
+    }
+    if (requested > CSV_MAX_THREADS) {
+        requested = CSV_MAX_THREADS;
+    }
+    return requested ? requested : 1;
+}
+
+int csv_read_columns(const char *path, const char **names, size_t count, size_t threads,
+                     double **columns, CsvResult *result, char *error, size_t error_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(error, error_size, "cannot open '%s': %s", path, strerror(errno));
+        return 0;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        snprintf(error, error_size, "'%s' has no header row", path);
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)info.st_size;
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        snprintf(error, error_size, "cannot map '%s': %s", path, strerror(errno));
+        return 0;
+    }
+    posix_madvise((void*)data, size, POSIX_MADV_SEQUENTIAL);
+
+    const char *end = data + size;
+    const char *header_end = memchr(data, '\n', size);
+    const char *body = header_end ? header_end + 1 : end;
+    if (!header_end) {
+        header_end = end;
+    }
+
+    int *slots;
+    size_t fields;
+    size_t last_wanted;
+    if (!match_header(data, header_end, names, count, &slots, &fields, &last_wanted, error, error_size)) {
+        munmap((void*)data, size);
+        return 0;
+    }
+
+    // cut the body into chunks that start at line boundaries
+    CsvChunk chunks[CSV_MAX_THREADS];
+    ScanBlock scan = best_scanner();
+    size_t chunk_count = pick_threads((size_t)(end - body), threads);
+    const char *start = body;
+    for (size_t i = 0; i < chunk_count; i++) {
+        const char *stop = end;
+        if (i + 1 < chunk_count) {
+            stop = body + (size_t)(end - body) * (i + 1) / chunk_count;
+            if (stop < start) {
+                stop = start;
+            }
+            const char *newline = memchr(stop, '\n', (size_t)(end - stop));
+            stop = newline ? newline + 1 : end;
+        }
+        chunks[i].begin = start;
+        chunks[i].end = stop;
+        chunks[i].slots = slots;
+        chunks[i].fields = fields;
+        chunks[i].last_wanted = last_wanted;
+        chunks[i].columns = columns;
+        chunks[i].scan = scan;
+        start = stop;
+    }
+
+    run_chunks(chunks, chunk_count, count_rows_thread);
+    size_t rows = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        chunks[i].first_row = rows;
+        rows += chunks[i].rows;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        void *memory = NULL;
+        if (rows > 0 && posix_memalign(&memory, COLUMN_ALIGNMENT, rows * sizeof(double)) != 0) {
+            for (size_t j = 0; j < i; j++) {
+                free(columns[j]);
+            }
+            snprintf(error, error_size, "out of memory for %zu rows", rows);
+            free(slots);
+            munmap((void*)data, size);
+            return 0;
+        }
+        columns[i] = memory;
+    }
+    if (rows > 0) {
+        run_chunks(chunks, chunk_count, parse_rows_thread);
+    }
+
+    free(slots);
+    munmap((void*)data, size);
+    result->rows = rows;
+    result->threads = chunk_count;
+    return 1;
+}
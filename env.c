@@ -3,17 +3,19 @@
  * 
  * handles variable storage and lookup using a dynamic array.
  * supports creating, updating, and retrieving variables by name.
+ * every environment is a garbage collection root while it exists.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "include/runtime.h"
+#include "include/object.h"
 
 // simple name-value pair for variables
 typedef struct {
     char *name;
-    double value;
+    Value value;
 } Variable;
 
 // environment holds all variables in a resizable array
@@ -37,6 +39,14 @@ static int env_resize(Environment *env) {
     return 1;
 }
 
+// let the collector see and update every variable
+static void env_scan_roots(void *context, HeapVisitor visit) {
+    Environment *env = context;
+    for (size_t i = 0; i < env->count; i++) {
+        visit(&env->variables[i].value);
+    }
+}
+
 // create new environment with initial capacity
 Environment* env_create(void) {
     Environment *env = malloc(sizeof(Environment));
@@ -52,6 +62,11 @@ Environment* env_create(void) {
     
     env->count = 0;
     env->capacity = INITIAL_CAPACITY;
+    if (!heap_add_root_scanner(env_scan_roots, env)) {
+        free(env->variables);
+        free(env);
+        return NULL;
+    }
     return env;
 }
 
@@ -61,6 +76,8 @@ void env_destroy(Environment *env) {
         return;
     }
     
+    heap_remove_root_scanner(env_scan_roots, env);
+    
     // free variable names first
     for (size_t i = 0; i < env->count; i++) {
         free(env->variables[i].name);
@@ -71,7 +88,7 @@ void env_destroy(Environment *env) {
 }
 
 // set variable value - creates new or updates existing
-int env_set(Environment *env, const char *name, double value) {
+int env_set_value(Environment *env, const char *name, Value value) {
     if (!env || !name) {
         return 0;
     }
@@ -107,7 +124,7 @@ int env_set(Environment *env, const char *name, double value) {
 }
 
 // get variable value by name
-int env_get(Environment *env, const char *name, double *value) {
+int env_get_value(Environment *env, const char *name, Value *value) {
     if (!env || !name || !value) {
         return 0;
     }
@@ -121,4 +138,21 @@ int env_get(Environment *env, const char *name, double *value) {
     }
     
     return 0; // not found
-}
\ No newline at end of file
+}
+// numeric conveniences over the value api
+int env_set(Environment *env, const char *name, double value) {
+    return env_set_value(env, name, value_from_double(value));
+}
+
+int env_get(Environment *env, const char *name, double *value) {
+    if (!value) {
+        return 0;
+    }
+    
+    Value stored;
+    if (!env_get_value(env, name, &stored)) {
+        return 0;
+    }
+    *value = value_to_number(stored);
+    return 1;
+}
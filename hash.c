@@ -0,0 +1,129 @@
+/*
+ * hash.c - string hashing and consistent hashing for shardjs
+ *
+ * strings follow xxh3's layout by length: up to 16 bytes are read as at
+ * most two overlapping words and mixed once, longer ones 16 bytes at a
+ * time, each pair of words multiplied together against its own piece
+ * of the secret and the 128-bit product folded to 64 bits. numbers are
+ * hashed inline (hash.h) so the vector kernels can share the code.
+ */
+
+#include "include/hash.h"
+#include "include/kernels.h"
+
+static const uint64_t secret[8] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL
+};
+
+#define PRIME64_1 0x9e3779b185ebca87ULL
+#define PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define PRIME64_3 0x165667b19e3779f9ULL
+
+static uint64_t read64(const char *p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static uint32_t read32(const char *p) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static uint64_t multiply_fold(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919e3779f9ULL;
+    return h ^ (h >> 32);
+}
+
+// for the fewest bits of input, which a single multiply spreads too little
+static uint64_t avalanche_strong(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static uint64_t mix16(const char *p, int piece, uint64_t seed) {
+    return multiply_fold(read64(p) ^ (secret[piece] + seed), read64(p + 8) ^ (secret[piece + 1] - seed));
+}
+
+uint64_t hash_bytes(const char *chars, size_t length, uint64_t seed) {
+    if (length > 16) {
+        uint64_t acc = (uint64_t)length * PRIME64_1;
+        size_t i = 0;
+        for (int piece = 0; i + 16 < length; i += 16, piece = (piece + 2) & 6) {
+            acc += mix16(chars + i, piece, seed);
+        }
+        // the last 16 bytes, overlapping the block before when the
+        // length is not a multiple of 16
+        acc += mix16(chars + length - 16, 6, seed);
+        return avalanche(acc);
+    }
+    if (length > 8) {
+        uint64_t low = read64(chars) ^ ((secret[4] ^ secret[5]) + seed);
+        uint64_t high = read64(chars + length - 8) ^ ((secret[6] ^ secret[7]) - seed);
+        uint64_t acc = length + __builtin_bswap64(low) + high + multiply_fold(low, high);
+        return avalanche(acc);
+    }
+    if (length >= 4) {
+        // the rrmxmx mixer numbers use, under a different secret
+        uint64_t words = read32(chars + length - 4) + ((uint64_t)read32(chars) << 32);
+        uint64_t k = words ^ ((secret[2] ^ secret[3]) - seed);
+        k ^= hash_rotate(k, 49) ^ hash_rotate(k, 24);
+        k *= HASH_MIX_MULTIPLIER;
+        k ^= (k >> 35) + length;
+        k *= HASH_MIX_MULTIPLIER;
+        return k ^ (k >> 28);
+    }
+    if (length > 0) {
+        uint64_t first = (uint8_t)chars[0];
+        uint64_t middle = (uint8_t)chars[length >> 1];
+        uint64_t last = (uint8_t)chars[length - 1];
+        uint64_t combined = (first << 16) | (middle << 24) | last | ((uint64_t)length << 8);
+        return avalanche_strong(combined ^ ((secret[0] >> 32 ^ secret[0]) + seed));
+    }
+    return avalanche_strong(seed ^ secret[6] ^ secret[7]);
+}
+
+void hash_numbers(const double *x, size_t n, uint64_t seed, uint64_t *out) {
+    kernel_hash_numbers(x, seed, out, n);
+}
+
+// lamping and veach's jump hash: a linear congruential sequence drawn
+// from the key decides, bucket count by bucket count, when the key
+// would jump to a newly added bucket, skipping straight to the next
+// jump each time
+uint32_t hash_jump(uint64_t key, uint32_t buckets) {
+    int64_t bucket = -1;
+    int64_t next = 0;
+    while (next < (int64_t)buckets) {
+        bucket = next;
+        key = key * 2862933555777941757ULL + 1;
+        next = (int64_t)((double)(bucket + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+    }
+    return (uint32_t)bucket;
+}
+
+// highest random weight - ties, which need a 64-bit collision, go to the
+// first node
+size_t hash_rendezvous(uint64_t key, const uint64_t *nodes, size_t n) {
+    size_t best = 0;
+    uint64_t best_score = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t score = avalanche(multiply_fold(key ^ secret[0], nodes[i] ^ secret[1]));
+        if (i == 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
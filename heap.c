@@ -0,0 +1,1004 @@
+/*
+ * heap.c - garbage collected heap for shardjs
+ *
+ * objects are born in the nursery, one block of memory handed out by
+ * bumping a pointer. when it fills, the objects still reachable in it
+ * are copied to the old generation and the whole block is reused, so
+ * the temporaries that make up most allocations cost nothing to free.
+ * old objects are malloc'd, kept on a list and reclaimed by mark-sweep
+ * once the old generation has grown enough since the last full
+ * collection.
+ *
+ * roots are the registered scanners (environments), the value stack of
+ * c locals and, for nursery collections, the old objects the write
+ * barrier has seen point into the nursery. literals are pinned in the
+ * old generation because the ast holds them.
+ *
+ * big old generations are marked by several threads. each keeps its
+ * own stack and moves half of it to a locked shared stack whenever that
+ * runs dry, where idle threads steal from. marking can also run in the
+ * background: the roots are marked in a short pause, then markers trace
+ * from them while the program goes on. values the program overwrites in
+ * old objects are logged and objects promoted meanwhile count as marked,
+ * so everything live when marking started is found (snapshot at the
+ * beginning). a later nursery collection adds what was overwritten to
+ * the marking, finishes it and hands the sweep to another thread.
+ *
+ * every thread running a program (the main one and each worker) has a
+ * heap of its own, so the state below is thread-local. marker and sweep
+ * threads work on another thread's heap and reach what they need of it
+ * through the pointer they are started with.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "include/object.h"
+
+#define HEAP_ALIGNMENT 8
+#define HEAP_NURSERY_MIN_SIZE 1024
+// old objects before an automatic thread count marks with more than one
+#define HEAP_PARALLEL_MARK_MIN_OBJECTS 50000
+// a marker shares work once its own stack holds this many objects
+#define MARK_SHARE_MIN 64
+// old objects hash to one of these locks while marking concurrently
+#define OBJECT_LOCK_STRIPES 64
+
+// growable stack of pointers, for the value stack, the remembered set
+// and the collector's work list
+typedef struct {
+    void **items;
+    size_t count;
+    size_t capacity;
+} PointerStack;
+
+typedef struct {
+    HeapRootScanner scan;
+    void *context;
+} RootScanner;
+
+static __thread char *nursery = NULL;
+static __thread char *nursery_top = NULL;
+static __thread char *nursery_end = NULL;
+static __thread size_t nursery_size = HEAP_NURSERY_SIZE;
+static __thread size_t nursery_objects = 0;
+
+static __thread Object *old_objects = NULL;
+static __thread size_t old_object_count = 0;
+static __thread size_t old_bytes = 0;
+static __thread size_t major_threshold = HEAP_MAJOR_MIN_BYTES;
+
+static __thread PointerStack value_stack = {NULL, 0, 0};
+static __thread PointerStack remembered = {NULL, 0, 0};
+static __thread PointerStack work = {NULL, 0, 0};
+
+static __thread RootScanner *scanners = NULL;
+static __thread size_t scanner_count = 0;
+static __thread size_t scanner_capacity = 0;
+
+static __thread size_t minor_collections = 0;
+static __thread size_t major_collections = 0;
+static __thread size_t promoted_bytes = 0;
+static __thread size_t last_mark_threads = 0;
+static __thread size_t minor_pauses[HEAP_PAUSE_BUCKETS];
+static __thread size_t major_pauses[HEAP_PAUSE_BUCKETS];
+static __thread double longest_pause_us = 0;
+
+typedef struct Collector Collector;
+
+// one per marking thread. the private stack needs no locking; the
+// shared one is where other threads steal from.
+typedef struct {
+    Object **items;
+    size_t count;
+    size_t capacity;
+    char lock;
+    Object **shared;
+    size_t shared_count;
+    size_t shared_capacity;
+    pthread_t thread;
+    int started;
+    Collector *collector;
+} MarkWorker;
+
+// what the threads marking one heap share
+struct Collector {
+    MarkWorker workers[HEAP_MAX_MARK_THREADS];
+    size_t worker_count;
+    size_t idle_workers;
+    const char *nursery;       // young objects are told apart by address
+    const char *nursery_end;
+    int concurrent;            // the program runs alongside the markers
+    char object_locks[OBJECT_LOCK_STRIPES];
+};
+
+static __thread Collector collector;
+static __thread size_t mark_threads_setting = 0;
+static __thread int concurrent_marking = 0;
+
+// written only by the heap's own thread, which is the only one that
+// reads it - markers look at their collector's copy
+__thread int heap_marking_active = 0;
+static __thread PointerStack overwritten = {NULL, 0, 0};
+
+// a collection can't stop halfway, so running out of memory in one is fatal
+static void out_of_memory(void) {
+    fprintf(stderr, "shardjs: out of memory during garbage collection\n");
+    abort();
+}
+
+static void stack_push(PointerStack *stack, void *item) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity ? stack->capacity * 2 : 64;
+        void **items = realloc(stack->items, capacity * sizeof(void*));
+        if (!items) {
+            out_of_memory();
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    stack->items[stack->count++] = item;
+}
+
+static void stack_free(PointerStack *stack) {
+    free(stack->items);
+    stack->items = NULL;
+    stack->count = 0;
+    stack->capacity = 0;
+}
+
+static size_t align_size(size_t size) {
+    return (size + HEAP_ALIGNMENT - 1) & ~(size_t)(HEAP_ALIGNMENT - 1);
+}
+
+// locks are held for a handful of loads and stores, so spin, but give
+// the cpu away in case the holder isn't running
+static void spin_lock(char *lock) {
+    while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+static void spin_unlock(char *lock) {
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+static double now_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void record_pause(size_t *histogram, double start) {
+    double elapsed = now_microseconds() - start;
+    size_t bucket = 0;
+    while (bucket + 1 < HEAP_PAUSE_BUCKETS && elapsed >= (double)((size_t)2 << bucket)) {
+        bucket++;
+    }
+    histogram[bucket]++;
+    if (elapsed > longest_pause_us) {
+        longest_pause_us = elapsed;
+    }
+}
+
+// give back what an object owns outside itself
+static void object_release(Object *object) {
+    switch (object->type) {
+        case OBJ_STRING:
+            string_release((StringObject*)object);
+            break;
+        case OBJ_FLOAT64_ARRAY:
+            float64_array_release((Float64ArrayObject*)object);
+            break;
+        case OBJ_ARRAY:
+            array_release((ArrayObject*)object);
+            break;
+        case OBJ_RECORD:
+            record_release((RecordObject*)object);
+            break;
+        case OBJ_MAP:
+            map_release((MapObject*)object);
+            break;
+        case OBJ_SKETCH:
+            sketch_release((SketchObject*)object);
+            break;
+        case OBJ_MATRIX:
+            matrix_release((MatrixObject*)object);
+            break;
+        case OBJ_WORKER:
+            break;
+        case OBJ_SHARED_ARRAY:
+            shared_array_release((SharedArrayObject*)object);
+            break;
+    }
+}
+
+static Object* old_allocate(size_t size) {
+    Object *object = malloc(size);
+    if (!object) {
+        return NULL;
+    }
+    object->next = old_objects;
+    old_objects = object;
+    old_object_count++;
+    old_bytes += size;
+    return object;
+}
+
+static int nursery_create(void) {
+    nursery = malloc(nursery_size);
+    if (!nursery) {
+        return 0;
+    }
+    nursery_top = nursery;
+    nursery_end = nursery + nursery_size;
+    return 1;
+}
+
+// allocate a zeroed object in the nursery, collecting it first if it is
+// full - NULL when out of memory
+void* heap_allocate(ObjectType type, size_t size) {
+    size = align_size(size);
+    if ((size_t)(nursery_end - nursery_top) < size) {
+        if (!nursery) {
+            if (!nursery_create()) {
+                return NULL;
+            }
+        } else {
+            heap_collect_minor();
+        }
+        if ((size_t)(nursery_end - nursery_top) < size) {
+            return NULL;
+        }
+    }
+
+    Object *object = (Object*)nursery_top;
+    nursery_top += size;
+    nursery_objects++;
+    memset(object, 0, size);
+    object->type = (uint8_t)type;
+    object->size = (uint32_t)size;
+    return object;
+}
+
+void* heap_allocate_pinned(ObjectType type, size_t size) {
+    size = align_size(size);
+    Object *object = old_allocate(size);
+    if (!object) {
+        return NULL;
+    }
+    Object *next = object->next;
+    memset(object, 0, size);
+    object->next = next;
+    object->type = (uint8_t)type;
+    object->flags = OBJECT_OLD | OBJECT_PINNED;
+    object->size = (uint32_t)size;
+    return object;
+}
+
+// call visit on every value an object holds. rope halves are plain
+// pointers, so they go through a value and back.
+static void visit_string(StringObject **slot, HeapVisitor visit) {
+    Value value = value_from_pointer(*slot);
+    visit(&value);
+    *slot = value_as_pointer(value);
+}
+
+static void visit_children(Object *object, HeapVisitor visit) {
+    switch (object->type) {
+        case OBJ_STRING: {
+            StringObject *string = (StringObject*)object;
+            if (string->kind == STRING_ROPE) {
+                visit_string(&string->as.rope.left, visit);
+                visit_string(&string->as.rope.right, visit);
+            }
+            break;
+        }
+        case OBJ_ARRAY: {
+            ArrayObject *array = (ArrayObject*)object;
+            if (array->kind == ARRAY_VALUES) {
+                ArrayElement *elements = array_elements(array);
+                for (size_t i = 0; i < array->length; i++) {
+                    visit(&elements[i].value);
+                }
+            }
+            break;
+        }
+        case OBJ_RECORD: {
+            RecordObject *record = (RecordObject*)object;
+            for (uint32_t i = 0; i < record->shape->count; i++) {
+                visit(record_slot(record, i));
+            }
+            break;
+        }
+        case OBJ_MAP: {
+            MapObject *map = (MapObject*)object;
+            for (size_t i = 0; i < map->entry_count; i++) {
+                visit(&map->entries[i].key);
+                visit(&map->entries[i].value);
+            }
+            break;
+        }
+        case OBJ_FLOAT64_ARRAY:
+        case OBJ_SKETCH:
+        case OBJ_MATRIX:
+        case OBJ_WORKER:
+        case OBJ_SHARED_ARRAY:
+            break;
+    }
+}
+
+static void visit_roots(HeapVisitor visit) {
+    for (size_t i = 0; i < scanner_count; i++) {
+        scanners[i].scan(scanners[i].context, visit);
+    }
+    for (size_t i = 0; i < value_stack.count; i++) {
+        visit(value_stack.items[i]);
+    }
+}
+
+// nursery collection. a reachable nursery object is copied to the old
+// generation the first time it is found, leaving its new address in its
+// header for every later reference, and the copy is queued so its own
+// children get the same treatment.
+static void evacuate(Value *slot) {
+    if (!value_is_pointer(*slot)) {
+        return;
+    }
+    Object *object = value_as_pointer(*slot);
+    if (object_flags(object) & OBJECT_OLD) {
+        return;
+    }
+    if (!object->next) {
+        Object *copy = old_allocate(object->size);
+        if (!copy) {
+            out_of_memory();
+        }
+        Object *next = copy->next;
+        memcpy(copy, object, object->size);
+        copy->next = next;
+        // promoted while marking runs - new to the snapshot, so kept
+        copy->flags |= heap_marking_active ? OBJECT_OLD | OBJECT_MARKED : OBJECT_OLD;
+        object->next = copy;
+        promoted_bytes += object->size;
+        stack_push(&work, copy);
+    }
+    *slot = value_from_pointer(object->next);
+}
+
+static void collect_nursery(void) {
+    if (!nursery) {
+        return;
+    }
+
+    visit_roots(evacuate);
+    for (size_t i = 0; i < remembered.count; i++) {
+        Object *object = remembered.items[i];
+        __atomic_fetch_and(&object->flags, (uint8_t)~OBJECT_REMEMBERED, __ATOMIC_RELAXED);
+        heap_lock_object(object);
+        if (object->type == OBJ_ARRAY) {
+            ArrayObject *array = (ArrayObject*)object;
+            ArrayElement *elements = array_elements(array);
+            for (size_t j = array->dirty_from; j < array->length; j++) {
+                evacuate(&elements[j].value);
+            }
+        } else if (object->type == OBJ_MAP) {
+            MapObject *map = (MapObject*)object;
+            for (size_t j = map->dirty_from; j < map->entry_count; j++) {
+                evacuate(&map->entries[j].key);
+                evacuate(&map->entries[j].value);
+            }
+        } else {
+            visit_children(object, evacuate);
+        }
+        heap_unlock_object(object);
+    }
+    remembered.count = 0;
+    while (work.count > 0) {
+        visit_children(work.items[--work.count], evacuate);
+    }
+
+    // whatever wasn't copied is garbage - only its buffers need freeing
+    for (char *cursor = nursery; cursor < nursery_top; cursor += ((Object*)cursor)->size) {
+        Object *object = (Object*)cursor;
+        if (!object->next) {
+            object_release(object);
+        }
+    }
+    nursery_top = nursery;
+    nursery_objects = 0;
+    minor_collections++;
+}
+
+// full collection - mark from the roots, then sweep the old generation.
+// only old objects are marked: a stop-the-world collection empties the
+// nursery first, and while marking in the background new objects are
+// either still in the nursery or promoted already marked.
+static int in_nursery(const Collector *marking, const Object *object) {
+    return (const char*)object >= marking->nursery && (const char*)object < marking->nursery_end;
+}
+
+static void worker_push(MarkWorker *worker, Object *object) {
+    if (worker->count == worker->capacity) {
+        size_t capacity = worker->capacity ? worker->capacity * 2 : 256;
+        Object **items = realloc(worker->items, capacity * sizeof(Object*));
+        if (!items) {
+            out_of_memory();
+        }
+        worker->items = items;
+        worker->capacity = capacity;
+    }
+    worker->items[worker->count++] = object;
+}
+
+static void mark_value(MarkWorker *worker, Value value) {
+    if (!value_is_pointer(value)) {
+        return;
+    }
+    Object *object = value_as_pointer(value);
+    if (in_nursery(worker->collector, object)) {
+        return;
+    }
+    if (!(__atomic_fetch_or(&object->flags, OBJECT_MARKED, __ATOMIC_RELAXED) & OBJECT_MARKED)) {
+        worker_push(worker, object);
+    }
+}
+
+static void mark_children(MarkWorker *worker, Object *object) {
+    // the program only runs alongside when marking concurrently
+    char *locks = worker->collector->object_locks;
+    int locked = worker->collector->concurrent;
+    if (locked) {
+        spin_lock(&locks[((uintptr_t)object >> 4) % OBJECT_LOCK_STRIPES]);
+    }
+    switch (object->type) {
+        case OBJ_STRING: {
+            StringObject *string = (StringObject*)object;
+            if (string->kind == STRING_ROPE) {
+                mark_value(worker, value_from_pointer(string->as.rope.left));
+                mark_value(worker, value_from_pointer(string->as.rope.right));
+            }
+            break;
+        }
+        case OBJ_ARRAY: {
+            ArrayObject *array = (ArrayObject*)object;
+            if (array->kind == ARRAY_VALUES) {
+                ArrayElement *elements = array_elements(array);
+                for (size_t i = 0; i < array->length; i++) {
+                    mark_value(worker, elements[i].value);
+                }
+            }
+            break;
+        }
+        case OBJ_RECORD: {
+            RecordObject *record = (RecordObject*)object;
+            for (uint32_t i = 0; i < record->shape->count; i++) {
+                mark_value(worker, *record_slot(record, i));
+            }
+            break;
+        }
+        case OBJ_MAP: {
+            MapObject *map = (MapObject*)object;
+            for (size_t i = 0; i < map->entry_count; i++) {
+                mark_value(worker, map->entries[i].key);
+                mark_value(worker, map->entries[i].value);
+            }
+            break;
+        }
+        case OBJ_FLOAT64_ARRAY:
+        case OBJ_SKETCH:
+        case OBJ_MATRIX:
+        case OBJ_WORKER:
+        case OBJ_SHARED_ARRAY:
+            break;
+    }
+    if (locked) {
+        spin_unlock(&locks[((uintptr_t)object >> 4) % OBJECT_LOCK_STRIPES]);
+    }
+}
+
+// move the older half of a worker's own stack where others can take it
+static void share_work(MarkWorker *worker) {
+    size_t half = worker->count / 2;
+    spin_lock(&worker->lock);
+    if (worker->shared_capacity < half) {
+        Object **shared = realloc(worker->shared, half * sizeof(Object*));
+        if (!shared) {
+            out_of_memory();
+        }
+        worker->shared = shared;
+        worker->shared_capacity = half;
+    }
+    memcpy(worker->shared, worker->items, half * sizeof(Object*));
+    memmove(worker->items, worker->items + half, (worker->count - half) * sizeof(Object*));
+    worker->count -= half;
+    __atomic_store_n(&worker->shared_count, half, __ATOMIC_RELEASE);
+    spin_unlock(&worker->lock);
+}
+
+// take half of what a worker has shared, at least one - 0 when empty
+static size_t steal_work(MarkWorker *thief, MarkWorker *victim) {
+    if (__atomic_load_n(&victim->shared_count, __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+    spin_lock(&victim->lock);
+    size_t count = victim->shared_count;
+    size_t taken = (count + 1) / 2;
+    for (size_t i = count - taken; i < count; i++) {
+        worker_push(thief, victim->shared[i]);
+    }
+    __atomic_store_n(&victim->shared_count, count - taken, __ATOMIC_RELEASE);
+    spin_unlock(&victim->lock);
+    return taken;
+}
+
+static int find_work(MarkWorker *worker) {
+    Collector *marking = worker->collector;
+    size_t self = (size_t)(worker - marking->workers);
+    for (size_t i = 0; i < marking->worker_count; i++) {
+        if (steal_work(worker, &marking->workers[(self + i) % marking->worker_count])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int any_shared_work(const Collector *marking) {
+    for (size_t i = 0; i < marking->worker_count; i++) {
+        if (__atomic_load_n(&marking->workers[i].shared_count, __ATOMIC_ACQUIRE) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// trace until no thread has anything left. a thread out of work counts
+// itself idle and only leaves once every thread is idle with nothing
+// shared; seeing shared work, it stops being idle and steals it.
+static void* mark_loop(void *argument) {
+    MarkWorker *worker = argument;
+    Collector *marking = worker->collector;
+    for (;;) {
+        while (worker->count > 0) {
+            mark_children(worker, worker->items[--worker->count]);
+            if (marking->worker_count > 1 && worker->count >= MARK_SHARE_MIN &&
+                __atomic_load_n(&worker->shared_count, __ATOMIC_ACQUIRE) == 0) {
+                share_work(worker);
+            }
+        }
+        if (find_work(worker)) {
+            continue;
+        }
+
+        __atomic_add_fetch(&marking->idle_workers, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (any_shared_work(marking)) {
+                __atomic_sub_fetch(&marking->idle_workers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            if (__atomic_load_n(&marking->idle_workers, __ATOMIC_SEQ_CST) == marking->worker_count) {
+                return NULL;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static size_t mark_thread_count(void) {
+    size_t threads = mark_threads_setting;
+    if (threads == 0) {
+        if (old_object_count < HEAP_PARALLEL_MARK_MIN_OBJECTS) {
+            return 1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    return threads > HEAP_MAX_MARK_THREADS ? HEAP_MAX_MARK_THREADS : threads;
+}
+
+static void mark_root(Value *slot) {
+    mark_value(&collector.workers[0], *slot);
+}
+
+// point the markers at this thread's heap - before marking any roots
+static void prepare_marking(void) {
+    for (size_t i = 0; i < HEAP_MAX_MARK_THREADS; i++) {
+        collector.workers[i].collector = &collector;
+    }
+    collector.nursery = nursery;
+    collector.nursery_end = nursery_end;
+}
+
+static void start_markers(size_t threads, size_t first) {
+    collector.worker_count = threads;
+    collector.idle_workers = 0;
+    for (size_t i = first; i < threads; i++) {
+        MarkWorker *worker = &collector.workers[i];
+        worker->started = pthread_create(&worker->thread, NULL, mark_loop, worker) == 0;
+        if (!worker->started) {
+            // it holds no work, so it can stand idle for good
+            __atomic_add_fetch(&collector.idle_workers, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+static void join_markers(void) {
+    for (size_t i = 0; i < collector.worker_count; i++) {
+        if (collector.workers[i].started) {
+            pthread_join(collector.workers[i].thread, NULL);
+            collector.workers[i].started = 0;
+        }
+    }
+}
+
+// trace what workers[0] holds with every thread, this one included
+static void mark_all(size_t threads) {
+    start_markers(threads, 1);
+    mark_loop(&collector.workers[0]);
+    join_markers();
+    last_mark_threads = threads;
+}
+
+// free the unmarked objects of a list and unmark the rest, which are
+// returned as a list ending at *tail
+static Object* sweep_objects(Object *list, Object **tail, size_t *freed, size_t *freed_bytes) {
+    Object *survivors = NULL;
+    Object **link = &survivors;
+    *tail = NULL;
+    *freed = 0;
+    *freed_bytes = 0;
+    while (list) {
+        Object *object = list;
+        list = object->next;
+        if (object_flags(object) & (OBJECT_MARKED | OBJECT_PINNED)) {
+            __atomic_fetch_and(&object->flags, (uint8_t)~OBJECT_MARKED, __ATOMIC_RELAXED);
+            *link = object;
+            link = &object->next;
+            *tail = object;
+            continue;
+        }
+        (*freed)++;
+        *freed_bytes += object->size;
+        object_release(object);
+        free(object);
+    }
+    *link = NULL;
+    return survivors;
+}
+
+static void sweep_finished(size_t freed, size_t freed_bytes) {
+    old_object_count -= freed;
+    old_bytes -= freed_bytes;
+    major_threshold = old_bytes * 2 > HEAP_MAJOR_MIN_BYTES ? old_bytes * 2 : HEAP_MAJOR_MIN_BYTES;
+    major_collections++;
+}
+
+static void sweep(void) {
+    Object *tail;
+    size_t freed;
+    size_t freed_bytes;
+    old_objects = sweep_objects(old_objects, &tail, &freed, &freed_bytes);
+    sweep_finished(freed, freed_bytes);
+}
+
+// after marking in the background, sweeping is too. the old objects are
+// taken off the list and swept on another thread while promotions start
+// a new list, and the survivors are put back once the thread is done.
+typedef struct {
+    Object *objects;       // to sweep, then the survivors
+    Object *tail;
+    size_t freed;
+    size_t freed_bytes;
+    pthread_t thread;
+    int started;
+    int running;
+    int done;
+} BackgroundSweep;
+
+static __thread BackgroundSweep background_sweep;
+
+static void* sweep_thread(void *argument) {
+    BackgroundSweep *job = argument;
+    job->objects = sweep_objects(job->objects, &job->tail, &job->freed, &job->freed_bytes);
+    __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void start_background_sweep(void) {
+    background_sweep.objects = old_objects;
+    old_objects = NULL;
+    background_sweep.done = 0;
+    background_sweep.running = 1;
+    background_sweep.started = pthread_create(&background_sweep.thread, NULL, sweep_thread, &background_sweep) == 0;
+    if (!background_sweep.started) {
+        sweep_thread(&background_sweep);
+    }
+}
+
+static void finish_background_sweep(void) {
+    if (!background_sweep.running) {
+        return;
+    }
+    if (background_sweep.started) {
+        pthread_join(background_sweep.thread, NULL);
+    }
+    if (background_sweep.tail) {
+        background_sweep.tail->next = old_objects;
+        old_objects = background_sweep.objects;
+    }
+    background_sweep.running = 0;
+    sweep_finished(background_sweep.freed, background_sweep.freed_bytes);
+}
+
+static void mark_sweep(void) {
+    prepare_marking();
+    visit_roots(mark_root);
+    mark_all(mark_thread_count());
+    sweep();
+}
+
+// mark the roots and leave the tracing to background threads. the
+// nursery has just been emptied and has to exist, since markers tell
+// young objects apart by address.
+static void start_concurrent_mark(void) {
+    if (!nursery && !nursery_create()) {
+        mark_sweep();
+        return;
+    }
+    prepare_marking();
+    visit_roots(mark_root);
+    heap_marking_active = 1;
+    collector.concurrent = 1;
+    size_t threads = mark_thread_count();
+    start_markers(threads, 0);
+    if (!collector.workers[0].started) {
+        // the roots are with the thread that failed to start, so the
+        // others stop at once and this one does the marking
+        join_markers();
+        heap_marking_active = 0;
+        collector.concurrent = 0;
+        mark_all(threads);
+        sweep();
+        return;
+    }
+    last_mark_threads = threads;
+}
+
+static int markers_finished(void) {
+    return __atomic_load_n(&collector.idle_workers, __ATOMIC_SEQ_CST) == collector.worker_count;
+}
+
+// wait for the markers, trace whatever was overwritten meanwhile and
+// sweep, in the background or right away. called with the nursery empty.
+static void finish_concurrent_mark(int sweep_in_background) {
+    join_markers();
+    heap_marking_active = 0;
+    collector.concurrent = 0;
+    for (size_t i = 0; i < overwritten.count; i++) {
+        mark_value(&collector.workers[0], value_from_pointer(overwritten.items[i]));
+    }
+    overwritten.count = 0;
+    mark_all(collector.worker_count);
+    if (sweep_in_background) {
+        start_background_sweep();
+    } else {
+        sweep();
+    }
+}
+
+// wait for any collection going on in the background
+static void finish_background_work(void) {
+    if (heap_marking_active) {
+        finish_concurrent_mark(0);
+    }
+    finish_background_sweep();
+}
+
+void heap_collect_minor(void) {
+    double start = now_microseconds();
+    int major = 0;
+    collect_nursery();
+    if (background_sweep.running) {
+        if (__atomic_load_n(&background_sweep.done, __ATOMIC_ACQUIRE)) {
+            finish_background_sweep();
+            major = 1;
+        }
+    } else if (heap_marking_active) {
+        // finish early rather than let floating garbage pile up
+        if (markers_finished() || old_bytes > major_threshold * 2) {
+            finish_concurrent_mark(1);
+            major = 1;
+        }
+    } else if (old_bytes > major_threshold) {
+        if (concurrent_marking) {
+            start_concurrent_mark();
+        } else {
+            mark_sweep();
+        }
+        major = 1;
+    }
+    record_pause(major ? major_pauses : minor_pauses, start);
+}
+
+// a background marking keeps what was live when it started, so it is
+// finished before marking again from scratch
+void heap_collect_major(void) {
+    double start = now_microseconds();
+    collect_nursery();
+    finish_background_work();
+    mark_sweep();
+    record_pause(major_pauses, start);
+}
+
+void heap_start_major(void) {
+    if (!concurrent_marking) {
+        heap_collect_major();
+        return;
+    }
+    if (heap_marking_active) {
+        return;
+    }
+    double start = now_microseconds();
+    collect_nursery();
+    finish_background_sweep();
+    start_concurrent_mark();
+    record_pause(major_pauses, start);
+}
+
+void heap_set_mark_threads(size_t threads) {
+    mark_threads_setting = threads;
+}
+
+void heap_set_concurrent_marking(int enabled) {
+    concurrent_marking = enabled;
+}
+
+size_t heap_mark_threads(void) {
+    return mark_threads_setting;
+}
+
+int heap_concurrent_marking(void) {
+    return concurrent_marking;
+}
+
+void heap_log_overwrite(Value old) {
+    stack_push(&overwritten, value_as_pointer(old));
+}
+
+void heap_lock_object_slow(Object *object) {
+    spin_lock(&collector.object_locks[((uintptr_t)object >> 4) % OBJECT_LOCK_STRIPES]);
+}
+
+void heap_unlock_object_slow(Object *object) {
+    spin_unlock(&collector.object_locks[((uintptr_t)object >> 4) % OBJECT_LOCK_STRIPES]);
+}
+
+// resize the nursery, emptying it first. the new one is allocated on
+// the next allocation.
+void heap_set_nursery_size(size_t bytes) {
+    collect_nursery();
+    finish_background_work();
+    free(nursery);
+    nursery = nursery_top = nursery_end = NULL;
+    nursery_size = bytes < HEAP_NURSERY_MIN_SIZE ? HEAP_NURSERY_MIN_SIZE : align_size(bytes);
+}
+
+void heap_remember(Object *owner) {
+    __atomic_fetch_or(&owner->flags, OBJECT_REMEMBERED, __ATOMIC_RELAXED);
+    stack_push(&remembered, owner);
+}
+
+void heap_push_root(Value *slot) {
+    stack_push(&value_stack, slot);
+}
+
+void heap_pop_roots(size_t count) {
+    value_stack.count -= count;
+}
+
+size_t heap_root_depth(void) {
+    return value_stack.count;
+}
+
+int heap_add_root_scanner(HeapRootScanner scan, void *context) {
+    if (scanner_count == scanner_capacity) {
+        size_t capacity = scanner_capacity ? scanner_capacity * 2 : 4;
+        RootScanner *grown = realloc(scanners, capacity * sizeof(RootScanner));
+        if (!grown) {
+            return 0;
+        }
+        scanners = grown;
+        scanner_capacity = capacity;
+    }
+    scanners[scanner_count].scan = scan;
+    scanners[scanner_count].context = context;
+    scanner_count++;
+    return 1;
+}
+
+void heap_remove_root_scanner(HeapRootScanner scan, void *context) {
+    for (size_t i = 0; i < scanner_count; i++) {
+        if (scanners[i].scan == scan && scanners[i].context == context) {
+            scanners[i] = scanners[--scanner_count];
+            break;
+        }
+    }
+    if (scanner_count == 0) {
+        free(scanners);
+        scanners = NULL;
+        scanner_capacity = 0;
+    }
+}
+
+// free every object - values still held anywhere become invalid
+void heap_destroy(void) {
+    if (heap_marking_active) {
+        join_markers();
+        heap_marking_active = 0;
+        collector.concurrent = 0;
+    }
+    finish_background_sweep();
+    string_table_destroy();
+    shape_table_destroy();
+
+    for (char *cursor = nursery; cursor < nursery_top; cursor += ((Object*)cursor)->size) {
+        object_release((Object*)cursor);
+    }
+    free(nursery);
+    nursery = nursery_top = nursery_end = NULL;
+    nursery_size = HEAP_NURSERY_SIZE;
+    nursery_objects = 0;
+
+    Object *object = old_objects;
+    while (object) {
+        Object *next = object->next;
+        object_release(object);
+        free(object);
+        object = next;
+    }
+    old_objects = NULL;
+    old_object_count = 0;
+    old_bytes = 0;
+    major_threshold = HEAP_MAJOR_MIN_BYTES;
+
+    stack_free(&value_stack);
+    stack_free(&remembered);
+    stack_free(&work);
+    stack_free(&overwritten);
+    for (size_t i = 0; i < HEAP_MAX_MARK_THREADS; i++) {
+        free(collector.workers[i].items);
+        free(collector.workers[i].shared);
+        memset(&collector.workers[i], 0, sizeof(MarkWorker));
+    }
+    collector.worker_count = 0;
+    mark_threads_setting = 0;
+    concurrent_marking = 0;
+
+    minor_collections = 0;
+    major_collections = 0;
+    promoted_bytes = 0;
+    last_mark_threads = 0;
+    memset(minor_pauses, 0, sizeof(minor_pauses));
+    memset(major_pauses, 0, sizeof(major_pauses));
+    longest_pause_us = 0;
+}
+
+HeapStats heap_get_stats(void) {
+    HeapStats stats;
+    stats.objects = nursery_objects + old_object_count;
+    stats.bytes = (size_t)(nursery_top - nursery) + old_bytes;
+    stats.old_bytes = old_bytes;
+    stats.minor_collections = minor_collections;
+    stats.major_collections = major_collections;
+    stats.promoted_bytes = promoted_bytes;
+    stats.mark_threads = last_mark_threads;
+    memcpy(stats.minor_pauses, minor_pauses, sizeof(minor_pauses));
+    memcpy(stats.major_pauses, major_pauses, sizeof(major_pauses));
+    stats.longest_pause_us = longest_pause_us;
+    return stats;
+}
@@ -0,0 +1,36 @@
+/*
+ * csv.h - numeric column reader for shardjs
+ *
+ * reads chosen columns of a comma separated file with a header row into
+ * arrays of doubles. structural characters are found a block at a time
+ * with simd compares, numbers go through a fast exact parser, and large
+ * files are split across threads at line boundaries.
+ */
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+
+// files smaller than this are read on the calling thread
+#define CSV_PARALLEL_MIN_BYTES (1u << 20)
+#define CSV_MAX_THREADS 8
+
+typedef struct {
+    size_t rows;
+    size_t threads;        // how many threads the parse used
+} CsvResult;
+
+// fill columns[i] with a new 32-byte aligned buffer of doubles holding
+// column names[i], to be released with free. fields that aren't
+// numbers read as NaN, and quoted fields are not supported. returns 0
+// with a reason in error when the file can't be read or a name isn't
+// in the header. threads of 0 picks a count from the file size and the
+// cpu count.
+int csv_read_columns(const char *path, const char **names, size_t count, size_t threads,
+                     double **columns, CsvResult *result, char *error, size_t error_size);
+
+// the number parser on its own - NaN unless all of [start, end) is one
+double csv_parse_number(const char *start, const char *end);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * hash.h - fast hashing and shard assignment for shardjs
+ *
+ * a seeded 64-bit hash of numbers and strings in the style of xxh3 -
+ * multiplies folded to 64 bits over a fixed secret, then a strong
+ * avalanche - and the two consistent hashes used to place keys on
+ * shards: jump hashing for numbered buckets and rendezvous hashing for
+ * a list of named nodes. the hashes are not xxh3's own values.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// the secret numbers are mixed with the seed, the multiplier is the one
+// xxh3 uses for its 4 to 8 byte inputs
+#define HASH_SECRET_NUMBER 0x1cad21f72c81017cULL
+#define HASH_MIX_MULTIPLIER 0x9fb21c651e98df25ULL
+
+// 0 and -0 are the same key, and so is every nan
+static inline uint64_t hash_number_bits(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return x != x ? 0x7ff8000000000000ULL : x == 0.0 ? 0 : bits;
+}
+
+static inline uint64_t hash_rotate(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// a number hashes as its eight bytes, through xxh3's rrmxmx mixer. the
+// vector kernels compute exactly this, four or two at a time.
+static inline uint64_t hash_number(double x, uint64_t seed) {
+    uint64_t k = hash_number_bits(x) ^ (HASH_SECRET_NUMBER ^ seed);
+    k ^= hash_rotate(k, 49) ^ hash_rotate(k, 24);
+    k *= HASH_MIX_MULTIPLIER;
+    k ^= (k >> 35) + 8;
+    k *= HASH_MIX_MULTIPLIER;
+    return k ^ (k >> 28);
+}
+
+// a string never hashes like the number it spells
+uint64_t hash_bytes(const char *chars, size_t length, uint64_t seed);
+// out[i] = hash_number(x[i], seed), with the vector kernels
+void hash_numbers(const double *x, size_t n, uint64_t seed, uint64_t *out);
+
+// the bucket from 0 to buckets - 1 for an already hashed key. growing
+// from n to n + 1 buckets moves only 1 / (n + 1) of the keys, all of
+// them to the new bucket. takes about ln(buckets) steps.
+uint32_t hash_jump(uint64_t key, uint32_t buckets);
+
+// the node whose hash scores highest combined with the key's. removing
+// a node moves only the keys it held, spread over the others.
+size_t hash_rendezvous(uint64_t key, const uint64_t *nodes, size_t n);
+
+#endif
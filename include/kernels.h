@@ -0,0 +1,42 @@
+/*
+ * kernels.h - whole-array numeric kernels for shardjs
+ *
+ * each kernel has a scalar version and, on x86, sse2 and avx2 versions
+ * picked once at startup. reductions use the same sixteen-lane order on
+ * every path, so results are bit-identical whichever one runs.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+} KernelIsa;
+
+// instruction set selection
+KernelIsa kernel_best_isa(void);
+KernelIsa kernel_current_isa(void);
+int kernel_use_isa(KernelIsa isa);
+const char* kernel_isa_name(KernelIsa isa);
+
+// reductions - callers have already checked the lengths
+double kernel_sum(const double *x, size_t n);
+double kernel_min(const double *x, size_t n);
+double kernel_max(const double *x, size_t n);
+double kernel_dot(const double *x, const double *y, size_t n);
+// the sum of (x[i] - center)^2
+double kernel_deviations(const double *x, double center, size_t n);
+
+// in place updates
+void kernel_scale(double *x, double factor, size_t n);
+void kernel_axpy(double alpha, const double *x, double *y, size_t n);
+
+// out[i] = hash_number(x[i], seed) from hash.h
+void kernel_hash_numbers(const double *x, uint64_t seed, uint64_t *out, size_t n);
+
+#endif
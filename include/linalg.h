@@ -0,0 +1,38 @@
+/*
+ * linalg.h - dense matrix arithmetic for shardjs
+ *
+ * matrices are rows of doubles one after another. a product is worked
+ * through in blocks sized for the caches, each block copied into the
+ * order a register-tiled vector kernel reads it in. every element is
+ * still summed over k in order, one multiply and one add at a time, so
+ * products come out as the same bits as the plain triple loop whatever
+ * the instruction set or the number of threads.
+ */
+
+#ifndef LINALG_H
+#define LINALG_H
+
+#include <stddef.h>
+
+// products with fewer multiply-adds than this run on the calling thread
+#define LINALG_PARALLEL_MIN (1u << 22)
+#define LINALG_MAX_THREADS 8
+
+// c (m by n) = a (m by k) times b (k by n). c must not overlap a or b.
+// threads of 0 picks a count from the size and the cpu count. returns
+// the number of threads used, or 0 when out of memory.
+size_t linalg_matmul(const double *a, const double *b, double *c, size_t m, size_t k, size_t n, size_t threads);
+
+// out (cols by rows) = a (rows by cols) turned over. out must not
+// overlap a.
+void linalg_transpose(const double *a, double *out, size_t rows, size_t cols);
+
+// y = a x, each element the dot kernel's sum of a row times x
+void linalg_matvec(const double *a, const double *x, double *y, size_t rows, size_t cols);
+
+// out[i] = a[i] op b[i] for op '+', '-', '*' or '/', where a step of 0
+// uses the one number throughout. out may be a or b.
+void linalg_elementwise(char op, const double *a, size_t a_step, const double *b, size_t b_step,
+                        double *out, size_t n);
+
+#endif
@@ -0,0 +1,566 @@
+/*
+ * object.h - heap objects for shardjs
+ *
+ * anything that doesn't fit in a nan-boxed value lives on the heap and
+ * is referenced through a pointer value. every object starts with the
+ * same header so the runtime can tell kinds apart and find them all.
+ */
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+#include "stats.h"
+#include "shared.h"
+
+typedef enum {
+    OBJ_STRING,
+    OBJ_FLOAT64_ARRAY,
+    OBJ_ARRAY,
+    OBJ_RECORD,
+    OBJ_MAP,
+    OBJ_SKETCH,
+    OBJ_MATRIX,
+    OBJ_WORKER,
+    OBJ_SHARED_ARRAY
+} ObjectType;
+
+// common header - must be the first member of every heap object
+typedef struct Object {
+    struct Object *next;   // old objects, newest first. in the nursery it is
+                           // NULL, or the new address once the object is copied
+    uint8_t type;          // ObjectType
+    uint8_t flags;         // OBJECT_* bits
+    uint32_t size;         // bytes, header included
+} Object;
+
+#define OBJECT_OLD        0x01   // lives in the old generation
+#define OBJECT_MARKED     0x02   // reached during a full collection
+#define OBJECT_REMEMBERED 0x04   // old object in the remembered set
+#define OBJECT_PINNED     0x08   // never moved or freed before heap_destroy
+
+// a new generation is bump-allocated in this much memory
+#define HEAP_NURSERY_SIZE (1u << 20)
+// a full collection runs once the old generation is past this size and
+// twice what survived the last one
+#define HEAP_MAJOR_MIN_BYTES (4u << 20)
+
+// at most this many threads mark the old generation
+#define HEAP_MAX_MARK_THREADS 8
+// pause histograms - bucket i counts pauses shorter than 2^(i+1)
+// microseconds and not shorter than 2^i, the last one everything longer
+#define HEAP_PAUSE_BUCKETS 24
+
+// heap counters for --stats
+typedef struct {
+    size_t objects;            // allocated and not yet freed
+    size_t bytes;
+    size_t old_bytes;          // the part of bytes in the old generation
+    size_t minor_collections;
+    size_t major_collections;
+    size_t promoted_bytes;     // copied out of the nursery, all time
+    size_t mark_threads;       // threads the last full collection marked with
+    size_t minor_pauses[HEAP_PAUSE_BUCKETS];   // nursery collections
+    size_t major_pauses[HEAP_PAUSE_BUCKETS];   // pauses that marked or swept
+    double longest_pause_us;
+} HeapStats;
+
+// heap interface. objects are zeroed and may move in any allocation, so
+// c code that holds values across one must root them - see below. each
+// thread gets a heap of its own on its first allocation, and objects
+// never cross from one to another.
+void* heap_allocate(ObjectType type, size_t size);
+// straight into the old generation, never moved or collected. pinned
+// objects must not refer to other objects.
+void* heap_allocate_pinned(ObjectType type, size_t size);
+void heap_collect_minor(void);
+void heap_collect_major(void);
+void heap_set_nursery_size(size_t bytes);
+// threads marking the old generation, 0 for one per cpu once it is big
+// enough to be worth it
+void heap_set_mark_threads(size_t threads);
+// mark in the background while the program runs, pausing it only to
+// seed the marking from the roots and to finish and sweep
+void heap_set_concurrent_marking(int enabled);
+// the settings above, for a worker to start its heap the same way
+size_t heap_mark_threads(void);
+int heap_concurrent_marking(void);
+// start a full collection - with concurrent marking it finishes in a
+// later nursery collection, otherwise right away
+void heap_start_major(void);
+void heap_destroy(void);
+HeapStats heap_get_stats(void);
+
+// the value stack - addresses of c locals holding values across an
+// allocation. a collection reads them as roots and updates them when
+// their objects move. pushes and pops must pair up.
+void heap_push_root(Value *slot);
+void heap_pop_roots(size_t count);
+size_t heap_root_depth(void);
+
+// other roots, such as environments, register a scanner that calls
+// visit on every value slot they hold
+typedef void (*HeapVisitor)(Value *slot);
+typedef void (*HeapRootScanner)(void *context, HeapVisitor visit);
+int heap_add_root_scanner(HeapRootScanner scan, void *context);
+void heap_remove_root_scanner(HeapRootScanner scan, void *context);
+
+// markers set OBJECT_MARKED from other threads, so the other bits are
+// read atomically too (a plain load on common cpus)
+static inline uint8_t object_flags(const Object *object) {
+    return __atomic_load_n(&object->flags, __ATOMIC_RELAXED);
+}
+
+// write barrier - call after storing value into owner. an old object that
+// starts pointing into the nursery is remembered, and the next nursery
+// collection treats it as a root. new objects are always in the nursery,
+// so the stores that fill one in need no barrier.
+void heap_remember(Object *owner);
+
+static inline int heap_is_old_to_young(const Object *owner, Value value) {
+    return (object_flags(owner) & OBJECT_OLD) && value_is_pointer(value) &&
+           !(object_flags(value_as_pointer(value)) & OBJECT_OLD);
+}
+
+static inline void heap_write_barrier(Object *owner, Value value) {
+    if (!(object_flags(owner) & OBJECT_REMEMBERED) && heap_is_old_to_young(owner, value)) {
+        heap_remember(owner);
+    }
+}
+
+// while a full collection marks in the background, everything that was
+// reachable when it started must still be found. a value overwritten in
+// an old object is logged for the marker before it is lost (call before
+// the store), and an old object is locked while what it refers to
+// changes, so markers never see it half updated. nothing may be
+// allocated while holding the lock.
+extern __thread int heap_marking_active;
+void heap_log_overwrite(Value old);
+void heap_lock_object_slow(Object *object);
+void heap_unlock_object_slow(Object *object);
+
+static inline void heap_overwrite_barrier(Object *owner, Value old) {
+    if (heap_marking_active && (object_flags(owner) & OBJECT_OLD) && value_is_pointer(old)) {
+        heap_log_overwrite(old);
+    }
+}
+
+static inline void heap_lock_object(Object *object) {
+    if (heap_marking_active && (object_flags(object) & OBJECT_OLD)) {
+        heap_lock_object_slow(object);
+    }
+}
+
+static inline void heap_unlock_object(Object *object) {
+    if (heap_marking_active && (object_flags(object) & OBJECT_OLD)) {
+        heap_unlock_object_slow(object);
+    }
+}
+
+static inline int value_is_object_type(Value value, ObjectType type) {
+    return value_is_pointer(value) && ((Object*)value_as_pointer(value))->type == type;
+}
+
+// strings. short ones are stored inline in the object, longer ones in
+// a separate buffer, and concatenation builds a rope that is only
+// flattened when somebody needs the characters.
+#define STRING_INLINE_MAX 23
+
+typedef enum {
+    STRING_INLINE,
+    STRING_FLAT,
+    STRING_ROPE
+} StringKind;
+
+typedef struct StringObject {
+    Object header;
+    uint8_t kind;          // StringKind
+    uint8_t interned;      // literals are interned and pinned
+    uint32_t length;
+    uint32_t hash;         // 0 until first needed
+    union {
+        char inline_chars[STRING_INLINE_MAX + 1];
+        char *chars;
+        struct {
+            struct StringObject *left;
+            struct StringObject *right;
+        } rope;
+    } as;
+} StringObject;
+
+static inline int value_is_string(Value value) {
+    return value_is_object_type(value, OBJ_STRING);
+}
+
+static inline StringObject* value_as_string(Value value) {
+    return (StringObject*)value_as_pointer(value);
+}
+
+// string interface - constructors return VALUE_NULL when out of memory
+Value string_from_chars(const char *chars, size_t length);
+Value string_intern(const char *chars, size_t length);
+// VALUE_NULL when nothing has interned these chars - never allocates
+Value string_find_interned(const char *chars, size_t length);
+Value string_concat(Value left, Value right);
+Value string_from_value(Value value);
+const char* string_chars(Value string);
+size_t string_length(Value string);
+uint32_t string_hash(Value string);
+int string_equals(Value left, Value right);
+int string_compare(Value left, Value right);
+
+// called by the heap when strings go away
+void string_release(StringObject *string);
+void string_table_destroy(void);
+
+// fixed-length arrays of doubles. the elements are a separate buffer
+// aligned for the widest vector loads the kernels use, or a read-only
+// mapping of a file of native-endian doubles.
+#define FLOAT64_ARRAY_ALIGNMENT 32
+
+typedef struct {
+    Object header;
+    uint8_t mapped;        // data is a read-only file mapping
+    size_t length;
+    double *data;          // NULL when length is 0
+} Float64ArrayObject;
+
+static inline int value_is_float64_array(Value value) {
+    return value_is_object_type(value, OBJ_FLOAT64_ARRAY);
+}
+
+static inline Float64ArrayObject* value_as_float64_array(Value value) {
+    return (Float64ArrayObject*)value_as_pointer(value);
+}
+
+// a zero-filled array - VALUE_NULL when out of memory
+Value float64_array_create(size_t length);
+// wrap a FLOAT64_ARRAY_ALIGNMENT aligned malloc'd buffer, taking it over
+Value float64_array_adopt(double *data, size_t length);
+// map a file without copying it. VALUE_NULL on failure, with a reason
+// written to error.
+Value float64_array_map(const char *path, char *error, size_t error_size);
+void float64_array_release(Float64ArrayObject *array);
+
+// dense matrices of doubles, written Matrix(rows, cols) in scripts. the
+// elements are one buffer, a row after another, allocated like a
+// Float64Array's so the matrix kernels can load whole vectors.
+typedef struct {
+    Object header;
+    size_t rows;
+    size_t cols;
+    double *data;          // NULL when there are no elements
+} MatrixObject;
+
+static inline int value_is_matrix(Value value) {
+    return value_is_object_type(value, OBJ_MATRIX);
+}
+
+static inline MatrixObject* value_as_matrix(Value value) {
+    return (MatrixObject*)value_as_pointer(value);
+}
+
+// a zero-filled matrix - VALUE_NULL when out of memory
+Value matrix_create(size_t rows, size_t cols);
+void matrix_release(MatrixObject *matrix);
+
+// a worker started by this thread's script, written Worker("path") in
+// scripts. the thread and its queues belong to worker.c and last until
+// the interpreter that started them shuts down, so the object is only
+// an index into that interpreter's workers and owns nothing itself.
+typedef struct {
+    Object header;
+    size_t index;
+} WorkerObject;
+
+static inline int value_is_worker(Value value) {
+    return value_is_object_type(value, OBJ_WORKER);
+}
+
+static inline WorkerObject* value_as_worker(Value value) {
+    return (WorkerObject*)value_as_pointer(value);
+}
+
+// an interpreter's handle on a shared buffer, written
+// SharedFloat64Array(n) or SharedInt64Array(n) in scripts. posting one
+// to a worker gives the worker a handle of its own on the same buffer.
+typedef struct {
+    Object header;
+    SharedBuffer *buffer;
+} SharedArrayObject;
+
+static inline int value_is_shared_array(Value value) {
+    return value_is_object_type(value, OBJ_SHARED_ARRAY);
+}
+
+static inline SharedArrayObject* value_as_shared_array(Value value) {
+    return (SharedArrayObject*)value_as_pointer(value);
+}
+
+// a handle taking over one reference to buffer - VALUE_NULL when out of
+// memory, with the reference still the caller's
+Value shared_array_adopt(SharedBuffer *buffer);
+void shared_array_release(SharedArrayObject *array);
+
+// arrays of any values, written [a, b, c] in scripts. an array holding
+// only numbers keeps them as raw doubles, which the collector never
+// scans and the vector kernels read directly; storing anything else
+// turns every element into a value for good. the first few elements
+// live in the object itself, so a small array is one allocation.
+#define ARRAY_INLINE_CAPACITY 4
+
+typedef enum {
+    ARRAY_NUMBERS,         // elements are doubles
+    ARRAY_VALUES           // elements are values
+} ArrayKind;
+
+typedef union {
+    Value value;
+    double number;
+} ArrayElement;
+
+typedef struct {
+    Object header;
+    uint8_t kind;          // an ArrayKind
+    size_t length;
+    size_t capacity;
+    ArrayElement *buffer;  // NULL while the elements fit inline
+    size_t dirty_from;     // lowest index stored since it was remembered
+    ArrayElement inline_elements[ARRAY_INLINE_CAPACITY];
+} ArrayObject;
+
+static inline int value_is_array(Value value) {
+    return value_is_object_type(value, OBJ_ARRAY);
+}
+
+static inline ArrayObject* value_as_array(Value value) {
+    return (ArrayObject*)value_as_pointer(value);
+}
+
+// the elements wherever they are - recomputed after anything that can
+// move the array or grow it
+static inline ArrayElement* array_elements(ArrayObject *array) {
+    return array->buffer ? array->buffer : array->inline_elements;
+}
+
+// element index as a value. index must be below the length.
+static inline Value array_get(Value value, size_t index) {
+    ArrayObject *array = value_as_array(value);
+    ArrayElement *element = &array_elements(array)[index];
+    return array->kind == ARRAY_NUMBERS ? value_from_number(element->number) : element->value;
+}
+
+// the write barrier for arrays also tracks the lowest index written, so
+// a big old array that is only appended to isn't rescanned from 0 by
+// every nursery collection
+static inline void array_write_barrier(ArrayObject *array, size_t index, Value value) {
+    if (!heap_is_old_to_young(&array->header, value)) {
+        return;
+    }
+    if (!(object_flags(&array->header) & OBJECT_REMEMBERED)) {
+        array->dirty_from = index;
+        heap_remember(&array->header);
+    } else if (index < array->dirty_from) {
+        array->dirty_from = index;
+    }
+}
+
+// constructors return VALUE_NULL and append returns 0 when out of memory
+Value array_create(size_t capacity);
+int array_append(Value array, Value item);
+// store item at an index below the length, with the barriers
+void array_set(Value array, size_t index, Value item);
+// take the last element off into item - 0 when the array is empty
+int array_pop(Value array, Value *item);
+// move the elements of an array of numbers out, leaving it empty: its
+// buffer, or a copy of the inline elements, with room for capacity and
+// NULL when there are none. 0 when out of memory.
+int array_take_numbers(Value array, ArrayElement **buffer, size_t *length, size_t *capacity);
+// an array of numbers around a buffer from array_take_numbers, which it
+// takes over - VALUE_NULL when out of memory, with the buffer still the
+// caller's
+Value array_adopt_numbers(ArrayElement *buffer, size_t length, size_t capacity);
+void array_release(ArrayObject *array);
+
+// objects, written {x: 1} in scripts. the values are kept in numbered
+// slots and the shape says which property name is in which slot. shapes
+// form a tree from the empty shape, one transition per added name, so
+// objects given the same names in the same order share a shape and an
+// access site can remember the slot it found for a shape.
+typedef struct Shape {
+    struct Shape *parent;
+    StringObject *name;            // the property this shape added, NULL at the root
+    uint32_t count;                // properties, this one included
+    uint32_t transition_count;
+    uint32_t transition_capacity;
+    struct Shape **transitions;    // shapes with one more property
+    struct Shape *next_shape;      // every shape, for freeing them
+} Shape;
+
+// the first slots are in the object, the rest in a separate buffer
+#define RECORD_INLINE_SLOTS 4
+
+typedef struct {
+    Object header;
+    Shape *shape;
+    Value *overflow;               // slots from RECORD_INLINE_SLOTS on
+    size_t overflow_capacity;
+    Value slots[RECORD_INLINE_SLOTS];
+} RecordObject;
+
+static inline int value_is_record(Value value) {
+    return value_is_object_type(value, OBJ_RECORD);
+}
+
+static inline RecordObject* value_as_record(Value value) {
+    return (RecordObject*)value_as_pointer(value);
+}
+
+static inline Value* record_slot(RecordObject *record, uint32_t slot) {
+    return slot < RECORD_INLINE_SLOTS ? &record->slots[slot] : &record->overflow[slot - RECORD_INLINE_SLOTS];
+}
+
+// overwrite a slot the record's shape already has
+static inline void record_store(RecordObject *record, uint32_t slot, Value value) {
+    Value *target = record_slot(record, slot);
+    heap_overwrite_barrier(&record->header, *target);
+    heap_lock_object(&record->header);
+    *target = value;
+    heap_unlock_object(&record->header);
+    heap_write_barrier(&record->header, value);
+}
+
+// shapes live until heap_destroy. names must be interned strings, which
+// are compared by address. these return NULL when out of memory.
+Shape* shape_empty(void);
+Shape* shape_transition(Shape *shape, StringObject *name);
+// the slot name is in, or -1
+int shape_lookup(const Shape *shape, const StringObject *name);
+void shape_table_destroy(void);
+
+// a record with room for every slot of shape, all of them 0 - VALUE_NULL
+// when out of memory
+Value record_create(Shape *shape);
+// the value of a property, null when the record doesn't have it
+Value record_get(Value record, const StringObject *name);
+// move a record to next, which adds one property to its shape, storing
+// value in the new slot - 0 when out of memory
+int record_add(Value record, Shape *next, Value value);
+// set a property, adding it if it is new - 0 when out of memory
+int record_put(Value record, StringObject *name, Value value);
+void record_release(RecordObject *record);
+
+// maps from numbers and strings to any value, as a swiss table. every
+// slot has a control byte holding 7 bits of its key's hash, or marking
+// it empty or deleted, and a probe checks a whole group of 16 control
+// bytes with one vector compare before it looks at any key. slots hold
+// indexes into the entries, which are kept in insertion order for
+// iteration; a deleted entry stays behind as a hole until the next
+// rehash packs them.
+#define MAP_GROUP_WIDTH 16
+
+typedef struct {
+    Value key;             // VALUE_NULL once deleted
+    Value value;
+    uint64_t hash;
+} MapEntry;
+
+typedef struct {
+    Object header;
+    size_t count;          // live entries
+    size_t capacity;       // slots - a power of two, at least one group, or 0
+    size_t growth_left;    // empty slots that may still be filled before a rehash
+    uint8_t *control;      // capacity control bytes, then a uint32_t entry index per slot
+    MapEntry *entries;
+    size_t entry_count;    // holes included
+    size_t entry_capacity;
+    size_t dirty_from;     // lowest entry stored since it was remembered
+} MapObject;
+
+static inline int value_is_map(Value value) {
+    return value_is_object_type(value, OBJ_MAP);
+}
+
+static inline MapObject* value_as_map(Value value) {
+    return (MapObject*)value_as_pointer(value);
+}
+
+// like arrays, maps remember the lowest entry written, since new keys
+// go on the end
+static inline void map_write_barrier(MapObject *map, size_t index, Value value) {
+    if (!heap_is_old_to_young(&map->header, value)) {
+        return;
+    }
+    if (!(object_flags(&map->header) & OBJECT_REMEMBERED)) {
+        map->dirty_from = index;
+        heap_remember(&map->header);
+    } else if (index < map->dirty_from) {
+        map->dirty_from = index;
+    }
+}
+
+static inline int map_key_valid(Value key) {
+    return value_is_number(key) || value_is_string(key);
+}
+
+// keys must pass map_key_valid. numbers are equal when their values are
+// (1 and 1.0, 0 and -0, and NaN with itself), strings by content. none
+// of these allocate on the heap; the ones that change the map return 0
+// when out of memory.
+Value map_create(void);
+// 1 with the value stored under key, or 0 if there is none
+int map_get(Value map, Value key, Value *value);
+int map_set(Value map, Value key, Value value);
+// 1 if key was there
+int map_delete(Value map, Value key);
+// add amount to the number under key, starting from 0 if it is absent,
+// in a single probe. -1 if the value there is not a number.
+int map_add(Value map, Value key, double amount, Value *total);
+void map_release(MapObject *map);
+
+// streaming accumulators - Stats, Quantiles, Distinct and Histogram in
+// scripts. they hold no values, only counts kept outside the heap, so the
+// collector never looks inside one.
+typedef enum {
+    SKETCH_STATS,          // count, mean, variance, min and max
+    SKETCH_QUANTILES,      // a ddsketch
+    SKETCH_DISTINCT,       // a hyperloglog
+    SKETCH_HISTOGRAM       // an hdr histogram
+} SketchKind;
+
+typedef struct {
+    Object header;
+    uint8_t kind;          // a SketchKind
+    union {
+        StatsMoments moments;
+        StatsQuantiles *quantiles;
+        StatsDistinct *distinct;
+        StatsHistogram *histogram;
+    } as;
+} SketchObject;
+
+static inline int value_is_sketch(Value value) {
+    return value_is_object_type(value, OBJ_SKETCH);
+}
+
+static inline SketchObject* value_as_sketch(Value value) {
+    return (SketchObject*)value_as_pointer(value);
+}
+
+static inline int value_is_sketch_kind(Value value, SketchKind kind) {
+    return value_is_sketch(value) && value_as_sketch(value)->kind == kind;
+}
+
+// the setting is the accuracy of a Quantiles, the precision of a
+// Distinct or the highest value of a Histogram, and is ignored for
+// Stats. VALUE_NULL when out of memory or the setting is out of range.
+Value sketch_create(SketchKind kind, double setting);
+// a Histogram around one already made, which it takes over - freed
+// here when the object cannot be allocated
+Value sketch_from_histogram(StatsHistogram *histogram);
+const char* sketch_kind_name(SketchKind kind);
+void sketch_release(SketchObject *sketch);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * pool.h - the runtime's thread pool for shardjs
+ *
+ * a task is cut into chunks numbered from 0. each thread starts on its
+ * own run of them and, once through, steals the back half of what
+ * another has left, so uneven chunks still keep every thread busy. the
+ * threads are started on first use and wait for the next task between
+ * runs. chunks are sized from the length of the work alone and partial
+ * results combined in chunk order, so what a reduction gives does not
+ * depend on the number of threads or on who stole what.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_MAX_THREADS 8
+// work on fewer numbers than this stays on the calling thread
+#define POOL_PARALLEL_MIN (1u << 18)
+// chunks hold at least this many numbers, and there are no more than
+// POOL_MAX_CHUNKS of them
+#define POOL_CHUNK_MIN 16384
+#define POOL_MAX_CHUNKS 256
+
+typedef enum {
+    POOL_SUM,
+    POOL_PRODUCT,
+    POOL_MIN,
+    POOL_MAX
+} PoolReduction;
+
+// a task's work on one chunk. it runs on any of the pool's threads and
+// must not touch the heap or the interpreter.
+typedef void (*PoolTask)(void *context, size_t chunk);
+
+// runs task on every chunk below chunks and returns once all are done.
+// threads of 0 means one per cpu; the calling thread is one of them. a
+// task that runs another goes through it on its own thread. returns
+// the number of threads that took part.
+size_t pool_run(PoolTask task, void *context, size_t chunks, size_t threads);
+
+// how many numbers go in each chunk of an array of n
+size_t pool_chunk_size(size_t n);
+
+// the sum, product, min or max of x, each chunk reduced with the
+// kernels and the partial results in chunk order. empty arrays give 0,
+// 1, Infinity and -Infinity. threads of 0 picks a count from n.
+double pool_reduce(PoolReduction op, const double *x, size_t n, size_t threads);
+
+// out[i] = fn applied to lo + i, fn taking whole arrays like the vecmath
+// functions. returns the number of threads used.
+size_t pool_tabulate(void (*fn)(const double *x, double *out, size_t n), double lo, double *out, size_t n,
+                     size_t threads);
+
+// chunks taken from another thread since the program started
+size_t pool_steals(void);
+
+// stops and joins the threads; the next task starts them again
+void pool_shutdown(void);
+
+#endif
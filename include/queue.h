@@ -0,0 +1,69 @@
+/*
+ * queue.h - message queues between interpreters for shardjs
+ *
+ * each interpreter takes messages from one queue that any number of
+ * threads post to. the queue is a fixed ring of slots, each carrying a
+ * sequence number that says whether it is free for the producer holding
+ * a given ticket or full for the consumer (vyukov's bounded queue).
+ * producers claim tickets with a compare-and-swap and the one consumer
+ * just loads and stores, so nobody ever takes a lock. a message owns
+ * what it points at; posting hands that over and taking hands it on.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+typedef enum {
+    MESSAGE_NULL,
+    MESSAGE_BOOL,          // number is 0 or 1
+    MESSAGE_NUMBER,
+    MESSAGE_STRING,        // length chars, malloc'd
+    MESSAGE_FLOAT64_ARRAY, // length doubles, a Float64Array's buffer or file mapping
+    MESSAGE_NUMBERS,       // an array of numbers' buffer, with room for capacity
+    MESSAGE_SHARED,        // a reference to a SharedBuffer
+    MESSAGE_ERROR          // length chars saying why a worker's script stopped
+} MessageKind;
+
+typedef struct {
+    MessageKind kind;
+    int mapped;            // data is a read-only file mapping
+    double number;
+    void *data;            // NULL when there is nothing to point at
+    size_t length;
+    size_t capacity;
+} Message;
+
+// give back whatever a message points at
+void message_free(Message *message);
+
+typedef struct MessageQueue MessageQueue;
+
+// room for capacity messages, rounded up to a power of two. the queue
+// starts with one reference and no senders - NULL when out of memory.
+MessageQueue* queue_create(size_t capacity);
+void queue_retain(MessageQueue *queue);
+// the last release frees the queue and any messages still in it
+void queue_release(MessageQueue *queue);
+
+// senders are the threads that may still post. a consumer waiting on an
+// empty queue gives up once there are none.
+void queue_add_sender(MessageQueue *queue);
+void queue_remove_sender(MessageQueue *queue);
+
+// the consumer has stopped taking messages, so posts fail from now on
+void queue_close(MessageQueue *queue);
+
+// post without waiting - 0 when the queue is full or closed, in which
+// case the message still belongs to the caller
+int queue_try_post(MessageQueue *queue, const Message *message);
+// post, waiting for room while the queue is full - 0 when it is closed
+int queue_post(MessageQueue *queue, const Message *message);
+
+// only the consumer takes. these return 0 when the queue is empty, the
+// waiting one only once no sender is left to fill it.
+int queue_try_take(MessageQueue *queue, Message *message);
+int queue_take(MessageQueue *queue, Message *message);
+
+#endif
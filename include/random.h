@@ -0,0 +1,45 @@
+/*
+ * random.h - seeded random numbers for shardjs
+ *
+ * xoshiro256** seeded through splitmix64. jumping a state moves it 2^128
+ * numbers on, which splits one seed into streams that never overlap.
+ * bulk fills draw from streams laid out by position in the array rather
+ * than by thread, so a seed gives the same numbers on any thread count
+ * and any instruction set.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// each run of this many elements in a fill comes from its own streams.
+// setting up its four streams costs about as much as 5000 elements.
+#define RANDOM_CHUNK (1u << 18)
+// fills of fewer elements than this run on the calling thread
+#define RANDOM_PARALLEL_MIN (1u << 20)
+#define RANDOM_MAX_THREADS 8
+
+typedef struct {
+    uint64_t s[4];
+} RandomState;
+
+void random_seed(RandomState *state, uint64_t seed);
+uint64_t random_next(RandomState *state);
+
+// uniform in [0, 1), from the top 53 bits of the next number
+double random_double(RandomState *state);
+
+// 2^128 numbers on, and 2^192 for the long jump
+void random_jump(RandomState *state);
+void random_long_jump(RandomState *state);
+
+// fills out with numbers as random_double gives them and leaves state
+// one long jump further on. chunk c of the array takes its elements in
+// turn from four streams, the starting state jumped 4c + 1 to 4c + 4
+// times. threads of 0 picks a count from the size and the cpu count.
+// returns the number of threads used.
+size_t random_fill(RandomState *state, double *out, size_t n, size_t threads);
+
+#endif
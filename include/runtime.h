@@ -2,13 +2,16 @@
  * runtime.h - main header for shardjs interpreter
  * 
  * defines ast nodes, opaque types, and function interfaces
- * for lexer, parser, ast, environment, and interpreter.
+ * for lexer, parser, ast, environment, interpreter, and optimizer.
  */
 
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "token.h"
+#include "value.h"
 
 // ast node types
 typedef enum {
@@ -18,25 +21,128 @@ typedef enum {
     AST_LET_DECL,
     AST_PRINT_CALL,
     AST_PROGRAM,
-    AST_IF_STMT
+    AST_IF_STMT,
+    AST_STRING,
+    AST_CALL,
+    AST_INDEX,
+    AST_INDEX_ASSIGN,
+    AST_ARRAY,
+    AST_OBJECT,
+    AST_PROPERTY,
+    AST_PROPERTY_ASSIGN,
+    AST_INTRINSIC
 } ASTNodeType;
 
+struct ASTNode;
+struct Shape;
+
+// a function scripts can call by name. arguments arrive evaluated and
+// rooted, so their slots stay current across allocations; errors are
+// reported through interpreter_set_error.
+typedef Value (*BuiltinFunction)(Value *args, int count);
+
+typedef struct {
+    const char *name;
+    int min_args;
+    int max_args;
+    BuiltinFunction function;
+} Builtin;
+
+#define CALL_MAX_ARGS 8
+
+// math functions the parser recognizes by name and compiles to their
+// own node rather than a call. numbers go straight to the hardware or
+// libm, arrays to the vector versions in vecmath.c.
+typedef enum {
+    INTRINSIC_SQRT,
+    INTRINSIC_EXP,
+    INTRINSIC_LOG,
+    INTRINSIC_SIN,
+    INTRINSIC_COS,
+    INTRINSIC_POW
+} IntrinsicKind;
+
+typedef struct {
+    const char *name;
+    IntrinsicKind kind;
+    int args;
+} Intrinsic;
+
+#define INTRINSIC_MAX_ARGS 2
+
+// specialized implementation of a binary operation, installed into the
+// node the first time it runs (quickening)
+typedef Value (*BinaryHandler)(struct ASTNode *node, Value left, Value right);
+
+// inline cache of a property access - the shapes it has seen and the
+// slot the property was in for each (-1 when it was missing). a store
+// that added the property also keeps the shape it moved the object to.
+#define PROPERTY_CACHE_ENTRIES 4
+
+typedef struct {
+    struct Shape *shapes[PROPERTY_CACHE_ENTRIES];
+    struct Shape *targets[PROPERTY_CACHE_ENTRIES];
+    int32_t slots[PROPERTY_CACHE_ENTRIES];
+    int count;
+    int megamorphic;   // saw too many shapes, always looks the name up
+} PropertyCache;
+
 // ast node structure
 typedef struct ASTNode {
     ASTNodeType type;
+    int refcount;  // expression nodes may be shared by several parents
     union {
         double number;
         char *identifier;
+        struct {
+            char *chars;
+            Value interned;  // VALUE_NULL until first executed
+        } string;
         struct {
             struct ASTNode *left;
             struct ASTNode *right;
             char operator;
+            BinaryHandler quick;  // NULL until first executed
         } binary;
         struct {
             char *name;
             struct ASTNode *value;
         } let_decl;
         struct ASTNode *print_arg;
+        struct {
+            char *name;
+            struct ASTNode **args;
+            int count;
+            const Builtin *builtin;  // NULL until first executed
+        } call;
+        struct {
+            const Intrinsic *intrinsic;
+            struct ASTNode *args[INTRINSIC_MAX_ARGS];
+            int count;
+        } intrinsic;
+        struct {
+            struct ASTNode *object;
+            struct ASTNode *index;
+            struct ASTNode *value;   // only for AST_INDEX_ASSIGN
+        } index;
+        struct {
+            struct ASTNode **elements;
+            int count;
+        } array;
+        struct {
+            char **keys;
+            struct ASTNode **values;
+            int count;
+            struct Shape *shape;     // NULL until first executed
+            uint32_t *slots;         // the slot each value goes in
+        } object;
+        struct {
+            struct ASTNode *object;
+            char *name;
+            Value key;               // interned name, VALUE_NULL until first executed
+            struct ASTNode *value;   // only for AST_PROPERTY_ASSIGN
+            PropertyCache *cache;
+        } property;
         struct {
             struct ASTNode **statements;
             int count;
@@ -50,7 +156,32 @@ typedef struct ASTNode {
     } data;
 } ASTNode;
 
+// hash-consing counters - how many expression nodes were asked for
+// versus how many distinct nodes had to be allocated, and how many
+// occupied slots the lookups stepped past on the way
+typedef struct {
+    size_t requested;
+    size_t unique;
+    size_t probes;
+} ASTConsStats;
+
+// quickening counters - binary nodes specialized on first execution and
+// specializations abandoned because their guard failed
+typedef struct {
+    size_t specialized;
+    size_t deopts;
+} QuickenStats;
+
+// inline cache counters - property accesses answered from a cache,
+// accesses that had to look the name up, and sites that gave up caching
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t megamorphic;
+} PropertyCacheStats;
+
 // opaque types
+typedef struct ASTConsTable ASTConsTable;
 typedef struct Lexer Lexer;
 typedef struct Parser Parser;
 typedef struct Environment Environment;
@@ -66,28 +197,75 @@ void parser_destroy(Parser *parser);
 ASTNode* parser_parse(Parser *parser);
 int parser_has_error(Parser *parser);
 const char* parser_get_error(Parser *parser);
+ASTConsStats parser_get_cons_stats(Parser *parser);
 
 // ast interface
 ASTNode* ast_create_number(double value);
 ASTNode* ast_create_identifier(const char *name);
+ASTNode* ast_create_string(const char *chars);
 ASTNode* ast_create_binary_op(ASTNode *left, char operator, ASTNode *right);
 ASTNode* ast_create_let_decl(const char *name, ASTNode *value);
 ASTNode* ast_create_print_call(ASTNode *arg);
 ASTNode* ast_create_program(void);
 ASTNode* ast_create_if_stmt(ASTNode *condition, ASTNode *if_branch, ASTNode *else_branch);
+ASTNode* ast_create_call(const char *name, ASTNode **args, int count);
+ASTNode* ast_create_intrinsic(const Intrinsic *intrinsic, ASTNode **args, int count);
+ASTNode* ast_create_index(ASTNode *object, ASTNode *index);
+ASTNode* ast_create_index_assign(ASTNode *object, ASTNode *index, ASTNode *value);
+ASTNode* ast_create_array(ASTNode **elements, int count);
+ASTNode* ast_create_object(char **keys, ASTNode **values, int count);
+ASTNode* ast_create_property(ASTNode *object, const char *name);
+ASTNode* ast_create_property_assign(ASTNode *object, const char *name, ASTNode *value);
 int ast_program_add_statement(ASTNode *program, ASTNode *statement);
+ASTNode* ast_retain(ASTNode *node);
 void ast_destroy(ASTNode *node);
 
+// hash-consed construction of pure expression nodes
+ASTConsTable* ast_cons_table_create(void);
+void ast_cons_table_destroy(ASTConsTable *table);
+ASTNode* ast_cons_number(ASTConsTable *table, double value);
+ASTNode* ast_cons_identifier(ASTConsTable *table, const char *name);
+ASTNode* ast_cons_string(ASTConsTable *table, const char *chars);
+ASTNode* ast_cons_binary_op(ASTConsTable *table, ASTNode *left, char operator, ASTNode *right);
+ASTNode* ast_cons_property(ASTConsTable *table, ASTNode *object, const char *name);
+ASTConsStats ast_cons_table_stats(ASTConsTable *table);
+
 // environment interface
 Environment* env_create(void);
 void env_destroy(Environment *env);
+int env_set_value(Environment *env, const char *name, Value value);
+int env_get_value(Environment *env, const char *name, Value *value);
 int env_set(Environment *env, const char *name, double value);
 int env_get(Environment *env, const char *name, double *value);
 
 // interpreter interface
+Value interpret_value(ASTNode *node, Environment *env);
 double interpret(ASTNode *node, Environment *env);
 int interpreter_has_error(void);
 const char* interpreter_get_error(void);
 void interpreter_clear_error(void);
+void interpreter_set_error(const char *message);
+QuickenStats interpreter_get_quicken_stats(void);
+PropertyCacheStats interpreter_get_property_cache_stats(void);
+
+// builtin function table
+const Builtin* builtin_lookup(const char *name);
+
+// math intrinsics - the one named, or NULL, and its value for number
+// arguments or, with arrays among them, a new Float64Array
+const Intrinsic* intrinsic_lookup(const char *name);
+double intrinsic_number(IntrinsicKind kind, double x, double y);
+Value intrinsic_apply(const Intrinsic *intrinsic, Value *args);
+
+// peephole counters for one optimizer rule
+typedef struct {
+    const char *name;
+    size_t hits;
+    size_t nodes_removed;
+} PeepholeStats;
+
+// optimizer interface
+int optimizer_run(ASTNode *program);
+int optimizer_get_peephole_stats(PeepholeStats *stats, int max);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+ * shared.h - memory shared between interpreters for shardjs
+ *
+ * a shared buffer is a fixed run of 64-bit elements, doubles or signed
+ * integers, that lives outside every heap. each interpreter holding it
+ * has its own object pointing there (see SharedArrayObject in object.h),
+ * and the buffer goes when the last reference to it is released. every
+ * element access is atomic and sequentially consistent, so workers can
+ * count and aggregate into one buffer without locks.
+ */
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SHARED_FLOAT64,
+    SHARED_INT64
+} SharedKind;
+
+typedef struct {
+    size_t references;
+    size_t length;
+    SharedKind kind;
+    int64_t elements[];    // an int64 each, or a double's bits
+} SharedBuffer;
+
+// a zero-filled buffer holding one reference - NULL when out of memory
+SharedBuffer* shared_buffer_create(SharedKind kind, size_t length);
+void shared_buffer_retain(SharedBuffer *buffer);
+void shared_buffer_release(SharedBuffer *buffer);
+
+// int64 elements go to and from doubles, so integers past 2^53 read
+// back rounded. the value stored into one must be a whole number that
+// fits (see shared_fits).
+int shared_fits(const SharedBuffer *buffer, double value);
+double shared_load(SharedBuffer *buffer, size_t index);
+void shared_store(SharedBuffer *buffer, size_t index, double value);
+// add value to the element, giving back what it held before
+double shared_add(SharedBuffer *buffer, size_t index, double value);
+// store replacement if the element holds expected, giving back what it
+// held either way. doubles compare by their bits, so NaN matches itself
+// and 0 doesn't match -0.
+double shared_compare_exchange(SharedBuffer *buffer, size_t index, double expected, double replacement);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * sort.h - sorting for shardjs
+ *
+ * numbers are sorted as 64-bit keys made from their bits, which order
+ * the same way the numbers do, with NaN after everything and -0 before
+ * 0. large arrays of keys are radix sorted, smaller ones go through a
+ * pattern-defeating quicksort, and very large ones are split across
+ * threads and merged. anything that isn't a plain number is sorted as
+ * records that carry a key, text and their original position.
+ */
+
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// arrays shorter than this are sorted by comparisons, not radix passes
+#define SORT_RADIX_MIN 1024
+// arrays shorter than this are sorted on the calling thread
+#define SORT_PARALLEL_MIN (1u << 20)
+#define SORT_MAX_THREADS 8
+
+// the key of a number: flip every bit of a negative one and just the
+// sign of a positive one, so unsigned order is numeric order. every NaN
+// gets the one key above +Infinity.
+static inline uint64_t sort_key(double number) {
+    uint64_t bits;
+    if (number != number) {
+        return 0xfff8000000000000ULL;
+    }
+    memcpy(&bits, &number, sizeof(bits));
+    return bits >> 63 ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+static inline double sort_number(uint64_t key) {
+    uint64_t bits = key >> 63 ? key & ~0x8000000000000000ULL : ~key;
+    double number;
+    memcpy(&number, &bits, sizeof(number));
+    return number;
+}
+
+// what a record is sorted by - numbers before text, then its position,
+// so records that compare equal keep their order
+typedef struct {
+    int is_text;
+    uint64_t key;          // sort_key of a number
+    const char *chars;     // text, not necessarily nul-terminated
+    size_t length;
+    size_t index;          // position before sorting
+} SortRecord;
+
+// sort in place, NaN last either way. threads of 0 picks a count from
+// the length and the cpu count; the result is the same whatever it is.
+// returns the number of threads used, or 0 when out of memory.
+size_t sort_doubles(double *data, size_t n, int descending, size_t threads);
+void sort_records(SortRecord *records, size_t n, int descending);
+
+#endif
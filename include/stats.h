@@ -0,0 +1,158 @@
+/*
+ * stats.h - streaming accumulators for shardjs
+ *
+ * summaries of a stream that never grow with it: the moments (count,
+ * mean, variance, min and max), a quantile sketch with a guaranteed
+ * relative error, a hyperloglog counting distinct values and an hdr
+ * histogram of whole numbers. each takes values one at a time or a
+ * whole array at once, and the array form gives the same answers, up
+ * to rounding. two of the same kind merge.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// count, mean and variance by welford's update. a batch is summarised
+// on its own with the vector kernels, then folded in with chan's
+// formula for combining two sets of moments.
+typedef struct {
+    uint64_t count;
+    double mean;
+    double m2;             // sum of squared differences from the mean
+    double min;
+    double max;
+} StatsMoments;
+
+void stats_moments_init(StatsMoments *moments);
+void stats_moments_add(StatsMoments *moments, double x);
+void stats_moments_add_batch(StatsMoments *moments, const double *x, size_t n);
+// fold other into moments
+void stats_moments_merge(StatsMoments *moments, const StatsMoments *other);
+// the sample variance, dividing by count - 1
+double stats_moments_variance(const StatsMoments *moments);
+
+// a ddsketch. positive values are bucketed by their exponent and the
+// top mantissa bits, so each bucket spans at most 1/2^bits of its lower
+// bound and its middle is within 1/(2^(bits+1) + 1) of anything in it.
+// values too small for a normal double count as zero. each sign has a
+// fixed window of buckets covering STATS_SKETCH_OCTAVES powers of two;
+// when the values span more, the lowest buckets are merged, which only
+// costs accuracy at the small end.
+#define STATS_SKETCH_OCTAVES 32
+#define STATS_SKETCH_MIN_ACCURACY 0.0005   // the finest relative error
+#define STATS_SKETCH_MAX_ACCURACY 0.25     // and the coarsest
+#define STATS_SKETCH_DEFAULT_ACCURACY 0.01
+
+typedef struct {
+    int64_t low;           // bucket index held in counts[0]
+    int64_t min_index;     // the non-empty range, min > max when empty
+    int64_t max_index;
+    size_t bins;
+    uint64_t *counts;
+} StatsStore;
+
+typedef struct {
+    int bits;              // mantissa bits in a bucket index
+    double accuracy;       // the relative error actually guaranteed
+    uint64_t count;
+    uint64_t zero_count;
+    double min;
+    double max;
+    StatsStore positive;
+    StatsStore negative;   // keyed by magnitude
+} StatsQuantiles;
+
+// NULL when out of memory. accuracy must lie between the limits above.
+StatsQuantiles* stats_quantiles_create(double accuracy);
+void stats_quantiles_free(StatsQuantiles *sketch);
+// values must be finite - 0 and nothing added otherwise
+int stats_quantiles_add(StatsQuantiles *sketch, double x);
+// n once every value has been added, or, adding none of them, the
+// index of the first that is not finite
+size_t stats_quantiles_add_batch(StatsQuantiles *sketch, const double *x, size_t n);
+// q from 0 to 1 - 0 is the minimum and 1 the maximum, exactly. the
+// sketch must not be empty.
+double stats_quantiles_quantile(const StatsQuantiles *sketch, double q);
+// add other's counts to sketch - 0 and nothing changed unless both
+// have the same accuracy
+int stats_quantiles_merge(StatsQuantiles *sketch, const StatsQuantiles *other);
+
+// a hyperloglog over 64-bit hashes with 2^precision one-byte registers.
+// the standard error is about 1.04 / sqrt(2^precision).
+#define STATS_DISTINCT_MIN_PRECISION 4
+#define STATS_DISTINCT_MAX_PRECISION 18
+#define STATS_DISTINCT_DEFAULT_PRECISION 14
+
+typedef struct {
+    int precision;
+    uint8_t registers[];
+} StatsDistinct;
+
+StatsDistinct* stats_distinct_create(int precision);
+void stats_distinct_free(StatsDistinct *distinct);
+void stats_distinct_add_hash(StatsDistinct *distinct, uint64_t hash);
+void stats_distinct_add_numbers(StatsDistinct *distinct, const double *x, size_t n);
+double stats_distinct_estimate(const StatsDistinct *distinct);
+// 0 and nothing changed unless both have the same precision
+int stats_distinct_merge(StatsDistinct *distinct, const StatsDistinct *other);
+
+// an hdr histogram of whole numbers from 0 to highest. each power of two
+// is split into enough equal sub-buckets that any value is told apart
+// from others differing in the given number of significant decimal
+// digits; recording a value is a shift, a count of leading zeros and an
+// increment.
+#define STATS_HISTOGRAM_MIN_DIGITS 1
+#define STATS_HISTOGRAM_MAX_DIGITS 5
+#define STATS_HISTOGRAM_DEFAULT_DIGITS 3
+#define STATS_HISTOGRAM_MAX_HIGHEST 9007199254740992.0   // 2^53
+#define STATS_HISTOGRAM_DEFAULT_HIGHEST 3600000000.0     // an hour in microseconds
+
+typedef struct {
+    int64_t highest;       // the highest value that can be recorded
+    int digits;
+    int half_magnitude;    // log2 of half the sub-buckets in a power of two
+    int64_t sub_buckets;
+    int64_t sub_bucket_mask;
+    size_t length;         // counts
+    uint64_t count;
+    double sum;
+    int64_t min;           // min > max when empty
+    int64_t max;
+    uint64_t counts[];
+} StatsHistogram;
+
+// NULL when out of memory or the settings are outside the limits above
+StatsHistogram* stats_histogram_create(double highest, int digits);
+void stats_histogram_free(StatsHistogram *histogram);
+// values must lie between 0 and highest, and are rounded down to whole
+// numbers - 0 and nothing recorded otherwise
+int stats_histogram_add(StatsHistogram *histogram, double x);
+// like stats_quantiles_add_batch, the index of the first value out of
+// range and nothing recorded, or n
+size_t stats_histogram_add_batch(StatsHistogram *histogram, const double *x, size_t n);
+// the value at or below which a fraction q of the recorded values lie,
+// as the highest value its bucket shares. 0 and 1 give the exact
+// minimum and maximum. the histogram must not be empty.
+double stats_histogram_quantile(const StatsHistogram *histogram, double q);
+// counts are added directly between histograms with the same settings,
+// and otherwise recorded again bucket by bucket. 0 and nothing changed
+// when other holds values above histogram's highest.
+int stats_histogram_merge(StatsHistogram *histogram, const StatsHistogram *other);
+// a compact printable form - the settings, extremes and sum, then the
+// counts as zigzag varints with runs of empty buckets shortened to one
+// negative number, all in base64. malloc'd and nul-terminated, or NULL
+// when out of memory.
+char* stats_histogram_encode(const StatsHistogram *histogram, size_t *length);
+// NULL when the text is not an encoded histogram or out of memory
+StatsHistogram* stats_histogram_decode(const char *text, size_t length);
+
+// hashes of the values the counter sees. numbers that compare equal
+// hash alike (0 and -0, every NaN), and a string never hashes like the
+// number it spells.
+uint64_t stats_hash_number(double x);
+uint64_t stats_hash_bytes(const char *chars, size_t length);
+
+#endif
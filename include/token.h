@@ -11,6 +11,7 @@
 typedef enum {
     TOKEN_NUMBER,
     TOKEN_IDENTIFIER,
+    TOKEN_STRING,
     TOKEN_LET,
     TOKEN_IF,
     TOKEN_ELSE,
@@ -21,6 +22,13 @@ typedef enum {
     TOKEN_DIVIDE,
     TOKEN_LPAREN,
     TOKEN_RPAREN,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
+    TOKEN_LBRACE,
+    TOKEN_RBRACE,
+    TOKEN_COLON,
+    TOKEN_DOT,
+    TOKEN_COMMA,
     TOKEN_SEMICOLON,
     TOKEN_GREATER,
     TOKEN_LESS,
@@ -0,0 +1,123 @@
+/*
+ * value.h - nan-boxed runtime values for shardjs
+ *
+ * every runtime value fits in 64 bits. doubles are stored as-is, and
+ * everything else lives in the payload of a negative quiet nan that
+ * real arithmetic never produces. checks and conversions are shifts,
+ * masks and one unsigned compare, so numeric code pays nothing extra.
+ */
+
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef uint64_t Value;
+
+// layout of the top 16 bits:
+//   below 0xfff9  a double (including +-inf and the canonical nans)
+//   0xfff9        special constants - null, false, true
+//   0xfffa        32-bit signed integer in the low bits
+//   0xfffb        48-bit pointer to a heap object
+#define VALUE_TAG_SHIFT    48
+#define VALUE_PAYLOAD_MASK 0x0000ffffffffffffULL
+#define VALUE_FIRST_TAGGED 0xfff9000000000000ULL
+
+#define VALUE_TAG_SPECIAL  0xfff9ULL
+#define VALUE_TAG_INT      0xfffaULL
+#define VALUE_TAG_POINTER  0xfffbULL
+
+#define VALUE_CANONICAL_NAN 0x7ff8000000000000ULL
+
+#define VALUE_NULL  ((VALUE_TAG_SPECIAL << VALUE_TAG_SHIFT) | 0)
+#define VALUE_FALSE ((VALUE_TAG_SPECIAL << VALUE_TAG_SHIFT) | 1)
+#define VALUE_TRUE  ((VALUE_TAG_SPECIAL << VALUE_TAG_SHIFT) | 2)
+
+static inline int value_is_double(Value value) {
+    return value < VALUE_FIRST_TAGGED;
+}
+
+static inline int value_is_int(Value value) {
+    return (value >> VALUE_TAG_SHIFT) == VALUE_TAG_INT;
+}
+
+static inline int value_is_number(Value value) {
+    return value_is_double(value) || value_is_int(value);
+}
+
+static inline int value_is_pointer(Value value) {
+    return (value >> VALUE_TAG_SHIFT) == VALUE_TAG_POINTER;
+}
+
+static inline int value_is_bool(Value value) {
+    return value == VALUE_TRUE || value == VALUE_FALSE;
+}
+
+static inline int value_is_null(Value value) {
+    return value == VALUE_NULL;
+}
+
+// doubles go in unchanged, except that any nan is made canonical so a
+// stray payload can never be mistaken for a tagged value
+static inline Value value_from_double(double number) {
+    Value value;
+    memcpy(&value, &number, sizeof(value));
+    if (number != number) {
+        value = VALUE_CANONICAL_NAN;
+    }
+    return value;
+}
+
+static inline double value_as_double(Value value) {
+    double number;
+    memcpy(&number, &value, sizeof(number));
+    return number;
+}
+
+static inline Value value_from_int(int32_t number) {
+    return (VALUE_TAG_INT << VALUE_TAG_SHIFT) | (uint32_t)number;
+}
+
+static inline int32_t value_as_int(Value value) {
+    return (int32_t)(uint32_t)value;
+}
+
+static inline Value value_from_bool(int flag) {
+    return flag ? VALUE_TRUE : VALUE_FALSE;
+}
+
+static inline Value value_from_pointer(const void *pointer) {
+    return (VALUE_TAG_POINTER << VALUE_TAG_SHIFT) | ((uint64_t)(uintptr_t)pointer & VALUE_PAYLOAD_MASK);
+}
+
+static inline void* value_as_pointer(Value value) {
+    return (void*)(uintptr_t)(value & VALUE_PAYLOAD_MASK);
+}
+
+// numbers that are exact 32-bit integers use the integer representation.
+// -0 has no integer form and stays a double so it still prints as -0.
+static inline Value value_from_number(double number) {
+    if (number >= -2147483648.0 && number <= 2147483647.0) {
+        int32_t integer = (int32_t)number;
+        if ((double)integer == number && (integer != 0 || value_from_double(number) == 0)) {
+            return value_from_int(integer);
+        }
+    }
+    return value_from_double(number);
+}
+
+// numeric view of any number value
+static inline double value_as_number(Value value) {
+    return value_is_int(value) ? (double)value_as_int(value) : value_as_double(value);
+}
+
+// value interface
+double value_to_number(Value value);
+int value_is_truthy(Value value);
+const char* value_type_name(Value value);
+size_t value_format(Value value, char *buffer, size_t size);
+void value_print(Value value, FILE *out);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * vecmath.h - math functions over whole arrays for shardjs
+ *
+ * sqrt, exp, log, sin, cos and pow of every element of an array, four
+ * at a time. sqrt is the hardware instruction and exact; the others are
+ * polynomial approximations with these bounds, measured against long
+ * double references in test_vecmath.c:
+ *
+ *     exp   under 1 ulp
+ *     log   under 0.52 ulp
+ *     sin   under 1 ulp
+ *     cos   under 1 ulp
+ *     pow   under 1 ulp while the result is a normal number
+ *
+ * results that come out subnormal may be off by one more unit in their
+ * last place. sin and cos of numbers beyond 2^19 * pi / 2 and pow of a
+ * non-positive x or of a non-finite or huge y go to libm a lane at a
+ * time. every instruction set gives the same bits for the same input,
+ * wherever in the array it sits.
+ */
+
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <stddef.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <emmintrin.h>
+#endif
+
+// one square root, as a single sqrtsd on x86. the other functions of a
+// single number are libm's.
+static inline double vecmath_sqrt_scalar(double x) {
+#if defined(__GNUC__) && defined(__SSE2__)
+    __m128d v = _mm_set_sd(x);
+    return _mm_cvtsd_f64(_mm_sqrt_sd(v, v));
+#else
+    return sqrt(x);
+#endif
+}
+
+// out[i] = f(x[i]). out may be x itself.
+void vecmath_sqrt(const double *x, double *out, size_t n);
+void vecmath_exp(const double *x, double *out, size_t n);
+void vecmath_log(const double *x, double *out, size_t n);
+void vecmath_sin(const double *x, double *out, size_t n);
+void vecmath_cos(const double *x, double *out, size_t n);
+
+// out[i] = pow(x[i * x_step], y[i * y_step]), where a step of 0 uses
+// the one number throughout
+void vecmath_pow(const double *x, size_t x_step, const double *y, size_t y_step, double *out, size_t n);
+
+#endif
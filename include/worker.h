@@ -0,0 +1,47 @@
+/*
+ * worker.h - workers for shardjs
+ *
+ * Worker("script.js") runs a script on a thread of its own, with its own
+ * heap, environment and interpreter state. interpreters never touch each
+ * other's objects; they only post messages to each other's inbox (see
+ * queue.h). numbers, strings, booleans and null are copied, while the
+ * elements of a Float64Array or an array of numbers move with the
+ * message and leave the sender holding an empty array. a shared array
+ * is neither: both sides end up holding the same memory (see shared.h).
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stddef.h>
+#include "value.h"
+
+// messages an inbox holds before posting to it waits
+#define WORKER_QUEUE_CAPACITY 1024
+
+// start a worker running the script at path - VALUE_NULL with the
+// reason in error when the script can't be read or the thread started
+Value worker_create(const char *path, char *error, size_t error_size);
+
+// post value to a worker this interpreter started, or from inside a
+// worker to the interpreter that started it. 0 with the reason in error
+// when the value can't be sent. a message for an interpreter that has
+// already finished is dropped.
+int worker_post(Value worker, Value value, char *error, size_t error_size);
+int worker_post_parent(Value value, char *error, size_t error_size);
+
+// whether this thread is running a worker's script
+int worker_is_worker(void);
+
+// wait for the next message to this interpreter. 0 with the reason in
+// error when a worker's script failed, or when nothing is left that
+// could send one.
+int worker_receive(Value *value, char *error, size_t error_size);
+
+// wait for every worker this interpreter started to finish and let go of
+// its inbox - at the end of a program, before heap_destroy. errors from
+// workers that were never received are written to stderr, and the
+// count of them is returned.
+int worker_shutdown(void);
+
+#endif
@@ -8,118 +8,749 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include "include/runtime.h"
+#include "include/object.h"
 
-// simple error tracking
-static int interpreter_error = 0;
-static char interpreter_error_msg[256];
+// what the interpreter keeps between nodes - the error being reported
+// and the counters for --stats. each thread running a program has its
+// own, so a worker's errors never show up in another interpreter.
+typedef struct {
+    int error;
+    char error_msg[256];
+    size_t quicken_specialized;
+    size_t quicken_deopts;
+    size_t property_cache_hits;
+    size_t property_cache_misses;
+    size_t property_cache_megamorphic;
+} InterpreterContext;
+
+static __thread InterpreterContext context;
 
 static void set_interpreter_error(const char *message) {
-    interpreter_error = 1;
-    snprintf(interpreter_error_msg, sizeof(interpreter_error_msg), "%s", message);
+    context.error = 1;
+    snprintf(context.error_msg, sizeof(context.error_msg), "%s", message);
+}
+
+// for builtins, which report errors the same way as the core
+void interpreter_set_error(const char *message) {
+    set_interpreter_error(message);
 }
 
 int interpreter_has_error(void) {
-    return interpreter_error;
+    return context.error;
 }
 
 const char* interpreter_get_error(void) {
-    return interpreter_error_msg;
+    return context.error_msg;
 }
 
 void interpreter_clear_error(void) {
-    interpreter_error = 0;
-    interpreter_error_msg[0] = '\0';
+    context.error = 0;
+    context.error_msg[0] = '\0';
 }
 
-// main eval function - walks ast and executes nodes
+// printable form of the internal operator codes
+static const char* operator_symbol(char operator) {
+    switch (operator) {
+        case 'G': return ">=";
+        case 'L': return "<=";
+        case 'E': return "==";
+        case 'N': return "!=";
+        case '+': return "+";
+        case '-': return "-";
+        case '*': return "*";
+        case '/': return "/";
+        case '>': return ">";
+        case '<': return "<";
+        default: return "?";
+    }
+}
+
+// quickening - a binary node starts out generic. its first execution
+// looks at the operator and operand types, installs a specialized
+// handler in the node, and later executions call that directly. every
+// specialized handler guards its assumptions and falls back to the
+// generic path (which re-specializes) when they stop holding.
+static Value binary_generic(ASTNode *node, Value left, Value right);
+static Value quick_number(ASTNode *node, Value left, Value right);
+
+QuickenStats interpreter_get_quicken_stats(void) {
+    QuickenStats stats;
+    stats.specialized = context.quicken_specialized;
+    stats.deopts = context.quicken_deopts;
+    return stats;
+}
+
+// drop a specialization whose guard failed and start over
+static Value binary_deopt(ASTNode *node, Value left, Value right) {
+    context.quicken_deopts++;
+    node->data.binary.quick = NULL;
+    // a site that has now seen both number forms stays on the mixed
+    // handler rather than flipping between int and double every time
+    if (value_is_number(left) && value_is_number(right)) {
+        node->data.binary.quick = quick_number;
+        context.quicken_specialized++;
+        return quick_number(node, left, right);
+    }
+    return binary_generic(node, left, right);
+}
+
+// double specializations - both operands must be unboxed doubles
+#define DOUBLE_HANDLER(name, expr) \
+    static Value name(ASTNode *node, Value left, Value right) { \
+        if (!value_is_double(left) || !value_is_double(right)) { \
+            return binary_deopt(node, left, right); \
+        } \
+        double left_val = value_as_double(left); \
+        double right_val = value_as_double(right); \
+        return value_from_double(expr); \
+    }
+
+// comparisons answer with the integers 1 and 0 whatever the operands are
+#define DOUBLE_TEST_HANDLER(name, expr) \
+    static Value name(ASTNode *node, Value left, Value right) { \
+        if (!value_is_double(left) || !value_is_double(right)) { \
+            return binary_deopt(node, left, right); \
+        } \
+        double left_val = value_as_double(left); \
+        double right_val = value_as_double(right); \
+        return value_from_int((expr) ? 1 : 0); \
+    }
+
+DOUBLE_HANDLER(quick_add_double, left_val + right_val)
+DOUBLE_HANDLER(quick_sub_double, left_val - right_val)
+DOUBLE_HANDLER(quick_mul_double, left_val * right_val)
+DOUBLE_TEST_HANDLER(quick_gt_double, left_val > right_val)
+DOUBLE_TEST_HANDLER(quick_lt_double, left_val < right_val)
+DOUBLE_TEST_HANDLER(quick_ge_double, left_val >= right_val)
+DOUBLE_TEST_HANDLER(quick_le_double, left_val <= right_val)
+DOUBLE_TEST_HANDLER(quick_eq_double, left_val == right_val)
+DOUBLE_TEST_HANDLER(quick_ne_double, left_val != right_val)
+
+static Value quick_div_double(ASTNode *node, Value left, Value right) {
+    if (!value_is_double(left) || !value_is_double(right)) {
+        return binary_deopt(node, left, right);
+    }
+    double right_val = value_as_double(right);
+    if (right_val == 0.0) {
+        set_interpreter_error("Division by zero");
+        return VALUE_NULL;
+    }
+    return value_from_double(value_as_double(left) / right_val);
+}
+
+static BinaryHandler double_handler(char operator) {
+    switch (operator) {
+        case '+': return quick_add_double;
+        case '-': return quick_sub_double;
+        case '*': return quick_mul_double;
+        case '/': return quick_div_double;
+        case '>': return quick_gt_double;
+        case '<': return quick_lt_double;
+        case 'G': return quick_ge_double;  // >= (Greater-equal)
+        case 'L': return quick_le_double;  // <= (Less-equal)
+        case 'E': return quick_eq_double;  // == (Equal)
+        case 'N': return quick_ne_double;  // != (Not-equal)
+        default: return NULL;
+    }
+}
+
+// int64 results that leave the int32 range become doubles, which are
+// still exact at that size, so the visible result matches double math
+static inline Value int_result(int64_t result) {
+    if (result >= INT32_MIN && result <= INT32_MAX) {
+        return value_from_int((int32_t)result);
+    }
+    return value_from_double((double)result);
+}
+
+// small integer specializations - both operands must be boxed int32s.
+// the arithmetic runs in int64, where two int32s can never overflow.
+#define INT_HANDLER(name, expr) \
+    static Value name(ASTNode *node, Value left, Value right) { \
+        if (!value_is_int(left) || !value_is_int(right)) { \
+            return binary_deopt(node, left, right); \
+        } \
+        int64_t left_val = value_as_int(left); \
+        int64_t right_val = value_as_int(right); \
+        return int_result(expr); \
+    }
+
+INT_HANDLER(quick_add_int, left_val + right_val)
+INT_HANDLER(quick_sub_int, left_val - right_val)
+INT_HANDLER(quick_gt_int, left_val > right_val)
+INT_HANDLER(quick_lt_int, left_val < right_val)
+INT_HANDLER(quick_ge_int, left_val >= right_val)
+INT_HANDLER(quick_le_int, left_val <= right_val)
+INT_HANDLER(quick_eq_int, left_val == right_val)
+INT_HANDLER(quick_ne_int, left_val != right_val)
+
+static Value quick_mul_int(ASTNode *node, Value left, Value right) {
+    if (!value_is_int(left) || !value_is_int(right)) {
+        return binary_deopt(node, left, right);
+    }
+    int64_t left_val = value_as_int(left);
+    int64_t right_val = value_as_int(right);
+    int64_t result = left_val * right_val;
+    // zero times a negative number is -0 in double math
+    if (result == 0 && (left_val < 0 || right_val < 0)) {
+        return value_from_double(-0.0);
+    }
+    return int_result(result);
+}
+
+static Value quick_div_int(ASTNode *node, Value left, Value right) {
+    if (!value_is_int(left) || !value_is_int(right)) {
+        return binary_deopt(node, left, right);
+    }
+    int64_t left_val = value_as_int(left);
+    int64_t right_val = value_as_int(right);
+    if (right_val == 0) {
+        set_interpreter_error("Division by zero");
+        return VALUE_NULL;
+    }
+    // only exact quotients stay integers, and 0 / negative is -0
+    if (left_val % right_val == 0 && (left_val != 0 || right_val > 0)) {
+        return int_result(left_val / right_val);
+    }
+    return value_from_double((double)left_val / (double)right_val);
+}
+
+static BinaryHandler int_handler(char operator) {
+    switch (operator) {
+        case '+': return quick_add_int;
+        case '-': return quick_sub_int;
+        case '*': return quick_mul_int;
+        case '/': return quick_div_int;
+        case '>': return quick_gt_int;
+        case '<': return quick_lt_int;
+        case 'G': return quick_ge_int;
+        case 'L': return quick_le_int;
+        case 'E': return quick_eq_int;
+        case 'N': return quick_ne_int;
+        default: return NULL;
+    }
+}
+
+// unspecialized arithmetic on two numbers of any representation
+static Value number_operation(char operator, double left_val, double right_val) {
+    switch (operator) {
+        case '+': return value_from_double(left_val + right_val);
+        case '-': return value_from_double(left_val - right_val);
+        case '*': return value_from_double(left_val * right_val);
+        case '/':
+            if (right_val == 0.0) {
+                set_interpreter_error("Division by zero");
+                return VALUE_NULL;
+            }
+            return value_from_double(left_val / right_val);
+        case '>': return value_from_int(left_val > right_val);
+        case '<': return value_from_int(left_val < right_val);
+        case 'G': return value_from_int(left_val >= right_val);
+        case 'L': return value_from_int(left_val <= right_val);
+        case 'E': return value_from_int(left_val == right_val);
+        case 'N': return value_from_int(left_val != right_val);
+        default: return VALUE_NULL;
+    }
+}
+
+// polymorphic sites that see ints and doubles mixed settle here
+static Value quick_number(ASTNode *node, Value left, Value right) {
+    if (!value_is_number(left) || !value_is_number(right)) {
+        return binary_deopt(node, left, right);
+    }
+    return number_operation(node->data.binary.operator, value_as_number(left), value_as_number(right));
+}
+
+// string specializations. + concatenates when either side is a string,
+// converting the other side the way print() would show it, and the
+// comparisons order two strings byte by byte.
+static Value quick_concat(ASTNode *node, Value left, Value right) {
+    if (!value_is_string(left) && !value_is_string(right)) {
+        return binary_deopt(node, left, right);
+    }
+    // converting either side can allocate and move the other
+    heap_push_root(&left);
+    heap_push_root(&right);
+    Value left_string = string_from_value(left);
+    heap_push_root(&left_string);
+    Value right_string = value_is_null(left_string) ? VALUE_NULL : string_from_value(right);
+    Value result = value_is_null(right_string) ? VALUE_NULL : string_concat(left_string, right_string);
+    heap_pop_roots(3);
+    if (value_is_null(result)) {
+        set_interpreter_error("Out of memory building string");
+    }
+    return result;
+}
+
+static Value quick_string_test(ASTNode *node, Value left, Value right) {
+    if (!value_is_string(left) || !value_is_string(right)) {
+        return binary_deopt(node, left, right);
+    }
+    switch (node->data.binary.operator) {
+        case 'E': return value_from_int(string_equals(left, right));
+        case 'N': return value_from_int(!string_equals(left, right));
+        case '>': return value_from_int(string_compare(left, right) > 0);
+        case '<': return value_from_int(string_compare(left, right) < 0);
+        case 'G': return value_from_int(string_compare(left, right) >= 0);
+        case 'L': return value_from_int(string_compare(left, right) <= 0);
+        default: return VALUE_NULL;
+    }
+}
+
+static BinaryHandler string_handler(char operator, Value left, Value right) {
+    if (operator == '+') {
+        return value_is_string(left) || value_is_string(right) ? quick_concat : NULL;
+    }
+    if (!value_is_string(left) || !value_is_string(right)) {
+        return NULL;
+    }
+    switch (operator) {
+        case '>': case '<': case 'G': case 'L': case 'E': case 'N':
+            return quick_string_test;
+        default:
+            return NULL;
+    }
+}
+
+// pick the specialization for this operator and these operands,
+// install it in the node and run it
+static Value binary_generic(ASTNode *node, Value left, Value right) {
+    char operator = node->data.binary.operator;
+    BinaryHandler handler = double_handler(operator);
+    
+    // every operator has a double form, so this also rejects unknown ones
+    if (!handler) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "Unknown binary operator: %c", operator);
+        set_interpreter_error(error_msg);
+        return VALUE_NULL;
+    }
+    
+    if (value_is_int(left) && value_is_int(right)) {
+        handler = int_handler(operator);
+    } else if (value_is_double(left) && value_is_double(right)) {
+        handler = double_handler(operator);
+    } else if (value_is_number(left) && value_is_number(right)) {
+        handler = quick_number;
+    } else {
+        handler = string_handler(operator, left, right);
+    }
+    
+    if (handler) {
+        node->data.binary.quick = handler;
+        context.quicken_specialized++;
+        return handler(node, left, right);
+    }
+    
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg), "Unsupported operand types for %s: %s and %s",
+             operator_symbol(operator), value_type_name(left), value_type_name(right));
+    set_interpreter_error(error_msg);
+    return VALUE_NULL;
+}
+
+// position of an element given an index value - 0 unless it names one
+static int element_position(Value index, size_t length, size_t *position) {
+    if (value_is_int(index)) {
+        int32_t i = value_as_int(index);
+        if (i < 0 || (size_t)i >= length) {
+            return 0;
+        }
+        *position = (size_t)i;
+        return 1;
+    }
+    if (value_is_double(index)) {
+        double d = value_as_double(index);
+        if (!(d >= 0.0 && d < (double)length) || d != (double)(size_t)d) {
+            return 0;
+        }
+        *position = (size_t)d;
+        return 1;
+    }
+    return 0;
+}
+
+// evaluate the object and index of an element access and find the
+// element's position - 0 after an error. stores also need an array that
+// is not mapped from a file. a map has no positions, so its key is
+// handed back instead.
+static int element_target(ASTNode *node, Environment *env, int for_store, Value *object, size_t *position,
+                          Value *key) {
+    *object = interpret_value(node->data.index.object, env);
+    if (interpreter_has_error()) {
+        return 0;
+    }
+    
+    heap_push_root(object);
+    Value index = interpret_value(node->data.index.index, env);
+    heap_pop_roots(1);
+    if (interpreter_has_error()) {
+        return 0;
+    }
+    
+    char error_msg[256];
+    size_t length;
+    if (value_is_float64_array(*object)) {
+        Float64ArrayObject *array = value_as_float64_array(*object);
+        if (for_store && array->mapped) {
+            set_interpreter_error("Cannot store into a Float64Array mapped from a file");
+            return 0;
+        }
+        length = array->length;
+    } else if (value_is_shared_array(*object)) {
+        length = value_as_shared_array(*object)->buffer->length;
+    } else if (value_is_array(*object)) {
+        length = value_as_array(*object)->length;
+    } else if (value_is_map(*object)) {
+        if (!map_key_valid(index)) {
+            snprintf(error_msg, sizeof(error_msg), "Map keys must be numbers or strings, got %s",
+                     value_type_name(index));
+            set_interpreter_error(error_msg);
+            return 0;
+        }
+        *key = index;
+        return 1;
+    } else {
+        snprintf(error_msg, sizeof(error_msg), "Cannot index a %s", value_type_name(*object));
+        set_interpreter_error(error_msg);
+        return 0;
+    }
+    
+    if (!element_position(index, length, position)) {
+        char index_text[64];
+        value_format(index, index_text, sizeof(index_text));
+        snprintf(error_msg, sizeof(error_msg), "Index %s out of range for %s(%zu)",
+                 index_text, value_type_name(*object), length);
+        set_interpreter_error(error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+// inline caches - a property access node remembers the shapes it has
+// seen with the slot each had the property in, so an object shaped like
+// one it saw before costs a pointer compare and a load. a site that sees
+// more shapes than it has room for stops adding them and looks names up.
+PropertyCacheStats interpreter_get_property_cache_stats(void) {
+    PropertyCacheStats stats;
+    stats.hits = context.property_cache_hits;
+    stats.misses = context.property_cache_misses;
+    stats.megamorphic = context.property_cache_megamorphic;
+    return stats;
+}
+
+static void property_cache_add(PropertyCache *cache, Shape *shape, Shape *target, int32_t slot) {
+    if (cache->megamorphic) {
+        return;
+    }
+    if (cache->count == PROPERTY_CACHE_ENTRIES) {
+        cache->megamorphic = 1;
+        context.property_cache_megamorphic++;
+        return;
+    }
+    cache->shapes[cache->count] = shape;
+    cache->targets[cache->count] = target;
+    cache->slots[cache->count] = slot;
+    cache->count++;
+}
+
+// the interned name of a property node, made on first use
+static StringObject* property_key(ASTNode *node) {
+    if (value_is_null(node->data.property.key)) {
+        const char *name = node->data.property.name;
+        node->data.property.key = string_intern(name, strlen(name));
+        if (value_is_null(node->data.property.key)) {
+            set_interpreter_error("Out of memory interning string");
+            return NULL;
+        }
+    }
+    return value_as_string(node->data.property.key);
+}
+
+// evaluate the object of a property access - NULL after an error
+static RecordObject* property_target(ASTNode *node, Environment *env, const char *verb, Value *object) {
+    *object = interpret_value(node->data.property.object, env);
+    if (interpreter_has_error()) {
+        return NULL;
+    }
+    if (!value_is_record(*object)) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "Cannot %s property '%s' of a %s",
+                 verb, node->data.property.name, value_type_name(*object));
+        set_interpreter_error(error_msg);
+        return NULL;
+    }
+    return value_as_record(*object);
+}
+
+static Value get_property(ASTNode *node, Environment *env) {
+    Value object;
+    RecordObject *record = property_target(node, env, "read", &object);
+    if (!record) {
+        return VALUE_NULL;
+    }
+    
+    PropertyCache *cache = node->data.property.cache;
+    Shape *shape = record->shape;
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->shapes[i] == shape) {
+            context.property_cache_hits++;
+            int32_t slot = cache->slots[i];
+            return slot < 0 ? VALUE_NULL : *record_slot(record, (uint32_t)slot);
+        }
+    }
+    
+    context.property_cache_misses++;
+    StringObject *key = property_key(node);
+    if (!key) {
+        return VALUE_NULL;
+    }
+    int32_t slot = shape_lookup(shape, key);
+    property_cache_add(cache, shape, NULL, slot);
+    return slot < 0 ? VALUE_NULL : *record_slot(record, (uint32_t)slot);
+}
+
+// a store either overwrites a slot the shape has or adds the property,
+// moving the object to the next shape - the cache remembers which
+static Value set_property(ASTNode *node, Environment *env) {
+    Value object;
+    if (!property_target(node, env, "set", &object)) {
+        return VALUE_NULL;
+    }
+    
+    heap_push_root(&object);
+    Value value = interpret_value(node->data.property.value, env);
+    heap_pop_roots(1);
+    if (interpreter_has_error()) {
+        return VALUE_NULL;
+    }
+    
+    // evaluating the value may have moved the object or changed its shape
+    RecordObject *record = value_as_record(object);
+    PropertyCache *cache = node->data.property.cache;
+    Shape *shape = record->shape;
+    Shape *target = NULL;
+    int32_t slot = -1;
+    int found = 0;
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->shapes[i] == shape) {
+            context.property_cache_hits++;
+            target = cache->targets[i];
+            slot = cache->slots[i];
+            found = 1;
+            break;
+        }
+    }
+    
+    if (!found) {
+        context.property_cache_misses++;
+        StringObject *key = property_key(node);
+        if (!key) {
+            return VALUE_NULL;
+        }
+        slot = shape_lookup(shape, key);
+        if (slot < 0) {
+            target = shape_transition(shape, key);
+            if (!target) {
+                set_interpreter_error("Out of memory adding property");
+                return VALUE_NULL;
+            }
+        }
+        property_cache_add(cache, shape, target, slot);
+    }
+    
+    if (slot >= 0) {
+        record_store(record, (uint32_t)slot, value);
+    } else if (!record_add(object, target, value)) {
+        set_interpreter_error("Out of memory adding property");
+        return VALUE_NULL;
+    }
+    return value;
+}
+
+// the first run of an object literal works out its shape and the slot
+// of each value - a repeated name keeps its first slot and last value
+static int object_literal_shape(ASTNode *node) {
+    int count = node->data.object.count;
+    uint32_t *slots = malloc((count > 0 ? (size_t)count : 1) * sizeof(uint32_t));
+    Shape *shape = shape_empty();
+    if (!slots || !shape) {
+        free(slots);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        const char *key = node->data.object.keys[i];
+        Value name = string_intern(key, strlen(key));
+        if (value_is_null(name)) {
+            free(slots);
+            return 0;
+        }
+        int slot = shape_lookup(shape, value_as_string(name));
+        if (slot < 0) {
+            shape = shape_transition(shape, value_as_string(name));
+            if (!shape) {
+                free(slots);
+                return 0;
+            }
+            slot = (int)shape->count - 1;
+        }
+        slots[i] = (uint32_t)slot;
+    }
+    node->data.object.slots = slots;
+    node->data.object.shape = shape;
+    return 1;
+}
+
+// run a builtin, resolving the name the first time the call executes
+static Value call_builtin(ASTNode *node, Environment *env) {
+    char error_msg[256];
+    const Builtin *builtin = node->data.call.builtin;
+    if (!builtin) {
+        builtin = builtin_lookup(node->data.call.name);
+        if (!builtin) {
+            snprintf(error_msg, sizeof(error_msg), "Unknown function: %s", node->data.call.name);
+            set_interpreter_error(error_msg);
+            return VALUE_NULL;
+        }
+        int count = node->data.call.count;
+        if (count < builtin->min_args || count > builtin->max_args) {
+            if (builtin->min_args == builtin->max_args) {
+                snprintf(error_msg, sizeof(error_msg), "%s expects %d argument%s, got %d",
+                         builtin->name, builtin->min_args, builtin->min_args == 1 ? "" : "s", count);
+            } else {
+                snprintf(error_msg, sizeof(error_msg), "%s expects %d to %d arguments, got %d",
+                         builtin->name, builtin->min_args, builtin->max_args, count);
+            }
+            set_interpreter_error(error_msg);
+            return VALUE_NULL;
+        }
+        node->data.call.builtin = builtin;
+    }
+    
+    // arguments stay rooted until the builtin returns, so builtins can
+    // allocate without rooting them again
+    int count = node->data.call.count;
+    Value args[CALL_MAX_ARGS];
+    for (int i = 0; i < count; i++) {
+        args[i] = interpret_value(node->data.call.args[i], env);
+        if (interpreter_has_error()) {
+            heap_pop_roots((size_t)i);
+            return VALUE_NULL;
+        }
+        heap_push_root(&args[i]);
+    }
+    Value result = builtin->function(args, count);
+    heap_pop_roots((size_t)count);
+    return result;
+}
+
+// sqrt, exp, log, sin, cos or pow. numbers go straight to the math
+// functions; arrays go through the vector versions in intrinsic_apply.
+static Value call_intrinsic(ASTNode *node, Environment *env) {
+    const Intrinsic *intrinsic = node->data.intrinsic.intrinsic;
+    int count = node->data.intrinsic.count;
+    Value args[INTRINSIC_MAX_ARGS];
+    int numbers = 1;
+    for (int i = 0; i < count; i++) {
+        args[i] = interpret_value(node->data.intrinsic.args[i], env);
+        if (interpreter_has_error()) {
+            heap_pop_roots((size_t)i);
+            return VALUE_NULL;
+        }
+        heap_push_root(&args[i]);
+        numbers = numbers && value_is_number(args[i]);
+    }
+    Value result;
+    if (numbers) {
+        double y = count > 1 ? value_to_number(args[1]) : 0.0;
+        result = value_from_number(intrinsic_number(intrinsic->kind, value_to_number(args[0]), y));
+    } else {
+        result = intrinsic_apply(intrinsic, args);
+    }
+    heap_pop_roots((size_t)count);
+    return result;
+}
+
+// numeric entry point - evaluates and converts the result to a double
 double interpret(ASTNode *node, Environment *env) {
+    return value_to_number(interpret_value(node, env));
+}
+
+// main eval function - walks ast and executes nodes
+Value interpret_value(ASTNode *node, Environment *env) {
     if (!node) {
         set_interpreter_error("Null AST node");
-        return 0.0;
+        return VALUE_NULL;
     }
     
     if (!env) {
         set_interpreter_error("Null environment");
-        return 0.0;
+        return VALUE_NULL;
     }
     
     interpreter_clear_error();
     
     switch (node->type) {
         case AST_NUMBER:
-            return node->data.number;
+            // integral literals start out on the integer fast path
+            return value_from_number(node->data.number);
+            
+        case AST_STRING:
+            // literals are interned once and the node keeps the result
+            if (value_is_null(node->data.string.interned)) {
+                const char *chars = node->data.string.chars;
+                node->data.string.interned = string_intern(chars, strlen(chars));
+                if (value_is_null(node->data.string.interned)) {
+                    set_interpreter_error("Out of memory interning string");
+                }
+            }
+            return node->data.string.interned;
             
         case AST_IDENTIFIER: {
-            double value;
-            if (env_get(env, node->data.identifier, &value)) {
+            Value value;
+            if (env_get_value(env, node->data.identifier, &value)) {
                 return value;
             } else {
                 char error_msg[256];
                 snprintf(error_msg, sizeof(error_msg), "Undefined variable: %s", node->data.identifier);
                 set_interpreter_error(error_msg);
-                return 0.0;
+                return VALUE_NULL;
             }
         }
         
         case AST_BINARY_OP: {
             // eval both sides first
-            double left_val = interpret(node->data.binary.left, env);
+            Value left = interpret_value(node->data.binary.left, env);
             if (interpreter_has_error()) {
-                return 0.0;
+                return VALUE_NULL;
             }
             
-            double right_val = interpret(node->data.binary.right, env);
+            // left has to survive any collection the right side causes
+            heap_push_root(&left);
+            Value right = interpret_value(node->data.binary.right, env);
+            heap_pop_roots(1);
             if (interpreter_has_error()) {
-                return 0.0;
+                return VALUE_NULL;
             }
             
-            // do the math or comparison
-            switch (node->data.binary.operator) {
-                case '+':
-                    return left_val + right_val;
-                case '-':
-                    return left_val - right_val;
-                case '*':
-                    return left_val * right_val;
-                case '/':
-                    if (right_val == 0.0) {
-                        set_interpreter_error("Division by zero");
-                        return 0.0;
-                    }
-                    return left_val / right_val;
-                case '>':
-                    return (left_val > right_val) ? 1.0 : 0.0;
-                case '<':
-                    return (left_val < right_val) ? 1.0 : 0.0;
-                case 'G':  // >= (Greater-equal)
-                    return (left_val >= right_val) ? 1.0 : 0.0;
-                case 'L':  // <= (Less-equal)
-                    return (left_val <= right_val) ? 1.0 : 0.0;
-                case 'E':  // == (Equal)
-                    return (left_val == right_val) ? 1.0 : 0.0;
-                case 'N':  // != (Not-equal)
-                    return (left_val != right_val) ? 1.0 : 0.0;
-                default:
-                    {
-                        char error_msg[256];
-                        snprintf(error_msg, sizeof(error_msg), "Unknown binary operator: %c", node->data.binary.operator);
-                        set_interpreter_error(error_msg);
-                        return 0.0;
-                    }
-            }
+            // quickened nodes jump straight to their specialized handler
+            BinaryHandler handler = node->data.binary.quick ? node->data.binary.quick : binary_generic;
+            return handler(node, left, right);
         }
         
         case AST_LET_DECL: {
             // eval the value and store it
-            double value = interpret(node->data.let_decl.value, env);
+            Value value = interpret_value(node->data.let_decl.value, env);
             if (interpreter_has_error()) {
-                return 0.0;
+                return VALUE_NULL;
             }
             
-            if (!env_set(env, node->data.let_decl.name, value)) {
+            if (!env_set_value(env, node->data.let_decl.name, value)) {
                 set_interpreter_error("Failed to store variable in environment");
-                return 0.0;
+                return VALUE_NULL;
             }
             
             return value;
@@ -127,52 +758,196 @@ double interpret(ASTNode *node, Environment *env) {
         
         case AST_PRINT_CALL: {
             // eval arg and print it
-            double value = interpret(node->data.print_arg, env);
+            Value value = interpret_value(node->data.print_arg, env);
             if (interpreter_has_error()) {
-                return 0.0;
+                return VALUE_NULL;
             }
             
-            printf("%.15g\n", value);
+            value_print(value, stdout);
+            putchar('\n');
             return value;
         }
         
         case AST_PROGRAM: {
             // run all statements, return last result
-            double last_result = 0.0;
+            Value last_result = value_from_double(0.0);
+            heap_push_root(&last_result);
             
             for (int i = 0; i < node->data.program.count; i++) {
-                last_result = interpret(node->data.program.statements[i], env);
+                last_result = interpret_value(node->data.program.statements[i], env);
                 if (interpreter_has_error()) {
-                    return 0.0;
+                    heap_pop_roots(1);
+                    return VALUE_NULL;
                 }
             }
             
+            heap_pop_roots(1);
             return last_result;
         }
         
         case AST_IF_STMT: {
             // evaluate the condition
-            double condition_value = interpret(node->data.if_stmt.condition, env);
+            Value condition = interpret_value(node->data.if_stmt.condition, env);
             if (interpreter_has_error()) {
-                return 0.0;
+                return VALUE_NULL;
             }
             
             // non-zero is true, zero is false
-            if (condition_value != 0.0) {
+            if (value_is_truthy(condition)) {
                 // execute if branch
-                return interpret(node->data.if_stmt.if_branch, env);
+                return interpret_value(node->data.if_stmt.if_branch, env);
             } else {
                 // execute else branch if it exists
                 if (node->data.if_stmt.else_branch != NULL) {
-                    return interpret(node->data.if_stmt.else_branch, env);
+                    return interpret_value(node->data.if_stmt.else_branch, env);
                 }
                 // no else branch, return 0
-                return 0.0;
+                return value_from_double(0.0);
+            }
+        }
+        
+        case AST_CALL:
+            return call_builtin(node, env);
+
+        case AST_INTRINSIC:
+            return call_intrinsic(node, env);
+            
+        case AST_ARRAY: {
+            Value array = array_create((size_t)node->data.array.count);
+            if (value_is_null(array)) {
+                set_interpreter_error("Out of memory creating array");
+                return VALUE_NULL;
+            }
+            heap_push_root(&array);
+            for (int i = 0; i < node->data.array.count; i++) {
+                Value element = interpret_value(node->data.array.elements[i], env);
+                if (interpreter_has_error()) {
+                    heap_pop_roots(1);
+                    return VALUE_NULL;
+                }
+                array_append(array, element);   // capacity is already there
+            }
+            heap_pop_roots(1);
+            return array;
+        }
+        
+        case AST_OBJECT: {
+            if (!node->data.object.shape && !object_literal_shape(node)) {
+                set_interpreter_error("Out of memory creating object");
+                return VALUE_NULL;
+            }
+            Value object = record_create(node->data.object.shape);
+            if (value_is_null(object)) {
+                set_interpreter_error("Out of memory creating object");
+                return VALUE_NULL;
+            }
+            heap_push_root(&object);
+            for (int i = 0; i < node->data.object.count; i++) {
+                Value element = interpret_value(node->data.object.values[i], env);
+                if (interpreter_has_error()) {
+                    heap_pop_roots(1);
+                    return VALUE_NULL;
+                }
+                // the object may have been promoted by now, so use the barriers
+                record_store(value_as_record(object), node->data.object.slots[i], element);
+            }
+            heap_pop_roots(1);
+            return object;
+        }
+        
+        case AST_PROPERTY:
+            return get_property(node, env);
+            
+        case AST_PROPERTY_ASSIGN:
+            return set_property(node, env);
+            
+        case AST_INDEX: {
+            Value object, key, item;
+            size_t position;
+            if (!element_target(node, env, 0, &object, &position, &key)) {
+                return VALUE_NULL;
+            }
+            if (value_is_map(object)) {
+                return map_get(object, key, &item) ? item : VALUE_NULL;
+            }
+            if (value_is_float64_array(object)) {
+                return value_from_double(value_as_float64_array(object)->data[position]);
             }
+            if (value_is_shared_array(object)) {
+                return value_from_number(shared_load(value_as_shared_array(object)->buffer, position));
+            }
+            return array_get(object, position);
+        }
+        
+        case AST_INDEX_ASSIGN: {
+            Value object, key = VALUE_NULL;
+            size_t position;
+            if (!element_target(node, env, 1, &object, &position, &key)) {
+                return VALUE_NULL;
+            }
+            
+            heap_push_root(&object);
+            heap_push_root(&key);
+            Value value = interpret_value(node->data.index.value, env);
+            heap_pop_roots(2);
+            if (interpreter_has_error()) {
+                return VALUE_NULL;
+            }
+            if (value_is_map(object)) {
+                if (!map_set(object, key, value)) {
+                    set_interpreter_error("Out of memory growing Map");
+                    return VALUE_NULL;
+                }
+                return value;
+            }
+            if (value_is_array(object)) {
+                // the value may have popped the element off
+                size_t length = value_as_array(object)->length;
+                if (position >= length) {
+                    char error_msg[256];
+                    snprintf(error_msg, sizeof(error_msg), "Index %zu out of range for Array(%zu)",
+                             position, length);
+                    set_interpreter_error(error_msg);
+                    return VALUE_NULL;
+                }
+                array_set(object, position, value);
+                return value;
+            }
+            if (!value_is_number(value)) {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg), "Cannot store a %s in a %s",
+                         value_type_name(value), value_type_name(object));
+                set_interpreter_error(error_msg);
+                return VALUE_NULL;
+            }
+            if (value_is_shared_array(object)) {
+                SharedBuffer *buffer = value_as_shared_array(object)->buffer;
+                if (!shared_fits(buffer, value_to_number(value))) {
+                    char error_msg[256], value_text[64];
+                    value_format(value, value_text, sizeof(value_text));
+                    snprintf(error_msg, sizeof(error_msg), "Cannot store %s in a SharedInt64Array", value_text);
+                    set_interpreter_error(error_msg);
+                    return VALUE_NULL;
+                }
+                shared_store(buffer, position, value_to_number(value));
+                return value;
+            }
+            
+            // the value may have posted the array's elements to a worker
+            Float64ArrayObject *array = value_as_float64_array(object);
+            if (position >= array->length) {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg), "Index %zu out of range for Float64Array(%zu)",
+                         position, array->length);
+                set_interpreter_error(error_msg);
+                return VALUE_NULL;
+            }
+            array->data[position] = value_to_number(value);
+            return value;
         }
         
         default:
             set_interpreter_error("Unsupported AST node type in interpreter core");
-            return 0.0;
+            return VALUE_NULL;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,603 @@
+/*
+ * kernels.c - whole-array numeric kernels for shardjs
+ *
+ * reductions keep sixteen independent partial results, lane j taking
+ * elements i with i % 16 == j, then fold the lanes in halves (lane j
+ * with lane j + 8, then + 4, + 2, + 1) and add any tail left to right.
+ * the avx2 version holds the lanes in four registers, the sse2 version
+ * in eight and the scalar version in an array, and none of them fuse
+ * multiplies into adds, so all three round identically. lengths are
+ * checked once by the caller; the loops themselves never bounds-check.
+ * hashing is integer work and gives the same bits on every path too.
+ */
+
+#include <math.h>
+#include "include/kernels.h"
+#include "include/hash.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#define LANES 16
+
+typedef struct {
+    double (*sum)(const double *x, size_t n);
+    double (*min)(const double *x, size_t n);
+    double (*max)(const double *x, size_t n);
+    double (*dot)(const double *x, const double *y, size_t n);
+    double (*deviations)(const double *x, double center, size_t n);
+    void (*scale)(double *x, double factor, size_t n);
+    void (*axpy)(double alpha, const double *x, double *y, size_t n);
+    void (*hash_numbers)(const double *x, uint64_t seed, uint64_t *out, size_t n);
+} KernelTable;
+
+// scalar versions - the reference every other path must match
+static double fold_sum(double *lanes) {
+    for (int width = LANES / 2; width > 0; width /= 2) {
+        for (int j = 0; j < width; j++) {
+            lanes[j] = lanes[j] + lanes[j + width];
+        }
+    }
+    return lanes[0];
+}
+
+static double sum_scalar(const double *x, size_t n) {
+    double lanes[LANES] = {0};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int j = 0; j < LANES; j++) {
+            lanes[j] += x[i + j];
+        }
+    }
+    double total = fold_sum(lanes);
+    for (; i < n; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+static double dot_scalar(const double *x, const double *y, size_t n) {
+    double lanes[LANES] = {0};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int j = 0; j < LANES; j++) {
+            lanes[j] += x[i + j] * y[i + j];
+        }
+    }
+    double total = fold_sum(lanes);
+    for (; i < n; i++) {
+        total += x[i] * y[i];
+    }
+    return total;
+}
+
+static double deviations_scalar(const double *x, double center, size_t n) {
+    double lanes[LANES] = {0};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int j = 0; j < LANES; j++) {
+            double d = x[i + j] - center;
+            lanes[j] += d * d;
+        }
+    }
+    double total = fold_sum(lanes);
+    for (; i < n; i++) {
+        double d = x[i] - center;
+        total += d * d;
+    }
+    return total;
+}
+
+// min and max give nan if any element is nan. the sign of a zero
+// result is settled by the wrappers at the bottom.
+static double min_scalar(const double *x, size_t n) {
+    double lowest = INFINITY;
+    int saw_nan = 0;
+    for (size_t i = 0; i < n; i++) {
+        saw_nan |= x[i] != x[i];
+        lowest = lowest < x[i] ? lowest : x[i];
+    }
+    return saw_nan ? NAN : lowest;
+}
+
+static double max_scalar(const double *x, size_t n) {
+    double highest = -INFINITY;
+    int saw_nan = 0;
+    for (size_t i = 0; i < n; i++) {
+        saw_nan |= x[i] != x[i];
+        highest = highest > x[i] ? highest : x[i];
+    }
+    return saw_nan ? NAN : highest;
+}
+
+static void scale_scalar(double *x, double factor, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        x[i] *= factor;
+    }
+}
+
+static void axpy_scalar(double alpha, const double *x, double *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = y[i] + alpha * x[i];
+    }
+}
+
+static void hash_numbers_scalar(const double *x, uint64_t seed, uint64_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = hash_number(x[i], seed);
+    }
+}
+
+static const KernelTable scalar_kernels = {
+    sum_scalar, min_scalar, max_scalar, dot_scalar, deviations_scalar, scale_scalar, axpy_scalar,
+    hash_numbers_scalar
+};
+
+#ifdef KERNELS_X86
+
+// sse2 - lanes 2k and 2k + 1 live in acc[k]
+__attribute__((target("sse2")))
+static double fold_sse2(__m128d *acc) {
+    for (int width = 4; width > 0; width /= 2) {
+        for (int k = 0; k < width; k++) {
+            acc[k] = _mm_add_pd(acc[k], acc[k + width]);
+        }
+    }
+    return _mm_cvtsd_f64(acc[0]) + _mm_cvtsd_f64(_mm_unpackhi_pd(acc[0], acc[0]));
+}
+
+__attribute__((target("sse2")))
+static double sum_sse2(const double *x, size_t n) {
+    __m128d acc[8];
+    for (int k = 0; k < 8; k++) {
+        acc[k] = _mm_setzero_pd();
+    }
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 8; k++) {
+            acc[k] = _mm_add_pd(acc[k], _mm_loadu_pd(x + i + 2 * k));
+        }
+    }
+    double total = fold_sse2(acc);
+    for (; i < n; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+__attribute__((target("sse2")))
+static double dot_sse2(const double *x, const double *y, size_t n) {
+    __m128d acc[8];
+    for (int k = 0; k < 8; k++) {
+        acc[k] = _mm_setzero_pd();
+    }
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 8; k++) {
+            __m128d product = _mm_mul_pd(_mm_loadu_pd(x + i + 2 * k), _mm_loadu_pd(y + i + 2 * k));
+            acc[k] = _mm_add_pd(acc[k], product);
+        }
+    }
+    double total = fold_sse2(acc);
+    for (; i < n; i++) {
+        total += x[i] * y[i];
+    }
+    return total;
+}
+
+__attribute__((target("sse2")))
+static double deviations_sse2(const double *x, double center, size_t n) {
+    __m128d acc[8];
+    for (int k = 0; k < 8; k++) {
+        acc[k] = _mm_setzero_pd();
+    }
+    __m128d c = _mm_set1_pd(center);
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 8; k++) {
+            __m128d d = _mm_sub_pd(_mm_loadu_pd(x + i + 2 * k), c);
+            acc[k] = _mm_add_pd(acc[k], _mm_mul_pd(d, d));
+        }
+    }
+    double total = fold_sse2(acc);
+    for (; i < n; i++) {
+        double d = x[i] - center;
+        total += d * d;
+    }
+    return total;
+}
+
+__attribute__((target("sse2")))
+static double min_sse2(const double *x, size_t n) {
+    __m128d low0 = _mm_set1_pd(INFINITY);
+    __m128d low1 = low0;
+    __m128d nans = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d first = _mm_loadu_pd(x + i);
+        __m128d second = _mm_loadu_pd(x + i + 2);
+        nans = _mm_or_pd(nans, _mm_or_pd(_mm_cmpunord_pd(first, first), _mm_cmpunord_pd(second, second)));
+        low0 = _mm_min_pd(low0, first);
+        low1 = _mm_min_pd(low1, second);
+    }
+    if (_mm_movemask_pd(nans)) {
+        return NAN;
+    }
+    low0 = _mm_min_pd(low0, low1);
+    double lowest = _mm_cvtsd_f64(_mm_min_pd(low0, _mm_unpackhi_pd(low0, low0)));
+    double rest = min_scalar(x + i, n - i);
+    return rest != rest || rest < lowest ? rest : lowest;
+}
+
+__attribute__((target("sse2")))
+static double max_sse2(const double *x, size_t n) {
+    __m128d high0 = _mm_set1_pd(-INFINITY);
+    __m128d high1 = high0;
+    __m128d nans = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d first = _mm_loadu_pd(x + i);
+        __m128d second = _mm_loadu_pd(x + i + 2);
+        nans = _mm_or_pd(nans, _mm_or_pd(_mm_cmpunord_pd(first, first), _mm_cmpunord_pd(second, second)));
+        high0 = _mm_max_pd(high0, first);
+        high1 = _mm_max_pd(high1, second);
+    }
+    if (_mm_movemask_pd(nans)) {
+        return NAN;
+    }
+    high0 = _mm_max_pd(high0, high1);
+    double highest = _mm_cvtsd_f64(_mm_max_pd(high0, _mm_unpackhi_pd(high0, high0)));
+    double rest = max_scalar(x + i, n - i);
+    return rest != rest || rest > highest ? rest : highest;
+}
+
+__attribute__((target("sse2")))
+static void scale_sse2(double *x, double factor, size_t n) {
+    __m128d f = _mm_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), f));
+    }
+    scale_scalar(x + i, factor, n - i);
+}
+
+__attribute__((target("sse2")))
+static void axpy_sse2(double alpha, const double *x, double *y, size_t n) {
+    __m128d a = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d product = _mm_mul_pd(a, _mm_loadu_pd(x + i));
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), product));
+    }
+    axpy_scalar(alpha, x + i, y + i, n - i);
+}
+
+// neither instruction set multiplies 64-bit lanes, so the low half of
+// k * m is put together from three 32 x 32 bit products
+__attribute__((target("sse2")))
+static inline __m128i multiply_sse2(__m128i k, __m128i m_low, __m128i m_high) {
+    __m128i low = _mm_mul_epu32(k, m_low);
+    __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(k, 32), m_low), _mm_mul_epu32(k, m_high));
+    return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+}
+
+__attribute__((target("sse2")))
+static void hash_numbers_sse2(const double *x, uint64_t seed, uint64_t *out, size_t n) {
+    const __m128i key = _mm_set1_epi64x((long long)(HASH_SECRET_NUMBER ^ seed));
+    const __m128i nan_bits = _mm_set1_epi64x(0x7ff8000000000000LL);
+    const __m128i m_low = _mm_set1_epi64x((long long)(HASH_MIX_MULTIPLIER & 0xffffffffu));
+    const __m128i m_high = _mm_set1_epi64x((long long)(HASH_MIX_MULTIPLIER >> 32));
+    const __m128i length = _mm_set1_epi64x(8);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_loadu_pd(x + i);
+        __m128i nan = _mm_castpd_si128(_mm_cmpunord_pd(v, v));
+        __m128i zero = _mm_castpd_si128(_mm_cmpeq_pd(v, _mm_setzero_pd()));
+        __m128i bits = _mm_andnot_si128(_mm_or_si128(nan, zero), _mm_castpd_si128(v));
+        bits = _mm_or_si128(bits, _mm_and_si128(nan, nan_bits));
+
+        __m128i k = _mm_xor_si128(bits, key);
+        __m128i r49 = _mm_or_si128(_mm_slli_epi64(k, 49), _mm_srli_epi64(k, 15));
+        __m128i r24 = _mm_or_si128(_mm_slli_epi64(k, 24), _mm_srli_epi64(k, 40));
+        k = _mm_xor_si128(k, _mm_xor_si128(r49, r24));
+        k = multiply_sse2(k, m_low, m_high);
+        k = _mm_xor_si128(k, _mm_add_epi64(_mm_srli_epi64(k, 35), length));
+        k = multiply_sse2(k, m_low, m_high);
+        k = _mm_xor_si128(k, _mm_srli_epi64(k, 28));
+        _mm_storeu_si128((__m128i*)(out + i), k);
+    }
+    hash_numbers_scalar(x + i, seed, out + i, n - i);
+}
+
+static const KernelTable sse2_kernels = {
+    sum_sse2, min_sse2, max_sse2, dot_sse2, deviations_sse2, scale_sse2, axpy_sse2,
+    hash_numbers_sse2
+};
+
+// avx2 - lanes 4k to 4k + 3 live in acc[k]
+__attribute__((target("avx2")))
+static double fold_avx2(__m256d *acc) {
+    acc[0] = _mm256_add_pd(acc[0], acc[2]);
+    acc[1] = _mm256_add_pd(acc[1], acc[3]);
+    acc[0] = _mm256_add_pd(acc[0], acc[1]);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc[0]), _mm256_extractf128_pd(acc[0], 1));
+    return _mm_cvtsd_f64(half) + _mm_cvtsd_f64(_mm_unpackhi_pd(half, half));
+}
+
+__attribute__((target("avx2")))
+static double sum_avx2(const double *x, size_t n) {
+    __m256d acc[4];
+    for (int k = 0; k < 4; k++) {
+        acc[k] = _mm256_setzero_pd();
+    }
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 4; k++) {
+            acc[k] = _mm256_add_pd(acc[k], _mm256_loadu_pd(x + i + 4 * k));
+        }
+    }
+    double total = fold_avx2(acc);
+    for (; i < n; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+static double dot_avx2(const double *x, const double *y, size_t n) {
+    __m256d acc[4];
+    for (int k = 0; k < 4; k++) {
+        acc[k] = _mm256_setzero_pd();
+    }
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 4; k++) {
+            __m256d product = _mm256_mul_pd(_mm256_loadu_pd(x + i + 4 * k), _mm256_loadu_pd(y + i + 4 * k));
+            acc[k] = _mm256_add_pd(acc[k], product);
+        }
+    }
+    double total = fold_avx2(acc);
+    for (; i < n; i++) {
+        total += x[i] * y[i];
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+static double deviations_avx2(const double *x, double center, size_t n) {
+    __m256d acc[4];
+    for (int k = 0; k < 4; k++) {
+        acc[k] = _mm256_setzero_pd();
+    }
+    __m256d c = _mm256_set1_pd(center);
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < 4; k++) {
+            __m256d d = _mm256_sub_pd(_mm256_loadu_pd(x + i + 4 * k), c);
+            acc[k] = _mm256_add_pd(acc[k], _mm256_mul_pd(d, d));
+        }
+    }
+    double total = fold_avx2(acc);
+    for (; i < n; i++) {
+        double d = x[i] - center;
+        total += d * d;
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+static double min_avx2(const double *x, size_t n) {
+    __m256d low0 = _mm256_set1_pd(INFINITY);
+    __m256d low1 = low0;
+    __m256d nans = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d first = _mm256_loadu_pd(x + i);
+        __m256d second = _mm256_loadu_pd(x + i + 4);
+        nans = _mm256_or_pd(nans, _mm256_or_pd(_mm256_cmp_pd(first, first, _CMP_UNORD_Q),
+                                               _mm256_cmp_pd(second, second, _CMP_UNORD_Q)));
+        low0 = _mm256_min_pd(low0, first);
+        low1 = _mm256_min_pd(low1, second);
+    }
+    if (_mm256_movemask_pd(nans)) {
+        return NAN;
+    }
+    low0 = _mm256_min_pd(low0, low1);
+    __m128d half = _mm_min_pd(_mm256_castpd256_pd128(low0), _mm256_extractf128_pd(low0, 1));
+    double lowest = _mm_cvtsd_f64(_mm_min_pd(half, _mm_unpackhi_pd(half, half)));
+    double rest = min_scalar(x + i, n - i);
+    return rest != rest || rest < lowest ? rest : lowest;
+}
+
+__attribute__((target("avx2")))
+static double max_avx2(const double *x, size_t n) {
+    __m256d high0 = _mm256_set1_pd(-INFINITY);
+    __m256d high1 = high0;
+    __m256d nans = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d first = _mm256_loadu_pd(x + i);
+        __m256d second = _mm256_loadu_pd(x + i + 4);
+        nans = _mm256_or_pd(nans, _mm256_or_pd(_mm256_cmp_pd(first, first, _CMP_UNORD_Q),
+                                               _mm256_cmp_pd(second, second, _CMP_UNORD_Q)));
+        high0 = _mm256_max_pd(high0, first);
+        high1 = _mm256_max_pd(high1, second);
+    }
+    if (_mm256_movemask_pd(nans)) {
+        return NAN;
+    }
+    high0 = _mm256_max_pd(high0, high1);
+    __m128d half = _mm_max_pd(_mm256_castpd256_pd128(high0), _mm256_extractf128_pd(high0, 1));
+    double highest = _mm_cvtsd_f64(_mm_max_pd(half, _mm_unpackhi_pd(half, half)));
+    double rest = max_scalar(x + i, n - i);
+    return rest != rest || rest > highest ? rest : highest;
+}
+
+__attribute__((target("avx2")))
+static void scale_avx2(double *x, double factor, size_t n) {
+    __m256d f = _mm256_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+    }
+    scale_scalar(x + i, factor, n - i);
+}
+
+__attribute__((target("avx2")))
+static void axpy_avx2(double alpha, const double *x, double *y, size_t n) {
+    __m256d a = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d product = _mm256_mul_pd(a, _mm256_loadu_pd(x + i));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), product));
+    }
+    axpy_scalar(alpha, x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i multiply_avx2(__m256i k, __m256i m_low, __m256i m_high) {
+    __m256i low = _mm256_mul_epu32(k, m_low);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(k, 32), m_low), _mm256_mul_epu32(k, m_high));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+static void hash_numbers_avx2(const double *x, uint64_t seed, uint64_t *out, size_t n) {
+    const __m256i key = _mm256_set1_epi64x((long long)(HASH_SECRET_NUMBER ^ seed));
+    const __m256i nan_bits = _mm256_set1_epi64x(0x7ff8000000000000LL);
+    const __m256i m_low = _mm256_set1_epi64x((long long)(HASH_MIX_MULTIPLIER & 0xffffffffu));
+    const __m256i m_high = _mm256_set1_epi64x((long long)(HASH_MIX_MULTIPLIER >> 32));
+    const __m256i length = _mm256_set1_epi64x(8);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(x + i);
+        __m256i nan = _mm256_castpd_si256(_mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+        __m256i zero = _mm256_castpd_si256(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_EQ_OQ));
+        __m256i bits = _mm256_andnot_si256(_mm256_or_si256(nan, zero), _mm256_castpd_si256(v));
+        bits = _mm256_or_si256(bits, _mm256_and_si256(nan, nan_bits));
+
+        __m256i k = _mm256_xor_si256(bits, key);
+        __m256i r49 = _mm256_or_si256(_mm256_slli_epi64(k, 49), _mm256_srli_epi64(k, 15));
+        __m256i r24 = _mm256_or_si256(_mm256_slli_epi64(k, 24), _mm256_srli_epi64(k, 40));
+        k = _mm256_xor_si256(k, _mm256_xor_si256(r49, r24));
+        k = multiply_avx2(k, m_low, m_high);
+        k = _mm256_xor_si256(k, _mm256_add_epi64(_mm256_srli_epi64(k, 35), length));
+        k = multiply_avx2(k, m_low, m_high);
+        k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 28));
+        _mm256_storeu_si256((__m256i*)(out + i), k);
+    }
+    hash_numbers_sse2(x + i, seed, out + i, n - i);
+}
+
+static const KernelTable avx2_kernels = {
+    sum_avx2, min_avx2, max_avx2, dot_avx2, deviations_avx2, scale_avx2, axpy_avx2,
+    hash_numbers_avx2
+};
+
+#endif
+
+static const KernelTable *current_kernels = NULL;
+static KernelIsa current_isa = KERNEL_SCALAR;
+
+KernelIsa kernel_best_isa(void) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KERNEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KERNEL_SSE2;
+    }
+#endif
+    return KERNEL_SCALAR;
+}
+
+// switch to a particular instruction set - 0 if this cpu lacks it
+int kernel_use_isa(KernelIsa isa) {
+    if (isa > kernel_best_isa()) {
+        return 0;
+    }
+    switch (isa) {
+#ifdef KERNELS_X86
+        case KERNEL_AVX2: current_kernels = &avx2_kernels; break;
+        case KERNEL_SSE2: current_kernels = &sse2_kernels; break;
+#endif
+        default: current_kernels = &scalar_kernels; break;
+    }
+    current_isa = isa;
+    return 1;
+}
+
+static const KernelTable* kernels(void) {
+    if (!current_kernels) {
+        kernel_use_isa(kernel_best_isa());
+    }
+    return current_kernels;
+}
+
+KernelIsa kernel_current_isa(void) {
+    kernels();
+    return current_isa;
+}
+
+const char* kernel_isa_name(KernelIsa isa) {
+    switch (isa) {
+        case KERNEL_AVX2: return "avx2";
+        case KERNEL_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+static int has_zero_with_sign(const double *x, size_t n, int negative) {
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] == 0.0 && (signbit(x[i]) != 0) == negative) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+double kernel_sum(const double *x, size_t n) {
+    return kernels()->sum(x, n);
+}
+
+double kernel_dot(const double *x, const double *y, size_t n) {
+    return kernels()->dot(x, y, n);
+}
+
+double kernel_deviations(const double *x, double center, size_t n) {
+    return kernels()->deviations(x, center, n);
+}
+
+void kernel_hash_numbers(const double *x, uint64_t seed, uint64_t *out, size_t n) {
+    kernels()->hash_numbers(x, seed, out, n);
+}
+
+// like Math.min - any nan wins, and -0 is below 0. the min and max
+// instructions treat the two zeros as equal, so a zero result gets its
+// sign from one more pass, which only ever runs when the answer is 0.
+double kernel_min(const double *x, size_t n) {
+    double lowest = kernels()->min(x, n);
+    if (lowest == 0.0) {
+        return has_zero_with_sign(x, n, 1) ? -0.0 : 0.0;
+    }
+    return lowest;
+}
+
+double kernel_max(const double *x, size_t n) {
+    double highest = kernels()->max(x, n);
+    if (highest == 0.0) {
+        return has_zero_with_sign(x, n, 0) ? 0.0 : -0.0;
+    }
+    return highest;
+}
+
+void kernel_scale(double *x, double factor, size_t n) {
+    kernels()->scale(x, factor, n);
+}
+
+void kernel_axpy(double alpha, const double *x, double *y, size_t n) {
+    kernels()->axpy(alpha, x, y, n);
+}
@@ -158,6 +158,61 @@ static Token lexer_read_number(Lexer *lexer) {
     return create_number_token(value, start_line, start_column);
 }
 
+// read a quoted string literal, decoding escapes. the token text is
+// the decoded contents. an unterminated literal is an error token.
+static Token lexer_read_string(Lexer *lexer) {
+    int start_line = lexer->line;
+    int start_column = lexer->column;
+    char quote = lexer->current_char;
+    lexer_advance(lexer); // opening quote
+    
+    size_t capacity = 32;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        return create_token(TOKEN_ERROR, start_line, start_column);
+    }
+    
+    while (lexer->current_char != quote) {
+        if (lexer->current_char == '\0' || lexer->current_char == '\n') {
+            free(buffer);
+            return create_token(TOKEN_ERROR, start_line, start_column);
+        }
+        
+        char ch = lexer->current_char;
+        if (ch == '\\') {
+            lexer_advance(lexer);
+            switch (lexer->current_char) {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case 'r': ch = '\r'; break;
+                case '\0':
+                    free(buffer);
+                    return create_token(TOKEN_ERROR, start_line, start_column);
+                default: ch = lexer->current_char; break;  // \\, \" and \'
+            }
+        }
+        
+        if (length + 1 >= capacity) {
+            capacity *= 2;
+            char *grown = realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+                return create_token(TOKEN_ERROR, start_line, start_column);
+            }
+            buffer = grown;
+        }
+        buffer[length++] = ch;
+        lexer_advance(lexer);
+    }
+    lexer_advance(lexer); // closing quote
+    
+    buffer[length] = '\0';
+    Token token = create_token(TOKEN_STRING, start_line, start_column);
+    token.text = buffer;
+    return token;
+}
+
 // read identifier or keyword
 static Token lexer_read_identifier(Lexer *lexer) {
     int start_line = lexer->line;
@@ -209,6 +264,11 @@ Token lexer_next_token(Lexer *lexer) {
         return lexer_read_number(lexer);
     }
     
+    // string literals
+    if (lexer->current_char == '"' || lexer->current_char == '\'') {
+        return lexer_read_string(lexer);
+    }
+    
     // identifiers and keywords
     if (isalpha(lexer->current_char) || lexer->current_char == '_') {
         return lexer_read_identifier(lexer);
@@ -260,6 +320,21 @@ Token lexer_next_token(Lexer *lexer) {
             return create_token(TOKEN_LPAREN, current_line, current_column);
         case ')':
             return create_token(TOKEN_RPAREN, current_line, current_column);
+        case '[':
+            return create_token(TOKEN_LBRACKET, current_line, current_column);
+        case ']':
+            return create_token(TOKEN_RBRACKET, current_line, current_column);
+        case '{':
+            return create_token(TOKEN_LBRACE, current_line, current_column);
+        case '}':
+            return create_token(TOKEN_RBRACE, current_line, current_column);
+        case ':':
+            return create_token(TOKEN_COLON, current_line, current_column);
+        case '.':
+            // numbers start with a digit, so a dot here is property access
+            return create_token(TOKEN_DOT, current_line, current_column);
+        case ',':
+            return create_token(TOKEN_COMMA, current_line, current_column);
         case ';':
             return create_token(TOKEN_SEMICOLON, current_line, current_column);
         default:
@@ -0,0 +1,357 @@
+/*
+ * linalg.c - dense matrix arithmetic for shardjs
+ *
+ * matmul follows the goto/blis layout. b is taken KC rows and NC
+ * columns at a time and copied into panels NR columns wide, a MC rows
+ * and KC columns at a time into panels MR rows tall, so the kernel
+ * streams both from contiguous memory: a piece of a stays in L2 while it
+ * meets every panel of b, and the piece of b stays in L3 while every
+ * piece of a passes through. the kernel keeps an MR by NR tile of c in
+ * vector registers through gcc's vector extensions, compiled for the
+ * baseline and for avx2 like vecmath.c. large products split the rows
+ * of c between threads, each packing its own copies.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "include/linalg.h"
+#include "include/kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINALG_X86 1
+#endif
+
+// the register tile - MR rows of c by NR columns, two vectors a row
+#define MR 4
+#define NR 8
+// the cache blocks
+#define MC 64
+#define KC 256
+#define NC 1024
+
+#define PACK_ALIGNMENT 32
+
+typedef double vd __attribute__((vector_size(32)));
+typedef double vh __attribute__((vector_size(16)));
+
+// inlined into each build so it is compiled for that instruction set
+#define INLINE static inline __attribute__((always_inline))
+
+// rows [0, mc) and columns [0, kc) of a as panels of MR rows, each
+// stored a column at a time, with rows past mc zero
+INLINE void pack_a(const double *a, size_t lda, size_t mc, size_t kc, double *packed) {
+    for (size_t i = 0; i < mc; i += MR) {
+        size_t rows = mc - i < MR ? mc - i : MR;
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t r = 0; r < MR; r++) {
+                *packed++ = r < rows ? a[(i + r) * lda + p] : 0.0;
+            }
+        }
+    }
+}
+
+// rows [0, kc) and columns [0, nc) of b as panels NR columns wide, each
+// stored a row at a time, with columns past nc zero
+INLINE void pack_b(const double *b, size_t ldb, size_t kc, size_t nc, double *packed) {
+    for (size_t j = 0; j < nc; j += NR) {
+        size_t cols = nc - j < NR ? nc - j : NR;
+        for (size_t p = 0; p < kc; p++) {
+            const double *row = b + p * ldb + j;
+            size_t col = 0;
+            for (; col < cols; col++) {
+                *packed++ = row[col];
+            }
+            for (; col < NR; col++) {
+                *packed++ = 0.0;
+            }
+        }
+    }
+}
+
+// an MR by NR tile of c, starting from 0 on the first block of k and
+// from what is there after it, plus kc products of a panel of a and a
+// panel of b, one multiply and one add at a time in k order. the tile
+// is spelled out in separate variables, since gcc leaves an array of
+// vectors in memory. with avx a row is two four-lane vectors; without
+// it, gcc splits four-lane vectors through the stack, so the tile is
+// done as two halves in two-lane sse2 vectors.
+#define LOAD_ROW(r, low, high) do {                                              \
+        if (first) {                                                             \
+            memset(&low, 0, sizeof(low));                                        \
+            memset(&high, 0, sizeof(high));                                      \
+        } else {                                                                 \
+            memcpy(&low, c + (r) * ldc, sizeof(low));                            \
+            memcpy(&high, c + (r) * ldc + sizeof(low) / sizeof(double), sizeof(high)); \
+        }                                                                        \
+    } while (0)
+
+#define ADD_PRODUCTS(r, low, high) do {                                          \
+        low += a[r] * b0;                                                        \
+        high += a[r] * b1;                                                       \
+    } while (0)
+
+#define STORE_ROW(r, low, high) do {                                             \
+        memcpy(c + (r) * ldc, &low, sizeof(low));                                \
+        memcpy(c + (r) * ldc + sizeof(low) / sizeof(double), &high, sizeof(high)); \
+    } while (0)
+
+#define MULTIPLY_TILE(vector) do {                                               \
+        vector c00, c01, c10, c11, c20, c21, c30, c31;                           \
+        LOAD_ROW(0, c00, c01);                                                   \
+        LOAD_ROW(1, c10, c11);                                                   \
+        LOAD_ROW(2, c20, c21);                                                   \
+        LOAD_ROW(3, c30, c31);                                                   \
+        for (size_t p = 0; p < kc; p++) {                                        \
+            vector b0, b1;                                                       \
+            memcpy(&b0, b, sizeof(b0));                                          \
+            memcpy(&b1, b + sizeof(b0) / sizeof(double), sizeof(b1));            \
+            ADD_PRODUCTS(0, c00, c01);                                           \
+            ADD_PRODUCTS(1, c10, c11);                                           \
+            ADD_PRODUCTS(2, c20, c21);                                           \
+            ADD_PRODUCTS(3, c30, c31);                                           \
+            a += MR;                                                             \
+            b += NR;                                                             \
+        }                                                                        \
+        STORE_ROW(0, c00, c01);                                                  \
+        STORE_ROW(1, c10, c11);                                                  \
+        STORE_ROW(2, c20, c21);                                                  \
+        STORE_ROW(3, c30, c31);                                                  \
+    } while (0)
+
+// all NR columns
+INLINE void multiply_wide(size_t kc, const double *a, const double *b, double *c, size_t ldc, int first) {
+    MULTIPLY_TILE(vd);
+}
+
+// NR / 2 columns, starting where b and c point
+INLINE void multiply_half(size_t kc, const double *a, const double *b, double *c, size_t ldc, int first) {
+    MULTIPLY_TILE(vh);
+}
+
+INLINE void multiply_tile(int wide, size_t kc, const double *a, const double *b, double *c, size_t ldc,
+                          int first) {
+    if (wide) {
+        multiply_wide(kc, a, b, c, ldc, first);
+    } else {
+        multiply_half(kc, a, b, c, ldc, first);
+        multiply_half(kc, a, b + NR / 2, c + NR / 2, ldc, first);
+    }
+}
+
+// a tile at the bottom or right edge of c, worked in a full-sized copy
+INLINE void multiply_edge(int wide, size_t kc, const double *a, const double *b, double *c, size_t ldc,
+                          int first, size_t rows, size_t cols) {
+    double tile[MR * NR] = {0};
+    if (!first) {
+        for (size_t r = 0; r < rows; r++) {
+            memcpy(tile + r * NR, c + r * ldc, cols * sizeof(double));
+        }
+    }
+    multiply_tile(wide, kc, a, b, tile, NR, first);
+    for (size_t r = 0; r < rows; r++) {
+        memcpy(c + r * ldc, tile + r * NR, cols * sizeof(double));
+    }
+}
+
+// one thread's share - rows of a and c, and all of b
+typedef struct {
+    const double *a;
+    const double *b;
+    double *c;
+    size_t m, k, n;
+    double *packed_a;      // MC by KC
+    double *packed_b;      // KC by NC, rounded up to whole panels
+} MatmulJob;
+
+INLINE void multiply_blocks(const MatmulJob *job, int wide) {
+    size_t m = job->m, k = job->k, n = job->n;
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = n - jc < NC ? n - jc : NC;
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = k - pc < KC ? k - pc : KC;
+            pack_b(job->b + pc * n + jc, n, kc, nc, job->packed_b);
+            for (size_t ic = 0; ic < m; ic += MC) {
+                size_t mc = m - ic < MC ? m - ic : MC;
+                pack_a(job->a + ic * k + pc, k, mc, kc, job->packed_a);
+                for (size_t jr = 0; jr < nc; jr += NR) {
+                    size_t cols = nc - jr < NR ? nc - jr : NR;
+                    for (size_t ir = 0; ir < mc; ir += MR) {
+                        size_t rows = mc - ir < MR ? mc - ir : MR;
+                        const double *a_panel = job->packed_a + ir * kc;
+                        const double *b_panel = job->packed_b + jr * kc;
+                        double *c = job->c + (ic + ir) * n + jc + jr;
+                        if (rows == MR && cols == NR) {
+                            multiply_tile(wide, kc, a_panel, b_panel, c, n, pc == 0);
+                        } else {
+                            multiply_edge(wide, kc, a_panel, b_panel, c, n, pc == 0, rows, cols);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void multiply_generic(const MatmulJob *job) {
+    multiply_blocks(job, 0);
+}
+
+#ifdef LINALG_X86
+__attribute__((target("avx2")))
+static void multiply_avx2(const MatmulJob *job) {
+    multiply_blocks(job, 1);
+}
+#endif
+
+static void* matmul_work(void *arg) {
+    const MatmulJob *job = arg;
+#ifdef LINALG_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        multiply_avx2(job);
+        return NULL;
+    }
+#endif
+    multiply_generic(job);
+    return NULL;
+}
+
+// run every job, the first on this thread
+static void run_jobs(MatmulJob *jobs, size_t count) {
+    pthread_t threads[LINALG_MAX_THREADS];
+    int started[LINALG_MAX_THREADS] = {0};
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, matmul_work, &jobs[i]) == 0;
+        if (!started[i]) {
+            matmul_work(&jobs[i]);
+        }
+    }
+    matmul_work(&jobs[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+static size_t pick_threads(size_t m, double work, size_t requested) {
+    if (requested == 0) {
+        if (work < LINALG_PARALLEL_MIN) {
+            return 1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cpus > 0 ? (size_t)cpus : 1;
+        // keep every share worth a thread
+        if ((double)requested > work / (LINALG_PARALLEL_MIN / 4)) {
+            requested = (size_t)(work / (LINALG_PARALLEL_MIN / 4));
+        }
+    }
+    if (requested > LINALG_MAX_THREADS) {
+        requested = LINALG_MAX_THREADS;
+    }
+    // every thread gets at least a tile's worth of rows
+    if (requested > (m + MR - 1) / MR) {
+        requested = (m + MR - 1) / MR;
+    }
+    return requested ? requested : 1;
+}
+
+static void* pack_buffer(size_t doubles) {
+    void *memory;
+    return posix_memalign(&memory, PACK_ALIGNMENT, doubles * sizeof(double)) == 0 ? memory : NULL;
+}
+
+size_t linalg_matmul(const double *a, const double *b, double *c, size_t m, size_t k, size_t n, size_t threads) {
+    if (m == 0 || n == 0) {
+        return 1;
+    }
+    if (k == 0) {
+        memset(c, 0, m * n * sizeof(double));
+        return 1;
+    }
+    threads = pick_threads(m, (double)m * (double)k * (double)n, threads);
+
+    // shares of whole tiles, the last one taking what is left
+    size_t share = (m + threads - 1) / threads;
+    share = (share + MR - 1) / MR * MR;
+    size_t kc = k < KC ? k : KC;
+    size_t panels = ((n < NC ? n : NC) + NR - 1) / NR;
+    size_t a_doubles = (size_t)MC * kc;
+    size_t b_doubles = kc * panels * NR;
+    MatmulJob jobs[LINALG_MAX_THREADS];
+    size_t count = 0;
+    int ok = 1;
+    for (size_t start = 0; start < m; start += share) {
+        MatmulJob *job = &jobs[count++];
+        job->a = a + start * k;
+        job->b = b;
+        job->c = c + start * n;
+        job->m = m - start < share ? m - start : share;
+        job->k = k;
+        job->n = n;
+        job->packed_a = pack_buffer(a_doubles);
+        job->packed_b = pack_buffer(b_doubles);
+        ok = ok && job->packed_a && job->packed_b;
+    }
+    if (ok) {
+        run_jobs(jobs, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(jobs[i].packed_a);
+        free(jobs[i].packed_b);
+    }
+    return ok ? count : 0;
+}
+
+// in square blocks, so the rows written and the rows read both stay in
+// the cache while a block is turned over
+#define TRANSPOSE_BLOCK 32
+
+void linalg_transpose(const double *a, double *out, size_t rows, size_t cols) {
+    for (size_t i0 = 0; i0 < rows; i0 += TRANSPOSE_BLOCK) {
+        size_t i_end = rows - i0 < TRANSPOSE_BLOCK ? rows : i0 + TRANSPOSE_BLOCK;
+        for (size_t j0 = 0; j0 < cols; j0 += TRANSPOSE_BLOCK) {
+            size_t j_end = cols - j0 < TRANSPOSE_BLOCK ? cols : j0 + TRANSPOSE_BLOCK;
+            for (size_t i = i0; i < i_end; i++) {
+                for (size_t j = j0; j < j_end; j++) {
+                    out[j * rows + i] = a[i * cols + j];
+                }
+            }
+        }
+    }
+}
+
+void linalg_matvec(const double *a, const double *x, double *y, size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++) {
+        y[i] = kernel_dot(a + i * cols, x, cols);
+    }
+}
+
+// the loop for one operator, with both steps 1 kept apart so the
+// compiler can vectorize it
+#define ELEMENTWISE(expression) do {                                       \
+        if (a_step == 1 && b_step == 1) {                                  \
+            for (size_t i = 0; i < n; i++) {                               \
+                double x = a[i], y = b[i];                                 \
+                out[i] = (expression);                                     \
+            }                                                              \
+        } else {                                                           \
+            for (size_t i = 0; i < n; i++) {                               \
+                double x = a[i * a_step], y = b[i * b_step];               \
+                out[i] = (expression);                                     \
+            }                                                              \
+        }                                                                  \
+    } while (0)
+
+void linalg_elementwise(char op, const double *a, size_t a_step, const double *b, size_t b_step,
+                        double *out, size_t n) {
+    switch (op) {
+        case '+': ELEMENTWISE(x + y); break;
+        case '-': ELEMENTWISE(x - y); break;
+        case '*': ELEMENTWISE(x * y); break;
+        case '/': ELEMENTWISE(x / y); break;
+    }
+}
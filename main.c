@@ -1,7 +1,7 @@
 /*
  * main.c - shardjs interpreter entry point
  * 
- * reads js file, tokenizes, parses, and executes it.
+ * reads js file, tokenizes, parses, optimizes, and executes it.
  * handles errors and cleans up resources.
  */
 
@@ -10,6 +10,9 @@
 #include <string.h>
 #include "include/token.h"
 #include "include/runtime.h"
+#include "include/object.h"
+#include "include/kernels.h"
+#include "include/worker.h"
 
 // read entire file into memory
 char* read_file(const char *filename) {
@@ -39,24 +42,109 @@ char* read_file(const char *filename) {
     return content;
 }
 
-// cleanup everything in one place
-void cleanup_resources(char *source, Lexer *lexer, Parser *parser, ASTNode *ast, Environment *env) {
+// cleanup everything in one place - nonzero when a worker's script
+// failed without the program receiving the error
+int cleanup_resources(char *source, Lexer *lexer, Parser *parser, ASTNode *ast, Environment *env) {
     if (env) env_destroy(env);
     if (ast) ast_destroy(ast);
     if (parser) parser_destroy(parser);
     if (lexer) lexer_destroy(lexer);
     if (source) free(source);
+    int failed = worker_shutdown();
+    heap_destroy();
+    return failed;
+}
+
+// one line per histogram, only the buckets that were hit
+static void print_pauses(const char *kind, const size_t *pauses) {
+    fprintf(stderr, "[stats] gc %s pauses:", kind);
+    int any = 0;
+    for (size_t i = 0; i < HEAP_PAUSE_BUCKETS; i++) {
+        if (pauses[i] > 0) {
+            if (i + 1 < HEAP_PAUSE_BUCKETS) {
+                fprintf(stderr, " <%zuus %zu", (size_t)2 << i, pauses[i]);
+            } else {
+                fprintf(stderr, " longer %zu", pauses[i]);
+            }
+            any = 1;
+        }
+    }
+    fprintf(stderr, any ? "\n" : " none\n");
+}
+
+// report runtime statistics on stderr so script output stays clean
+void print_stats(Parser *parser) {
+    fflush(stdout);
+    
+    ASTConsStats cons = parser_get_cons_stats(parser);
+    double shared = cons.requested > 0
+        ? 100.0 * (double)(cons.requested - cons.unique) / (double)cons.requested
+        : 0.0;
+    
+    fprintf(stderr, "[stats] ast: %zu expression nodes parsed, %zu unique (%.1f%% deduplicated)\n",
+            cons.requested, cons.unique, shared);
+    
+    QuickenStats quicken = interpreter_get_quicken_stats();
+    fprintf(stderr, "[stats] quicken: %zu binary nodes specialized, %zu deopts\n",
+            quicken.specialized, quicken.deopts);
+    PropertyCacheStats caches = interpreter_get_property_cache_stats();
+    fprintf(stderr, "[stats] inline caches: %zu hits, %zu misses, %zu megamorphic sites\n",
+            caches.hits, caches.misses, caches.megamorphic);
+    
+    HeapStats heap = heap_get_stats();
+    fprintf(stderr, "[stats] heap: %zu objects, %zu bytes (%zu old)\n", heap.objects, heap.bytes, heap.old_bytes);
+    fprintf(stderr, "[stats] gc: %zu minor, %zu major collections, %zu bytes promoted, marked with %zu threads\n",
+            heap.minor_collections, heap.major_collections, heap.promoted_bytes, heap.mark_threads);
+    print_pauses("minor", heap.minor_pauses);
+    print_pauses("major", heap.major_pauses);
+    fprintf(stderr, "[stats] gc longest pause: %.1f us\n", heap.longest_pause_us);
+    fprintf(stderr, "[stats] kernels: %s\n", kernel_isa_name(kernel_current_isa()));
+    
+    PeepholeStats peephole[32];
+    int rules = optimizer_get_peephole_stats(peephole, 32);
+    for (int i = 0; i < rules && i < 32; i++) {
+        fprintf(stderr, "[stats] peephole %-18s %zu hits, %zu nodes removed\n",
+                peephole[i].name, peephole[i].hits, peephole[i].nodes_removed);
+    }
 }
 
 int main(int argc, char *argv[]) {
-    // need exactly one arg - the js file
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <script.js>\n", argv[0]);
-        fprintf(stderr, "  script.js: Path to JavaScript file to execute\n");
+    // optional flags followed by the js file
+    int show_stats = 0;
+    int concurrent_gc = 0;
+    long gc_threads = 0;
+    const char *script_path = NULL;
+    int usage_error = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--concurrent-gc") == 0) {
+            concurrent_gc = 1;
+        } else if (strncmp(argv[i], "--gc-threads=", 13) == 0) {
+            char *end;
+            gc_threads = strtol(argv[i] + 13, &end, 10);
+            if (*end != '\0' || end == argv[i] + 13 || gc_threads < 1) {
+                usage_error = 1;
+            }
+        } else if (!script_path && i == argc - 1) {
+            script_path = argv[i];
+        } else {
+            usage_error = 1;
+        }
+    }
+    if (usage_error || !script_path) {
+        fprintf(stderr, "Usage: %s [--stats] [--concurrent-gc] [--gc-threads=N] <script.js>\n", argv[0]);
+        fprintf(stderr, "  script.js:        Path to JavaScript file to execute\n");
+        fprintf(stderr, "  --stats:          Print runtime statistics to stderr\n");
+        fprintf(stderr, "  --concurrent-gc:  Mark the old generation in the background\n");
+        fprintf(stderr, "  --gc-threads=N:   Mark with N threads (default: one per cpu on big heaps)\n");
         return 1;
     }
+    heap_set_concurrent_marking(concurrent_gc);
+    heap_set_mark_threads((size_t)gc_threads);
     
-    if (strlen(argv[1]) == 0) {
+    if (strlen(script_path) == 0) {
         fprintf(stderr, "Error: Script filename cannot be empty\n");
         return 1;
     }
@@ -70,7 +158,7 @@ int main(int argc, char *argv[]) {
     int exit_code = 0;
     
     // read the source file
-    source = read_file(argv[1]);
+    source = read_file(script_path);
     if (!source) {
         exit_code = 1;
         goto cleanup;
@@ -110,6 +198,13 @@ int main(int argc, char *argv[]) {
         goto cleanup;
     }
     
+    // fold constants and drop branches that can never run
+    if (!optimizer_run(ast)) {
+        fprintf(stderr, "Error: Could not optimize program - out of memory\n");
+        exit_code = 1;
+        goto cleanup;
+    }
+    
     // create var environment
     env = env_create();
     if (!env) {
@@ -131,8 +226,14 @@ int main(int argc, char *argv[]) {
     // avoid unused var warning
     (void)result;
     
+    if (show_stats) {
+        print_stats(parser);
+    }
+    
 cleanup:
-    cleanup_resources(source, lexer, parser, ast, env);
+    if (cleanup_resources(source, lexer, parser, ast, env)) {
+        exit_code = 1;
+    }
     
     return exit_code;
 }
\ No newline at end of file
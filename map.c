@@ -0,0 +1,347 @@
+/*
+ * map.c - hash maps for shardjs
+ *
+ * a swiss table. a key's hash is split in two: the high bits pick the
+ * group of 16 slots a probe starts at, and the low 7 bits are stored in
+ * the slot's control byte. looking a key up loads the 16 control bytes
+ * of a group, compares them all with those 7 bits at once, and only
+ * checks the keys of the slots that matched - about one in 128 of the
+ * others. a group with an empty slot ends the probe, otherwise it moves
+ * to the next group along a triangular sequence that visits them all.
+ *
+ * the slots store indexes into a separate array of entries that keys
+ * are appended to, so walking the entries gives insertion order and
+ * growing the table never moves a key's entry, only its index.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "include/object.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define CONTROL_EMPTY   0x80
+#define CONTROL_DELETED 0xfe
+// full slots hold 0 to 127, so the high bit alone means empty or deleted
+
+// the smallest table is one group. at most 7 of every 8 slots are
+// filled before a rehash.
+#define MAP_MIN_CAPACITY MAP_GROUP_WIDTH
+
+static inline uint32_t* slot_entries(MapObject *map) {
+    return (uint32_t*)(map->control + map->capacity);
+}
+
+// bit i is set where control byte i of the group is byte
+static inline uint32_t group_match(const uint8_t *group, uint8_t byte) {
+#ifdef MAP_SSE2
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < MAP_GROUP_WIDTH; i++) {
+        if (group[i] == byte) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// bit i is set where slot i of the group is empty or deleted
+static inline uint32_t group_match_free(const uint8_t *group) {
+#ifdef MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < MAP_GROUP_WIDTH; i++) {
+        if (group[i] & 0x80) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+static inline int lowest_bit(uint32_t mask) {
+    return __builtin_ctz(mask);
+}
+
+// the splitmix64 finalizer, so every bit of the input reaches the low
+// 7 bits of the tag and the high bits that pick a group
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// numbers are hashed by value, with 0 and -0 and all NaNs made one
+static uint64_t key_hash(Value key) {
+    if (value_is_string(key)) {
+        return mix((uint64_t)string_hash(key) ^ 0x9e3779b97f4a7c15ULL);
+    }
+    double number = value_to_number(key);
+    if (number == 0.0) {
+        number = 0.0;
+    } else if (number != number) {
+        number = NAN;
+    }
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return mix(bits);
+}
+
+static int keys_equal(Value a, Value b) {
+    if (value_is_string(a)) {
+        return value_is_string(b) && string_equals(a, b);
+    }
+    if (!value_is_number(b)) {
+        return 0;
+    }
+    double x = value_to_number(a);
+    double y = value_to_number(b);
+    return x == y || (x != x && y != y);
+}
+
+static inline size_t group_mask(MapObject *map) {
+    return map->capacity / MAP_GROUP_WIDTH - 1;
+}
+
+// the slot holding key, or -1
+static long find_slot(MapObject *map, Value key, uint64_t hash) {
+    if (map->capacity == 0) {
+        return -1;
+    }
+    size_t mask = group_mask(map);
+    size_t group = (size_t)(hash >> 7) & mask;
+    uint8_t tag = (uint8_t)(hash & 0x7f);
+    uint32_t *indexes = slot_entries(map);
+    for (size_t step = 1;; step++) {
+        const uint8_t *control = map->control + group * MAP_GROUP_WIDTH;
+        for (uint32_t matches = group_match(control, tag); matches; matches &= matches - 1) {
+            size_t slot = group * MAP_GROUP_WIDTH + (size_t)lowest_bit(matches);
+            MapEntry *entry = &map->entries[indexes[slot]];
+            if (entry->hash == hash && keys_equal(entry->key, key)) {
+                return (long)slot;
+            }
+        }
+        if (group_match(control, CONTROL_EMPTY)) {
+            return -1;
+        }
+        group = (group + step) & mask;
+    }
+}
+
+// the first empty or deleted slot along the probe sequence for hash
+static size_t free_slot(uint8_t *control, size_t capacity, uint64_t hash) {
+    size_t mask = capacity / MAP_GROUP_WIDTH - 1;
+    size_t group = (size_t)(hash >> 7) & mask;
+    for (size_t step = 1;; step++) {
+        uint32_t free = group_match_free(control + group * MAP_GROUP_WIDTH);
+        if (free) {
+            return group * MAP_GROUP_WIDTH + (size_t)lowest_bit(free);
+        }
+        group = (group + step) & mask;
+    }
+}
+
+// rebuild the slots at a new capacity, packing the holes out of the
+// entries on the way. hashes are cached, so no key is hashed again.
+static int rehash(MapObject *map, size_t capacity) {
+    uint8_t *control = malloc(capacity + capacity * sizeof(uint32_t));
+    if (!control) {
+        return 0;
+    }
+    memset(control, CONTROL_EMPTY, capacity);
+    uint32_t *indexes = (uint32_t*)(control + capacity);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < map->entry_count; i++) {
+        MapEntry *entry = &map->entries[i];
+        if (value_is_null(entry->key)) {
+            continue;
+        }
+        if (kept != i) {
+            map->entries[kept] = *entry;
+        }
+        size_t slot = free_slot(control, capacity, entry->hash);
+        control[slot] = (uint8_t)(entry->hash & 0x7f);
+        indexes[slot] = (uint32_t)kept;
+        kept++;
+    }
+    // entries moved down, past where the barrier last looked
+    if (kept != map->entry_count) {
+        map->dirty_from = 0;
+    }
+
+    free(map->control);
+    map->control = control;
+    map->capacity = capacity;
+    map->entry_count = kept;
+    map->growth_left = capacity / 8 * 7 - kept;
+    return 1;
+}
+
+Value map_create(void) {
+    MapObject *map = heap_allocate(OBJ_MAP, sizeof(MapObject));
+    return map ? value_from_pointer(map) : VALUE_NULL;
+}
+
+int map_get(Value value, Value key, Value *result) {
+    MapObject *map = value_as_map(value);
+    long slot = find_slot(map, key, key_hash(key));
+    if (slot < 0) {
+        return 0;
+    }
+    *result = map->entries[slot_entries(map)[slot]].value;
+    return 1;
+}
+
+// room for one more key - called with the map locked
+static int reserve(MapObject *map) {
+    if (map->entry_count == map->entry_capacity) {
+        // mostly holes - packing them out is enough
+        if (map->entry_count - map->count >= map->entry_count / 2 && map->entry_count > 0) {
+            if (!rehash(map, map->capacity)) {
+                return 0;
+            }
+        } else {
+            size_t capacity = map->entry_capacity ? map->entry_capacity * 2 : 4;
+            if (capacity > UINT32_MAX) {
+                return 0;
+            }
+            MapEntry *entries = realloc(map->entries, capacity * sizeof(MapEntry));
+            if (!entries) {
+                return 0;
+            }
+            map->entries = entries;
+            map->entry_capacity = capacity;
+        }
+    }
+    if (map->growth_left == 0) {
+        // grow unless deleted slots are what used the room up
+        size_t capacity = map->capacity == 0 ? MAP_MIN_CAPACITY : map->capacity;
+        if (map->count + 1 > capacity / 16 * 7) {
+            capacity *= 2;
+        }
+        if (!rehash(map, capacity)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// add a key known to be absent - called with the map locked
+static int insert(MapObject *map, Value key, uint64_t hash, Value item) {
+    if (!reserve(map)) {
+        return 0;
+    }
+    size_t slot = free_slot(map->control, map->capacity, hash);
+    if (map->control[slot] == CONTROL_EMPTY) {
+        map->growth_left--;
+    }
+    map->control[slot] = (uint8_t)(hash & 0x7f);
+    size_t index = map->entry_count++;
+    slot_entries(map)[slot] = (uint32_t)index;
+    MapEntry *entry = &map->entries[index];
+    entry->key = key;
+    entry->value = item;
+    entry->hash = hash;
+    map->count++;
+    map_write_barrier(map, index, key);
+    map_write_barrier(map, index, item);
+    return 1;
+}
+
+// number keys are stored in their canonical form, so 1.0 comes back as 1
+static Value stored_key(Value key) {
+    if (value_is_string(key)) {
+        return key;
+    }
+    double number = value_to_number(key);
+    return value_from_number(number == 0.0 ? 0.0 : number);
+}
+
+int map_set(Value value, Value key, Value item) {
+    MapObject *map = value_as_map(value);
+    uint64_t hash = key_hash(key);
+    long slot = find_slot(map, key, hash);
+    if (slot >= 0) {
+        uint32_t index = slot_entries(map)[slot];
+        heap_overwrite_barrier(&map->header, map->entries[index].value);
+        heap_lock_object(&map->header);
+        map->entries[index].value = item;
+        heap_unlock_object(&map->header);
+        map_write_barrier(map, index, item);
+        return 1;
+    }
+
+    heap_lock_object(&map->header);
+    int ok = insert(map, stored_key(key), hash, item);
+    heap_unlock_object(&map->header);
+    return ok;
+}
+
+int map_add(Value value, Value key, double amount, Value *total) {
+    MapObject *map = value_as_map(value);
+    uint64_t hash = key_hash(key);
+    long slot = find_slot(map, key, hash);
+    if (slot >= 0) {
+        MapEntry *entry = &map->entries[slot_entries(map)[slot]];
+        if (!value_is_number(entry->value)) {
+            return -1;
+        }
+        // a number replaces a number, so only the lock is needed
+        *total = value_from_number(value_to_number(entry->value) + amount);
+        heap_lock_object(&map->header);
+        entry->value = *total;
+        heap_unlock_object(&map->header);
+        return 1;
+    }
+
+    *total = value_from_number(amount);
+    heap_lock_object(&map->header);
+    int ok = insert(map, stored_key(key), hash, *total);
+    heap_unlock_object(&map->header);
+    return ok;
+}
+
+int map_delete(Value value, Value key) {
+    MapObject *map = value_as_map(value);
+    long slot = find_slot(map, key, key_hash(key));
+    if (slot < 0) {
+        return 0;
+    }
+    MapEntry *entry = &map->entries[slot_entries(map)[slot]];
+    heap_overwrite_barrier(&map->header, entry->key);
+    heap_overwrite_barrier(&map->header, entry->value);
+    heap_lock_object(&map->header);
+    entry->key = VALUE_NULL;
+    entry->value = VALUE_NULL;
+    heap_unlock_object(&map->header);
+
+    // probes only continue past a group with no empty slot, so in a group
+    // that has one the slot can go back to empty
+    uint8_t *group = map->control + (size_t)slot / MAP_GROUP_WIDTH * MAP_GROUP_WIDTH;
+    if (group_match(group, CONTROL_EMPTY)) {
+        map->control[slot] = CONTROL_EMPTY;
+        map->growth_left++;
+    } else {
+        map->control[slot] = CONTROL_DELETED;
+    }
+    map->count--;
+    return 1;
+}
+
+void map_release(MapObject *map) {
+    free(map->control);
+    free(map->entries);
+}
@@ -0,0 +1,744 @@
+/*
+ * optimizer.c - static optimizations over the shardjs ast
+ *
+ * propagates constants through let declarations and if/else branches,
+ * folds constant expressions and removes branches that can never run,
+ * then runs a table-driven peephole pass over the result. runs once
+ * between parsing and interpretation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/runtime.h"
+
+// what we know about a variable at a given point in the program.
+// variables missing from the table are definitely undefined there.
+typedef struct {
+    char *name;
+    int varying;     // 1 if the value differs between paths or is not constant
+    double value;    // only meaningful when varying == 0
+} ConstEntry;
+
+typedef struct {
+    ConstEntry *entries;
+    int count;
+    int capacity;
+} ConstTable;
+
+// optimizer state for one run
+typedef struct {
+    Environment *scratch;   // empty environment used to fold constant expressions
+} Optimizer;
+
+static void table_init(ConstTable *table) {
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+static void table_free(ConstTable *table) {
+    for (int i = 0; i < table->count; i++) {
+        free(table->entries[i].name);
+    }
+    free(table->entries);
+    table_init(table);
+}
+
+static ConstEntry* table_find(ConstTable *table, const char *name) {
+    for (int i = 0; i < table->count; i++) {
+        if (strcmp(table->entries[i].name, name) == 0) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// record a variable's state, adding it if needed - returns 0 on oom
+static int table_set(ConstTable *table, const char *name, int varying, double value) {
+    ConstEntry *entry = table_find(table, name);
+    if (!entry) {
+        if (table->count >= table->capacity) {
+            int new_capacity = table->capacity == 0 ? 8 : table->capacity * 2;
+            ConstEntry *new_entries = realloc(table->entries, new_capacity * sizeof(ConstEntry));
+            if (!new_entries) {
+                return 0;
+            }
+            table->entries = new_entries;
+            table->capacity = new_capacity;
+        }
+
+        char *name_copy = strdup(name);
+        if (!name_copy) {
+            return 0;
+        }
+        entry = &table->entries[table->count++];
+        entry->name = name_copy;
+    }
+
+    entry->varying = varying;
+    entry->value = value;
+    return 1;
+}
+
+static int table_copy(ConstTable *dest, ConstTable *src) {
+    table_init(dest);
+    for (int i = 0; i < src->count; i++) {
+        if (!table_set(dest, src->entries[i].name, src->entries[i].varying, src->entries[i].value)) {
+            table_free(dest);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// two doubles are the same constant only if they are bitwise equal,
+// so 0 and -0 (or two different nans) never merge
+static int same_constant(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// merge the state after an if branch and an else branch into dest.
+// a variable that is undefined on one path is not safe to fold either,
+// since reading it must still raise "Undefined variable".
+static int table_meet(ConstTable *dest, ConstTable *a, ConstTable *b) {
+    ConstTable result;
+    table_init(&result);
+
+    for (int i = 0; i < a->count; i++) {
+        ConstEntry *left = &a->entries[i];
+        ConstEntry *right = table_find(b, left->name);
+        int varying = !right || left->varying || right->varying ||
+                      !same_constant(left->value, right->value);
+        if (!table_set(&result, left->name, varying, left->value)) {
+            table_free(&result);
+            return 0;
+        }
+    }
+
+    // anything only the second path defines is maybe-undefined
+    for (int i = 0; i < b->count; i++) {
+        if (!table_find(a, b->entries[i].name)) {
+            if (!table_set(&result, b->entries[i].name, 1, 0.0)) {
+                table_free(&result);
+                return 0;
+            }
+        }
+    }
+
+    table_free(dest);
+    *dest = result;
+    return 1;
+}
+
+// if the table knows this variable is constant, give back its value
+static int lookup_constant(ConstTable *table, const char *name, double *value) {
+    ConstEntry *entry = table_find(table, name);
+    if (!entry || entry->varying) {
+        return 0;
+    }
+    *value = entry->value;
+    return 1;
+}
+
+// give a binary node new operands. the parser shares identical subtrees
+// and the same subtree may rewrite differently at each use, so children
+// are always transformed on the caller's own references and shared
+// nodes are copied rather than edited. consumes expr, left and right.
+static ASTNode* with_operands(ASTNode *expr, ASTNode *left, ASTNode *right) {
+    if (left == expr->data.binary.left && right == expr->data.binary.right) {
+        ast_destroy(left);
+        ast_destroy(right);
+        return expr;
+    }
+
+    if (expr->refcount == 1) {
+        ast_destroy(expr->data.binary.left);
+        ast_destroy(expr->data.binary.right);
+        expr->data.binary.left = left;
+        expr->data.binary.right = right;
+        return expr;
+    }
+
+    ASTNode *copy = ast_create_binary_op(left, expr->data.binary.operator, right);
+    if (!copy) {
+        ast_destroy(left);
+        ast_destroy(right);
+        return expr;
+    }
+    ast_destroy(expr);
+    return copy;
+}
+
+// replace an expression whose operands are all numbers by its value.
+// it is evaluated with the interpreter itself so folding can never
+// disagree with runtime semantics. errors like division by zero are
+// left in place to be reported when the code runs.
+static ASTNode* fold_constant(Optimizer *opt, ASTNode *expr) {
+    Value value = interpret_value(expr, opt->scratch);
+    if (interpreter_has_error()) {
+        interpreter_clear_error();
+        return expr;
+    }
+    if (!value_is_number(value)) {
+        return expr;
+    }
+
+    ASTNode *number = ast_create_number(value_as_number(value));
+    if (!number) {
+        return expr;
+    }
+    ast_destroy(expr);
+    return number;
+}
+
+// fold an expression using known constants. takes ownership of expr
+// and returns the expression to use in its place.
+static ASTNode* fold_expression(Optimizer *opt, ASTNode *expr, ConstTable *table) {
+    if (!expr) {
+        return NULL;
+    }
+
+    switch (expr->type) {
+        case AST_IDENTIFIER: {
+            double value;
+            if (!lookup_constant(table, expr->data.identifier, &value)) {
+                return expr;
+            }
+            ASTNode *number = ast_create_number(value);
+            if (!number) {
+                return expr; // keep the lookup, still correct
+            }
+            ast_destroy(expr);
+            return number;
+        }
+
+        case AST_BINARY_OP: {
+            ASTNode *left = fold_expression(opt, ast_retain(expr->data.binary.left), table);
+            ASTNode *right = fold_expression(opt, ast_retain(expr->data.binary.right), table);
+            expr = with_operands(expr, left, right);
+
+            if (expr->data.binary.left->type != AST_NUMBER ||
+                expr->data.binary.right->type != AST_NUMBER) {
+                return expr;
+            }
+
+            return fold_constant(opt, expr);
+        }
+
+        // sqrt(16) or pow(2, 10). intrinsics are never shared either.
+        case AST_INTRINSIC: {
+            int constant = 1;
+            for (int i = 0; i < expr->data.intrinsic.count; i++) {
+                expr->data.intrinsic.args[i] = fold_expression(opt, expr->data.intrinsic.args[i], table);
+                constant = constant && expr->data.intrinsic.args[i]->type == AST_NUMBER;
+            }
+            return constant ? fold_constant(opt, expr) : expr;
+        }
+
+        // calls and element accesses are never shared, so their operands
+        // are folded in place
+        case AST_CALL:
+            for (int i = 0; i < expr->data.call.count; i++) {
+                expr->data.call.args[i] = fold_expression(opt, expr->data.call.args[i], table);
+            }
+            return expr;
+
+        case AST_ARRAY:
+            for (int i = 0; i < expr->data.array.count; i++) {
+                expr->data.array.elements[i] = fold_expression(opt, expr->data.array.elements[i], table);
+            }
+            return expr;
+
+        case AST_INDEX:
+        case AST_INDEX_ASSIGN:
+            expr->data.index.object = fold_expression(opt, expr->data.index.object, table);
+            expr->data.index.index = fold_expression(opt, expr->data.index.index, table);
+            expr->data.index.value = fold_expression(opt, expr->data.index.value, table);
+            return expr;
+
+        case AST_OBJECT:
+            for (int i = 0; i < expr->data.object.count; i++) {
+                expr->data.object.values[i] = fold_expression(opt, expr->data.object.values[i], table);
+            }
+            return expr;
+
+        // property reads are shared along with their inline cache, and
+        // an object is never a constant, so they are left as they are
+        case AST_PROPERTY_ASSIGN:
+            expr->data.property.value = fold_expression(opt, expr->data.property.value, table);
+            return expr;
+
+        default:
+            return expr;
+    }
+}
+
+static ASTNode* optimize_statement(Optimizer *opt, ASTNode *stmt, ConstTable *table);
+
+// optimize a branch of an if statement against its own copy of the table.
+// a branch that disappears becomes an empty program so the if stays valid.
+static ASTNode* optimize_branch(Optimizer *opt, ASTNode *branch, ConstTable *table) {
+    ASTNode *result = optimize_statement(opt, branch, table);
+    if (!result) {
+        result = ast_create_program();
+    }
+    return result;
+}
+
+static int is_empty_statement(ASTNode *stmt) {
+    return !stmt || (stmt->type == AST_PROGRAM && stmt->data.program.count == 0);
+}
+
+// optimize an if statement - constant conditions select one branch
+// outright, anything else is optimized on both paths and merged
+static ASTNode* optimize_if(Optimizer *opt, ASTNode *stmt, ConstTable *table) {
+    ASTNode *condition = fold_expression(opt, stmt->data.if_stmt.condition, table);
+    stmt->data.if_stmt.condition = condition;
+
+    if (condition->type == AST_NUMBER) {
+        ASTNode *live;
+        if (condition->data.number != 0.0) {
+            live = stmt->data.if_stmt.if_branch;
+            stmt->data.if_stmt.if_branch = NULL;
+        } else {
+            live = stmt->data.if_stmt.else_branch;
+            stmt->data.if_stmt.else_branch = NULL;
+        }
+
+        // the dead branch goes away with the if node itself
+        ast_destroy(stmt);
+        return optimize_statement(opt, live, table);
+    }
+
+    ConstTable else_table;
+    if (!table_copy(&else_table, table)) {
+        return stmt;
+    }
+
+    stmt->data.if_stmt.if_branch = optimize_branch(opt, stmt->data.if_stmt.if_branch, table);
+    if (stmt->data.if_stmt.else_branch) {
+        stmt->data.if_stmt.else_branch = optimize_branch(opt, stmt->data.if_stmt.else_branch, &else_table);
+    }
+
+    if (!table_meet(table, table, &else_table)) {
+        // can't merge - forget everything rather than keep wrong facts
+        table_free(table);
+        table_free(&else_table);
+        return stmt;
+    }
+    table_free(&else_table);
+    return stmt;
+}
+
+// optimize one statement. takes ownership of stmt and returns its
+// replacement, or NULL if the statement can be dropped entirely.
+static ASTNode* optimize_statement(Optimizer *opt, ASTNode *stmt, ConstTable *table) {
+    if (!stmt) {
+        return NULL;
+    }
+
+    switch (stmt->type) {
+        case AST_LET_DECL: {
+            ASTNode *value = fold_expression(opt, stmt->data.let_decl.value, table);
+            stmt->data.let_decl.value = value;
+
+            int ok;
+            if (value->type == AST_NUMBER) {
+                ok = table_set(table, stmt->data.let_decl.name, 0, value->data.number);
+            } else {
+                ok = table_set(table, stmt->data.let_decl.name, 1, 0.0);
+            }
+            if (!ok) {
+                // out of memory - stop trusting the table from here on
+                table_free(table);
+            }
+            return stmt;
+        }
+
+        case AST_PRINT_CALL:
+            stmt->data.print_arg = fold_expression(opt, stmt->data.print_arg, table);
+            return stmt;
+
+        case AST_IF_STMT:
+            return optimize_if(opt, stmt, table);
+
+        case AST_PROGRAM: {
+            int kept = 0;
+            for (int i = 0; i < stmt->data.program.count; i++) {
+                ASTNode *result = optimize_statement(opt, stmt->data.program.statements[i], table);
+                if (result) {
+                    stmt->data.program.statements[kept++] = result;
+                }
+            }
+            stmt->data.program.count = kept;
+
+            // a nested block left empty can go entirely
+            if (kept == 0) {
+                ast_destroy(stmt);
+                return NULL;
+            }
+            return stmt;
+        }
+
+        default:
+            return fold_expression(opt, stmt, table);
+    }
+}
+
+// peephole rules. each rule looks at one node and either leaves it alone,
+// replaces it, or (for statements) deletes it by returning NULL. rewrites
+// take ownership of the node and report how many nodes they took off the
+// executed path - zero means the rule did not match. adding a rule is
+// one row in peephole_rules below.
+typedef enum {
+    PEEP_EXPRESSION,   // applies wherever the node is evaluated
+    PEEP_STATEMENT     // applies only where the node is a statement
+} PeepholeContext;
+
+typedef enum {
+    SIDE_NONE,
+    SIDE_LEFT,
+    SIDE_RIGHT
+} PeepholeSide;
+
+typedef struct PeepholeRule PeepholeRule;
+typedef ASTNode* (*PeepholeRewrite)(const PeepholeRule *rule, ASTNode *node, size_t *removed);
+
+struct PeepholeRule {
+    const char *name;
+    PeepholeContext context;
+    ASTNodeType type;        // node type the rule looks at
+    char operator;           // binary operator to match
+    PeepholeSide side;       // operand that must be the constant
+    double constant;         // matched bitwise, so -0 is distinct from 0
+    PeepholeRewrite rewrite;
+};
+
+static int is_constant(ASTNode *node, double value) {
+    return node->type == AST_NUMBER && same_constant(node->data.number, value);
+}
+
+static int is_comparison(ASTNode *node) {
+    if (node->type != AST_BINARY_OP) {
+        return 0;
+    }
+    switch (node->data.binary.operator) {
+        case '>': case '<': case 'G': case 'L': case 'E': case 'N':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// whether an expression can only produce a number. a variable may hold
+// a string, and "s" + -0 or "s" * 1 do something other than give back
+// "s", so identities only apply to operands known to be numeric.
+static int is_numeric(ASTNode *node) {
+    switch (node->type) {
+        case AST_NUMBER:
+            return 1;
+        case AST_BINARY_OP:
+            if (node->data.binary.operator == '+') {
+                return is_numeric(node->data.binary.left) && is_numeric(node->data.binary.right);
+            }
+            return 1;  // everything else yields a number or fails
+        case AST_INTRINSIC:
+            // a number from numbers, an array from any array
+            for (int i = 0; i < node->data.intrinsic.count; i++) {
+                if (!is_numeric(node->data.intrinsic.args[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// x op c -> x when c is an exact identity of op for every double,
+// including nan, infinities and -0
+static ASTNode* rewrite_identity(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    if (node->data.binary.operator != rule->operator) {
+        return node;
+    }
+
+    ASTNode *constant = rule->side == SIDE_RIGHT ? node->data.binary.right : node->data.binary.left;
+    ASTNode *kept = rule->side == SIDE_RIGHT ? node->data.binary.left : node->data.binary.right;
+    if (!is_constant(constant, rule->constant) || !is_numeric(kept)) {
+        return node;
+    }
+
+    ast_retain(kept);
+    ast_destroy(node);
+    *removed = 2;
+    return kept;
+}
+
+// (a < b) != 0 -> a < b, since comparisons already yield exactly 0 or 1
+static ASTNode* rewrite_boolean_identity(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    ASTNode *operand = rule->side == SIDE_RIGHT ? node->data.binary.left : node->data.binary.right;
+    if (!is_comparison(operand)) {
+        return node;
+    }
+    return rewrite_identity(rule, node, removed);
+}
+
+// if (c) if (c) s -> if (c) s, and if (c) a else if (c) b else d ->
+// if (c) a else d. hash-consing makes identical conditions the same
+// node, and nothing runs between the two tests, so the inner outcome
+// is already known - the inner test is a jump to a jump.
+static ASTNode* rewrite_redundant_test(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    (void)rule;
+    ASTNode *condition = node->data.if_stmt.condition;
+
+    ASTNode *then_branch = node->data.if_stmt.if_branch;
+    if (then_branch->type == AST_IF_STMT && then_branch->data.if_stmt.condition == condition) {
+        node->data.if_stmt.if_branch = then_branch->data.if_stmt.if_branch;
+        then_branch->data.if_stmt.if_branch = NULL;
+        ast_destroy(then_branch);
+        *removed = 2;
+        return node;
+    }
+
+    ASTNode *else_branch = node->data.if_stmt.else_branch;
+    if (else_branch && else_branch->type == AST_IF_STMT && else_branch->data.if_stmt.condition == condition) {
+        node->data.if_stmt.else_branch = else_branch->data.if_stmt.else_branch;
+        else_branch->data.if_stmt.else_branch = NULL;
+        ast_destroy(else_branch);
+        *removed = 2;
+        return node;
+    }
+
+    return node;
+}
+
+// if (c) s else {} -> if (c) s
+static ASTNode* rewrite_empty_else(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    (void)rule;
+    ASTNode *else_branch = node->data.if_stmt.else_branch;
+    if (!else_branch || !is_empty_statement(else_branch)) {
+        return node;
+    }
+    ast_destroy(else_branch);
+    node->data.if_stmt.else_branch = NULL;
+    *removed = 1;
+    return node;
+}
+
+// if (c) {} -> c. nothing runs on either path, only the condition is
+// kept for the errors it might raise.
+static ASTNode* rewrite_empty_if(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    (void)rule;
+    if (!is_empty_statement(node->data.if_stmt.if_branch) ||
+        !is_empty_statement(node->data.if_stmt.else_branch)) {
+        return node;
+    }
+    ASTNode *condition = node->data.if_stmt.condition;
+    node->data.if_stmt.condition = NULL;
+    ast_destroy(node);
+    *removed = 1;
+    return condition;
+}
+
+// let x = x; stores back the value it just loaded. the load stays,
+// since it still has to fail when x is undefined.
+static ASTNode* rewrite_self_store(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    (void)rule;
+    ASTNode *value = node->data.let_decl.value;
+    if (value->type != AST_IDENTIFIER || strcmp(value->data.identifier, node->data.let_decl.name) != 0) {
+        return node;
+    }
+    node->data.let_decl.value = NULL;
+    ast_destroy(node);
+    *removed = 1;
+    return value;
+}
+
+// a constant used as a statement computes nothing anyone can see
+static ASTNode* rewrite_unused_constant(const PeepholeRule *rule, ASTNode *node, size_t *removed) {
+    (void)rule;
+    ast_destroy(node);
+    *removed = 1;
+    return NULL;
+}
+
+static const PeepholeRule peephole_rules[] = {
+    { "mul-by-one",        PEEP_EXPRESSION, AST_BINARY_OP, '*', SIDE_RIGHT, 1.0,  rewrite_identity },
+    { "one-times",         PEEP_EXPRESSION, AST_BINARY_OP, '*', SIDE_LEFT,  1.0,  rewrite_identity },
+    { "div-by-one",        PEEP_EXPRESSION, AST_BINARY_OP, '/', SIDE_RIGHT, 1.0,  rewrite_identity },
+    { "sub-zero",          PEEP_EXPRESSION, AST_BINARY_OP, '-', SIDE_RIGHT, 0.0,  rewrite_identity },
+    { "add-negative-zero", PEEP_EXPRESSION, AST_BINARY_OP, '+', SIDE_RIGHT, -0.0, rewrite_identity },
+    { "negative-zero-add", PEEP_EXPRESSION, AST_BINARY_OP, '+', SIDE_LEFT,  -0.0, rewrite_identity },
+    { "test-ne-zero",      PEEP_EXPRESSION, AST_BINARY_OP, 'N', SIDE_RIGHT, 0.0,  rewrite_boolean_identity },
+    { "test-eq-one",       PEEP_EXPRESSION, AST_BINARY_OP, 'E', SIDE_RIGHT, 1.0,  rewrite_boolean_identity },
+    { "redundant-test",    PEEP_STATEMENT,  AST_IF_STMT,   0,   SIDE_NONE,  0.0,  rewrite_redundant_test },
+    { "empty-else",        PEEP_STATEMENT,  AST_IF_STMT,   0,   SIDE_NONE,  0.0,  rewrite_empty_else },
+    { "empty-if",          PEEP_STATEMENT,  AST_IF_STMT,   0,   SIDE_NONE,  0.0,  rewrite_empty_if },
+    { "self-store",        PEEP_STATEMENT,  AST_LET_DECL,  0,   SIDE_NONE,  0.0,  rewrite_self_store },
+    { "unused-constant",   PEEP_STATEMENT,  AST_NUMBER,    0,   SIDE_NONE,  0.0,  rewrite_unused_constant },
+};
+
+#define PEEPHOLE_RULE_COUNT (sizeof(peephole_rules) / sizeof(peephole_rules[0]))
+
+// per-rule counters, accumulated over every optimizer run on this thread
+static __thread size_t peephole_hits[PEEPHOLE_RULE_COUNT];
+static __thread size_t peephole_removed[PEEPHOLE_RULE_COUNT];
+
+// apply matching rules to one node until none of them fire
+static ASTNode* apply_rules(ASTNode *node, PeepholeContext context) {
+    int changed = 1;
+    while (node && changed) {
+        changed = 0;
+        for (size_t i = 0; i < PEEPHOLE_RULE_COUNT; i++) {
+            const PeepholeRule *rule = &peephole_rules[i];
+            if (rule->context != context || rule->type != node->type) {
+                continue;
+            }
+
+            size_t removed = 0;
+            ASTNode *result = rule->rewrite(rule, node, &removed);
+            if (removed == 0) {
+                continue;
+            }
+
+            peephole_hits[i]++;
+            peephole_removed[i] += removed;
+            node = result;
+            changed = 1;
+            break;
+        }
+    }
+    return node;
+}
+
+static ASTNode* peephole_expression(ASTNode *expr) {
+    if (expr->type == AST_BINARY_OP) {
+        ASTNode *left = peephole_expression(ast_retain(expr->data.binary.left));
+        ASTNode *right = peephole_expression(ast_retain(expr->data.binary.right));
+        expr = with_operands(expr, left, right);
+    } else if (expr->type == AST_CALL) {
+        for (int i = 0; i < expr->data.call.count; i++) {
+            expr->data.call.args[i] = peephole_expression(expr->data.call.args[i]);
+        }
+    } else if (expr->type == AST_INTRINSIC) {
+        for (int i = 0; i < expr->data.intrinsic.count; i++) {
+            expr->data.intrinsic.args[i] = peephole_expression(expr->data.intrinsic.args[i]);
+        }
+    } else if (expr->type == AST_ARRAY) {
+        for (int i = 0; i < expr->data.array.count; i++) {
+            expr->data.array.elements[i] = peephole_expression(expr->data.array.elements[i]);
+        }
+    } else if (expr->type == AST_INDEX || expr->type == AST_INDEX_ASSIGN) {
+        expr->data.index.object = peephole_expression(expr->data.index.object);
+        expr->data.index.index = peephole_expression(expr->data.index.index);
+        if (expr->data.index.value) {
+            expr->data.index.value = peephole_expression(expr->data.index.value);
+        }
+    } else if (expr->type == AST_OBJECT) {
+        for (int i = 0; i < expr->data.object.count; i++) {
+            expr->data.object.values[i] = peephole_expression(expr->data.object.values[i]);
+        }
+    } else if (expr->type == AST_PROPERTY_ASSIGN) {
+        expr->data.property.value = peephole_expression(expr->data.property.value);
+    }
+    return apply_rules(expr, PEEP_EXPRESSION);
+}
+
+static ASTNode* peephole_statement(ASTNode *stmt);
+
+static ASTNode* peephole_branch(ASTNode *branch) {
+    ASTNode *result = peephole_statement(branch);
+    if (!result) {
+        result = ast_create_program();
+    }
+    return result;
+}
+
+// run the peephole rules bottom-up over one statement. takes ownership
+// and returns the replacement, or NULL if the statement went away.
+static ASTNode* peephole_statement(ASTNode *stmt) {
+    if (!stmt) {
+        return NULL;
+    }
+
+    switch (stmt->type) {
+        case AST_LET_DECL:
+            stmt->data.let_decl.value = peephole_expression(stmt->data.let_decl.value);
+            break;
+
+        case AST_PRINT_CALL:
+            stmt->data.print_arg = peephole_expression(stmt->data.print_arg);
+            break;
+
+        case AST_IF_STMT:
+            stmt->data.if_stmt.condition = peephole_expression(stmt->data.if_stmt.condition);
+            stmt->data.if_stmt.if_branch = peephole_branch(stmt->data.if_stmt.if_branch);
+            if (stmt->data.if_stmt.else_branch) {
+                stmt->data.if_stmt.else_branch = peephole_branch(stmt->data.if_stmt.else_branch);
+            }
+            break;
+
+        case AST_PROGRAM: {
+            int kept = 0;
+            for (int i = 0; i < stmt->data.program.count; i++) {
+                ASTNode *result = peephole_statement(stmt->data.program.statements[i]);
+                if (result) {
+                    stmt->data.program.statements[kept++] = result;
+                }
+            }
+            stmt->data.program.count = kept;
+            return stmt;
+        }
+
+        default:
+            stmt = peephole_expression(stmt);
+            break;
+    }
+
+    return apply_rules(stmt, PEEP_STATEMENT);
+}
+
+// copy out the peephole counters - returns how many rules there are
+int optimizer_get_peephole_stats(PeepholeStats *stats, int max) {
+    int count = (int)PEEPHOLE_RULE_COUNT;
+    for (int i = 0; i < count && i < max; i++) {
+        stats[i].name = peephole_rules[i].name;
+        stats[i].hits = peephole_hits[i];
+        stats[i].nodes_removed = peephole_removed[i];
+    }
+    return count;
+}
+
+// run all optimizations over a parsed program in place
+int optimizer_run(ASTNode *program) {
+    if (!program || program->type != AST_PROGRAM) {
+        return 0;
+    }
+
+    Optimizer opt;
+    opt.scratch = env_create();
+    if (!opt.scratch) {
+        return 0;
+    }
+
+    ConstTable table;
+    table_init(&table);
+
+    int kept = 0;
+    for (int i = 0; i < program->data.program.count; i++) {
+        ASTNode *result = optimize_statement(&opt, program->data.program.statements[i], &table);
+        if (result) {
+            program->data.program.statements[kept++] = result;
+        }
+    }
+    program->data.program.count = kept;
+
+    // clean up what constant propagation left behind
+    peephole_statement(program);
+
+    table_free(&table);
+    env_destroy(opt.scratch);
+    return 1;
+}
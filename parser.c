@@ -3,6 +3,7 @@
  * 
  * converts tokens into an abstract syntax tree.
  * handles expressions, statements, and basic error recovery.
+ * expression nodes are hash-consed so repeated subtrees share memory.
  */
 
 #define _GNU_SOURCE
@@ -17,6 +18,7 @@ struct Parser {
     Lexer *lexer;
     Token current_token;
     Token lookahead_token;
+    ASTConsTable *cons;   // shares identical expression subtrees
     int has_error;
     char error_message[256];
 };
@@ -32,6 +34,9 @@ static ASTNode* parse_expression(Parser *parser);
 static ASTNode* parse_comparison(Parser *parser);
 static ASTNode* parse_term(Parser *parser);
 static ASTNode* parse_factor(Parser *parser);
+static ASTNode* parse_primary(Parser *parser);
+static ASTNode* parse_call(Parser *parser);
+static ASTNode* parse_array(Parser *parser);
 static ASTNode* parse_statement(Parser *parser);
 static ASTNode* parse_let_declaration(Parser *parser);
 static ASTNode* parse_print_call(Parser *parser);
@@ -49,6 +54,11 @@ Parser* parser_create(Lexer *lexer) {
     }
     
     parser->lexer = lexer;
+    parser->cons = ast_cons_table_create();
+    if (!parser->cons) {
+        free(parser);
+        return NULL;
+    }
     parser->has_error = 0;
     parser->error_message[0] = '\0';
     
@@ -66,6 +76,7 @@ void parser_destroy(Parser *parser) {
     
     token_free(&parser->current_token);
     token_free(&parser->lookahead_token);
+    ast_cons_table_destroy(parser->cons);
     
     free(parser);
 }
@@ -133,6 +144,11 @@ const char* parser_get_error(Parser *parser) {
     return parser->has_error ? parser->error_message : "No error";
 }
 
+// how much expression sharing the parse achieved
+ASTConsStats parser_get_cons_stats(Parser *parser) {
+    return ast_cons_table_stats(parser ? parser->cons : NULL);
+}
+
 // parse comparison operators (>, <, >=, <=, ==, !=) - lowest precedence
 static ASTNode* parse_expression(Parser *parser) {
     if (!parser || parser->has_error) {
@@ -188,7 +204,7 @@ static ASTNode* parse_expression(Parser *parser) {
             return NULL;
         }
         
-        left = ast_create_binary_op(left, operator, right);
+        left = ast_cons_binary_op(parser->cons, left, operator, right);
         if (!left) {
             parser_error(parser, "Failed to create comparison operation node");
             return NULL;
@@ -219,7 +235,7 @@ static ASTNode* parse_comparison(Parser *parser) {
             return NULL;
         }
         
-        left = ast_create_binary_op(left, operator, right);
+        left = ast_cons_binary_op(parser->cons, left, operator, right);
         if (!left) {
             parser_error(parser, "Failed to create binary operation node");
             return NULL;
@@ -250,7 +266,7 @@ static ASTNode* parse_term(Parser *parser) {
             return NULL;
         }
         
-        left = ast_create_binary_op(left, operator, right);
+        left = ast_cons_binary_op(parser->cons, left, operator, right);
         if (!left) {
             parser_error(parser, "Failed to create binary operation node");
             return NULL;
@@ -260,8 +276,258 @@ static ASTNode* parse_term(Parser *parser) {
     return left;
 }
 
-// parse numbers, identifiers, and (expr)
+// parse a primary followed by any number of [index] and .name suffixes
 static ASTNode* parse_factor(Parser *parser) {
+    ASTNode *node = parse_primary(parser);
+    if (!node || parser->has_error) {
+        return node;
+    }
+    
+    while (parser_match(parser, TOKEN_LBRACKET) || parser_match(parser, TOKEN_DOT)) {
+        if (parser_match(parser, TOKEN_DOT)) {
+            parser_advance(parser); // consume '.'
+            if (!parser_match(parser, TOKEN_IDENTIFIER)) {
+                ast_destroy(node);
+                parser_error(parser, "Expected property name after '.'");
+                return NULL;
+            }
+            
+            ASTNode *property = ast_cons_property(parser->cons, node, parser->current_token.text);
+            if (!property) {
+                ast_destroy(node);
+                parser_error(parser, "Failed to create property node");
+                return NULL;
+            }
+            parser_advance(parser); // consume name
+            node = property;
+            continue;
+        }
+        
+        parser_advance(parser); // consume '['
+        
+        ASTNode *index = parse_expression(parser);
+        if (!index || parser->has_error) {
+            ast_destroy(node);
+            return NULL;
+        }
+        
+        if (!parser_consume(parser, TOKEN_RBRACKET, "Expected ']' after index")) {
+            ast_destroy(index);
+            ast_destroy(node);
+            return NULL;
+        }
+        
+        ASTNode *indexed = ast_create_index(node, index);
+        if (!indexed) {
+            ast_destroy(index);
+            ast_destroy(node);
+            parser_error(parser, "Failed to create index node");
+            return NULL;
+        }
+        node = indexed;
+    }
+    
+    return node;
+}
+
+// a math intrinsic in place of a call, its argument count checked here
+// since the name can't mean anything else
+static ASTNode* parse_intrinsic(Parser *parser, const Intrinsic *intrinsic, ASTNode **args, int count) {
+    if (count != intrinsic->args) {
+        char message[128];
+        snprintf(message, sizeof(message), "%s expects %d argument%s, got %d",
+                 intrinsic->name, intrinsic->args, intrinsic->args == 1 ? "" : "s", count);
+        parser_error(parser, message);
+        return NULL;
+    }
+    ASTNode *node = ast_create_intrinsic(intrinsic, args, count);
+    if (!node) {
+        parser_error(parser, "Failed to create intrinsic node");
+    }
+    return node;
+}
+
+// parse name(arg, ...) - calls are not shared since they have effects,
+// and neither are intrinsics, which the optimizer rewrites in place
+static ASTNode* parse_call(Parser *parser) {
+    char *name = strdup(parser->current_token.text);
+    if (!name) {
+        parser_error(parser, "Memory allocation failed for function name");
+        return NULL;
+    }
+    parser_advance(parser); // consume name
+    parser_advance(parser); // consume '('
+    
+    ASTNode *args[CALL_MAX_ARGS];
+    int count = 0;
+    if (!parser_match(parser, TOKEN_RPAREN)) {
+        do {
+            if (count > 0) {
+                parser_advance(parser); // consume ','
+            }
+            if (count == CALL_MAX_ARGS) {
+                parser_error(parser, "Too many arguments in call");
+                break;
+            }
+            ASTNode *arg = parse_expression(parser);
+            if (!arg || parser->has_error) {
+                break;
+            }
+            args[count++] = arg;
+        } while (parser_match(parser, TOKEN_COMMA));
+    }
+    
+    if (parser->has_error || !parser_consume(parser, TOKEN_RPAREN, "Expected ')' after arguments")) {
+        for (int i = 0; i < count; i++) {
+            ast_destroy(args[i]);
+        }
+        free(name);
+        return NULL;
+    }
+    
+    const Intrinsic *intrinsic = intrinsic_lookup(name);
+    ASTNode *call = intrinsic ? parse_intrinsic(parser, intrinsic, args, count) : ast_create_call(name, args, count);
+    free(name);
+    if (!call) {
+        for (int i = 0; i < count; i++) {
+            ast_destroy(args[i]);
+        }
+        if (!parser->has_error) {
+            parser_error(parser, "Failed to create call node");
+        }
+        return NULL;
+    }
+    return call;
+}
+
+// parse [a, b, ...] - each evaluation builds a new array, so never shared
+static ASTNode* parse_array(Parser *parser) {
+    parser_advance(parser); // consume '['
+    
+    ASTNode **elements = NULL;
+    int count = 0;
+    int capacity = 0;
+    if (!parser_match(parser, TOKEN_RBRACKET)) {
+        do {
+            if (count > 0) {
+                parser_advance(parser); // consume ','
+            }
+            ASTNode *element = parse_expression(parser);
+            if (!element || parser->has_error) {
+                break;
+            }
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 4;
+                ASTNode **grown = realloc(elements, capacity * sizeof(ASTNode*));
+                if (!grown) {
+                    ast_destroy(element);
+                    parser_error(parser, "Memory allocation failed for array literal");
+                    break;
+                }
+                elements = grown;
+            }
+            elements[count++] = element;
+        } while (parser_match(parser, TOKEN_COMMA));
+    }
+    
+    if (parser->has_error || !parser_consume(parser, TOKEN_RBRACKET, "Expected ']' after array elements")) {
+        for (int i = 0; i < count; i++) {
+            ast_destroy(elements[i]);
+        }
+        free(elements);
+        return NULL;
+    }
+    
+    ASTNode *array = ast_create_array(elements, count);
+    if (!array) {
+        for (int i = 0; i < count; i++) {
+            ast_destroy(elements[i]);
+        }
+        free(elements);
+        parser_error(parser, "Failed to create array node");
+        return NULL;
+    }
+    return array;
+}
+
+static void free_object_parts(char **keys, ASTNode **values, int count) {
+    for (int i = 0; i < count; i++) {
+        free(keys[i]);
+        ast_destroy(values[i]);
+    }
+    free(keys);
+    free(values);
+}
+
+// parse {name: value, "name": value, ...} - like arrays, never shared
+static ASTNode* parse_object(Parser *parser) {
+    parser_advance(parser); // consume '{'
+    
+    char **keys = NULL;
+    ASTNode **values = NULL;
+    int count = 0;
+    int capacity = 0;
+    if (!parser_match(parser, TOKEN_RBRACE)) {
+        do {
+            if (count > 0) {
+                parser_advance(parser); // consume ','
+            }
+            if (!parser_match(parser, TOKEN_IDENTIFIER) && !parser_match(parser, TOKEN_STRING)) {
+                parser_error(parser, "Expected property name in object literal");
+                break;
+            }
+            char *key = strdup(parser->current_token.text);
+            if (!key) {
+                parser_error(parser, "Memory allocation failed for property name");
+                break;
+            }
+            parser_advance(parser); // consume name
+            if (!parser_consume(parser, TOKEN_COLON, "Expected ':' after property name")) {
+                free(key);
+                break;
+            }
+            ASTNode *value = parse_expression(parser);
+            if (!value || parser->has_error) {
+                free(key);
+                break;
+            }
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 4;
+                char **grown_keys = realloc(keys, capacity * sizeof(char*));
+                if (grown_keys) {
+                    keys = grown_keys;
+                }
+                ASTNode **grown_values = grown_keys ? realloc(values, capacity * sizeof(ASTNode*)) : NULL;
+                if (!grown_values) {
+                    free(key);
+                    ast_destroy(value);
+                    parser_error(parser, "Memory allocation failed for object literal");
+                    break;
+                }
+                values = grown_values;
+            }
+            keys[count] = key;
+            values[count] = value;
+            count++;
+        } while (parser_match(parser, TOKEN_COMMA));
+    }
+    
+    if (parser->has_error || !parser_consume(parser, TOKEN_RBRACE, "Expected '}' after object properties")) {
+        free_object_parts(keys, values, count);
+        return NULL;
+    }
+    
+    ASTNode *object = ast_create_object(keys, values, count);
+    if (!object) {
+        free_object_parts(keys, values, count);
+        parser_error(parser, "Failed to create object node");
+        return NULL;
+    }
+    return object;
+}
+
+// parse numbers, strings, identifiers, calls, arrays, objects, and (expr)
+static ASTNode* parse_primary(Parser *parser) {
     if (!parser || parser->has_error) {
         return NULL;
     }
@@ -269,18 +535,39 @@ static ASTNode* parse_factor(Parser *parser) {
     if (parser_match(parser, TOKEN_NUMBER)) {
         double value = parser->current_token.number;
         parser_advance(parser);
-        return ast_create_number(value);
+        return ast_cons_number(parser->cons, value);
+    }
+    
+    if (parser_match(parser, TOKEN_STRING)) {
+        ASTNode *node = ast_cons_string(parser->cons, parser->current_token.text);
+        if (!node) {
+            parser_error(parser, "Memory allocation failed for string");
+            return NULL;
+        }
+        parser_advance(parser);
+        return node;
+    }
+    
+    if (parser_match(parser, TOKEN_LBRACKET)) {
+        return parse_array(parser);
+    }
+    
+    if (parser_match(parser, TOKEN_LBRACE)) {
+        return parse_object(parser);
+    }
+    
+    // name( starts a function call
+    if (parser_match(parser, TOKEN_IDENTIFIER) && parser->lookahead_token.type == TOKEN_LPAREN) {
+        return parse_call(parser);
     }
     
     if (parser_match(parser, TOKEN_IDENTIFIER)) {
-        char *name = strdup(parser->current_token.text);
-        if (!name) {
+        ASTNode *node = ast_cons_identifier(parser->cons, parser->current_token.text);
+        if (!node) {
             parser_error(parser, "Memory allocation failed for identifier");
             return NULL;
         }
         parser_advance(parser);
-        ASTNode *node = ast_create_identifier(name);
-        free(name); // ast_create_identifier makes its own copy
         return node;
     }
     
@@ -300,7 +587,7 @@ static ASTNode* parse_factor(Parser *parser) {
         return expr;
     }
     
-    parser_error(parser, "Expected number, identifier, or '('");
+    parser_error(parser, "Expected number, string, identifier, '[', '{', or '('");
     return NULL;
 }
 
@@ -366,6 +653,46 @@ static ASTNode* parse_statement(Parser *parser) {
         return NULL;
     }
     
+    // a[i] = value stores into an element
+    if (expr->type == AST_INDEX && parser_match(parser, TOKEN_ASSIGN)) {
+        parser_advance(parser); // consume '='
+        
+        ASTNode *value = parse_expression(parser);
+        if (!value || parser->has_error) {
+            ast_destroy(expr);
+            return NULL;
+        }
+        
+        ASTNode *store = ast_create_index_assign(ast_retain(expr->data.index.object),
+                                                 ast_retain(expr->data.index.index), value);
+        ast_destroy(expr);
+        if (!store) {
+            parser_error(parser, "Failed to create index assignment node");
+            return NULL;
+        }
+        expr = store;
+    }
+    
+    // p.name = value sets a property
+    if (expr->type == AST_PROPERTY && parser_match(parser, TOKEN_ASSIGN)) {
+        parser_advance(parser); // consume '='
+        
+        ASTNode *value = parse_expression(parser);
+        if (!value || parser->has_error) {
+            ast_destroy(expr);
+            return NULL;
+        }
+        
+        ASTNode *store = ast_create_property_assign(ast_retain(expr->data.property.object),
+                                                    expr->data.property.name, value);
+        ast_destroy(expr);
+        if (!store) {
+            parser_error(parser, "Failed to create property assignment node");
+            return NULL;
+        }
+        expr = store;
+    }
+    
     // optional semicolon
     if (parser_match(parser, TOKEN_SEMICOLON)) {
         parser_advance(parser);
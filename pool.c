@@ -0,0 +1,294 @@
+/*
+ * pool.c - the runtime's thread pool for shardjs
+ *
+ * each thread owns a run of chunks, taken from the front under a spin
+ * lock held for a couple of loads and stores. a thread that runs out
+ * moves the back half of another's run to itself and carries on. no
+ * chunk makes new ones, so a thread that finds nothing left anywhere is
+ * finished. between tasks the threads sleep on a condition variable,
+ * woken by a new generation number.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "include/pool.h"
+#include "include/kernels.h"
+
+typedef struct {
+    size_t next;          // the chunks left, taken from the front
+    size_t end;           // and stolen from the back
+    char lock;
+    size_t generation;    // the last task this thread saw
+    pthread_t thread;
+} PoolWorker;
+
+// workers[0] is whichever thread called pool_run
+static PoolWorker workers[POOL_MAX_THREADS];
+static size_t worker_count = 1;
+static int shutdown_registered = 0;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t task_posted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t task_finished = PTHREAD_COND_INITIALIZER;
+static size_t generation = 0;
+static int stopping = 0;
+static PoolTask current_task = NULL;
+static void *current_context = NULL;
+static size_t active = 0;      // threads taking part in the task
+static size_t finished = 0;    // of those, besides the caller, done
+
+// set while a task runs, so one started from inside it runs inline
+static char running = 0;
+static size_t steals = 0;
+
+static void spin_lock(char *lock) {
+    while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+static void spin_unlock(char *lock) {
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+static int take_chunk(PoolWorker *worker, size_t *chunk) {
+    spin_lock(&worker->lock);
+    int found = worker->next < worker->end;
+    if (found) {
+        *chunk = worker->next++;
+    }
+    spin_unlock(&worker->lock);
+    return found;
+}
+
+// the back half of the first run found with anything left, at least one
+// chunk - 0 when every run is empty
+static int steal_chunks(size_t self) {
+    for (size_t i = 1; i < active; i++) {
+        PoolWorker *victim = &workers[(self + i) % active];
+        spin_lock(&victim->lock);
+        size_t left = victim->end - victim->next;
+        if (left == 0) {
+            spin_unlock(&victim->lock);
+            continue;
+        }
+        size_t taken = (left + 1) / 2;
+        victim->end -= taken;
+        size_t start = victim->end;
+        spin_unlock(&victim->lock);
+
+        PoolWorker *thief = &workers[self];
+        spin_lock(&thief->lock);
+        thief->next = start;
+        thief->end = start + taken;
+        spin_unlock(&thief->lock);
+        __atomic_add_fetch(&steals, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+static void run_chunks(size_t self) {
+    for (;;) {
+        size_t chunk;
+        if (take_chunk(&workers[self], &chunk)) {
+            current_task(current_context, chunk);
+        } else if (!steal_chunks(self)) {
+            return;
+        }
+    }
+}
+
+static void* worker_loop(void *argument) {
+    PoolWorker *worker = argument;
+    size_t self = (size_t)(worker - workers);
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (worker->generation == generation && !stopping) {
+            pthread_cond_wait(&task_posted, &pool_lock);
+        }
+        if (stopping) {
+            break;
+        }
+        worker->generation = generation;
+        if (self >= active) {
+            continue;
+        }
+        pthread_mutex_unlock(&pool_lock);
+        run_chunks(self);
+        pthread_mutex_lock(&pool_lock);
+        if (++finished == active - 1) {
+            pthread_cond_signal(&task_finished);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+// starts threads until there are wanted, returning how many there are
+static size_t start_workers(size_t wanted) {
+    while (worker_count < wanted) {
+        PoolWorker *worker = &workers[worker_count];
+        worker->generation = generation;
+        if (pthread_create(&worker->thread, NULL, worker_loop, worker) != 0) {
+            break;
+        }
+        worker_count++;
+    }
+    if (worker_count > 1 && !shutdown_registered) {
+        shutdown_registered = atexit(pool_shutdown) == 0;
+    }
+    return worker_count < wanted ? worker_count : wanted;
+}
+
+static size_t cpu_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+size_t pool_run(PoolTask task, void *context, size_t chunks, size_t threads) {
+    if (threads == 0) {
+        threads = cpu_count();
+    }
+    if (threads > POOL_MAX_THREADS) {
+        threads = POOL_MAX_THREADS;
+    }
+    if (threads > chunks) {
+        threads = chunks;
+    }
+    if (threads > 1 && !__atomic_test_and_set(&running, __ATOMIC_ACQUIRE)) {
+        threads = start_workers(threads);
+        if (threads > 1) {
+            // contiguous runs, so each thread starts on its own stretch
+            for (size_t i = 0; i < threads; i++) {
+                workers[i].next = chunks * i / threads;
+                workers[i].end = chunks * (i + 1) / threads;
+            }
+            pthread_mutex_lock(&pool_lock);
+            current_task = task;
+            current_context = context;
+            active = threads;
+            finished = 0;
+            generation++;
+            pthread_cond_broadcast(&task_posted);
+            pthread_mutex_unlock(&pool_lock);
+
+            run_chunks(0);
+
+            pthread_mutex_lock(&pool_lock);
+            while (finished < active - 1) {
+                pthread_cond_wait(&task_finished, &pool_lock);
+            }
+            pthread_mutex_unlock(&pool_lock);
+            __atomic_clear(&running, __ATOMIC_RELEASE);
+            return threads;
+        }
+        __atomic_clear(&running, __ATOMIC_RELEASE);
+    }
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        task(context, chunk);
+    }
+    return 1;
+}
+
+size_t pool_chunk_size(size_t n) {
+    size_t size = (n + POOL_MAX_CHUNKS - 1) / POOL_MAX_CHUNKS;
+    return size < POOL_CHUNK_MIN ? POOL_CHUNK_MIN : size;
+}
+
+static size_t pick_threads(size_t n, size_t threads) {
+    if (threads == 0 && n < POOL_PARALLEL_MIN) {
+        return 1;
+    }
+    return threads;
+}
+
+typedef struct {
+    PoolReduction op;
+    const double *x;
+    size_t n;
+    size_t chunk_size;
+    double *partials;
+} ReduceTask;
+
+static double product(const double *x, size_t n) {
+    double result = 1.0;
+    for (size_t i = 0; i < n; i++) {
+        result *= x[i];
+    }
+    return result;
+}
+
+static double reduce_run(PoolReduction op, const double *x, size_t n) {
+    switch (op) {
+        case POOL_SUM:     return kernel_sum(x, n);
+        case POOL_PRODUCT: return product(x, n);
+        case POOL_MIN:     return n ? kernel_min(x, n) : INFINITY;
+        case POOL_MAX:     return n ? kernel_max(x, n) : -INFINITY;
+    }
+    return 0.0;
+}
+
+static void reduce_chunk(void *context, size_t chunk) {
+    ReduceTask *task = context;
+    size_t start = chunk * task->chunk_size;
+    size_t count = task->n - start < task->chunk_size ? task->n - start : task->chunk_size;
+    task->partials[chunk] = reduce_run(task->op, task->x + start, count);
+}
+
+double pool_reduce(PoolReduction op, const double *x, size_t n, size_t threads) {
+    double partials[POOL_MAX_CHUNKS];
+    ReduceTask task = { op, x, n, pool_chunk_size(n), partials };
+    size_t chunks = (n + task.chunk_size - 1) / task.chunk_size;
+    if (chunks <= 1) {
+        return reduce_run(op, x, n);
+    }
+    pool_run(reduce_chunk, &task, chunks, pick_threads(n, threads));
+    return reduce_run(op, partials, chunks);
+}
+
+typedef struct {
+    void (*fn)(const double *x, double *out, size_t n);
+    double lo;
+    double *out;
+    size_t n;
+    size_t chunk_size;
+} TabulateTask;
+
+static void tabulate_chunk(void *context, size_t chunk) {
+    TabulateTask *task = context;
+    size_t start = chunk * task->chunk_size;
+    size_t count = task->n - start < task->chunk_size ? task->n - start : task->chunk_size;
+    double *out = task->out + start;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = task->lo + (double)(start + i);
+    }
+    task->fn(out, out, count);
+}
+
+size_t pool_tabulate(void (*fn)(const double *x, double *out, size_t n), double lo, double *out, size_t n,
+                     size_t threads) {
+    TabulateTask task = { fn, lo, out, n, pool_chunk_size(n) };
+    size_t chunks = (n + task.chunk_size - 1) / task.chunk_size;
+    return pool_run(tabulate_chunk, &task, chunks, pick_threads(n, threads));
+}
+
+size_t pool_steals(void) {
+    return __atomic_load_n(&steals, __ATOMIC_RELAXED);
+}
+
+void pool_shutdown(void) {
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&task_posted);
+    pthread_mutex_unlock(&pool_lock);
+    for (size_t i = 1; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    worker_count = 1;
+    stopping = 0;
+}
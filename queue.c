@@ -0,0 +1,184 @@
+/*
+ * queue.c - message queues between interpreters for shardjs
+ *
+ * slot i starts with sequence i. a producer holding ticket t may fill
+ * slot t % capacity once its sequence is t, and publishes it by storing
+ * t + 1; the consumer, at position p, takes the slot once its sequence
+ * is p + 1 and frees it for the ticket one lap later by storing
+ * p + capacity. producers and the consumer keep their counters on
+ * cache lines of their own. waiting is yielding, then sleeping in
+ * growing steps, since a worker may wait a long time.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "include/queue.h"
+#include "include/shared.h"
+
+#define CACHE_LINE 64
+// rounds of yielding before a waiter starts to sleep
+#define QUEUE_YIELD_ROUNDS 64
+#define QUEUE_MAX_SLEEP_NS 1000000
+
+typedef struct {
+    size_t sequence;
+    Message message;
+} QueueSlot;
+
+struct MessageQueue {
+    size_t head __attribute__((aligned(CACHE_LINE)));   // the next ticket
+    size_t tail __attribute__((aligned(CACHE_LINE)));   // the consumer's position
+    QueueSlot *slots __attribute__((aligned(CACHE_LINE)));
+    size_t mask;
+    size_t references;
+    size_t senders;
+    int closed;
+};
+
+void message_free(Message *message) {
+    if (message->data) {
+        if (message->kind == MESSAGE_SHARED) {
+            shared_buffer_release(message->data);
+        } else if (message->mapped) {
+            munmap(message->data, message->length * sizeof(double));
+        } else {
+            free(message->data);
+        }
+    }
+    message->data = NULL;
+    message->length = 0;
+}
+
+MessageQueue* queue_create(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    void *memory;
+    if (posix_memalign(&memory, CACHE_LINE, sizeof(MessageQueue)) != 0) {
+        return NULL;
+    }
+    MessageQueue *queue = memory;
+    queue->slots = malloc(size * sizeof(QueueSlot));
+    if (!queue->slots) {
+        free(queue);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        queue->slots[i].sequence = i;
+    }
+    queue->head = 0;
+    queue->tail = 0;
+    queue->mask = size - 1;
+    queue->references = 1;
+    queue->senders = 0;
+    queue->closed = 0;
+    return queue;
+}
+
+void queue_retain(MessageQueue *queue) {
+    __atomic_add_fetch(&queue->references, 1, __ATOMIC_RELAXED);
+}
+
+void queue_release(MessageQueue *queue) {
+    if (__atomic_sub_fetch(&queue->references, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    Message message;
+    while (queue_try_take(queue, &message)) {
+        message_free(&message);
+    }
+    free(queue->slots);
+    free(queue);
+}
+
+void queue_add_sender(MessageQueue *queue) {
+    __atomic_add_fetch(&queue->senders, 1, __ATOMIC_SEQ_CST);
+}
+
+// after the sender's last post, so a consumer that sees none left and
+// looks once more finds everything that was posted
+void queue_remove_sender(MessageQueue *queue) {
+    __atomic_sub_fetch(&queue->senders, 1, __ATOMIC_SEQ_CST);
+}
+
+void queue_close(MessageQueue *queue) {
+    __atomic_store_n(&queue->closed, 1, __ATOMIC_SEQ_CST);
+}
+
+static void back_off(unsigned *round) {
+    if (*round < QUEUE_YIELD_ROUNDS) {
+        sched_yield();
+    } else {
+        unsigned shift = *round - QUEUE_YIELD_ROUNDS;
+        long nanoseconds = shift < 20 ? 1000L << shift : QUEUE_MAX_SLEEP_NS;
+        struct timespec pause = { 0, nanoseconds < QUEUE_MAX_SLEEP_NS ? nanoseconds : QUEUE_MAX_SLEEP_NS };
+        nanosleep(&pause, NULL);
+    }
+    (*round)++;
+}
+
+int queue_try_post(MessageQueue *queue, const Message *message) {
+    if (__atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    size_t ticket = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    QueueSlot *slot;
+    for (;;) {
+        slot = &queue->slots[ticket & queue->mask];
+        size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)ticket;
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &ticket, ticket + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // ticket now holds the head another producer moved it to
+        } else if (difference < 0) {
+            // the consumer hasn't freed this slot from the last lap
+            return 0;
+        } else {
+            ticket = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+    slot->message = *message;
+    __atomic_store_n(&slot->sequence, ticket + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int queue_post(MessageQueue *queue, const Message *message) {
+    unsigned round = 0;
+    while (!queue_try_post(queue, message)) {
+        if (__atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+        back_off(&round);
+    }
+    return 1;
+}
+
+int queue_try_take(MessageQueue *queue, Message *message) {
+    QueueSlot *slot = &queue->slots[queue->tail & queue->mask];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != queue->tail + 1) {
+        return 0;
+    }
+    *message = slot->message;
+    __atomic_store_n(&slot->sequence, queue->tail + queue->mask + 1, __ATOMIC_RELEASE);
+    queue->tail++;
+    return 1;
+}
+
+int queue_take(MessageQueue *queue, Message *message) {
+    unsigned round = 0;
+    while (!queue_try_take(queue, message)) {
+        if (__atomic_load_n(&queue->senders, __ATOMIC_SEQ_CST) == 0) {
+            return queue_try_take(queue, message);
+        }
+        back_off(&round);
+    }
+    return 1;
+}
@@ -0,0 +1,240 @@
+/*
+ * random.c - seeded random numbers for shardjs
+ *
+ * the xoshiro256** generator of Blackman and Vigna. a fill runs four
+ * streams side by side in the lanes of a gcc vector, compiled for the
+ * baseline instruction set and again for avx2. xoshiro's multiplies by
+ * 5 and 9 are a shift and an add, and the top 53 bits become a double
+ * in two exact halves, so the lanes need nothing past sse2 and give the
+ * bits random_double would.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "include/random.h"
+#include "include/kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RANDOM_X86 1
+#endif
+
+#define LANES 4
+
+typedef double vd __attribute__((vector_size(32)));
+typedef uint64_t vu __attribute__((vector_size(32)));
+
+// always inlined, so each build compiles them for its own instruction
+// set, and passed by pointer as in vecmath.c
+#define INLINE static inline __attribute__((always_inline))
+
+#define ROTL(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+// the low 52 bits of a double of 2^52
+#define TWO_52_BITS 0x4330000000000000ULL
+
+static const uint64_t jump_polynomial[4] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+};
+
+static const uint64_t long_jump_polynomial[4] = {
+    0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+};
+
+void random_seed(RandomState *state, uint64_t seed) {
+    // splitmix64, so that nearby seeds give unrelated states and no seed
+    // gives the all-zero state
+    for (int i = 0; i < 4; i++) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        state->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t random_next(RandomState *state) {
+    uint64_t *s = state->s;
+    uint64_t result = ROTL(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL(s[3], 45);
+    return result;
+}
+
+double random_double(RandomState *state) {
+    return (double)(random_next(state) >> 11) * 0x1p-53;
+}
+
+static void jump_by(RandomState *state, const uint64_t *polynomial) {
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (polynomial[i] & (1ULL << b)) {
+                for (int j = 0; j < 4; j++) {
+                    s[j] ^= state->s[j];
+                }
+            }
+            random_next(state);
+        }
+    }
+    memcpy(state->s, s, sizeof(s));
+}
+
+void random_jump(RandomState *state) {
+    jump_by(state, jump_polynomial);
+}
+
+void random_long_jump(RandomState *state) {
+    jump_by(state, long_jump_polynomial);
+}
+
+// one step of four streams, lane l holding word k of stream l in sk
+INLINE void next_lanes(vu *s0, vu *s1, vu *s2, vu *s3, vd *out) {
+    vu x = (*s1 << 2) + *s1;
+    x = ROTL(x, 7);
+    vu result = (x << 3) + x;
+    vu t = *s1 << 17;
+    *s2 ^= *s0;
+    *s3 ^= *s1;
+    *s1 ^= *s2;
+    *s0 ^= *s3;
+    *s2 ^= t;
+    *s3 = ROTL(*s3, 45);
+
+    // the top 21 and the next 32 bits each fit the mantissa of 2^52, so
+    // both convert exactly, and so does their sum
+    vd high = (vd)((result >> 43) | TWO_52_BITS) - 0x1p52;
+    vd low = (vd)(((result >> 11) & 0xffffffffULL) | TWO_52_BITS) - 0x1p52;
+    *out = (high * 0x1p32 + low) * 0x1p-53;
+}
+
+// element i from stream i % 4
+INLINE void fill_lanes(const RandomState *streams, double *out, size_t n) {
+    vu s0, s1, s2, s3;
+    for (int l = 0; l < LANES; l++) {
+        s0[l] = streams[l].s[0];
+        s1[l] = streams[l].s[1];
+        s2[l] = streams[l].s[2];
+        s3[l] = streams[l].s[3];
+    }
+    vd x;
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        next_lanes(&s0, &s1, &s2, &s3, &x);
+        memcpy(out + i, &x, sizeof(x));
+    }
+    if (i < n) {
+        next_lanes(&s0, &s1, &s2, &s3, &x);
+        memcpy(out + i, &x, (n - i) * sizeof(double));
+    }
+}
+
+static void fill_generic(const RandomState *streams, double *out, size_t n) {
+    fill_lanes(streams, out, n);
+}
+
+#ifdef RANDOM_X86
+__attribute__((target("avx2")))
+static void fill_avx2(const RandomState *streams, double *out, size_t n) {
+    fill_lanes(streams, out, n);
+}
+#endif
+
+typedef struct {
+    RandomState start;   // the state the whole fill starts from
+    double *out;
+    size_t n;
+    size_t first_chunk;
+    size_t end_chunk;
+} FillJob;
+
+static void* fill_work(void *arg) {
+    const FillJob *job = arg;
+    RandomState state = job->start;
+    for (size_t i = 0; i < job->first_chunk * LANES; i++) {
+        random_jump(&state);
+    }
+    for (size_t c = job->first_chunk; c < job->end_chunk; c++) {
+        RandomState streams[LANES];
+        for (int l = 0; l < LANES; l++) {
+            random_jump(&state);
+            streams[l] = state;
+        }
+        size_t start = c * RANDOM_CHUNK;
+        size_t count = job->n - start < RANDOM_CHUNK ? job->n - start : RANDOM_CHUNK;
+#ifdef RANDOM_X86
+        if (kernel_current_isa() == KERNEL_AVX2) {
+            fill_avx2(streams, job->out + start, count);
+            continue;
+        }
+#endif
+        fill_generic(streams, job->out + start, count);
+    }
+    return NULL;
+}
+
+// run every job, the first on this thread
+static void run_jobs(FillJob *jobs, size_t count) {
+    pthread_t threads[RANDOM_MAX_THREADS];
+    int started[RANDOM_MAX_THREADS] = {0};
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, fill_work, &jobs[i]) == 0;
+        if (!started[i]) {
+            fill_work(&jobs[i]);
+        }
+    }
+    fill_work(&jobs[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+static size_t pick_threads(size_t n, size_t chunks, size_t requested) {
+    if (requested == 0) {
+        if (n < RANDOM_PARALLEL_MIN) {
+            return 1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cpus > 0 ? (size_t)cpus : 1;
+    }
+    if (requested > RANDOM_MAX_THREADS) {
+        requested = RANDOM_MAX_THREADS;
+    }
+    if (requested > chunks) {
+        requested = chunks;
+    }
+    return requested ? requested : 1;
+}
+
+size_t random_fill(RandomState *state, double *out, size_t n, size_t threads) {
+    RandomState start = *state;
+    random_long_jump(state);
+    if (n == 0) {
+        return 1;
+    }
+    size_t chunks = (n + RANDOM_CHUNK - 1) / RANDOM_CHUNK;
+    threads = pick_threads(n, chunks, threads);
+
+    // whole chunks to each thread, so the streams do not depend on the
+    // split
+    size_t share = (chunks + threads - 1) / threads;
+    FillJob jobs[RANDOM_MAX_THREADS];
+    size_t count = 0;
+    for (size_t first = 0; first < chunks; first += share) {
+        FillJob *job = &jobs[count++];
+        job->start = start;
+        job->out = out;
+        job->n = n;
+        job->first_chunk = first;
+        job->end_chunk = chunks - first < share ? chunks : first + share;
+    }
+    run_jobs(jobs, count);
+    return count;
+}
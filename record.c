@@ -0,0 +1,150 @@
+/*
+ * record.c - objects for shardjs
+ *
+ * an object keeps its property values in numbered slots and points at a
+ * shape that says which name is in which slot. adding a property
+ * follows the transition for that name out of the current shape, making
+ * it the first time, so every object built with the same names in the
+ * same order ends up with the same shape. property access sites in the
+ * interpreter cache the shapes they have seen with the slot each one
+ * gave, which turns a repeated lookup into a shape compare and a load.
+ *
+ * shapes are plain malloc'd memory that lives until heap_destroy, like
+ * the interned names they hold, and like them belong to one thread.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "include/object.h"
+
+static __thread Shape *root_shape = NULL;
+static __thread Shape *all_shapes = NULL;
+
+static Shape* shape_create(Shape *parent, StringObject *name) {
+    Shape *shape = calloc(1, sizeof(Shape));
+    if (!shape) {
+        return NULL;
+    }
+    shape->parent = parent;
+    shape->name = name;
+    shape->count = parent ? parent->count + 1 : 0;
+    shape->next_shape = all_shapes;
+    all_shapes = shape;
+    return shape;
+}
+
+Shape* shape_empty(void) {
+    if (!root_shape) {
+        root_shape = shape_create(NULL, NULL);
+    }
+    return root_shape;
+}
+
+Shape* shape_transition(Shape *shape, StringObject *name) {
+    for (uint32_t i = 0; i < shape->transition_count; i++) {
+        if (shape->transitions[i]->name == name) {
+            return shape->transitions[i];
+        }
+    }
+
+    if (shape->transition_count == shape->transition_capacity) {
+        uint32_t capacity = shape->transition_capacity ? shape->transition_capacity * 2 : 2;
+        Shape **transitions = realloc(shape->transitions, capacity * sizeof(Shape*));
+        if (!transitions) {
+            return NULL;
+        }
+        shape->transitions = transitions;
+        shape->transition_capacity = capacity;
+    }
+    Shape *next = shape_create(shape, name);
+    if (!next) {
+        return NULL;
+    }
+    shape->transitions[shape->transition_count++] = next;
+    return next;
+}
+
+// walks back towards the root, newest property first
+int shape_lookup(const Shape *shape, const StringObject *name) {
+    for (; shape && shape->name; shape = shape->parent) {
+        if (shape->name == name) {
+            return (int)shape->count - 1;
+        }
+    }
+    return -1;
+}
+
+void shape_table_destroy(void) {
+    Shape *shape = all_shapes;
+    while (shape) {
+        Shape *next = shape->next_shape;
+        free(shape->transitions);
+        free(shape);
+        shape = next;
+    }
+    all_shapes = NULL;
+    root_shape = NULL;
+}
+
+Value record_create(Shape *shape) {
+    size_t overflow_capacity = shape->count > RECORD_INLINE_SLOTS ? shape->count - RECORD_INLINE_SLOTS : 0;
+    Value *overflow = NULL;
+    if (overflow_capacity > 0) {
+        overflow = calloc(overflow_capacity, sizeof(Value));
+        if (!overflow) {
+            return VALUE_NULL;
+        }
+    }
+
+    RecordObject *record = heap_allocate(OBJ_RECORD, sizeof(RecordObject));
+    if (!record) {
+        free(overflow);
+        return VALUE_NULL;
+    }
+    record->shape = shape;
+    record->overflow = overflow;
+    record->overflow_capacity = overflow_capacity;
+    return value_from_pointer(record);
+}
+
+Value record_get(Value value, const StringObject *name) {
+    RecordObject *record = value_as_record(value);
+    int slot = shape_lookup(record->shape, name);
+    return slot < 0 ? VALUE_NULL : *record_slot(record, (uint32_t)slot);
+}
+
+int record_add(Value value, Shape *next, Value item) {
+    RecordObject *record = value_as_record(value);
+    uint32_t slot = next->count - 1;
+    heap_lock_object(&record->header);
+    if (slot >= RECORD_INLINE_SLOTS && slot - RECORD_INLINE_SLOTS >= record->overflow_capacity) {
+        size_t capacity = record->overflow_capacity ? record->overflow_capacity * 2 : RECORD_INLINE_SLOTS;
+        Value *overflow = realloc(record->overflow, capacity * sizeof(Value));
+        if (!overflow) {
+            heap_unlock_object(&record->header);
+            return 0;
+        }
+        record->overflow = overflow;
+        record->overflow_capacity = capacity;
+    }
+    *record_slot(record, slot) = item;
+    record->shape = next;
+    heap_unlock_object(&record->header);
+    heap_write_barrier(&record->header, item);
+    return 1;
+}
+
+int record_put(Value value, StringObject *name, Value item) {
+    RecordObject *record = value_as_record(value);
+    int slot = shape_lookup(record->shape, name);
+    if (slot >= 0) {
+        record_store(record, (uint32_t)slot, item);
+        return 1;
+    }
+    Shape *next = shape_transition(record->shape, name);
+    return next && record_add(value, next, item);
+}
+
+void record_release(RecordObject *record) {
+    free(record->overflow);
+}
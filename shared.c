@@ -0,0 +1,98 @@
+/*
+ * shared.c - memory shared between interpreters for shardjs
+ *
+ * integer elements use the atomic fetch-add and compare-exchange
+ * directly. there is no atomic add for doubles, so a double's add is a
+ * compare-exchange on its bits, retried until no other thread got in
+ * between the load and the store.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "include/shared.h"
+
+// 2^63, the first double past the largest int64
+#define INT64_LIMIT 9223372036854775808.0
+
+static int64_t bits_of(double value) {
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double double_of(int64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// what an element holds, as the double a script sees
+static double element_value(const SharedBuffer *buffer, int64_t element) {
+    return buffer->kind == SHARED_INT64 ? (double)element : double_of(element);
+}
+
+static int64_t element_of(const SharedBuffer *buffer, double value) {
+    return buffer->kind == SHARED_INT64 ? (int64_t)value : bits_of(value);
+}
+
+SharedBuffer* shared_buffer_create(SharedKind kind, size_t length) {
+    if (length > (SIZE_MAX - sizeof(SharedBuffer)) / sizeof(int64_t)) {
+        return NULL;
+    }
+    // zero bits are 0 for both kinds
+    SharedBuffer *buffer = calloc(1, sizeof(SharedBuffer) + length * sizeof(int64_t));
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->references = 1;
+    buffer->length = length;
+    buffer->kind = kind;
+    return buffer;
+}
+
+void shared_buffer_retain(SharedBuffer *buffer) {
+    __atomic_add_fetch(&buffer->references, 1, __ATOMIC_RELAXED);
+}
+
+void shared_buffer_release(SharedBuffer *buffer) {
+    if (__atomic_sub_fetch(&buffer->references, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(buffer);
+    }
+}
+
+int shared_fits(const SharedBuffer *buffer, double value) {
+    if (buffer->kind == SHARED_FLOAT64) {
+        return 1;
+    }
+    return value >= -INT64_LIMIT && value < INT64_LIMIT && value == (double)(int64_t)value;
+}
+
+double shared_load(SharedBuffer *buffer, size_t index) {
+    return element_value(buffer, __atomic_load_n(&buffer->elements[index], __ATOMIC_SEQ_CST));
+}
+
+void shared_store(SharedBuffer *buffer, size_t index, double value) {
+    __atomic_store_n(&buffer->elements[index], element_of(buffer, value), __ATOMIC_SEQ_CST);
+}
+
+double shared_add(SharedBuffer *buffer, size_t index, double value) {
+    int64_t *element = &buffer->elements[index];
+    if (buffer->kind == SHARED_INT64) {
+        // wraps on overflow, like the hardware
+        return (double)__atomic_fetch_add(element, (int64_t)value, __ATOMIC_SEQ_CST);
+    }
+    int64_t old = __atomic_load_n(element, __ATOMIC_RELAXED);
+    // a failed exchange leaves what the element holds now in old
+    while (!__atomic_compare_exchange_n(element, &old, bits_of(double_of(old) + value), 1,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    }
+    return double_of(old);
+}
+
+double shared_compare_exchange(SharedBuffer *buffer, size_t index, double expected, double replacement) {
+    int64_t old = element_of(buffer, expected);
+    __atomic_compare_exchange_n(&buffer->elements[index], &old, element_of(buffer, replacement), 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return element_value(buffer, old);
+}
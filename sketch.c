@@ -0,0 +1,76 @@
+/*
+ * sketch.c - accumulator values for shardjs
+ *
+ * a small heap object around one of the summaries in stats.c. the
+ * moments fit in the object; the sketches' counts are allocated beside
+ * it, like a Float64Array's elements, and freed with it.
+ */
+
+#include <stdlib.h>
+#include "include/object.h"
+
+Value sketch_from_histogram(StatsHistogram *histogram) {
+    SketchObject *sketch = heap_allocate(OBJ_SKETCH, sizeof(SketchObject));
+    if (!sketch) {
+        stats_histogram_free(histogram);
+        return VALUE_NULL;
+    }
+    sketch->kind = SKETCH_HISTOGRAM;
+    sketch->as.histogram = histogram;
+    return value_from_pointer(sketch);
+}
+
+Value sketch_create(SketchKind kind, double setting) {
+    if (kind == SKETCH_HISTOGRAM) {
+        StatsHistogram *histogram = stats_histogram_create(setting, STATS_HISTOGRAM_DEFAULT_DIGITS);
+        return histogram ? sketch_from_histogram(histogram) : VALUE_NULL;
+    }
+    StatsQuantiles *quantiles = NULL;
+    StatsDistinct *distinct = NULL;
+    if (kind == SKETCH_QUANTILES) {
+        quantiles = stats_quantiles_create(setting);
+        if (!quantiles) {
+            return VALUE_NULL;
+        }
+    } else if (kind == SKETCH_DISTINCT) {
+        distinct = stats_distinct_create((int)setting);
+        if (!distinct) {
+            return VALUE_NULL;
+        }
+    }
+
+    SketchObject *sketch = heap_allocate(OBJ_SKETCH, sizeof(SketchObject));
+    if (!sketch) {
+        stats_quantiles_free(quantiles);
+        stats_distinct_free(distinct);
+        return VALUE_NULL;
+    }
+    sketch->kind = (uint8_t)kind;
+    switch (kind) {
+        case SKETCH_STATS: stats_moments_init(&sketch->as.moments); break;
+        case SKETCH_QUANTILES: sketch->as.quantiles = quantiles; break;
+        case SKETCH_DISTINCT: sketch->as.distinct = distinct; break;
+        case SKETCH_HISTOGRAM: break;   // made above
+    }
+    return value_from_pointer(sketch);
+}
+
+const char* sketch_kind_name(SketchKind kind) {
+    switch (kind) {
+        case SKETCH_STATS: return "Stats";
+        case SKETCH_QUANTILES: return "Quantiles";
+        case SKETCH_DISTINCT: return "Distinct";
+        case SKETCH_HISTOGRAM: return "Histogram";
+    }
+    return "Sketch";
+}
+
+void sketch_release(SketchObject *sketch) {
+    if (sketch->kind == SKETCH_QUANTILES) {
+        stats_quantiles_free(sketch->as.quantiles);
+    } else if (sketch->kind == SKETCH_DISTINCT) {
+        stats_distinct_free(sketch->as.distinct);
+    } else if (sketch->kind == SKETCH_HISTOGRAM) {
+        stats_histogram_free(sketch->as.histogram);
+    }
+}
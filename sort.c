@@ -0,0 +1,482 @@
+/*
+ * sort.c - sorting for shardjs
+ *
+ * numbers become keys whose unsigned order is their numeric order (see
+ * sort_key), so one radix sort serves every double. it makes a pass per
+ * byte of the key from the lowest, scattering the keys into 256 buckets
+ * counted up front, and skips a byte all the keys share - arrays of
+ * small integers only pay for the few bytes that vary.
+ *
+ * below SORT_RADIX_MIN keys, and for records, the sort is pdqsort:
+ * quicksort with a median of three (or of nine) pivot, insertion sort
+ * for short ranges, a check that bails out early on input that is
+ * already in order, and heapsort once bad pivots suggest an adversarial
+ * pattern, so the worst case stays n log n.
+ *
+ * past SORT_PARALLEL_MIN keys each thread radix sorts a slice, then
+ * neighbouring slices are merged in pairs, each pair on its own thread,
+ * until one is left. the keys decide the order completely, so the
+ * result never depends on the thread count.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "include/sort.h"
+
+#define NAN_KEY 0xfff8000000000000ULL
+
+// keys in descending order, NaN still last
+static inline uint64_t reverse_key(uint64_t key) {
+    return key == NAN_KEY ? key : ~key;
+}
+
+// pdqsort over an array of TYPE in the order of the LESS(a, b) macro,
+// defining NAME(begin, n). the first element of every range after the
+// leftmost one has the range's pivot before it, which the partitions
+// use as a sentinel.
+#define PDQ_INSERTION_MAX 24
+#define PDQ_NINTHER_MIN 128
+#define PDQ_PARTIAL_MOVES 8
+
+#define DEFINE_PDQSORT(NAME, TYPE, LESS)                                                     \
+static void NAME##_insertion(TYPE *begin, TYPE *end) {                                       \
+    for (TYPE *cur = begin + 1; cur < end; cur++) {                                          \
+        TYPE tmp = *cur;                                                                     \
+        TYPE *sift = cur;                                                                    \
+        while (sift != begin && LESS(tmp, sift[-1])) {                                       \
+            *sift = sift[-1];                                                                \
+            sift--;                                                                          \
+        }                                                                                    \
+        *sift = tmp;                                                                         \
+    }                                                                                        \
+}                                                                                            \
+                                                                                             \
+/* insertion sort that gives up after a few moves - 0 if it did */                           \
+static int NAME##_partial_insertion(TYPE *begin, TYPE *end) {                                \
+    size_t moves = 0;                                                                        \
+    for (TYPE *cur = begin + 1; cur < end; cur++) {                                          \
+        if (LESS(*cur, cur[-1])) {                                                           \
+            TYPE tmp = *cur;                                                                 \
+            TYPE *sift = cur;                                                                \
+            do {                                                                             \
+                *sift = sift[-1];                                                            \
+                sift--;                                                                      \
+            } while (sift != begin && LESS(tmp, sift[-1]));                                  \
+            *sift = tmp;                                                                     \
+            moves += (size_t)(cur - sift);                                                   \
+            if (moves > PDQ_PARTIAL_MOVES) {                                                 \
+                return 0;                                                                    \
+            }                                                                                \
+        }                                                                                    \
+    }                                                                                        \
+    return 1;                                                                                \
+}                                                                                            \
+                                                                                             \
+static void NAME##_sift_down(TYPE *heap, size_t root, size_t n) {                            \
+    TYPE tmp = heap[root];                                                                   \
+    for (size_t child; (child = 2 * root + 1) < n; root = child) {                           \
+        if (child + 1 < n && LESS(heap[child], heap[child + 1])) {                           \
+            child++;                                                                         \
+        }                                                                                    \
+        if (!LESS(tmp, heap[child])) {                                                       \
+            break;                                                                           \
+        }                                                                                    \
+        heap[root] = heap[child];                                                            \
+    }                                                                                        \
+    heap[root] = tmp;                                                                        \
+}                                                                                            \
+                                                                                             \
+static void NAME##_heapsort(TYPE *begin, TYPE *end) {                                        \
+    size_t n = (size_t)(end - begin);                                                        \
+    for (size_t i = n / 2; i-- > 0;) {                                                       \
+        NAME##_sift_down(begin, i, n);                                                       \
+    }                                                                                        \
+    while (n > 1) {                                                                          \
+        n--;                                                                                 \
+        TYPE tmp = begin[0];                                                                 \
+        begin[0] = begin[n];                                                                 \
+        begin[n] = tmp;                                                                      \
+        NAME##_sift_down(begin, 0, n);                                                       \
+    }                                                                                        \
+}                                                                                            \
+                                                                                             \
+static inline void NAME##_swap(TYPE *a, TYPE *b) {                                           \
+    TYPE tmp = *a;                                                                           \
+    *a = *b;                                                                                 \
+    *b = tmp;                                                                                \
+}                                                                                            \
+                                                                                             \
+static inline void NAME##_sort3(TYPE *a, TYPE *b, TYPE *c) {                                 \
+    if (LESS(*b, *a)) NAME##_swap(a, b);                                                     \
+    if (LESS(*c, *b)) NAME##_swap(b, c);                                                     \
+    if (LESS(*b, *a)) NAME##_swap(a, b);                                                     \
+}                                                                                            \
+                                                                                             \
+/* elements less than the pivot at *begin go left of it, the rest right */                   \
+static TYPE* NAME##_partition_right(TYPE *begin, TYPE *end, int *already_partitioned) {      \
+    TYPE pivot = *begin;                                                                     \
+    TYPE *first = begin;                                                                     \
+    TYPE *last = end;                                                                        \
+    while (LESS(*++first, pivot)) {}                                                         \
+    if (first - 1 == begin) {                                                                \
+        while (first < last && !LESS(*--last, pivot)) {}                                     \
+    } else {                                                                                 \
+        while (!LESS(*--last, pivot)) {}                                                     \
+    }                                                                                        \
+    *already_partitioned = first >= last;                                                    \
+    while (first < last) {                                                                   \
+        NAME##_swap(first, last);                                                            \
+        while (LESS(*++first, pivot)) {}                                                     \
+        while (!LESS(*--last, pivot)) {}                                                     \
+    }                                                                                        \
+    TYPE *pivot_position = first - 1;                                                        \
+    *begin = *pivot_position;                                                                \
+    *pivot_position = pivot;                                                                 \
+    return pivot_position;                                                                   \
+}                                                                                            \
+                                                                                             \
+/* elements equal to the pivot go left - used when a range is all at */                     \
+/* least its sentinel, so runs of equal elements are done in one step */                     \
+static TYPE* NAME##_partition_left(TYPE *begin, TYPE *end) {                                 \
+    TYPE pivot = *begin;                                                                     \
+    TYPE *first = begin;                                                                     \
+    TYPE *last = end;                                                                        \
+    while (LESS(pivot, *--last)) {}                                                          \
+    if (last + 1 == end) {                                                                   \
+        while (first < last && !LESS(pivot, *++first)) {}                                    \
+    } else {                                                                                 \
+        while (!LESS(pivot, *++first)) {}                                                    \
+    }                                                                                        \
+    while (first < last) {                                                                   \
+        NAME##_swap(first, last);                                                            \
+        while (LESS(pivot, *--last)) {}                                                      \
+        while (!LESS(pivot, *++first)) {}                                                    \
+    }                                                                                        \
+    *begin = *last;                                                                          \
+    *last = pivot;                                                                           \
+    return last;                                                                             \
+}                                                                                            \
+                                                                                             \
+static void NAME##_loop(TYPE *begin, TYPE *end, int bad_allowed, int leftmost) {             \
+    for (;;) {                                                                               \
+        size_t size = (size_t)(end - begin);                                                 \
+        if (size < PDQ_INSERTION_MAX) {                                                      \
+            NAME##_insertion(begin, end);                                                    \
+            return;                                                                          \
+        }                                                                                    \
+        size_t half = size / 2;                                                              \
+        if (size > PDQ_NINTHER_MIN) {                                                        \
+            NAME##_sort3(begin, begin + half, end - 1);                                      \
+            NAME##_sort3(begin + 1, begin + (half - 1), end - 2);                            \
+            NAME##_sort3(begin + 2, begin + (half + 1), end - 3);                            \
+            NAME##_sort3(begin + (half - 1), begin + half, begin + (half + 1));              \
+            NAME##_swap(begin, begin + half);                                                \
+        } else {                                                                             \
+            NAME##_sort3(begin + half, begin, end - 1);                                      \
+        }                                                                                    \
+        if (!leftmost && !LESS(begin[-1], *begin)) {                                         \
+            begin = NAME##_partition_left(begin, end) + 1;                                   \
+            continue;                                                                        \
+        }                                                                                    \
+                                                                                             \
+        int already_partitioned;                                                             \
+        TYPE *pivot = NAME##_partition_right(begin, end, &already_partitioned);              \
+        size_t left = (size_t)(pivot - begin);                                               \
+        size_t right = (size_t)(end - (pivot + 1));                                          \
+        if (left < size / 8 || right < size / 8) {                                           \
+            if (--bad_allowed == 0) {                                                        \
+                NAME##_heapsort(begin, end);                                                 \
+                return;                                                                      \
+            }                                                                                \
+            /* break up whatever pattern made the pivot bad */                               \
+            if (left >= PDQ_INSERTION_MAX) {                                                 \
+                NAME##_swap(begin, begin + left / 4);                                        \
+                NAME##_swap(pivot - 1, pivot - left / 4);                                    \
+                if (left > PDQ_NINTHER_MIN) {                                                \
+                    NAME##_swap(begin + 1, begin + (left / 4 + 1));                          \
+                    NAME##_swap(begin + 2, begin + (left / 4 + 2));                          \
+                    NAME##_swap(pivot - 2, pivot - (left / 4 + 1));                          \
+                    NAME##_swap(pivot - 3, pivot - (left / 4 + 2));                          \
+                }                                                                            \
+            }                                                                                \
+            if (right >= PDQ_INSERTION_MAX) {                                                \
+                NAME##_swap(pivot + 1, pivot + (1 + right / 4));                             \
+                NAME##_swap(end - 1, end - right / 4);                                       \
+                if (right > PDQ_NINTHER_MIN) {                                               \
+                    NAME##_swap(pivot + 2, pivot + (2 + right / 4));                         \
+                    NAME##_swap(pivot + 3, pivot + (3 + right / 4));                         \
+                    NAME##_swap(end - 2, end - (1 + right / 4));                             \
+                    NAME##_swap(end - 3, end - (2 + right / 4));                             \
+                }                                                                            \
+            }                                                                                \
+        } else if (already_partitioned && NAME##_partial_insertion(begin, pivot) &&          \
+                   NAME##_partial_insertion(pivot + 1, end)) {                               \
+            return;                                                                          \
+        }                                                                                    \
+        NAME##_loop(begin, pivot, bad_allowed, leftmost);                                    \
+        begin = pivot + 1;                                                                   \
+        leftmost = 0;                                                                        \
+    }                                                                                        \
+}                                                                                            \
+                                                                                             \
+static void NAME(TYPE *begin, size_t n) {                                                    \
+    int bad_allowed = 1;                                                                     \
+    while (((size_t)1 << bad_allowed) < n) {                                                 \
+        bad_allowed++;                                                                       \
+    }                                                                                        \
+    NAME##_loop(begin, begin + n, bad_allowed, 1);                                           \
+}
+
+#define KEY_LESS(a, b) ((a) < (b))
+DEFINE_PDQSORT(pdqsort_keys, uint64_t, KEY_LESS)
+
+static inline int compare_text(const SortRecord *a, const SortRecord *b) {
+    size_t shorter = a->length < b->length ? a->length : b->length;
+    int order = memcmp(a->chars, b->chars, shorter);
+    if (order != 0) {
+        return order;
+    }
+    return (a->length > b->length) - (a->length < b->length);
+}
+
+// numbers first, then text, then the original position
+static inline int record_before(const SortRecord *a, const SortRecord *b, int descending) {
+    if (a->is_text != b->is_text) {
+        return a->is_text < b->is_text;
+    }
+    if (a->is_text) {
+        int order = compare_text(a, b);
+        if (order != 0) {
+            return descending ? order > 0 : order < 0;
+        }
+    } else if (a->key != b->key) {
+        return descending ? reverse_key(a->key) < reverse_key(b->key) : a->key < b->key;
+    }
+    return a->index < b->index;
+}
+
+#define RECORD_ASCENDING(a, b) record_before(&(a), &(b), 0)
+#define RECORD_DESCENDING(a, b) record_before(&(a), &(b), 1)
+DEFINE_PDQSORT(pdqsort_records_ascending, SortRecord, RECORD_ASCENDING)
+DEFINE_PDQSORT(pdqsort_records_descending, SortRecord, RECORD_DESCENDING)
+
+void sort_records(SortRecord *records, size_t n, int descending) {
+    if (descending) {
+        pdqsort_records_descending(records, n);
+    } else {
+        pdqsort_records_ascending(records, n);
+    }
+}
+
+// lsd radix sort with scratch room for n keys. the keys end up sorted
+// in keys.
+static void radix_sort(uint64_t *keys, uint64_t *scratch, size_t n) {
+    static const int bytes = 8;
+    size_t (*counts)[256] = calloc((size_t)bytes, sizeof(*counts));
+    if (!counts) {
+        pdqsort_keys(keys, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = keys[i];
+        for (int b = 0; b < bytes; b++) {
+            counts[b][(key >> (8 * b)) & 0xff]++;
+        }
+    }
+
+    uint64_t *source = keys;
+    uint64_t *target = scratch;
+    for (int b = 0; b < bytes; b++) {
+        size_t *count = counts[b];
+        int shift = 8 * b;
+        if (count[(source[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+        size_t offsets[256];
+        size_t total = 0;
+        for (int v = 0; v < 256; v++) {
+            offsets[v] = total;
+            total += count[v];
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = source[i];
+            target[offsets[(key >> shift) & 0xff]++] = key;
+        }
+        uint64_t *swap = source;
+        source = target;
+        target = swap;
+    }
+    if (source != keys) {
+        memcpy(keys, source, n * sizeof(uint64_t));
+    }
+    free(counts);
+}
+
+static void sort_keys(uint64_t *keys, uint64_t *scratch, size_t n) {
+    // input already in order costs one pass, not eight
+    size_t ordered = 1;
+    while (ordered < n && keys[ordered - 1] <= keys[ordered]) {
+        ordered++;
+    }
+    if (ordered == n) {
+        return;
+    }
+    if (n >= SORT_RADIX_MIN) {
+        radix_sort(keys, scratch, n);
+    } else {
+        pdqsort_keys(keys, n);
+    }
+}
+
+// one slice to sort, or two neighbouring runs to merge into target
+typedef struct {
+    uint64_t *keys;
+    uint64_t *scratch;
+    size_t start;
+    size_t middle;
+    size_t end;
+} SortJob;
+
+static void* sort_slice(void *argument) {
+    SortJob *job = argument;
+    sort_keys(job->keys + job->start, job->scratch + job->start, job->end - job->start);
+    return NULL;
+}
+
+// merge keys[start, middle) and keys[middle, end) into scratch
+static void* merge_runs(void *argument) {
+    SortJob *job = argument;
+    const uint64_t *left = job->keys + job->start;
+    const uint64_t *left_end = job->keys + job->middle;
+    const uint64_t *right = left_end;
+    const uint64_t *right_end = job->keys + job->end;
+    uint64_t *out = job->scratch + job->start;
+    while (left < left_end && right < right_end) {
+        *out++ = *right < *left ? *right++ : *left++;
+    }
+    memcpy(out, left, (size_t)(left_end - left) * sizeof(uint64_t));
+    out += left_end - left;
+    memcpy(out, right, (size_t)(right_end - right) * sizeof(uint64_t));
+    return NULL;
+}
+
+// run work over every job, the first on this thread
+static void run_jobs(SortJob *jobs, size_t count, void *(*work)(void*)) {
+    pthread_t threads[SORT_MAX_THREADS];
+    int started[SORT_MAX_THREADS] = {0};
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, work, &jobs[i]) == 0;
+        if (!started[i]) {
+            work(&jobs[i]);
+        }
+    }
+    work(&jobs[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+// sort slices on their own threads, then merge neighbours in pairs. the
+// sorted keys may end up in either buffer - the one returned.
+static uint64_t* sort_parallel(uint64_t *keys, uint64_t *scratch, size_t n, size_t threads) {
+    size_t bounds[SORT_MAX_THREADS + 1];
+    for (size_t i = 0; i <= threads; i++) {
+        bounds[i] = n / threads * i + (i == threads ? n % threads : 0);
+    }
+    SortJob jobs[SORT_MAX_THREADS];
+    for (size_t i = 0; i < threads; i++) {
+        jobs[i] = (SortJob){keys, scratch, bounds[i], bounds[i], bounds[i + 1]};
+    }
+    run_jobs(jobs, threads, sort_slice);
+
+    size_t runs = threads;
+    while (runs > 1) {
+        size_t pairs = 0;
+        for (size_t i = 0; i + 1 < runs; i += 2) {
+            jobs[pairs++] = (SortJob){keys, scratch, bounds[i], bounds[i + 1], bounds[i + 2]};
+        }
+        // an odd run out is carried across as it is
+        if (runs % 2) {
+            jobs[pairs++] = (SortJob){keys, scratch, bounds[runs - 1], bounds[runs], bounds[runs]};
+        }
+        run_jobs(jobs, pairs, merge_runs);
+
+        size_t merged = 0;
+        for (size_t i = 0; i < runs; i += 2) {
+            bounds[merged++] = bounds[i];
+        }
+        bounds[merged] = n;
+        runs = merged;
+        uint64_t *swap = keys;
+        keys = scratch;
+        scratch = swap;
+    }
+    return keys;
+}
+
+static size_t pick_threads(size_t n, size_t requested) {
+    if (requested == 0) {
+        if (n < SORT_PARALLEL_MIN) {
+            return 1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = cpus > 0 ? (size_t)cpus : 1;
+        // keep every slice worth a thread
+        if (requested > n / (SORT_PARALLEL_MIN / 4)) {
+            requested = n / (SORT_PARALLEL_MIN / 4);
+        }
+    }
+    if (requested > SORT_MAX_THREADS) {
+        requested = SORT_MAX_THREADS;
+    }
+    if (requested > n / 2) {
+        requested = n / 2;
+    }
+    return requested ? requested : 1;
+}
+
+size_t sort_doubles(double *data, size_t n, int descending, size_t threads) {
+    if (n < 2) {
+        return 1;
+    }
+    threads = pick_threads(n, threads);
+
+    // short arrays need no scratch and keep their keys on the stack
+    uint64_t small[SORT_RADIX_MIN];
+    uint64_t *keys = small;
+    uint64_t *scratch = NULL;
+    if (n >= SORT_RADIX_MIN || threads > 1) {
+        keys = malloc(n * sizeof(uint64_t));
+        scratch = malloc(n * sizeof(uint64_t));
+        if (!keys || !scratch) {
+            free(keys);
+            free(scratch);
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = sort_key(data[i]);
+        keys[i] = descending ? reverse_key(key) : key;
+    }
+    uint64_t *sorted = keys;
+    if (threads > 1) {
+        sorted = sort_parallel(keys, scratch, n, threads);
+    } else {
+        sort_keys(keys, scratch, n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        data[i] = sort_number(descending ? reverse_key(sorted[i]) : sorted[i]);
+    }
+
+    if (keys != small) {
+        free(keys);
+        free(scratch);
+    }
+    return threads;
+}
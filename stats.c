@@ -0,0 +1,828 @@
+/*
+ * stats.c - streaming accumulators for shardjs
+ *
+ * nothing here allocates once an accumulator exists, so a script can
+ * feed one rows for as long as it likes. adding an array never goes an
+ * element at a time through the one-value paths: the moments of the
+ * array come from the vector kernels, and the sketch works out a block
+ * of bucket indexes before it touches any counts, so its window moves
+ * at most once a block.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "include/stats.h"
+#include "include/kernels.h"
+
+// 'a' is below 'b' for min - nan wins, and -0 is below 0
+static int lower(double a, double b) {
+    return a < b || a != a || (a == 0.0 && b == 0.0 && signbit(a) && !signbit(b));
+}
+
+static int higher(double a, double b) {
+    return a > b || a != a || (a == 0.0 && b == 0.0 && !signbit(a) && signbit(b));
+}
+
+static void moments_bounds(StatsMoments *moments, double low, double high) {
+    if (lower(low, moments->min)) {
+        moments->min = low;
+    }
+    if (higher(high, moments->max)) {
+        moments->max = high;
+    }
+}
+
+void stats_moments_init(StatsMoments *moments) {
+    moments->count = 0;
+    moments->mean = 0.0;
+    moments->m2 = 0.0;
+    moments->min = INFINITY;
+    moments->max = -INFINITY;
+}
+
+void stats_moments_add(StatsMoments *moments, double x) {
+    moments->count++;
+    double delta = x - moments->mean;
+    moments->mean += delta / (double)moments->count;
+    moments->m2 += delta * (x - moments->mean);
+    moments_bounds(moments, x, x);
+}
+
+void stats_moments_add_batch(StatsMoments *moments, const double *x, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    // two passes over the batch - its mean, then the spread around it
+    StatsMoments batch;
+    batch.count = n;
+    batch.mean = kernel_sum(x, n) / (double)n;
+    batch.m2 = kernel_deviations(x, batch.mean, n);
+    batch.min = kernel_min(x, n);
+    batch.max = kernel_max(x, n);
+    stats_moments_merge(moments, &batch);
+}
+
+void stats_moments_merge(StatsMoments *moments, const StatsMoments *other) {
+    StatsMoments added = *other;
+    if (added.count == 0) {
+        return;
+    }
+    moments_bounds(moments, added.min, added.max);
+    if (moments->count == 0) {
+        moments->count = added.count;
+        moments->mean = added.mean;
+        moments->m2 = added.m2;
+        return;
+    }
+    double before = (double)moments->count;
+    double count = (double)added.count;
+    double total = before + count;
+    double delta = added.mean - moments->mean;
+    moments->mean += delta * (count / total);
+    moments->m2 += added.m2 + delta * delta * (before * count / total);
+    moments->count += added.count;
+}
+
+double stats_moments_variance(const StatsMoments *moments) {
+    return moments->m2 / (double)(moments->count - 1);
+}
+
+// sketch buckets. a positive double's bit pattern rises with its value,
+// so the pattern shifted right to keep the exponent and the top 'bits'
+// of the mantissa is a bucket index, and a carry out of the mantissa
+// steps into the next power of two just as it should.
+#define MAGNITUDE_MASK 0x7fffffffffffffffULL
+#define SMALLEST_NORMAL 0x0010000000000000ULL
+#define INFINITE_BITS 0x7ff0000000000000ULL
+#define BATCH 256
+
+static uint64_t double_bits(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// the value reported for a bucket - the harmonic mean of its bounds,
+// which is the same relative distance from both
+static double bucket_value(int64_t index, int bits) {
+    double low = bits_double((uint64_t)index << (52 - bits));
+    double high = bits_double((uint64_t)(index + 1) << (52 - bits));
+    return low * (2.0 / (1.0 + low / high));
+}
+
+static void store_init(StatsStore *store, uint64_t *counts, size_t bins) {
+    store->low = 0;
+    store->min_index = 1;
+    store->max_index = 0;
+    store->bins = bins;
+    store->counts = counts;
+}
+
+static int store_empty(const StatsStore *store) {
+    return store->min_index > store->max_index;
+}
+
+// slide the window to start at low. moving up merges every bucket
+// that falls off the bottom into the new first one.
+static void store_move(StatsStore *store, int64_t low) {
+    int64_t bins = (int64_t)store->bins;
+    uint64_t *counts = store->counts;
+    int64_t shift = low - store->low;
+    if (shift > 0) {
+        int64_t kept = shift < bins ? bins - shift - 1 : 0;
+        uint64_t merged = 0;
+        for (int64_t i = 0; i < bins - kept; i++) {
+            merged += counts[i];
+        }
+        memmove(counts + 1, counts + (bins - kept), (size_t)kept * sizeof(uint64_t));
+        memset(counts + 1 + kept, 0, (size_t)(bins - 1 - kept) * sizeof(uint64_t));
+        counts[0] = merged;
+    } else if (shift < 0) {
+        // only done when everything still fits
+        memmove(counts - shift, counts, (size_t)(bins + shift) * sizeof(uint64_t));
+        memset(counts, 0, (size_t)(-shift) * sizeof(uint64_t));
+    }
+    store->low = low;
+    if (store->min_index < low) {
+        store->min_index = low;
+    }
+}
+
+// make room for indexes lowest to highest
+static void store_cover(StatsStore *store, int64_t lowest, int64_t highest) {
+    int64_t bins = (int64_t)store->bins;
+    if (!store_empty(store)) {
+        lowest = store->min_index < lowest ? store->min_index : lowest;
+        highest = store->max_index > highest ? store->max_index : highest;
+    }
+    if (lowest >= store->low && highest < store->low + bins) {
+        return;
+    }
+    int64_t low;
+    if (highest - lowest < bins) {
+        // centred, leaving room to grow either way
+        low = lowest - (bins - (highest - lowest + 1)) / 2;
+    } else {
+        low = highest - bins + 1;
+    }
+    if (store_empty(store)) {
+        store->low = low;
+    } else {
+        store_move(store, low);
+    }
+}
+
+// note that buckets lowest to highest have been counted. anything
+// below the window went into its first bucket.
+static void store_widen(StatsStore *store, int64_t lowest, int64_t highest) {
+    lowest = lowest < store->low ? store->low : lowest;
+    if (store_empty(store)) {
+        store->min_index = lowest;
+        store->max_index = highest;
+        return;
+    }
+    store->min_index = lowest < store->min_index ? lowest : store->min_index;
+    store->max_index = highest > store->max_index ? highest : store->max_index;
+}
+
+// the window already covers index, or index is below it and merges
+// into the first bucket
+static void store_count(StatsStore *store, int64_t index) {
+    store->counts[(index > store->low ? index : store->low) - store->low]++;
+    store_widen(store, index, index);
+}
+
+StatsQuantiles* stats_quantiles_create(double accuracy) {
+    if (!(accuracy >= STATS_SKETCH_MIN_ACCURACY && accuracy <= STATS_SKETCH_MAX_ACCURACY)) {
+        return NULL;
+    }
+    // the fewest mantissa bits that are accurate enough
+    int bits = 1;
+    while (1.0 / (double)((2 << bits) + 1) > accuracy) {
+        bits++;
+    }
+    size_t bins = (size_t)STATS_SKETCH_OCTAVES << bits;
+    StatsQuantiles *sketch = malloc(sizeof(StatsQuantiles));
+    uint64_t *counts = calloc(2 * bins, sizeof(uint64_t));
+    if (!sketch || !counts) {
+        free(sketch);
+        free(counts);
+        return NULL;
+    }
+    sketch->bits = bits;
+    sketch->accuracy = 1.0 / (double)((2 << bits) + 1);
+    sketch->count = 0;
+    sketch->zero_count = 0;
+    sketch->min = INFINITY;
+    sketch->max = -INFINITY;
+    store_init(&sketch->positive, counts, bins);
+    store_init(&sketch->negative, counts + bins, bins);
+    return sketch;
+}
+
+void stats_quantiles_free(StatsQuantiles *sketch) {
+    if (sketch) {
+        free(sketch->positive.counts);
+        free(sketch);
+    }
+}
+
+int stats_quantiles_add(StatsQuantiles *sketch, double x) {
+    uint64_t magnitude = double_bits(x) & MAGNITUDE_MASK;
+    if (magnitude >= INFINITE_BITS) {
+        return 0;
+    }
+    if (magnitude < SMALLEST_NORMAL) {
+        sketch->zero_count++;
+    } else {
+        StatsStore *store = x < 0.0 ? &sketch->negative : &sketch->positive;
+        int64_t index = (int64_t)(magnitude >> (52 - sketch->bits));
+        if (index < store->low || index >= store->low + (int64_t)store->bins) {
+            store_cover(store, index, index);
+        }
+        store_count(store, index);
+    }
+    sketch->count++;
+    sketch->min = x < sketch->min ? x : sketch->min;
+    sketch->max = x > sketch->max ? x : sketch->max;
+    return 1;
+}
+
+size_t stats_quantiles_add_batch(StatsQuantiles *sketch, const double *x, size_t n) {
+    size_t valid = 0;
+    while (valid < n && (double_bits(x[valid]) & MAGNITUDE_MASK) < INFINITE_BITS) {
+        valid++;
+    }
+    if (valid < n) {
+        return valid;
+    }
+
+    // a block at a time: indexes first, with positive ones for positive
+    // values, negated ones for negative values and 0 for zeros
+    int shift = 52 - sketch->bits;
+    int64_t keys[BATCH];
+    for (size_t start = 0; start < valid; start += BATCH) {
+        size_t count = valid - start < BATCH ? valid - start : BATCH;
+        int64_t positive_low = INT64_MAX, positive_high = 0;
+        int64_t negative_low = INT64_MAX, negative_high = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t bits = double_bits(x[start + i]);
+            uint64_t magnitude = bits & MAGNITUDE_MASK;
+            int64_t index = magnitude < SMALLEST_NORMAL ? 0 : (int64_t)(magnitude >> shift);
+            if (bits >> 63) {
+                keys[i] = -index;
+                negative_low = index && index < negative_low ? index : negative_low;
+                negative_high = index > negative_high ? index : negative_high;
+            } else {
+                keys[i] = index;
+                positive_low = index && index < positive_low ? index : positive_low;
+                positive_high = index > positive_high ? index : positive_high;
+            }
+        }
+        if (positive_high > 0) {
+            store_cover(&sketch->positive, positive_low, positive_high);
+        }
+        if (negative_high > 0) {
+            store_cover(&sketch->negative, negative_low, negative_high);
+        }
+
+        // then the counts, with the non-empty ranges widened once
+        StatsStore *positive = &sketch->positive, *negative = &sketch->negative;
+        uint64_t zeros = 0;
+        for (size_t i = 0; i < count; i++) {
+            int64_t key = keys[i];
+            if (key > 0) {
+                positive->counts[(key > positive->low ? key : positive->low) - positive->low]++;
+            } else if (key < 0) {
+                negative->counts[(-key > negative->low ? -key : negative->low) - negative->low]++;
+            } else {
+                zeros++;
+            }
+        }
+        if (positive_high > 0) {
+            store_widen(positive, positive_low, positive_high);
+        }
+        if (negative_high > 0) {
+            store_widen(negative, negative_low, negative_high);
+        }
+        sketch->zero_count += zeros;
+    }
+
+    double low = kernel_min(x, valid);
+    double high = kernel_max(x, valid);
+    sketch->min = low < sketch->min ? low : sketch->min;
+    sketch->max = high > sketch->max ? high : sketch->max;
+    sketch->count += valid;
+    return valid;
+}
+
+static double clamp(const StatsQuantiles *sketch, double x) {
+    return x < sketch->min ? sketch->min : x > sketch->max ? sketch->max : x;
+}
+
+// walk the buckets from the most negative value up until more than
+// rank values have gone by
+double stats_quantiles_quantile(const StatsQuantiles *sketch, double q) {
+    if (q <= 0.0) {
+        return sketch->min;
+    }
+    if (q >= 1.0) {
+        return sketch->max;
+    }
+    double rank = q * (double)(sketch->count - 1);
+    double seen = 0.0;
+
+    const StatsStore *store = &sketch->negative;
+    for (int64_t i = store->max_index; i >= store->min_index; i--) {
+        seen += (double)store->counts[i - store->low];
+        if (seen > rank) {
+            return clamp(sketch, -bucket_value(i, sketch->bits));
+        }
+    }
+    seen += (double)sketch->zero_count;
+    if (seen > rank) {
+        return clamp(sketch, 0.0);
+    }
+    store = &sketch->positive;
+    for (int64_t i = store->min_index; i <= store->max_index; i++) {
+        seen += (double)store->counts[i - store->low];
+        if (seen > rank) {
+            return clamp(sketch, bucket_value(i, sketch->bits));
+        }
+    }
+    return sketch->max;
+}
+
+static void store_merge(StatsStore *store, const StatsStore *other) {
+    if (store_empty(other)) {
+        return;
+    }
+    int64_t lowest = other->min_index, highest = other->max_index;
+    store_cover(store, lowest, highest);
+    for (int64_t i = lowest; i <= highest; i++) {
+        store->counts[(i > store->low ? i : store->low) - store->low] += other->counts[i - other->low];
+    }
+    store_widen(store, lowest, highest);
+}
+
+int stats_quantiles_merge(StatsQuantiles *sketch, const StatsQuantiles *other) {
+    if (sketch->bits != other->bits) {
+        return 0;
+    }
+    // other may be sketch itself, so its totals are read first
+    uint64_t count = other->count, zero_count = other->zero_count;
+    store_merge(&sketch->positive, &other->positive);
+    store_merge(&sketch->negative, &other->negative);
+    sketch->count += count;
+    sketch->zero_count += zero_count;
+    sketch->min = other->min < sketch->min ? other->min : sketch->min;
+    sketch->max = other->max > sketch->max ? other->max : sketch->max;
+    return 1;
+}
+
+StatsDistinct* stats_distinct_create(int precision) {
+    if (precision < STATS_DISTINCT_MIN_PRECISION || precision > STATS_DISTINCT_MAX_PRECISION) {
+        return NULL;
+    }
+    StatsDistinct *distinct = calloc(1, sizeof(StatsDistinct) + ((size_t)1 << precision));
+    if (distinct) {
+        distinct->precision = precision;
+    }
+    return distinct;
+}
+
+void stats_distinct_free(StatsDistinct *distinct) {
+    free(distinct);
+}
+
+// the top bits pick a register, which keeps the longest run of leading
+// zeros seen in the rest. the bit or'd in stops a run at the end.
+void stats_distinct_add_hash(StatsDistinct *distinct, uint64_t hash) {
+    int precision = distinct->precision;
+    uint64_t rest = (hash << precision) | ((uint64_t)1 << (precision - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    uint8_t *reg = &distinct->registers[hash >> (64 - precision)];
+    if (rank > *reg) {
+        *reg = rank;
+    }
+}
+
+void stats_distinct_add_numbers(StatsDistinct *distinct, const double *x, size_t n) {
+    uint64_t hashes[BATCH];
+    for (size_t start = 0; start < n; start += BATCH) {
+        size_t count = n - start < BATCH ? n - start : BATCH;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = stats_hash_number(x[start + i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            stats_distinct_add_hash(distinct, hashes[i]);
+        }
+    }
+}
+
+double stats_distinct_estimate(const StatsDistinct *distinct) {
+    size_t m = (size_t)1 << distinct->precision;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < m; i++) {
+        // 2^-rank, built directly
+        sum += bits_double((uint64_t)(1023 - distinct->registers[i]) << 52);
+        zeros += distinct->registers[i] == 0;
+    }
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / (double)m);
+    double estimate = alpha * (double)m * (double)m / sum;
+    // few values - count the empty registers instead
+    if (estimate <= 2.5 * (double)m && zeros > 0) {
+        estimate = (double)m * log((double)m / (double)zeros);
+    }
+    return estimate;
+}
+
+int stats_distinct_merge(StatsDistinct *distinct, const StatsDistinct *other) {
+    if (distinct->precision != other->precision) {
+        return 0;
+    }
+    size_t m = (size_t)1 << distinct->precision;
+    for (size_t i = 0; i < m; i++) {
+        distinct->registers[i] = other->registers[i] > distinct->registers[i] ? other->registers[i] : distinct->registers[i];
+    }
+    return 1;
+}
+
+// hdr histogram. values below sub_buckets fill the first range one to
+// a bucket; past that each power of two has half as many buckets,
+// twice as wide as the ones in the power below.
+static int histogram_bucket(const StatsHistogram *histogram, uint64_t value) {
+    return 63 - histogram->half_magnitude - __builtin_clzll(value | (uint64_t)histogram->sub_bucket_mask);
+}
+
+static size_t histogram_index(const StatsHistogram *histogram, uint64_t value) {
+    int bucket = histogram_bucket(histogram, value);
+    int64_t sub_bucket = (int64_t)(value >> bucket);
+    return (size_t)((((int64_t)bucket + 1) << histogram->half_magnitude) + sub_bucket - histogram->sub_buckets / 2);
+}
+
+// the lowest value counted at index, and the width of its bucket
+static uint64_t histogram_value(const StatsHistogram *histogram, size_t index, uint64_t *width) {
+    int64_t half = histogram->sub_buckets / 2;
+    int bucket = (int)(index >> histogram->half_magnitude) - 1;
+    int64_t sub_bucket = (int64_t)(index & (size_t)(half - 1)) + half;
+    if (bucket < 0) {
+        sub_bucket -= half;
+        bucket = 0;
+    }
+    *width = (uint64_t)1 << bucket;
+    return (uint64_t)sub_bucket << bucket;
+}
+
+StatsHistogram* stats_histogram_create(double highest, int digits) {
+    if (digits < STATS_HISTOGRAM_MIN_DIGITS || digits > STATS_HISTOGRAM_MAX_DIGITS ||
+        !(highest >= 2.0 && highest <= STATS_HISTOGRAM_MAX_HIGHEST)) {
+        return NULL;
+    }
+    // enough sub-buckets to tell apart every whole number up to 2 * 10^digits
+    int64_t single_unit = 2;
+    for (int i = 0; i < digits; i++) {
+        single_unit *= 10;
+    }
+    int magnitude = 0;
+    while (((int64_t)1 << magnitude) < single_unit) {
+        magnitude++;
+    }
+    int64_t sub_buckets = (int64_t)1 << magnitude;
+
+    // then one power of two after another until highest fits
+    int64_t top = (int64_t)highest;
+    size_t buckets = 1;
+    for (int64_t untrackable = sub_buckets; untrackable <= top; untrackable <<= 1) {
+        buckets++;
+    }
+    size_t length = (buckets + 1) * (size_t)(sub_buckets / 2);
+
+    StatsHistogram *histogram = calloc(1, sizeof(StatsHistogram) + length * sizeof(uint64_t));
+    if (!histogram) {
+        return NULL;
+    }
+    histogram->highest = top;
+    histogram->digits = digits;
+    histogram->half_magnitude = magnitude - 1;
+    histogram->sub_buckets = sub_buckets;
+    histogram->sub_bucket_mask = sub_buckets - 1;
+    histogram->length = length;
+    histogram->min = INT64_MAX;
+    histogram->max = -1;
+    return histogram;
+}
+
+void stats_histogram_free(StatsHistogram *histogram) {
+    free(histogram);
+}
+
+static int histogram_takes(const StatsHistogram *histogram, double x) {
+    return x >= 0.0 && x < (double)histogram->highest + 1.0;
+}
+
+static void histogram_record(StatsHistogram *histogram, uint64_t value, uint64_t count) {
+    histogram->counts[histogram_index(histogram, value)] += count;
+    histogram->count += count;
+    histogram->sum += (double)value * (double)count;
+    histogram->min = (int64_t)value < histogram->min ? (int64_t)value : histogram->min;
+    histogram->max = (int64_t)value > histogram->max ? (int64_t)value : histogram->max;
+}
+
+int stats_histogram_add(StatsHistogram *histogram, double x) {
+    if (!histogram_takes(histogram, x)) {
+        return 0;
+    }
+    histogram_record(histogram, (uint64_t)x, 1);
+    return 1;
+}
+
+size_t stats_histogram_add_batch(StatsHistogram *histogram, const double *x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (!histogram_takes(histogram, x[i])) {
+            return i;
+        }
+    }
+    // the totals are kept in locals so the loop is only the counting
+    int64_t low = histogram->min, high = histogram->max;
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t value = (uint64_t)x[i];
+        histogram->counts[histogram_index(histogram, value)]++;
+        sum += (double)value;
+        low = (int64_t)value < low ? (int64_t)value : low;
+        high = (int64_t)value > high ? (int64_t)value : high;
+    }
+    histogram->count += n;
+    histogram->sum += sum;
+    histogram->min = low;
+    histogram->max = high;
+    return n;
+}
+
+double stats_histogram_quantile(const StatsHistogram *histogram, double q) {
+    if (q <= 0.0) {
+        return (double)histogram->min;
+    }
+    if (q >= 1.0) {
+        return (double)histogram->max;
+    }
+    uint64_t target = (uint64_t)(q * (double)histogram->count + 0.5);
+    target = target < 1 ? 1 : target;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < histogram->length; i++) {
+        seen += histogram->counts[i];
+        if (seen >= target) {
+            uint64_t width;
+            uint64_t highest = histogram_value(histogram, i, &width) + width - 1;
+            return (double)((int64_t)highest < histogram->max ? (int64_t)highest : histogram->max);
+        }
+    }
+    return (double)histogram->max;
+}
+
+int stats_histogram_merge(StatsHistogram *histogram, const StatsHistogram *other) {
+    if (other->count == 0) {
+        return 1;
+    }
+    if (other->max > histogram->highest) {
+        return 0;
+    }
+    // other may be histogram itself
+    uint64_t count = other->count;
+    double sum = other->sum;
+    int64_t low = other->min, high = other->max;
+    if (other->digits == histogram->digits && other->highest == histogram->highest) {
+        for (size_t i = 0; i < histogram->length; i++) {
+            histogram->counts[i] += other->counts[i];
+        }
+    } else {
+        for (size_t i = 0; i < other->length; i++) {
+            if (other->counts[i]) {
+                uint64_t width;
+                uint64_t value = histogram_value(other, i, &width);
+                histogram->counts[histogram_index(histogram, value)] += other->counts[i];
+            }
+        }
+    }
+    histogram->count += count;
+    histogram->sum += sum;
+    histogram->min = low < histogram->min ? low : histogram->min;
+    histogram->max = high > histogram->max ? high : histogram->max;
+    return 1;
+}
+
+// the encoded form
+#define HISTOGRAM_MAGIC "hd1"
+
+static const char base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint8_t* put_varint(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static uint8_t* put_signed(uint8_t *out, int64_t value) {
+    return put_varint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+char* stats_histogram_encode(const StatsHistogram *histogram, size_t *length) {
+    size_t used = histogram->length;
+    while (used > 0 && histogram->counts[used - 1] == 0) {
+        used--;
+    }
+    uint8_t *bytes = malloc(64 + 10 * used);
+    if (!bytes) {
+        return NULL;
+    }
+    uint8_t *out = bytes;
+    memcpy(out, HISTOGRAM_MAGIC, 3);
+    out += 3;
+    out = put_varint(out, (uint64_t)histogram->digits);
+    out = put_varint(out, (uint64_t)histogram->highest);
+    out = put_varint(out, histogram->count ? (uint64_t)histogram->min : 0);
+    out = put_varint(out, histogram->count ? (uint64_t)histogram->max : 0);
+    out = put_varint(out, double_bits(histogram->sum));
+    out = put_varint(out, used);
+    for (size_t i = 0; i < used; ) {
+        if (histogram->counts[i]) {
+            out = put_signed(out, (int64_t)histogram->counts[i++]);
+            continue;
+        }
+        int64_t run = 0;
+        while (i < used && histogram->counts[i] == 0) {
+            run++;
+            i++;
+        }
+        out = put_signed(out, -run);
+    }
+
+    size_t size = (size_t)(out - bytes);
+    char *text = malloc((size + 2) / 3 * 4 + 1);
+    if (!text) {
+        free(bytes);
+        return NULL;
+    }
+    char *cursor = text;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t group = (uint32_t)bytes[i] << 16;
+        group |= i + 1 < size ? (uint32_t)bytes[i + 1] << 8 : 0;
+        group |= i + 2 < size ? (uint32_t)bytes[i + 2] : 0;
+        *cursor++ = base64_digits[group >> 18 & 63];
+        *cursor++ = base64_digits[group >> 12 & 63];
+        *cursor++ = i + 1 < size ? base64_digits[group >> 6 & 63] : '=';
+        *cursor++ = i + 2 < size ? base64_digits[group & 63] : '=';
+    }
+    *cursor = '\0';
+    free(bytes);
+    *length = (size_t)(cursor - text);
+    return text;
+}
+
+static int base64_value(char c) {
+    const char *found = c ? strchr(base64_digits, c) : NULL;
+    return found ? (int)(found - base64_digits) : -1;
+}
+
+// reading the bytes back - every read checks it stays in bounds
+typedef struct {
+    const uint8_t *at;
+    const uint8_t *end;
+    int ok;
+} Reader;
+
+static uint64_t get_varint(Reader *reader) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (reader->at == reader->end) {
+            break;
+        }
+        uint8_t byte = *reader->at++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    reader->ok = 0;
+    return 0;
+}
+
+static int64_t get_signed(Reader *reader) {
+    uint64_t value = get_varint(reader);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+StatsHistogram* stats_histogram_decode(const char *text, size_t length) {
+    if (length == 0 || length % 4 != 0) {
+        return NULL;
+    }
+    uint8_t *bytes = malloc(length / 4 * 3);
+    if (!bytes) {
+        return NULL;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        int padding = (text[i + 3] == '=') + (text[i + 2] == '=');
+        int a = base64_value(text[i]), b = base64_value(text[i + 1]);
+        int c = padding == 2 ? 0 : base64_value(text[i + 2]);
+        int d = padding >= 1 ? 0 : base64_value(text[i + 3]);
+        if (a < 0 || b < 0 || c < 0 || d < 0 || (padding && i + 4 != length) ||
+            (padding == 1 && text[i + 2] == '=')) {
+            free(bytes);
+            return NULL;
+        }
+        uint32_t group = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | (uint32_t)d;
+        bytes[size++] = (uint8_t)(group >> 16);
+        if (padding < 2) {
+            bytes[size++] = (uint8_t)(group >> 8);
+        }
+        if (padding < 1) {
+            bytes[size++] = (uint8_t)group;
+        }
+    }
+
+    Reader reader = { bytes, bytes + size, 1 };
+    StatsHistogram *histogram = NULL;
+    if (size < 3 || memcmp(bytes, HISTOGRAM_MAGIC, 3) != 0) {
+        free(bytes);
+        return NULL;
+    }
+    reader.at += 3;
+    uint64_t digits = get_varint(&reader);
+    uint64_t highest = get_varint(&reader);
+    uint64_t min = get_varint(&reader);
+    uint64_t max = get_varint(&reader);
+    double sum = bits_double(get_varint(&reader));
+    uint64_t used = get_varint(&reader);
+    if (reader.ok && digits <= STATS_HISTOGRAM_MAX_DIGITS && highest <= (uint64_t)STATS_HISTOGRAM_MAX_HIGHEST) {
+        histogram = stats_histogram_create((double)highest, (int)digits);
+    }
+    if (!histogram || used > histogram->length || min > max || max > highest) {
+        stats_histogram_free(histogram);
+        free(bytes);
+        return NULL;
+    }
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < used && reader.ok; ) {
+        int64_t entry = get_signed(&reader);
+        if (entry > 0) {
+            histogram->counts[i++] = (uint64_t)entry;
+            count += (uint64_t)entry;
+        } else if (entry < 0 && (uint64_t)-entry <= used - i) {
+            i += (size_t)-entry;
+        } else {
+            reader.ok = 0;
+        }
+    }
+    if (!reader.ok || reader.at != reader.end) {
+        stats_histogram_free(histogram);
+        free(bytes);
+        return NULL;
+    }
+    free(bytes);
+    histogram->count = count;
+    histogram->sum = sum;
+    if (count) {
+        histogram->min = (int64_t)min;
+        histogram->max = (int64_t)max;
+    }
+    return histogram;
+}
+
+// murmur3's finaliser
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t stats_hash_number(double x) {
+    uint64_t bits = x != x ? 0x7ff8000000000000ULL : x == 0.0 ? 0 : double_bits(x);
+    return mix64(bits + 0x9e3779b97f4a7c15ULL);
+}
+
+// fnv-1a, then mixed with a different constant from numbers
+uint64_t stats_hash_bytes(const char *chars, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)chars[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mix64(h ^ 0x6a09e667f3bcc909ULL);
+}
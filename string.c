@@ -0,0 +1,345 @@
+/*
+ * string.c - string values for shardjs
+ *
+ * strings up to STRING_INLINE_MAX bytes live inside their object, longer
+ * ones own a separate buffer. concatenation of long strings just links
+ * the two halves in a rope node, so building a string piece by piece is
+ * linear; the rope is flattened in place the first time its characters
+ * are needed. literals are interned so each distinct one exists once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/object.h"
+
+static StringObject* string_allocate(StringKind kind, size_t length, int pinned) {
+    StringObject *string = pinned ? heap_allocate_pinned(OBJ_STRING, sizeof(StringObject))
+                                  : heap_allocate(OBJ_STRING, sizeof(StringObject));
+    if (!string) {
+        return NULL;
+    }
+    string->kind = (uint8_t)kind;
+    string->length = (uint32_t)length;
+    return string;
+}
+
+static Value string_create(const char *chars, size_t length, int pinned) {
+    if (length > UINT32_MAX) {
+        return VALUE_NULL;
+    }
+
+    if (length <= STRING_INLINE_MAX) {
+        StringObject *string = string_allocate(STRING_INLINE, length, pinned);
+        if (!string) {
+            return VALUE_NULL;
+        }
+        memcpy(string->as.inline_chars, chars, length);
+        string->as.inline_chars[length] = '\0';
+        return value_from_pointer(string);
+    }
+
+    char *buffer = malloc(length + 1);
+    if (!buffer) {
+        return VALUE_NULL;
+    }
+    StringObject *string = string_allocate(STRING_FLAT, length, pinned);
+    if (!string) {
+        free(buffer);
+        return VALUE_NULL;
+    }
+    memcpy(buffer, chars, length);
+    buffer[length] = '\0';
+    string->as.chars = buffer;
+    return value_from_pointer(string);
+}
+
+// a new inline or flat string holding a copy of chars
+Value string_from_chars(const char *chars, size_t length) {
+    return string_create(chars, length, 0);
+}
+
+void string_release(StringObject *string) {
+    if (string->kind == STRING_FLAT) {
+        free(string->as.chars);
+    }
+}
+
+// copy the characters of a rope into buffer, left to right. ropes built
+// in a loop are as deep as the loop is long, so this walks with its own
+// stack instead of recursing.
+static int rope_copy(StringObject *root, char *buffer) {
+    size_t capacity = 64;
+    size_t top = 0;
+    StringObject **stack = malloc(capacity * sizeof(StringObject*));
+    if (!stack) {
+        return 0;
+    }
+
+    stack[top++] = root;
+    while (top > 0) {
+        StringObject *node = stack[--top];
+        switch (node->kind) {
+            case STRING_INLINE:
+                memcpy(buffer, node->as.inline_chars, node->length);
+                buffer += node->length;
+                break;
+            case STRING_FLAT:
+                memcpy(buffer, node->as.chars, node->length);
+                buffer += node->length;
+                break;
+            case STRING_ROPE:
+                if (top + 2 > capacity) {
+                    capacity *= 2;
+                    StringObject **grown = realloc(stack, capacity * sizeof(StringObject*));
+                    if (!grown) {
+                        free(stack);
+                        return 0;
+                    }
+                    stack = grown;
+                }
+                // right goes under left so left is copied first
+                stack[top++] = node->as.rope.right;
+                stack[top++] = node->as.rope.left;
+                break;
+        }
+    }
+
+    free(stack);
+    return 1;
+}
+
+// turn a rope into a flat string in place - returns 0 when out of memory
+static int string_flatten(StringObject *string) {
+    if (string->kind != STRING_ROPE) {
+        return 1;
+    }
+
+    char *buffer = malloc((size_t)string->length + 1);
+    if (!buffer) {
+        return 0;
+    }
+    if (!rope_copy(string, buffer)) {
+        free(buffer);
+        return 0;
+    }
+    buffer[string->length] = '\0';
+
+    // the halves are dropped, which a background marker has to hear about
+    heap_overwrite_barrier(&string->header, value_from_pointer(string->as.rope.left));
+    heap_overwrite_barrier(&string->header, value_from_pointer(string->as.rope.right));
+    heap_lock_object(&string->header);
+    string->kind = STRING_FLAT;
+    string->as.chars = buffer;
+    heap_unlock_object(&string->header);
+    return 1;
+}
+
+// nul-terminated characters of a string, flattening it if needed.
+// NULL when a rope can't be flattened for lack of memory.
+const char* string_chars(Value value) {
+    StringObject *string = value_as_string(value);
+    if (!string_flatten(string)) {
+        return NULL;
+    }
+    return string->kind == STRING_INLINE ? string->as.inline_chars : string->as.chars;
+}
+
+size_t string_length(Value value) {
+    return value_as_string(value)->length;
+}
+
+// short results are copied into a fresh inline string, anything longer
+// becomes a rope node in constant time
+Value string_concat(Value left, Value right) {
+    StringObject *left_string = value_as_string(left);
+    StringObject *right_string = value_as_string(right);
+
+    if (left_string->length == 0) {
+        return right;
+    }
+    if (right_string->length == 0) {
+        return left;
+    }
+
+    size_t length = (size_t)left_string->length + right_string->length;
+    if (length > UINT32_MAX) {
+        return VALUE_NULL;
+    }
+
+    // the allocation can move both halves, so they are rooted across it
+    // and looked up again after
+    heap_push_root(&left);
+    heap_push_root(&right);
+    StringObject *string = string_allocate(length <= STRING_INLINE_MAX ? STRING_INLINE : STRING_ROPE, length, 0);
+    heap_pop_roots(2);
+    if (!string) {
+        return VALUE_NULL;
+    }
+    left_string = value_as_string(left);
+    right_string = value_as_string(right);
+
+    if (length <= STRING_INLINE_MAX) {
+        // both halves are inline too, since nothing shorter is ever a rope
+        memcpy(string->as.inline_chars, left_string->as.inline_chars, left_string->length);
+        memcpy(string->as.inline_chars + left_string->length, right_string->as.inline_chars, right_string->length);
+        string->as.inline_chars[length] = '\0';
+        return value_from_pointer(string);
+    }
+
+    string->as.rope.left = left_string;
+    string->as.rope.right = right_string;
+    return value_from_pointer(string);
+}
+
+// the string print() would show for a value
+Value string_from_value(Value value) {
+    if (value_is_string(value)) {
+        return value;
+    }
+    char buffer[64];
+    size_t length = value_format(value, buffer, sizeof(buffer));
+    return string_from_chars(buffer, length);
+}
+
+// fnv-1a, never 0 so 0 can mean "not computed yet"
+static uint32_t hash_chars(const char *chars, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)chars[i];
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// 0 only when a rope could not be flattened to hash it
+uint32_t string_hash(Value value) {
+    StringObject *string = value_as_string(value);
+    if (string->hash == 0) {
+        const char *chars = string_chars(value);
+        if (chars) {
+            string->hash = hash_chars(chars, string->length);
+        }
+    }
+    return string->hash;
+}
+
+int string_equals(Value left, Value right) {
+    if (left == right) {
+        return 1;
+    }
+    StringObject *left_string = value_as_string(left);
+    StringObject *right_string = value_as_string(right);
+    if (left_string->length != right_string->length) {
+        return 0;
+    }
+    if (left_string->hash && right_string->hash && left_string->hash != right_string->hash) {
+        return 0;
+    }
+    const char *left_chars = string_chars(left);
+    const char *right_chars = string_chars(right);
+    return left_chars && right_chars && memcmp(left_chars, right_chars, left_string->length) == 0;
+}
+
+// byte-wise ordering, shorter prefix first
+int string_compare(Value left, Value right) {
+    const char *left_chars = string_chars(left);
+    const char *right_chars = string_chars(right);
+    if (!left_chars || !right_chars) {
+        return 0;
+    }
+    size_t left_length = string_length(left);
+    size_t right_length = string_length(right);
+    size_t shorter = left_length < right_length ? left_length : right_length;
+    int order = memcmp(left_chars, right_chars, shorter);
+    if (order != 0) {
+        return order;
+    }
+    return (left_length > right_length) - (left_length < right_length);
+}
+
+// intern table - open addressing over string objects, power-of-two size.
+// one per thread, like the heap the strings live in
+static __thread StringObject **intern_slots = NULL;
+static __thread size_t intern_capacity = 0;
+static __thread size_t intern_count = 0;
+
+#define INTERN_INITIAL_CAPACITY 64
+
+static StringObject** intern_slot(StringObject **slots, size_t capacity, const char *chars,
+                                  size_t length, uint32_t hash) {
+    size_t mask = capacity - 1;
+    size_t index = hash & mask;
+    while (slots[index]) {
+        StringObject *entry = slots[index];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(string_chars(value_from_pointer(entry)), chars, length) == 0) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+static int intern_grow(void) {
+    size_t new_capacity = intern_capacity == 0 ? INTERN_INITIAL_CAPACITY : intern_capacity * 2;
+    StringObject **new_slots = calloc(new_capacity, sizeof(StringObject*));
+    if (!new_slots) {
+        return 0;
+    }
+    for (size_t i = 0; i < intern_capacity; i++) {
+        StringObject *entry = intern_slots[i];
+        if (entry) {
+            const char *chars = string_chars(value_from_pointer(entry));
+            *intern_slot(new_slots, new_capacity, chars, entry->length, entry->hash) = entry;
+        }
+    }
+    free(intern_slots);
+    intern_slots = new_slots;
+    intern_capacity = new_capacity;
+    return 1;
+}
+
+// the one shared string with these contents
+Value string_intern(const char *chars, size_t length) {
+    if ((intern_count + 1) * 10 > intern_capacity * 7 && !intern_grow()) {
+        return VALUE_NULL;
+    }
+
+    uint32_t hash = hash_chars(chars, length);
+    StringObject **slot = intern_slot(intern_slots, intern_capacity, chars, length, hash);
+    if (*slot) {
+        return value_from_pointer(*slot);
+    }
+
+    // the ast holds literals, so they are pinned rather than collected
+    Value value = string_create(chars, length, 1);
+    if (value_is_null(value)) {
+        return VALUE_NULL;
+    }
+    StringObject *string = value_as_string(value);
+    string->hash = hash;
+    string->interned = 1;
+    *slot = string;
+    intern_count++;
+    return value;
+}
+
+// the interned string with these contents without adding one, or
+// VALUE_NULL when nothing has interned them
+Value string_find_interned(const char *chars, size_t length) {
+    if (intern_capacity == 0) {
+        return VALUE_NULL;
+    }
+    StringObject **slot = intern_slot(intern_slots, intern_capacity, chars, length,
+                                      hash_chars(chars, length));
+    return *slot ? value_from_pointer(*slot) : VALUE_NULL;
+}
+
+// forget the intern table - the strings themselves belong to the heap
+void string_table_destroy(void) {
+    free(intern_slots);
+    intern_slots = NULL;
+    intern_capacity = 0;
+    intern_count = 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * test_array.c - tests for general arrays
+ *
+ * covers the inline elements and the move to a buffer, arrays of
+ * numbers and their switch to values, popping, arrays moving through
+ * the collector, and pushing and popping while old arrays are marked
+ * concurrently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/object.h"
+
+static Value text(const char *chars) {
+    return string_from_chars(chars, strlen(chars));
+}
+
+void test_array_growth() {
+    printf("Testing array growth...\n");
+
+    Value value = array_create(0);
+    heap_push_root(&value);
+    ArrayObject *array = value_as_array(value);
+    assert(array->kind == ARRAY_NUMBERS);
+    assert(array->capacity == ARRAY_INLINE_CAPACITY);
+    assert(array->buffer == NULL);
+
+    // the first elements stay in the object
+    for (int i = 0; i < ARRAY_INLINE_CAPACITY; i++) {
+        assert(array_append(value, value_from_int(i)));
+    }
+    assert(array->buffer == NULL);
+    assert(array_elements(array) == array->inline_elements);
+
+    // then they move to a buffer that doubles
+    assert(array_append(value, value_from_int(ARRAY_INLINE_CAPACITY)));
+    assert(array->buffer != NULL);
+    assert(array->capacity == ARRAY_INLINE_CAPACITY * 2);
+    for (int i = ARRAY_INLINE_CAPACITY + 1; i < 1000; i++) {
+        assert(array_append(value, value_from_int(i)));
+    }
+    assert(array->length == 1000);
+    assert(array->capacity == 1024);
+    for (int i = 0; i < 1000; i++) {
+        assert(value_is_int(array_get(value, (size_t)i)) && value_as_int(array_get(value, (size_t)i)) == i);
+    }
+
+    // a known size is allocated up front
+    Value sized = array_create(100);
+    assert(value_as_array(sized)->capacity == 100);
+    assert(value_as_array(sized)->buffer != NULL);
+    assert(value_as_array(array_create(3))->buffer == NULL);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Array growth test passed\n");
+}
+
+void test_array_kinds() {
+    printf("Testing array element kinds...\n");
+
+    Value value = array_create(0);
+    heap_push_root(&value);
+    ArrayObject *array = value_as_array(value);
+
+    // numbers of either representation stay raw doubles
+    assert(array_append(value, value_from_int(7)));
+    assert(array_append(value, value_from_double(2.5)));
+    assert(array_append(value, value_from_double(-0.0)));
+    array_set(value, 0, value_from_int(8));
+    assert(array->kind == ARRAY_NUMBERS);
+    assert(array_elements(array)[1].number == 2.5);
+    assert(value_as_int(array_get(value, 0)) == 8);
+    assert(value_as_double(array_get(value, 1)) == 2.5);
+    assert(array_get(value, 2) == value_from_double(-0.0));
+
+    // anything else boxes them all, for good
+    array_set(value, 1, text("two"));
+    assert(array->kind == ARRAY_VALUES);
+    assert(value_as_int(array_get(value, 0)) == 8);
+    assert(strcmp(string_chars(array_get(value, 1)), "two") == 0);
+    assert(array_get(value, 2) == value_from_double(-0.0));
+    array_set(value, 1, value_from_int(9));
+    assert(array->kind == ARRAY_VALUES);
+
+    Value mixed = array_create(0);
+    heap_push_root(&mixed);
+    assert(array_append(mixed, value_from_int(1)));
+    assert(array_append(mixed, VALUE_TRUE));
+    assert(value_as_array(mixed)->kind == ARRAY_VALUES);
+    assert(array_get(mixed, 1) == VALUE_TRUE);
+
+    // popping takes from the end
+    Value item;
+    assert(array_pop(mixed, &item) && item == VALUE_TRUE);
+    assert(array_pop(mixed, &item) && value_as_int(item) == 1);
+    assert(!array_pop(mixed, &item));
+    assert(value_as_array(mixed)->length == 0);
+
+    heap_pop_roots(2);
+    heap_destroy();
+    printf("Array kind test passed\n");
+}
+
+void test_array_collection() {
+    printf("Testing arrays through collections...\n");
+
+    // small arrays carry their strings inline when they are copied out
+    // of the nursery; a bigger one has them in its buffer
+    Value small = array_create(0);
+    heap_push_root(&small);
+    Value large = array_create(0);
+    heap_push_root(&large);
+    char chars[32];
+    for (int i = 0; i < 100; i++) {
+        int length = snprintf(chars, sizeof(chars), "element-%d", i);
+        Value element = string_from_chars(chars, (size_t)length);
+        if (i < 3) {
+            array_append(small, element);
+        }
+        array_append(large, element);
+    }
+    Value numbers = array_create(0);
+    heap_push_root(&numbers);
+    for (int i = 0; i < 3; i++) {
+        array_append(numbers, value_from_double(i + 0.5));
+    }
+
+    heap_collect_minor();
+    assert(value_as_array(small)->header.flags & OBJECT_OLD);
+    assert(value_as_array(small)->buffer == NULL);
+    assert(value_as_array(numbers)->buffer == NULL);
+    assert(value_as_double(array_get(numbers, 2)) == 2.5);
+    assert(strcmp(string_chars(array_get(small, 2)), "element-2") == 0);
+    for (int i = 0; i < 100; i++) {
+        snprintf(chars, sizeof(chars), "element-%d", i);
+        assert(strcmp(string_chars(array_get(large, (size_t)i)), chars) == 0);
+    }
+
+    // switching an old array of numbers to values remembers it when a
+    // young value arrives
+    array_set(numbers, 1, text("young"));
+    assert(value_as_array(numbers)->header.flags & OBJECT_REMEMBERED);
+    heap_collect_minor();
+    assert(strcmp(string_chars(array_get(numbers, 1)), "young") == 0);
+    assert(value_as_double(array_get(numbers, 0)) == 0.5);
+
+    // popped strings can be freed
+    size_t before = heap_get_stats().objects;
+    Value item;
+    for (int i = 0; i < 50; i++) {
+        assert(array_pop(large, &item));
+    }
+    heap_collect_major();
+    assert(heap_get_stats().objects == before - 50);
+
+    heap_pop_roots(3);
+    heap_destroy();
+    printf("Array collection test passed\n");
+}
+
+void test_array_concurrent_marking() {
+    printf("Testing arrays changing under the markers...\n");
+
+    heap_set_nursery_size(64u << 10);
+    heap_set_concurrent_marking(1);
+    heap_set_mark_threads(3);
+
+    Value lists = array_create(0);
+    heap_push_root(&lists);
+    for (int i = 0; i < 500; i++) {
+        Value list = array_create(0);
+        heap_push_root(&list);
+        for (int j = 0; j < i % 8; j++) {
+            array_append(list, value_from_int(j));
+        }
+        array_append(lists, list);
+        heap_pop_roots(1);
+    }
+    heap_collect_minor();
+
+    // numbers turn into strings, and strings are popped off and pushed
+    // back onto other arrays, while the old arrays are traced
+    char chars[32];
+    for (int round = 0; round < 3; round++) {
+        heap_start_major();
+        for (size_t i = 0; i < 500; i++) {
+            Value list = array_get(lists, i);
+            heap_push_root(&list);
+            int length = snprintf(chars, sizeof(chars), "r%d-%zu", round, i);
+            Value label = string_from_chars(chars, (size_t)length);
+            assert(array_append(list, label));
+            if (i > 0) {
+                Value previous = array_get(lists, i - 1);
+                Value item;
+                assert(array_pop(previous, &item));
+                heap_push_root(&item);
+                assert(array_append(list, item));
+                heap_pop_roots(1);
+            }
+            heap_pop_roots(1);
+        }
+        heap_collect_major();
+    }
+
+    // each list gained two items a round and lost one, except the last
+    for (size_t i = 0; i < 500; i++) {
+        ArrayObject *list = value_as_array(array_get(lists, i));
+        size_t expected = i % 8 + (i == 0 ? 3 : 6) - (i == 499 ? 0 : 3);
+        assert(list->length == expected);
+        for (size_t j = 0; j < list->length; j++) {
+            Value item = array_get(array_get(lists, i), j);
+            assert(value_is_int(item) || strlen(string_chars(item)) > 0);
+        }
+    }
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Concurrent array test passed\n");
+}
+
+int main() {
+    printf("Running array tests...\n\n");
+
+    test_array_growth();
+    test_array_kinds();
+    test_array_collection();
+    test_array_concurrent_marking();
+
+    printf("All array tests passed!\n");
+    return 0;
+}
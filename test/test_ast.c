@@ -181,6 +181,70 @@ void test_ast_if_stmt_memory_management() {
     printf("Complex if statement memory management passed\n");
 }
 
+void test_ast_hash_consing() {
+    printf("Testing hash-consed expression nodes...\n");
+    
+    ASTConsTable *table = ast_cons_table_create();
+    assert(table != NULL);
+    
+    // x * 2 built twice should come back as the very same node
+    ASTNode *first = ast_cons_binary_op(table, ast_cons_identifier(table, "x"), '*', ast_cons_number(table, 2.0));
+    ASTNode *second = ast_cons_binary_op(table, ast_cons_identifier(table, "x"), '*', ast_cons_number(table, 2.0));
+    assert(first != NULL);
+    assert(first == second);
+    
+    // different operator or operand means a different node
+    ASTNode *other = ast_cons_binary_op(table, ast_cons_identifier(table, "x"), '+', ast_cons_number(table, 2.0));
+    assert(other != first);
+    assert(other->data.binary.left == first->data.binary.left);
+    
+    // 0 and -0 print differently so they must not be merged
+    ASTNode *zero = ast_cons_number(table, 0.0);
+    ASTNode *negative_zero = ast_cons_number(table, -0.0);
+    assert(zero != negative_zero);
+    
+    ASTConsStats stats = ast_cons_table_stats(table);
+    assert(stats.requested == 11);
+    assert(stats.unique == 6);
+    
+    ast_destroy(first);
+    ast_destroy(second);
+    ast_destroy(other);
+    ast_destroy(zero);
+    ast_destroy(negative_zero);
+    ast_cons_table_destroy(table);
+    
+    printf("Hash-consed expression nodes passed\n");
+}
+
+void test_ast_shared_node_lifetime() {
+    printf("Testing shared node lifetime...\n");
+    
+    ASTConsTable *table = ast_cons_table_create();
+    assert(table != NULL);
+    
+    ASTNode *shared = ast_cons_binary_op(table, ast_cons_number(table, 1.0), '+', ast_cons_number(table, 2.0));
+    ASTNode *print_a = ast_create_print_call(ast_retain(shared));
+    ASTNode *print_b = ast_create_print_call(shared);
+    assert(print_a->data.print_arg == print_b->data.print_arg);
+    
+    // the table can go first, the ast keeps its own references
+    ast_cons_table_destroy(table);
+    ast_destroy(print_a);
+    
+    assert(print_b->data.print_arg->type == AST_BINARY_OP);
+    assert(print_b->data.print_arg->data.binary.left->data.number == 1.0);
+    ast_destroy(print_b);
+    
+    // null table falls back to plain unshared nodes
+    ASTNode *plain = ast_cons_number(NULL, 3.0);
+    assert(plain != NULL);
+    assert(plain->refcount == 1);
+    ast_destroy(plain);
+    
+    printf("Shared node lifetime passed\n");
+}
+
 int main() {
     printf("Running AST tests...\n\n");
     
@@ -194,6 +258,8 @@ int main() {
     test_ast_create_if_stmt();
     test_ast_create_if_stmt_no_else();
     test_ast_if_stmt_memory_management();
+    test_ast_hash_consing();
+    test_ast_shared_node_lifetime();
     
     printf("\nAll AST tests passed!\n");
     return 0;
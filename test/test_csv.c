@@ -0,0 +1,169 @@
+/*
+ * test_csv.c - tests for the numeric CSV column reader
+ *
+ * checks the number parser against strtod, the handling of headers,
+ * short rows, blank lines and CRLF endings, and that splitting a file
+ * across threads reads exactly what one thread reads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+#include "../include/csv.h"
+
+static const char *csv_path = "test_csv.csv";
+
+static void write_file(const char *text) {
+    FILE *file = fopen(csv_path, "wb");
+    assert(file != NULL);
+    fputs(text, file);
+    fclose(file);
+}
+
+static int same_bits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static double parse(const char *text) {
+    return csv_parse_number(text, text + strlen(text));
+}
+
+void test_csv_parse_number() {
+    printf("Testing CSV number parsing...\n");
+
+    const char *samples[] = {
+        "0", "-0", "1", "+7", "3.25", "-0.125", ".5", "5.", "1e10", "1E-5", "2.5e+3",
+        "0.1", "0.3", "123456789012345678", "9007199254740993", "1.7976931348623157e308",
+        "4.9e-324", "2.2250738585072014e-308", "0.000000000000000000001234",
+        "3.14159265358979323846264338327950288", "1e400", "-1e-400", "inf", "-nan"
+    };
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        double expected = strtod(samples[i], NULL);
+        double parsed = parse(samples[i]);
+        assert(same_bits(parsed, expected) || (isnan(parsed) && isnan(expected)));
+    }
+
+    // random digit strings must round exactly like strtod
+    char text[64];
+    srand(42);
+    for (int i = 0; i < 20000; i++) {
+        int digits = 1 + rand() % 20;
+        int point = rand() % (digits + 1);
+        int length = 0;
+        for (int d = 0; d < digits; d++) {
+            if (d == point) {
+                text[length++] = '.';
+            }
+            text[length++] = (char)('0' + rand() % 10);
+        }
+        length += snprintf(text + length, sizeof(text) - (size_t)length, "e%d", rand() % 61 - 30);
+        assert(same_bits(parse(text), strtod(text, NULL)));
+    }
+
+    // blanks and junk are NaN; surrounding spaces and \r are fine
+    assert(isnan(parse("")));
+    assert(isnan(parse("  ")));
+    assert(isnan(parse("12abc")));
+    assert(isnan(parse("1e")));
+    assert(isnan(parse("-")));
+    assert(parse(" 42 \r") == 42.0);
+
+    printf("CSV number parsing test passed\n");
+}
+
+void test_csv_read_columns() {
+    printf("Testing CSV column reading...\n");
+
+    write_file("id, \"price\" ,qty\r\n1,2.5,3\r\n2,1e2,\r\n\r\n3,-0.125\r\n4,x,9");
+    const char *names[] = { "qty", "price" };
+    double *columns[2];
+    CsvResult result;
+    char error[256];
+    assert(csv_read_columns(csv_path, names, 2, 1, columns, &result, error, sizeof(error)));
+    assert(result.rows == 4);
+
+    // qty: 3, empty, missing, 9
+    assert(columns[0][0] == 3.0);
+    assert(isnan(columns[0][1]));
+    assert(isnan(columns[0][2]));
+    assert(columns[0][3] == 9.0);
+    // price: 2.5, 100, -0.125, junk
+    assert(columns[1][0] == 2.5);
+    assert(columns[1][1] == 100.0);
+    assert(columns[1][2] == -0.125);
+    assert(isnan(columns[1][3]));
+    free(columns[0]);
+    free(columns[1]);
+
+    // a header with no rows gives empty columns
+    write_file("a,b\n");
+    assert(csv_read_columns(csv_path, names + 1, 0, 1, columns, &result, error, sizeof(error)));
+    assert(result.rows == 0);
+
+    const char *missing[] = { "a", "nope" };
+    assert(!csv_read_columns(csv_path, missing, 2, 1, columns, &result, error, sizeof(error)));
+    assert(strcmp(error, "no column named 'nope'") == 0);
+
+    const char *twice[] = { "a", "a" };
+    assert(!csv_read_columns(csv_path, twice, 2, 1, columns, &result, error, sizeof(error)));
+
+    unlink(csv_path);
+    assert(!csv_read_columns(csv_path, names, 2, 1, columns, &result, error, sizeof(error)));
+    assert(strstr(error, "cannot open") != NULL);
+
+    printf("CSV column reading test passed\n");
+}
+
+void test_csv_threads_agree() {
+    printf("Testing threaded CSV reading...\n");
+
+    // uneven rows so chunk boundaries land mid-line
+    FILE *file = fopen(csv_path, "wb");
+    assert(file != NULL);
+    fputs("x,label,y\n", file);
+    for (int i = 0; i < 5000; i++) {
+        if (i % 97 == 0) {
+            fputs("\n", file);
+        }
+        fprintf(file, "%d.%d,row-%d,%g\n", i, i % 7, i * 31, i * 0.001);
+    }
+    fclose(file);
+
+    const char *names[] = { "y", "x" };
+    double *single[2];
+    double *split[2];
+    CsvResult one;
+    CsvResult many;
+    char error[256];
+    assert(csv_read_columns(csv_path, names, 2, 1, single, &one, error, sizeof(error)));
+    assert(csv_read_columns(csv_path, names, 2, 4, split, &many, error, sizeof(error)));
+    assert(one.rows == 5000 && many.rows == 5000);
+    assert(one.threads == 1 && many.threads == 4);
+    for (int c = 0; c < 2; c++) {
+        assert(memcmp(single[c], split[c], 5000 * sizeof(double)) == 0);
+    }
+    assert(single[1][4321] == strtod("4321.2", NULL));
+    assert(single[0][10] == strtod("0.01", NULL));
+
+    for (int c = 0; c < 2; c++) {
+        free(single[c]);
+        free(split[c]);
+    }
+    unlink(csv_path);
+    printf("Threaded CSV reading test passed\n");
+}
+
+int main() {
+    printf("Running CSV tests...\n\n");
+
+    test_csv_parse_number();
+    test_csv_read_columns();
+    test_csv_threads_agree();
+
+    printf("All CSV tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * test_hash.c - tests for hashing and shard assignment
+ *
+ * the vector kernels must hash every number to the same bits as the
+ * inline scalar version. the hashes are checked for collisions among
+ * nearby inputs and for avalanche, and the two consistent hashes for
+ * even spreads and for moving only the keys they have to when the
+ * buckets or nodes change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/hash.h"
+#include "../include/kernels.h"
+
+static int popcount(uint64_t x) {
+    return __builtin_popcountll(x);
+}
+
+static int compare_hashes(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// no two of n hashes alike
+static int all_different(uint64_t *hashes, size_t n) {
+    qsort(hashes, n, sizeof(uint64_t), compare_hashes);
+    for (size_t i = 1; i < n; i++) {
+        if (hashes[i] == hashes[i - 1]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void test_hash_numbers() {
+    printf("Testing number hashes...\n");
+
+    assert(hash_number(0.0, 0) == hash_number(-0.0, 0));
+    assert(hash_number(NAN, 0) == hash_number(-NAN, 0));
+    assert(hash_number(1.0, 0) != hash_number(1.0, 1));
+    assert(hash_number(1.0, 0) != hash_number(2.0, 0));
+
+    // small integers, the usual ids, never collide
+    size_t n = 100000;
+    uint64_t *hashes = malloc(n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = hash_number((double)i, 0);
+    }
+    assert(all_different(hashes, n));
+
+    // every vector path gives the scalar bits, tails and special values
+    // included
+    double x[67];
+    for (int i = 0; i < 67; i++) {
+        x[i] = i % 11 == 0 ? -0.0 : i % 13 == 0 ? NAN : i % 17 == 0 ? INFINITY : (double)i * 1.25 - 30.0;
+    }
+    KernelIsa isas[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            printf("  %s not available, skipped\n", kernel_isa_name(isas[k]));
+            continue;
+        }
+        for (size_t length = 0; length <= 67; length++) {
+            for (size_t offset = 0; offset < 2 && offset + length <= 67; offset++) {
+                uint64_t out[67];
+                hash_numbers(x + offset, length, 12345, out);
+                for (size_t i = 0; i < length; i++) {
+                    assert(out[i] == hash_number(x[offset + i], 12345));
+                }
+            }
+        }
+    }
+    assert(kernel_use_isa(kernel_best_isa()));
+
+    free(hashes);
+    printf("Number hash test passed\n");
+}
+
+void test_hash_bytes() {
+    printf("Testing string hashes...\n");
+
+    // every length through each of the paths, all different
+    char text[200];
+    for (int i = 0; i < 200; i++) {
+        text[i] = (char)('a' + i % 26);
+    }
+    uint64_t hashes[201];
+    for (size_t length = 0; length <= 200; length++) {
+        hashes[length] = hash_bytes(text, length, 0);
+    }
+    assert(all_different(hashes, 201));
+
+    // a string is not the number it spells, nor its eight bytes
+    double one = 1.0;
+    char bytes[8];
+    memcpy(bytes, &one, sizeof(bytes));
+    assert(hash_bytes("1", 1, 0) != hash_number(1.0, 0));
+    assert(hash_bytes(bytes, 8, 0) != hash_number(1.0, 0));
+    assert(hash_bytes("ab", 2, 0) != hash_bytes("ab", 2, 1));
+    assert(hash_bytes("", 0, 0) != hash_bytes("", 0, 1));
+
+    // flipping any one input bit flips about half the output bits
+    size_t lengths[] = { 1, 3, 4, 7, 8, 12, 16, 17, 40, 100 };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t length = lengths[l];
+        uint64_t base = hash_bytes(text, length, 0);
+        int flipped = 0, trials = 0;
+        for (size_t bit = 0; bit < length * 8; bit++) {
+            text[bit / 8] ^= (char)(1 << (bit % 8));
+            flipped += popcount(base ^ hash_bytes(text, length, 0));
+            text[bit / 8] ^= (char)(1 << (bit % 8));
+            trials++;
+        }
+        double average = (double)flipped / (double)trials;
+        assert(average > 26.0 && average < 38.0);
+    }
+
+    // ids written as text, with their common prefixes, never collide
+    size_t n = 100000;
+    uint64_t *many = malloc(n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+        char key[32];
+        int length = snprintf(key, sizeof(key), "user:%zu", i);
+        many[i] = hash_bytes(key, (size_t)length, 0);
+    }
+    assert(all_different(many, n));
+    free(many);
+
+    printf("String hash test passed\n");
+}
+
+void test_hash_jump() {
+    printf("Testing jump hashing...\n");
+
+    assert(hash_jump(12345, 1) == 0);
+
+    // keys spread evenly, and one more bucket takes keys only for itself
+    size_t n = 200000;
+    uint32_t counts[11] = {0};
+    size_t moved = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = hash_number((double)i, 0);
+        uint32_t before = hash_jump(key, 10);
+        uint32_t after = hash_jump(key, 11);
+        assert(before < 10 && after < 11);
+        assert(after == before || after == 10);
+        moved += after != before;
+        counts[before]++;
+    }
+    for (int b = 0; b < 10; b++) {
+        assert(counts[b] > n / 10 * 95 / 100 && counts[b] < n / 10 * 105 / 100);
+    }
+    // a new eleventh bucket takes about an eleventh of the keys
+    assert(moved > n / 11 * 95 / 100 && moved < n / 11 * 105 / 100);
+
+    // large bucket counts stay in range
+    for (size_t i = 0; i < 1000; i++) {
+        assert(hash_jump(hash_number((double)i, 0), 2147483647u) < 2147483647u);
+    }
+
+    printf("Jump hash test passed\n");
+}
+
+void test_hash_rendezvous() {
+    printf("Testing rendezvous hashing...\n");
+
+    uint64_t nodes[5];
+    for (int i = 0; i < 5; i++) {
+        char name[16];
+        int length = snprintf(name, sizeof(name), "db%d", i);
+        nodes[i] = hash_bytes(name, (size_t)length, 0);
+    }
+    assert(hash_rendezvous(99, nodes, 1) == 0);
+
+    // without the last node, only its keys move
+    size_t n = 100000;
+    size_t counts[5] = {0};
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = hash_number((double)i, 0);
+        size_t all = hash_rendezvous(key, nodes, 5);
+        size_t fewer = hash_rendezvous(key, nodes, 4);
+        assert(all < 5 && fewer < 4);
+        assert(all == 4 || fewer == all);
+        counts[all]++;
+    }
+    for (int i = 0; i < 5; i++) {
+        assert(counts[i] > n / 5 * 95 / 100 && counts[i] < n / 5 * 105 / 100);
+    }
+
+    printf("Rendezvous hash test passed\n");
+}
+
+int main() {
+    printf("Running hash tests...\n\n");
+
+    test_hash_numbers();
+    test_hash_bytes();
+    test_hash_jump();
+    test_hash_rendezvous();
+
+    printf("All hash tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,399 @@
+/*
+ * test_heap.c - tests for the garbage collected heap
+ *
+ * covers nursery collection and promotion, the value stack and root
+ * scanners, the write barrier, full collections of the old generation
+ * and pinned literals, parallel and concurrent marking and the pause
+ * histograms.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/object.h"
+
+void test_heap_nursery_collection() {
+    printf("Testing nursery collection...\n");
+
+    Value kept = string_from_chars("kept", 4);
+    const char *text = "a flat string that owns a separate buffer";
+    Value flat = string_from_chars(text, strlen(text));
+    Value garbage = string_from_chars("garbage", 7);
+    (void)garbage;
+    assert(!(value_as_string(kept)->header.flags & OBJECT_OLD));
+    assert(heap_get_stats().objects == 3);
+
+    heap_push_root(&kept);
+    heap_push_root(&flat);
+    Value before = kept;
+    heap_collect_minor();
+
+    // survivors moved to the old generation, the rest is gone
+    HeapStats stats = heap_get_stats();
+    assert(kept != before);
+    assert(value_as_string(kept)->header.flags & OBJECT_OLD);
+    assert(strcmp(string_chars(kept), "kept") == 0);
+    assert(strcmp(string_chars(flat), text) == 0);
+    assert(stats.objects == 2);
+    assert(stats.minor_collections == 1);
+    assert(stats.promoted_bytes == stats.old_bytes);
+
+    // old objects stay put in later nursery collections
+    before = kept;
+    heap_collect_minor();
+    assert(kept == before);
+
+    heap_pop_roots(2);
+    assert(heap_root_depth() == 0);
+    heap_destroy();
+    printf("Nursery collection test passed\n");
+}
+
+void test_heap_shared_and_nested() {
+    printf("Testing promotion of shared objects...\n");
+
+    // a rope and an array both point at the same nursery string, which
+    // must be copied once and both references updated
+    Value left = string_from_chars("0123456789abcdef", 16);
+    Value right = string_from_chars("ghijklmnopqrstuv", 16);
+    heap_push_root(&left);
+    heap_push_root(&right);
+    Value rope = string_concat(left, right);
+    heap_pop_roots(2);
+    Value array = array_create(0);
+    array_append(array, right);
+    array_append(array, rope);
+    heap_push_root(&array);
+
+    heap_collect_minor();
+    ArrayObject *moved = value_as_array(array);
+    StringObject *moved_rope = value_as_string(array_elements(moved)[1].value);
+    assert(moved_rope->kind == STRING_ROPE);
+    assert(moved_rope->as.rope.right == value_as_string(array_elements(moved)[0].value));
+    assert(moved_rope->header.flags & OBJECT_OLD);
+    assert(strcmp(string_chars(array_elements(moved)[1].value), "0123456789abcdefghijklmnopqrstuv") == 0);
+    assert(heap_get_stats().objects == 4);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Shared object promotion test passed\n");
+}
+
+void test_heap_write_barrier() {
+    printf("Testing the write barrier...\n");
+
+    Value array = array_create(2);
+    heap_push_root(&array);
+    heap_collect_minor();
+    ArrayObject *old = value_as_array(array);
+    assert(old->header.flags & OBJECT_OLD);
+
+    // the only reference to this young string is from an old object
+    array_append(array, string_from_chars("young", 5));
+    assert(old->header.flags & OBJECT_REMEMBERED);
+    assert(old->dirty_from == 0);
+    heap_collect_minor();
+    assert(!(old->header.flags & OBJECT_REMEMBERED));
+    assert(value_as_string(array_elements(old)[0].value)->header.flags & OBJECT_OLD);
+    assert(strcmp(string_chars(array_elements(old)[0].value), "young") == 0);
+
+    // storing an old value needs no remembering
+    array_append(array, array_elements(old)[0].value);
+    assert(!(old->header.flags & OBJECT_REMEMBERED));
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Write barrier test passed\n");
+}
+
+static Value scanned_slots[2];
+
+static void scan_test_roots(void *context, HeapVisitor visit) {
+    assert(context == scanned_slots);
+    visit(&scanned_slots[0]);
+    visit(&scanned_slots[1]);
+}
+
+void test_heap_major_collection() {
+    printf("Testing full collections...\n");
+
+    assert(heap_add_root_scanner(scan_test_roots, scanned_slots));
+    scanned_slots[0] = float64_array_create(1000);
+    scanned_slots[1] = value_from_int(7);
+    Value literal = string_intern("literal", 7);
+    assert(value_as_string(literal)->header.flags & OBJECT_PINNED);
+
+    // promote some garbage along with the live array
+    Value temporary = array_create(0);
+    heap_push_root(&temporary);
+    for (int i = 0; i < 10; i++) {
+        array_append(temporary, string_from_chars("temporary", 9));
+    }
+    heap_collect_minor();
+    heap_pop_roots(1);
+    assert(heap_get_stats().objects == 13);
+
+    // the old garbage goes, the scanned array and the literal stay
+    heap_collect_major();
+    HeapStats stats = heap_get_stats();
+    assert(stats.major_collections == 1);
+    assert(stats.objects == 2);
+    assert(value_as_float64_array(scanned_slots[0])->length == 1000);
+    assert(value_as_int(scanned_slots[1]) == 7);
+    assert(string_intern("literal", 7) == literal);
+    assert(!(value_as_float64_array(scanned_slots[0])->header.flags & OBJECT_MARKED));
+
+    heap_remove_root_scanner(scan_test_roots, scanned_slots);
+    heap_collect_major();
+    assert(heap_get_stats().objects == 1);
+
+    heap_destroy();
+    printf("Full collection test passed\n");
+}
+
+void test_heap_automatic_collection() {
+    printf("Testing collection on allocation...\n");
+
+    // a small nursery fills quickly; a list of every tenth string keeps
+    // some of them alive through many collections
+    heap_set_nursery_size(4096);
+    Value list = array_create(0);
+    heap_push_root(&list);
+    char text[32];
+    for (int i = 0; i < 20000; i++) {
+        int length = snprintf(text, sizeof(text), "item-%d", i);
+        Value item = string_from_chars(text, (size_t)length);
+        assert(!value_is_null(item));
+        if (i % 10 == 0) {
+            array_append(list, item);
+        }
+    }
+
+    HeapStats stats = heap_get_stats();
+    assert(stats.minor_collections > 100);
+    assert(stats.bytes < 2000 * 64 + 4096);
+    ArrayObject *kept = value_as_array(list);
+    assert(kept->length == 2000);
+    for (size_t i = 0; i < kept->length; i++) {
+        snprintf(text, sizeof(text), "item-%zu", i * 10);
+        assert(strcmp(string_chars(array_elements(kept)[i].value), text) == 0);
+    }
+
+    heap_pop_roots(1);
+    heap_destroy();
+    assert(heap_get_stats().objects == 0);
+    printf("Collection on allocation test passed\n");
+}
+
+// n old arrays of [string, rope] under one rooted array, with as much
+// garbage promoted alongside
+static Value build_old_graph(size_t count) {
+    Value list = array_create(0);
+    heap_push_root(&list);
+    char text[32];
+    for (size_t i = 0; i < count; i++) {
+        Value pair = array_create(2);
+        heap_push_root(&pair);
+        int length = snprintf(text, sizeof(text), "name-%zu", i);
+        Value name = string_from_chars(text, (size_t)length);
+        array_append(pair, name);
+        Value long_name = string_from_chars("a string long enough for a rope", 31);
+        array_append(pair, string_concat(long_name, array_get(pair, 0)));
+        array_append(list, pair);
+        heap_pop_roots(1);
+        string_from_chars("garbage that is promoted too", 28);
+    }
+    heap_collect_minor();
+    heap_pop_roots(1);
+    return list;
+}
+
+static int check_old_graph(Value list, size_t count) {
+    ArrayObject *array = value_as_array(list);
+    char text[64];
+    for (size_t i = 0; i < count; i++) {
+        ArrayObject *pair = value_as_array(array_elements(array)[i].value);
+        snprintf(text, sizeof(text), "name-%zu", i);
+        if (strcmp(string_chars(array_elements(pair)[0].value), text) != 0) {
+            return 0;
+        }
+        snprintf(text, sizeof(text), "a string long enough for a ropename-%zu", i);
+        if (strcmp(string_chars(array_elements(pair)[1].value), text) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void test_heap_parallel_marking() {
+    printf("Testing parallel marking...\n");
+
+    // a nursery big enough that the whole graph is promoted at once
+    heap_set_nursery_size(8u << 20);
+    heap_set_mark_threads(4);
+    Value list = build_old_graph(20000);
+    heap_push_root(&list);
+    size_t live = 1 + 20000 * 4;
+
+    heap_collect_major();
+    HeapStats stats = heap_get_stats();
+    assert(stats.mark_threads == 4);
+    assert(stats.objects == live);
+    assert(check_old_graph(list, 20000));
+
+    // and again with one thread. checking flattened the ropes, so their
+    // left halves are garbage now.
+    heap_set_mark_threads(1);
+    heap_collect_major();
+    assert(heap_get_stats().mark_threads == 1);
+    assert(heap_get_stats().objects == live - 20000);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Parallel marking test passed\n");
+}
+
+void test_heap_concurrent_snapshot() {
+    printf("Testing concurrent marking keeps the snapshot...\n");
+
+    heap_set_concurrent_marking(1);
+    heap_set_mark_threads(2);
+    Value from = array_create(1);
+    Value to = array_create(1);
+    heap_push_root(&from);
+    heap_push_root(&to);
+    array_append(from, string_from_chars("moved while marking", 19));
+    array_append(to, value_from_int(0));
+    heap_collect_minor();
+
+    // the string's only reference moves from an array the markers may
+    // not have reached to one they may have finished with
+    heap_start_major();
+    assert(heap_marking_active);
+    Value moved = array_get(from, 0);
+    array_set(to, 0, moved);
+    array_set(from, 0, value_from_int(0));
+    heap_collect_major();
+    assert(!heap_marking_active);
+    assert(strcmp(string_chars(array_get(to, 0)), "moved while marking") == 0);
+    assert(heap_get_stats().objects == 3);
+
+    // flattening a rope drops its halves the same way
+    Value left = string_from_chars("the left half of a rope", 23);
+    heap_push_root(&left);
+    Value rope = string_concat(left, array_get(to, 0));
+    heap_pop_roots(1);
+    array_set(from, 0, rope);
+    heap_collect_minor();
+    heap_start_major();
+    assert(strcmp(string_chars(array_get(from, 0)),
+                  "the left half of a ropemoved while marking") == 0);
+    array_set(to, 0, value_from_int(0));
+    heap_collect_major();
+    assert(strcmp(string_chars(array_get(from, 0)),
+                  "the left half of a ropemoved while marking") == 0);
+    // from, to and the flattened rope
+    assert(heap_get_stats().objects == 3);
+
+    // left to nursery collections, the marking and then the sweep finish
+    // on their own
+    array_set(from, 0, value_from_int(0));
+    size_t majors = heap_get_stats().major_collections;
+    heap_start_major();
+    while (heap_get_stats().major_collections == majors) {
+        heap_collect_minor();
+    }
+    assert(!heap_marking_active);
+    assert(heap_get_stats().objects == 2);
+
+    heap_pop_roots(2);
+    heap_destroy();
+    printf("Concurrent snapshot test passed\n");
+}
+
+void test_heap_concurrent_mutation() {
+    printf("Testing the program running alongside the markers...\n");
+
+    heap_set_nursery_size(64u << 10);
+    heap_set_concurrent_marking(1);
+    heap_set_mark_threads(3);
+    Value list = build_old_graph(5000);
+    heap_push_root(&list);
+
+    // appending grows the array under the markers, storing replaces
+    // the pairs they trace, and nursery collections promote as they go
+    size_t majors = heap_get_stats().major_collections;
+    for (int round = 0; round < 3; round++) {
+        heap_start_major();
+        char text[32];
+        for (size_t i = 0; i < 5000; i++) {
+            ArrayObject *array = value_as_array(list);
+            Value pair = array_elements(array)[i].value;
+            heap_push_root(&pair);
+            Value copy = array_create(2);
+            heap_push_root(&copy);
+            array_append(copy, array_get(pair, 0));
+            array_append(copy, array_get(pair, 1));
+            array_set(list, i, copy);
+            heap_pop_roots(2);
+            int length = snprintf(text, sizeof(text), "extra-%zu", i);
+            array_append(list, string_from_chars(text, (size_t)length));
+        }
+        heap_collect_major();
+        assert(check_old_graph(list, 5000));
+        assert(value_as_array(list)->length == 5000 * (size_t)(round + 2));
+    }
+    HeapStats stats = heap_get_stats();
+    assert(stats.major_collections >= majors + 6);
+    // the list, the last copies, names, flattened ropes and the extras
+    assert(stats.objects == 1 + 5000 * 3 + 5000 * 3);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Concurrent mutation test passed\n");
+}
+
+void test_heap_pause_histograms() {
+    printf("Testing pause histograms...\n");
+
+    Value kept = string_from_chars("kept", 4);
+    heap_push_root(&kept);
+    for (int i = 0; i < 5; i++) {
+        heap_collect_minor();
+    }
+    heap_collect_major();
+    heap_pop_roots(1);
+
+    HeapStats stats = heap_get_stats();
+    size_t minor = 0;
+    size_t major = 0;
+    for (size_t i = 0; i < HEAP_PAUSE_BUCKETS; i++) {
+        minor += stats.minor_pauses[i];
+        major += stats.major_pauses[i];
+    }
+    assert(minor == 5);
+    assert(major == 1);
+    assert(stats.longest_pause_us >= 0);
+
+    heap_destroy();
+    assert(heap_get_stats().minor_pauses[0] == 0);
+    printf("Pause histogram test passed\n");
+}
+
+int main() {
+    printf("Running heap tests...\n\n");
+
+    test_heap_nursery_collection();
+    test_heap_shared_and_nested();
+    test_heap_write_barrier();
+    test_heap_major_collection();
+    test_heap_automatic_collection();
+    test_heap_parallel_marking();
+    test_heap_concurrent_snapshot();
+    test_heap_concurrent_mutation();
+    test_heap_pause_histograms();
+
+    printf("All heap tests passed!\n");
+    return 0;
+}
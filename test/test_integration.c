@@ -86,6 +86,28 @@ int run_error_test(const char *script_content, const char *test_name) {
     }
 }
 
+// a file of native doubles for the mapping tests
+static int write_doubles(const char *path, const double *values, size_t count) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    size_t written = fwrite(values, sizeof(double), count, file);
+    fclose(file);
+    return written == count;
+}
+
+// a small text file for the csv tests
+static int write_text(const char *path, const char *text) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    int ok = fputs(text, file) >= 0;
+    fclose(file);
+    return ok;
+}
+
 int main() {
     TestResults results = {0, 0};
     
@@ -620,6 +642,624 @@ int main() {
         results.failed++;
     }
     
+    printf("\nConstant Propagation Tests:\n");
+    printf("===========================\n\n");
+    
+    // branches on constant flags are resolved before execution
+    if (run_test_script("let mode = 2;\nif (mode == 2) print(1) else print(2);\nif (mode == 3) print(3);", "1\n", "Constant flag selects branch")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let debug = 0;\nif (debug) let level = 3; else let level = 1;\nprint(level * 10);", "10\n", "Constant branch assignment flows downstream")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let off = 0;\nif (off) let y = 1;\nprint(y);", "Runtime error - variable only set in dead branch")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let zero = 0;\nif (1) print(5 / zero);", "Runtime error - division by zero in constant branch")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    printf("\nInteger Fast Path Tests:\n");
+    printf("========================\n\n");
+    
+    if (run_test_script("let big = 2147483647;\nprint(big + 1);\nprint(big * big);", "2147483648\n4.61168601413242e+18\n", "Integer overflow promotes to double")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let n = 0 - 5;\nprint(0 * n);\nprint(0 / n);", "-0\n-0\n", "Integer arithmetic keeps negative zero")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("print(6 / 3);\nprint(7 / 2);\nprint(1 / 3);", "2\n3.5\n0.333333333333333\n", "Integer division stays exact")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let x = 3;\nlet x = x + 0.5;\nprint(x * 2);\nprint(1.5 + 1.5);", "7\n3\n", "Mixed int and double arithmetic")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    printf("\nString Tests:\n");
+    printf("=============\n\n");
+    
+    if (run_test_script("print(\"hello\");\nlet name = 'world';\nprint(\"hello, \" + name);", "hello\nhello, world\n", "String literals and concatenation")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let n = 3;\nprint(\"n = \" + n + \", half = \" + n / 2);\nprint(1 + 2 + \"!\");", "n = 3, half = 1.5\n3!\n", "Numbers convert when concatenated")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let s = \"\";\nlet s = s + \"0123456789\";\nlet s = s + \"0123456789\";\nlet s = s + \"0123456789\";\nprint(s);", "012345678901234567890123456789\n", "Repeated concatenation")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("print(\"abc\" == \"ab\" + \"c\");\nprint(\"apple\" < \"banana\");\nif (\"\") print(1); else print(2);", "1\n1\n2\n", "String comparison and truthiness")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("print(\"tab\\there\");\nprint('say \\'hi\\'');", "tab\there\nsay 'hi'\n", "String escapes")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("print(\"ab\" * 2);", "Runtime error - string arithmetic")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("print(\"unterminated);", "Parse error - unterminated string")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    printf("\nFloat64Array Tests:\n");
+    printf("===================\n\n");
+    
+    if (run_test_script("let a = Float64Array(4);\na[0] = 1.5;\na[1] = 2;\na[3] = 0 - 4;\nprint(a);\nprint(a[1] * a[0]);", "Float64Array(4) [1.5, 2, 0, -4]\n3\n", "Float64Array creation and indexing")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let a = Float64Array(3);\na[0] = 3; a[1] = 0 - 1; a[2] = 2;\nprint(sum(a));\nprint(min(a));\nprint(max(a));\nprint(dot(a, a));\nprint(length(a));", "4\n-1\n3\n14\n3\n", "Array reductions")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let x = Float64Array(2);\nx[0] = 1; x[1] = 2;\nlet y = scale(Float64Array(2), 0);\naxpy(3, x, y);\nscale(y, 0.5);\nprint(y);", "Float64Array(2) [1.5, 3]\n", "In-place scale and axpy")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("print(min(Float64Array(0)));\nprint(max(Float64Array(0)));\nprint(sum(Float64Array(0)));", "inf\n-inf\n0\n", "Empty array reductions")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let a = Float64Array(2);\nprint(a[2]);", "Runtime error - index out of range")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("print(dot(Float64Array(2), Float64Array(3)));", "Runtime error - mismatched lengths")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("print(nosuch(1));", "Runtime error - unknown function")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    double mapped_values[] = { 1.5, 2.0, -4.0, 0.5 };
+    if (write_doubles("temp_test.bin", mapped_values, 4) &&
+        run_test_script("let a = mapFloat64(\"temp_test.bin\");\nprint(a);\nprint(sum(a));\nprint(dot(a, a) + min(a));\nlet b = Float64Array(length(a));\naxpy(2, a, b);\nprint(b[2]);", "Float64Array(4) [1.5, 2, -4, 0.5]\n0\n18.5\n-8\n", "Mapped file reductions")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let a = mapFloat64(\"temp_test.bin\");\na[0] = 1;", "Runtime error - store into mapped array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_test.bin");
+    
+    if (run_error_test("print(mapFloat64(\"no_such_file.bin\"));", "Runtime error - missing mapped file")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    printf("\nArray and CSV Tests:\n");
+    
+    if (run_test_script("let a = [1, \"two\", [3, 4]];\nprint(a);\nprint(a[2][1] + length(a));\na[0] = a[1];\nprint(a[0]);\nprint([]);", "[1, \"two\", [3, 4]]\n7\ntwo\n[]\n", "Array literals and indexing")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let a = [1, 2];\nprint(a[2]);", "Runtime error - array index out of range")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let a = [];\npush(a, 1.5);\npush(a, 2);\nprint(push(a, 3));\nprint(sum(a));\nprint(max(a) + dot(a, a));\nprint(pop(a));\npush(a, \"x\");\nprint(a);\nprint(pop(a));\nprint(pop(a));\nprint(pop(a));\nprint(pop(a));\nprint(a);", "3\n6.5\n18.25\n3\n[1.5, 2, \"x\"]\nx\n2\n1.5\nnull\n[]\n", "Array push and pop")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let a = [1, 2];\na[1] = pop(a);", "Runtime error - store past an element popped by its value")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sum([1, \"two\"]));", "Runtime error - sum of an array holding a string")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let a = [3, 1.5, 0 - 2, 10];\nprint(sort(a));\nprint(sort(a, \"desc\"));\nlet f = Float64Array(3);\nf[0] = 2; f[1] = 0 - 1; f[2] = 1;\nprint(sort(f));\nprint(sort([\"pear\", 2, \"apple\", 1]));\nprint(sort([]));", "[-2, 1.5, 3, 10]\n[10, 3, 1.5, -2]\nFloat64Array(3) [-1, 1, 2]\n[1, 2, \"apple\", \"pear\"]\n[]\n", "Sorting arrays")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let rows = [{name: \"b\", n: 2}, {name: \"a\", n: 1}, {name: \"c\", n: 2}];\nprint(sortBy(rows, \"n\", \"desc\"));\nprint(sortBy(rows, \"name\"));", "[{name: \"b\", n: 2}, {name: \"c\", n: 2}, {name: \"a\", n: 1}]\n[{name: \"a\", n: 1}, {name: \"b\", n: 2}, {name: \"c\", n: 2}]\n", "Sorting objects by a property")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let rows = [{name: \"b\"}, {name: \"a\"}];\nlet field = \"na\" + \"me\";\nprint(sortBy(rows, field));", "[{name: \"a\"}, {name: \"b\"}]\n", "Sorting objects by a computed property name")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sortBy([{n: 1}], \"m\" + \"issing\"));", "Runtime error - sorting objects by a property they lack")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sort([1, [2]]));", "Runtime error - sorting an array holding an array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sort([1, 2], \"up\"));", "Runtime error - unknown sort order")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (write_text("temp_test.csv", "id,price, qty\r\n1,2.5,3\r\n2,,4\r\n\r\n3,1e3\r\n") &&
+        run_test_script("let c = readCsvColumns(\"temp_test.csv\", [\"qty\", \"price\"]);\nprint(c);\nprint(sum(c[0]));\nprint(max(c[1]));", "[Float64Array(3) [3, 4, nan], Float64Array(3) [2.5, nan, 1000]]\nnan\nnan\n", "CSV columns")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("print(readCsvColumns(\"temp_test.csv\", [\"volume\"]));", "Runtime error - missing CSV column")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_test.csv");
+    
+    if (run_error_test("print(readCsvColumns(\"no_such_file.csv\", [\"a\"]));", "Runtime error - missing CSV file")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    printf("\nObject Tests:\n");
+    
+    if (run_test_script("let p = {x: 1, y: \"two\", z: [3]};\nprint(p);\nprint(p.x + p.z[0]);\np.w = {v: p.y};\np.x = p.x * 10;\nprint(p);\nprint(p.w.v);\nprint(p.missing);\nprint({});", "{x: 1, y: \"two\", z: [3]}\n4\n{x: 10, y: \"two\", z: [3], w: {v: \"two\"}}\ntwo\nnull\n{}\n", "Object literals and properties")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_test_script("let a = {x: 1, y: 2};\nlet b = {y: 3, x: 4};\nlet p = a;\nprint(p.x);\nlet p = b;\nprint(p.x);\nlet p = a;\nprint(p.x + p.y);\nprint({k: 1, k: 2});", "1\n4\n3\n{k: 2}\n", "Objects of different shapes at one site")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let n = 5;\nprint(n.x);", "Runtime error - property of a number")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    
+    if (run_error_test("let p = {x: 1;", "Parse error - unclosed object literal")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nMap Tests:\n");
+
+    if (run_test_script("let m = Map();\nmapSet(m, 1, \"a\");\nmapSet(m, \"1\", \"b\");\nm[\"k\"] = 2;\nprint(m);\nprint(m[1.0]);\nprint(mapGet(m, \"missing\"));\nprint(mapAdd(m, \"k\", 5));\nprint(mapDelete(m, 1));\nprint(mapHas(m, 1));\nprint(mapKeys(m));\nprint(mapValues(m));\nprint(length(m));", "Map(3) {1 => \"a\", \"1\" => \"b\", \"k\" => 2}\na\nnull\n7\ntrue\nfalse\n[\"1\", \"k\"]\n[\"b\", 7]\n2\n", "Map set, get, add and delete")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let m = Map();\nmapAdd(m, \"x\", 1);\nmapAdd(m, \"y\", 2);\nmapAdd(m, \"x\", 3);\nmapDelete(m, \"x\");\nmapAdd(m, \"x\", 4);\nprint(m);\nprint(Map());", "Map(2) {\"y\" => 2, \"x\" => 4}\nMap(0) {}\n", "Map insertion order")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let m = Map();\nm[[1]] = 2;", "Runtime error - array as a map key")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let m = Map();\nmapSet(m, \"s\", \"t\");\nmapAdd(m, \"s\", 1);", "Runtime error - adding to a string in a map")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nAccumulator Tests:\n");
+
+    if (run_test_script("let s = Stats();\nstatsAdd(s, 2);\nstatsAdd(s, [4, 4, 4, 5, 5, 7, 9]);\nprint(s);\nprint(statsCount(s));\nprint(statsMean(s));\nprint(statsVariance(s));\nprint(statsMin(s));\nprint(statsMax(s));\nprint(statsMean(Stats()));", "Stats(8)\n8\n5\n4.57142857142857\n2\n9\nnull\n", "Stats moments, one value and a batch")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let q = Quantiles(0.01);\nstatsAdd(q, [10, 20, 30, 40, 50, 60, 70, 80, 90, 100]);\nprint(q);\nprint(statsQuantile(q, 0.5));\nprint(statsQuantile(q, 0.9));\nprint(statsQuantile(q, 1));\nprint(statsMin(q));", "Quantiles(10)\n50.2487562189055\n90.4972375690608\n100\n10\n", "Quantile sketch")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let d = Distinct();\nstatsAdd(d, [\"a\", \"b\", 1, 1.0, \"a\"]);\nstatsAdd(d, [1, 2, 3]);\nstatsAdd(d, \"c\");\nprint(d);\nprint(statsCount(d));", "Distinct(~6)\n6\n", "Distinct count of numbers and strings")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let s = Stats();\nstatsQuantile(s, 0.5);", "Runtime error - quantile of a Stats")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let s = Stats();\nstatsAdd(s, [1, \"x\"]);", "Runtime error - adding a string to a Stats")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let h = Histogram(1000000, 3);\nstatsAdd(h, [1, 2, 3, 100, 1000, 12345.7]);\nstatsAdd(h, 7);\nprint(h);\nprint(statsMean(h));\nprint(statsQuantile(h, 0.5));\nprint(statsQuantile(h, 0.9));\nprint(statsMax(h));", "Histogram(7)\n1922.57142857143\n7\n1000\n12345\n", "Histogram of whole numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let a = Histogram();\nstatsAdd(a, [5, 10, 20]);\nlet b = histogramDecode(histogramEncode(a));\nstatsMerge(b, a);\nprint(b);\nprint(statsQuantile(b, 0.5));\nlet s = Stats();\nstatsAdd(s, [1, 2, 3]);\nlet t = Stats();\nstatsAdd(t, [4, 5]);\nprint(statsMean(statsMerge(s, t)));", "Histogram(6)\n10\n3\n", "Histogram encode, decode and merge")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let h = Histogram(100);\nstatsAdd(h, [1, 101]);", "Runtime error - value above a Histogram's highest")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let q = Quantiles(0.01);\nstatsMerge(q, Quantiles(0.02));", "Runtime error - merging Quantiles of different accuracy")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("histogramDecode(\"not a histogram\");", "Runtime error - decoding a bad histogram")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nHashing Tests:\n");
+
+    if (run_test_script("print(hash(7) == hash([5, 6, 7])[2]);\nprint(hash(\"7\") == hash(7));\nprint(hash(7, 1) == hash(7));\nprint(hash([1, \"a\"])[1] == hash(\"a\"));\nprint(hash(0) == hash(0.0));", "1\n0\n0\n1\n1\n", "hash of numbers, strings and arrays")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let shards = jumpHash([1, 2, 3, 4, 5, 6, 7, 8], 4);\nprint(shards);\nprint(jumpHash(3, 4) == shards[2]);\nprint(jumpHash(\"user:1\", 1));\nprint(rendezvousHash(\"user:42\", [\"db1\", \"db2\", \"db3\"]));\nprint(rendezvousHash(42, [10, 20, 30]));", "Float64Array(8) [1, 0, 1, 3, 3, 0, 2, 1]\n1\n0\ndb2\n20\n", "jump and rendezvous shard assignment")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("jumpHash(1, 0);", "Runtime error - jumpHash with no buckets")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("rendezvousHash(1, []);", "Runtime error - rendezvousHash with no nodes")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nMath Tests:\n");
+
+    if (run_test_script("print(sqrt(16));\nprint(pow(2, 10));\nprint(exp(0) + log(1));\nprint(sin(0) + cos(0));\nlet x = 2;\nprint(sqrt(x * 8));\nprint(log(0 - 1));\nprint(log(0));", "4\n1024\n1\n1\n4\nnan\n-inf\n", "math functions of numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("print(sqrt([1, 4, 9, 16]));\nprint(pow([1, 2, 3], 2));\nprint(pow(2, Float64Array(3)));\nprint(pow([2, 3], [3, 2]));\nprint(exp([]));", "Float64Array(4) [1, 2, 3, 4]\nFloat64Array(3) [1, 4, 9]\nFloat64Array(3) [1, 1, 1]\nFloat64Array(2) [8, 9]\nFloat64Array(0) []\n", "math functions of arrays")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sqrt(1, 2));", "Parse error - sqrt with two arguments")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(sqrt(\"a\"));", "Runtime error - sqrt of a string")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(pow([1, 2], [1, 2, 3]));", "Runtime error - pow of arrays of different lengths")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nMatrix Tests:\n");
+
+    if (run_test_script("let a = Matrix([[1, 2], [3, 4]]);\nprint(a);\nlet b = Matrix(2, 3, [1, 0, 2, 0, 1, 3]);\nprint(b);\nprint(Matrix(1, 2));\nprint(matrixRows(b) * 10 + matrixCols(b));", "Matrix(2x2) [[1, 2], [3, 4]]\nMatrix(2x3) [[1, 0, 2], [0, 1, 3]]\nMatrix(1x2) [[0, 0]]\n23\n", "matrix construction")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let a = Matrix([[1, 2], [3, 4]]);\nlet b = Matrix(2, 3, [1, 0, 2, 0, 1, 3]);\nprint(matmul(a, b));\nprint(matvec(a, [1, 1]));\nprint(transpose(b));\nprint(matmul(b, transpose(b)));", "Matrix(2x3) [[1, 2, 8], [3, 4, 18]]\nFloat64Array(2) [3, 7]\nMatrix(3x2) [[1, 0], [0, 1], [2, 3]]\nMatrix(2x2) [[5, 6], [6, 10]]\n", "matrix products")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let a = Matrix([[1, 2], [3, 4]]);\nprint(matrixAdd(a, 1));\nprint(matrixSub(10, a));\nprint(matrixMul(a, a));\nprint(matrixDiv(a, 2));\nlet a = matrixSet(a, 1, 0, 10);\nprint(matrixGet(a, 1, 0) + matrixGet(a, 0, 1));", "Matrix(2x2) [[2, 3], [4, 5]]\nMatrix(2x2) [[9, 8], [7, 6]]\nMatrix(2x2) [[1, 4], [9, 16]]\nMatrix(2x2) [[0.5, 1], [1.5, 2]]\n12\n", "matrix elements")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(matmul(Matrix(2, 3), Matrix(2, 3)));", "Runtime error - matmul of mismatched shapes")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(Matrix([[1, 2], [3]]));", "Runtime error - ragged matrix rows")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(matrixGet(Matrix(2, 2), 2, 0));", "Runtime error - matrix index out of range")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nRandom Tests:\n");
+
+    if (run_test_script("let a = random();\nrandomSeed(42);\nlet b = random();\nrandomSeed(42);\nprint(random() == b);\nprint(a == b);\nprint(b);\nlet x = random();\nprint(x >= 0);\nprint(x < 1);", "1\n0\n0.0838629710598822\n1\n1\n", "seeded random numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("randomSeed(7);\nlet a = fillRandom(Float64Array(3));\nrandomSeed(7);\nlet b = fillRandom([1, 2, 3]);\nprint(a[0] == b[0]);\nprint(a[2] == b[2]);\nprint(sum(a) < 3);\nprint(fillRandom([]));", "1\n1\n1\n[]\n", "filling arrays with random numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("randomSeed(0.5);", "Runtime error - fractional random seed")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("fillRandom(\"abc\");", "Runtime error - filling a string with random numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nParallel Tests:\n");
+
+    if (run_test_script("print(parallelReduce([1, 2, 3, 4], \"+\"));\nprint(parallelReduce([1, 2, 3, 4], \"*\"));\nprint(parallelReduce([3, 1, 2], \"min\"));\nprint(parallelReduce(Float64Array(3), \"max\"));\nprint(parallelReduce([], \"min\"));", "10\n24\n1\n0\ninf\n", "parallel reductions")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("print(parallelFor(0, 4, \"sqrt\"));\nprint(parallelFor(2, 2, \"exp\"));\nlet a = parallelFor(1, 300001, \"log\");\nprint(length(a));\nprint(parallelReduce(a, \"max\") == log(300000));", "Float64Array(4) [0, 1, 1.4142135623731, 1.73205080756888]\nFloat64Array(0) []\n300000\n1\n", "parallel for over a range")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("parallelReduce([1, 2], \"-\");", "Runtime error - unknown parallel reduction")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("parallelFor(0, 3, \"pow\");", "Runtime error - parallel for with a two-argument function")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nWorker Tests:\n");
+
+    if (write_text("temp_worker.js", "let m = receiveMessage();\npostMessage(sum(m));\nlet s = receiveMessage();\npostMessage(s + \"!\");\n") &&
+        run_test_script("let w = Worker(\"temp_worker.js\");\nlet a = Float64Array(3);\na[0] = 1.5;\na[2] = 2;\npostMessage(w, a);\nprint(length(a));\nprint(receiveMessage());\npostMessage(w, \"hi\");\nprint(receiveMessage());", "0\n3.5\nhi!\n", "worker moving a Float64Array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_test_script("let w = Worker(\"temp_worker.js\");\nlet b = [1, 2, 3];\npostMessage(w, b);\nprint(b);\nprint(receiveMessage());\npostMessage(w, 5);\nprint(receiveMessage());", "[]\n6\n5!\n", "worker moving an array of numbers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let w = Worker(\"temp_worker.js\");\npostMessage(w, {a: 1});", "Runtime error - posting an object")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_worker.js");
+
+    if (write_text("temp_worker.js", "print(nothing);\n") &&
+        run_error_test("let w = Worker(\"temp_worker.js\");\nprint(receiveMessage());", "Runtime error - failing worker script")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let w = Worker(\"temp_worker.js\");\nprint(1);", "Runtime error - worker failure never received")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_worker.js");
+
+    if (write_text("temp_worker.js", "let m = receiveMessage();\n") &&
+        run_error_test("let w = Worker(\"temp_worker.js\");\nprint(1);", "Runtime error - worker failing after the program ends")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_worker.js");
+
+    if (run_error_test("let w = Worker(\"no_such_worker.js\");", "Runtime error - missing worker script")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(receiveMessage());", "Runtime error - receiving with no workers")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("postMessage(1);", "Runtime error - posting to a parent outside a worker")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    printf("\nShared Memory Tests:\n");
+
+    if (run_test_script("let c = SharedInt64Array(2);\nprint(atomicsAdd(c, 0, 5));\nprint(atomicsAdd(c, 0, 2));\nprint(atomicsCompareExchange(c, 0, 6, 1));\nprint(atomicsCompareExchange(c, 0, 7, 3));\nc[1] = 0 - 4;\nprint(c[0] + c[1]);\nlet f = SharedFloat64Array(3);\nf[2] = 0.5;\nprint(atomicsAdd(f, 2, 0.25));\nprint(atomicsStore(f, 0, 9));\nprint(atomicsLoad(f, 2));\nprint(f);\nprint(length(c));", "0\n5\n7\n7\n-1\n0.5\n9\n0.75\nSharedFloat64Array(3) [9, 0, 0.75]\n2\n", "atomics on shared arrays")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (write_text("temp_worker.js", "let c = receiveMessage();\nlet f = receiveMessage();\natomicsAdd(c, 0, 1);\natomicsAdd(f, 0, 0.5);\natomicsAdd(c, 0, 1);\natomicsAdd(f, 0, 0.5);\npostMessage(atomicsCompareExchange(c, 1, 0, 1));\n") &&
+        run_test_script("let a = Worker(\"temp_worker.js\");\nlet b = Worker(\"temp_worker.js\");\nlet c = SharedInt64Array(2);\nlet f = SharedFloat64Array(1);\npostMessage(a, c);\npostMessage(a, f);\npostMessage(b, c);\npostMessage(b, f);\nprint(receiveMessage() + receiveMessage());\nprint(c);\nprint(f);", "1\nSharedInt64Array(2) [4, 1]\nSharedFloat64Array(1) [2]\n", "workers sharing counters")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+    unlink("temp_worker.js");
+
+    if (run_error_test("let c = SharedInt64Array(2);\nc[0] = 0.5;", "Runtime error - fraction in a SharedInt64Array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let c = SharedInt64Array(2);\natomicsAdd(c, 0, 0.5);", "Runtime error - adding a fraction to a SharedInt64Array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("let c = SharedFloat64Array(2);\nprint(atomicsLoad(c, 2));", "Runtime error - atomics index out of range")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
+    if (run_error_test("print(atomicsLoad(Float64Array(2), 0));", "Runtime error - atomics on a Float64Array")) {
+        results.passed++;
+    } else {
+        results.failed++;
+    }
+
     // print results
     printf("\n=================================\n");
     printf("Test Results: %d passed, %d failed\n", results.passed, results.failed);
@@ -9,7 +9,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
 #include "../include/runtime.h"
+#include "../include/object.h"
+#include "../include/worker.h"
 
 void test_interpret_number() {
     printf("Testing number literal interpretation...\n");
@@ -1417,6 +1420,544 @@ void test_interpret_if_branch_error() {
     printf("If statement with branch error test passed\n");
 }
 
+void test_interpret_quickening() {
+    printf("Testing quickening of binary operations...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    assert(env_set(env, "x", 4.0));
+    
+    ASTNode *add = ast_create_binary_op(ast_create_identifier("x"), '+', ast_create_number(1.0));
+    assert(add != NULL);
+    assert(add->data.binary.quick == NULL);
+    
+    QuickenStats before = interpreter_get_quicken_stats();
+    
+    // first run specializes the node in place
+    double result = interpret(add, env);
+    assert(!interpreter_has_error());
+    assert(result == 5.0);
+    assert(add->data.binary.quick != NULL);
+    
+    BinaryHandler specialized = add->data.binary.quick;
+    QuickenStats after_first = interpreter_get_quicken_stats();
+    assert(after_first.specialized == before.specialized + 1);
+    
+    // later runs reuse the handler without specializing again
+    assert(env_set(env, "x", 10.5));
+    result = interpret(add, env);
+    assert(!interpreter_has_error());
+    assert(result == 11.5);
+    assert(add->data.binary.quick == specialized);
+    
+    QuickenStats after_second = interpreter_get_quicken_stats();
+    assert(after_second.specialized == after_first.specialized);
+    assert(after_second.deopts == before.deopts);
+    
+    ast_destroy(add);
+    env_destroy(env);
+    printf("Quickening test passed\n");
+}
+
+void test_interpret_quickened_division_by_zero() {
+    printf("Testing quickened division still checks for zero...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    assert(env_set(env, "d", 2.0));
+    
+    ASTNode *div = ast_create_binary_op(ast_create_number(8.0), '/', ast_create_identifier("d"));
+    assert(div != NULL);
+    
+    assert(interpret(div, env) == 4.0);
+    assert(div->data.binary.quick != NULL);
+    
+    assert(env_set(env, "d", 0.0));
+    interpret(div, env);
+    assert(interpreter_has_error());
+    assert(strstr(interpreter_get_error(), "Division by zero") != NULL);
+    
+    ast_destroy(div);
+    env_destroy(env);
+    printf("Quickened division by zero test passed\n");
+}
+
+void test_interpret_quickening_deopt() {
+    printf("Testing quickening guard failure...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    assert(env_set(env, "x", 2.5));
+    
+    ASTNode *mul = ast_create_binary_op(ast_create_identifier("x"), '*', ast_create_number(0.5));
+    assert(mul != NULL);
+    assert(interpret(mul, env) == 1.25);
+    assert(mul->data.binary.quick != NULL);
+    
+    // a boxed integer breaks the double-only specialization
+    QuickenStats before = interpreter_get_quicken_stats();
+    assert(env_set_value(env, "x", value_from_int(21)));
+    assert(interpret(mul, env) == 10.5);
+    assert(!interpreter_has_error());
+    
+    QuickenStats after = interpreter_get_quicken_stats();
+    assert(after.deopts == before.deopts + 1);
+    
+    // and a boolean is not a number at all
+    assert(env_set_value(env, "x", VALUE_TRUE));
+    interpret(mul, env);
+    assert(interpreter_has_error());
+    assert(strstr(interpreter_get_error(), "Unsupported operand types for *: boolean and number") != NULL);
+    
+    ast_destroy(mul);
+    env_destroy(env);
+    printf("Quickening guard failure test passed\n");
+}
+
+void test_interpret_integer_fast_path() {
+    printf("Testing integer fast path...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    assert(env_set_value(env, "x", value_from_int(6)));
+    
+    // integral literals and int operands stay integers
+    ASTNode *add = ast_create_binary_op(ast_create_identifier("x"), '+', ast_create_number(1.0));
+    assert(add != NULL);
+    Value result = interpret_value(add, env);
+    assert(!interpreter_has_error());
+    assert(value_is_int(result) && value_as_int(result) == 7);
+    
+    // leaving the int32 range promotes to an exact double
+    QuickenStats before = interpreter_get_quicken_stats();
+    assert(env_set_value(env, "x", value_from_int(INT32_MAX)));
+    result = interpret_value(add, env);
+    assert(value_is_double(result));
+    assert(value_as_double(result) == 2147483648.0);
+    assert(interpreter_get_quicken_stats().deopts == before.deopts);
+    
+    // zero times a negative number is -0, which only a double can hold
+    ASTNode *mul = ast_create_binary_op(ast_create_number(0.0), '*', ast_create_identifier("n"));
+    assert(env_set_value(env, "n", value_from_int(-5)));
+    result = interpret_value(mul, env);
+    assert(value_is_double(result));
+    assert(value_as_double(result) == 0.0 && signbit(value_as_double(result)));
+    
+    // integer division stays integral only when it is exact
+    ASTNode *div = ast_create_binary_op(ast_create_identifier("x"), '/', ast_create_number(2.0));
+    assert(env_set_value(env, "x", value_from_int(8)));
+    result = interpret_value(div, env);
+    assert(value_is_int(result) && value_as_int(result) == 4);
+    assert(env_set_value(env, "x", value_from_int(7)));
+    result = interpret_value(div, env);
+    assert(value_is_double(result) && value_as_double(result) == 3.5);
+    
+    // int32 min / -1 does not fit back into an int32
+    ASTNode *negate = ast_create_binary_op(ast_create_identifier("x"), '/', ast_create_identifier("n"));
+    assert(env_set_value(env, "x", value_from_int(INT32_MIN)));
+    assert(env_set_value(env, "n", value_from_int(-1)));
+    result = interpret_value(negate, env);
+    assert(value_is_double(result) && value_as_double(result) == 2147483648.0);
+    
+    // comparisons answer with integers
+    ASTNode *test = ast_create_binary_op(ast_create_number(2.5), '<', ast_create_number(3.0));
+    result = interpret_value(test, env);
+    assert(value_is_int(result) && value_as_int(result) == 1);
+    
+    ast_destroy(add);
+    ast_destroy(mul);
+    ast_destroy(div);
+    ast_destroy(negate);
+    ast_destroy(test);
+    env_destroy(env);
+    printf("Integer fast path test passed\n");
+}
+
+void test_interpret_mixed_numbers() {
+    printf("Testing sites that mix ints and doubles...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    assert(env_set_value(env, "x", value_from_int(3)));
+    
+    ASTNode *sub = ast_create_binary_op(ast_create_identifier("x"), '-', ast_create_number(1.0));
+    assert(sub != NULL);
+    assert(interpret(sub, env) == 2.0);
+    BinaryHandler int_form = sub->data.binary.quick;
+    assert(int_form != NULL);
+    
+    // one guard failure moves the site to the mixed handler for good
+    QuickenStats before = interpreter_get_quicken_stats();
+    assert(env_set(env, "x", 0.5));
+    assert(interpret(sub, env) == -0.5);
+    BinaryHandler mixed_form = sub->data.binary.quick;
+    assert(mixed_form != NULL && mixed_form != int_form);
+    
+    assert(env_set_value(env, "x", value_from_int(10)));
+    assert(interpret(sub, env) == 9.0);
+    assert(sub->data.binary.quick == mixed_form);
+    assert(interpreter_get_quicken_stats().deopts == before.deopts + 1);
+    
+    ast_destroy(sub);
+    env_destroy(env);
+    printf("Mixed number site test passed\n");
+}
+
+void test_interpret_strings() {
+    printf("Testing string operations...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    
+    // literals are interned once and reused on every run
+    ASTNode *literal = ast_create_string("total: ");
+    Value first = interpret_value(literal, env);
+    assert(value_is_string(first));
+    assert(interpret_value(literal, env) == first);
+    
+    // + concatenates, converting the number on the right
+    assert(env_set_value(env, "n", value_from_int(12)));
+    ASTNode *concat = ast_create_binary_op(literal, '+', ast_create_identifier("n"));
+    Value result = interpret_value(concat, env);
+    assert(!interpreter_has_error());
+    assert(value_is_string(result));
+    assert(strcmp(string_chars(result), "total: 12") == 0);
+    
+    // the same site still adds once both sides are numbers again
+    ASTNode *add = ast_create_binary_op(ast_create_identifier("a"), '+', ast_create_identifier("b"));
+    assert(env_set_value(env, "a", string_intern("x", 1)));
+    assert(env_set_value(env, "b", value_from_double(0.5)));
+    result = interpret_value(add, env);
+    assert(strcmp(string_chars(result), "x0.5") == 0);
+    assert(env_set_value(env, "a", value_from_int(2)));
+    assert(interpret(add, env) == 2.5);
+    
+    // strings compare by contents
+    ASTNode *equal = ast_create_binary_op(ast_create_identifier("s"), 'E', ast_create_string("ab"));
+    assert(env_set_value(env, "s", string_concat(string_from_chars("a", 1), string_from_chars("b", 1))));
+    assert(interpret(equal, env) == 1.0);
+    
+    // other arithmetic on strings is an error
+    ASTNode *mul = ast_create_binary_op(ast_create_string("ab"), '*', ast_create_number(2.0));
+    interpret(mul, env);
+    assert(interpreter_has_error());
+    assert(strstr(interpreter_get_error(), "Unsupported operand types for *: string and number") != NULL);
+    
+    ast_destroy(concat);
+    ast_destroy(add);
+    ast_destroy(equal);
+    ast_destroy(mul);
+    env_destroy(env);
+    heap_destroy();
+    printf("String operations test passed\n");
+}
+
+void test_interpret_float64_arrays() {
+    printf("Testing Float64Array builtins and indexing...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    
+    ASTNode *length = ast_create_number(4.0);
+    ASTNode *create = ast_create_call("Float64Array", &length, 1);
+    Value array = interpret_value(create, env);
+    assert(!interpreter_has_error());
+    assert(value_is_float64_array(array));
+    assert(value_as_float64_array(array)->length == 4);
+    assert(((uintptr_t)value_as_float64_array(array)->data % FLOAT64_ARRAY_ALIGNMENT) == 0);
+    assert(create->data.call.builtin != NULL);
+    assert(env_set_value(env, "a", array));
+    
+    // a[1] = 2.5, then read it back
+    ASTNode *store = ast_create_index_assign(ast_create_identifier("a"), ast_create_number(1.0),
+                                             ast_create_number(2.5));
+    assert(interpret(store, env) == 2.5);
+    ASTNode *load = ast_create_index(ast_create_identifier("a"), ast_create_number(1.0));
+    assert(interpret(load, env) == 2.5);
+    
+    ASTNode *arg = ast_create_identifier("a");
+    ASTNode *sum = ast_create_call("sum", &arg, 1);
+    assert(interpret(sum, env) == 2.5);
+    
+    // indexes must be whole numbers inside the array
+    ASTNode *outside = ast_create_index(ast_create_identifier("a"), ast_create_number(4.0));
+    interpret(outside, env);
+    assert(interpreter_has_error());
+    assert(strcmp(interpreter_get_error(), "Index 4 out of range for Float64Array(4)") == 0);
+    ASTNode *fraction = ast_create_index(ast_create_identifier("a"), ast_create_number(0.5));
+    interpret(fraction, env);
+    assert(interpreter_has_error());
+    
+    // unknown names and wrong arity fail at run time
+    ASTNode *unknown = ast_create_call("nosuch", NULL, 0);
+    interpret(unknown, env);
+    assert(strcmp(interpreter_get_error(), "Unknown function: nosuch") == 0);
+    ASTNode *bare = ast_create_call("sum", NULL, 0);
+    interpret(bare, env);
+    assert(strcmp(interpreter_get_error(), "sum expects 1 argument, got 0") == 0);
+    
+    ast_destroy(create);
+    ast_destroy(store);
+    ast_destroy(load);
+    ast_destroy(sum);
+    ast_destroy(outside);
+    ast_destroy(fraction);
+    ast_destroy(unknown);
+    ast_destroy(bare);
+    env_destroy(env);
+    heap_destroy();
+    printf("Float64Array test passed\n");
+}
+
+// a[2] = pop([postMessage(w, a), 5]) - evaluating the value sends a's
+// elements to a worker, so the store must find the array empty rather
+// than write through its old buffer
+void test_interpret_store_after_transfer() {
+    printf("Testing a store into a Float64Array posted away...\n");
+    
+    FILE *file = fopen("temp_transfer.js", "w");
+    assert(file != NULL);
+    fputs("let m = receiveMessage();\n", file);
+    fclose(file);
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    ASTNode *path = ast_create_string("temp_transfer.js");
+    ASTNode *start = ast_create_call("Worker", &path, 1);
+    assert(env_set_value(env, "w", interpret_value(start, env)));
+    ASTNode *length = ast_create_number(4.0);
+    ASTNode *create = ast_create_call("Float64Array", &length, 1);
+    assert(env_set_value(env, "a", interpret_value(create, env)));
+    assert(!interpreter_has_error());
+    
+    ASTNode *post_args[2] = { ast_create_identifier("w"), ast_create_identifier("a") };
+    ASTNode **elements = malloc(2 * sizeof(ASTNode*));
+    elements[0] = ast_create_call("postMessage", post_args, 2);
+    elements[1] = ast_create_number(5.0);
+    ASTNode *list = ast_create_array(elements, 2);
+    ASTNode *pop = ast_create_call("pop", &list, 1);
+    ASTNode *store = ast_create_index_assign(ast_create_identifier("a"), ast_create_number(2.0), pop);
+    interpret(store, env);
+    assert(interpreter_has_error());
+    assert(strcmp(interpreter_get_error(), "Index 2 out of range for Float64Array(0)") == 0);
+    
+    // the worker got the elements and finished cleanly
+    assert(worker_shutdown() == 0);
+    remove("temp_transfer.js");
+    ast_destroy(start);
+    ast_destroy(create);
+    ast_destroy(store);
+    env_destroy(env);
+    heap_destroy();
+    printf("Store after transfer test passed\n");
+}
+
+void test_interpret_arrays() {
+    printf("Testing array literals and indexing...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    
+    // [1, "x", [2]]
+    ASTNode **inner = malloc(sizeof(ASTNode*));
+    inner[0] = ast_create_number(2.0);
+    ASTNode **elements = malloc(3 * sizeof(ASTNode*));
+    elements[0] = ast_create_number(1.0);
+    elements[1] = ast_create_string("x");
+    elements[2] = ast_create_array(inner, 1);
+    ASTNode *literal = ast_create_array(elements, 3);
+    Value array = interpret_value(literal, env);
+    assert(!interpreter_has_error());
+    assert(value_is_array(array));
+    assert(value_as_array(array)->length == 3);
+    assert(value_is_array(array_get(array, 2)));
+    assert(env_set_value(env, "a", array));
+    
+    // elements of any type can be stored and read back
+    ASTNode *store = ast_create_index_assign(ast_create_identifier("a"), ast_create_number(0.0),
+                                             ast_create_string("y"));
+    interpret_value(store, env);
+    ASTNode *load = ast_create_index(ast_create_identifier("a"), ast_create_number(0.0));
+    Value loaded = interpret_value(load, env);
+    assert(value_is_string(loaded));
+    ASTNode *nested = ast_create_index(ast_create_index(ast_create_identifier("a"), ast_create_number(2.0)),
+                                       ast_create_number(0.0));
+    assert(interpret(nested, env) == 2.0);
+    
+    ASTNode *outside = ast_create_index(ast_create_identifier("a"), ast_create_number(3.0));
+    interpret(outside, env);
+    assert(interpreter_has_error());
+    assert(strcmp(interpreter_get_error(), "Index 3 out of range for Array(3)") == 0);
+    
+    ast_destroy(literal);
+    ast_destroy(store);
+    ast_destroy(load);
+    ast_destroy(nested);
+    ast_destroy(outside);
+    env_destroy(env);
+    heap_destroy();
+    printf("Array test passed\n");
+}
+
+// object literal nodes take over malloc'd key strings
+static char* key_copy(const char *name) {
+    char *copy = malloc(strlen(name) + 1);
+    strcpy(copy, name);
+    return copy;
+}
+
+void test_interpret_objects() {
+    printf("Testing objects and inline caches...\n");
+    
+    Environment *env = env_create();
+    assert(env != NULL);
+    
+    // {x: 1, y: "two", x: 3} - the repeated name keeps its first slot
+    char **keys = malloc(3 * sizeof(char*));
+    keys[0] = key_copy("x");
+    keys[1] = key_copy("y");
+    keys[2] = key_copy("x");
+    ASTNode **values = malloc(3 * sizeof(ASTNode*));
+    values[0] = ast_create_number(1.0);
+    values[1] = ast_create_string("two");
+    values[2] = ast_create_number(3.0);
+    ASTNode *literal = ast_create_object(keys, values, 3);
+    Value first = interpret_value(literal, env);
+    assert(!interpreter_has_error());
+    assert(value_is_record(first));
+    assert(value_as_record(first)->shape->count == 2);
+    assert(env_set_value(env, "p", first));
+    
+    // a second object from the same literal shares the shape
+    Value second = interpret_value(literal, env);
+    assert(value_as_record(second)->shape == value_as_record(first)->shape);
+    assert(env_set_value(env, "q", second));
+    
+    PropertyCacheStats before = interpreter_get_property_cache_stats();
+    ASTNode *read = ast_create_property(ast_create_identifier("p"), "x");
+    assert(interpret(read, env) == 3.0);
+    assert(interpret(read, env) == 3.0);
+    PropertyCacheStats after = interpreter_get_property_cache_stats();
+    assert(after.misses == before.misses + 1);
+    assert(after.hits == before.hits + 1);
+    
+    // a missing property reads as null, and is cached like any other
+    ASTNode *missing = ast_create_property(ast_create_identifier("p"), "z");
+    assert(value_is_null(interpret_value(missing, env)));
+    assert(!interpreter_has_error());
+    
+    // adding a property moves p to a new shape, and the site sees both
+    ASTNode *add = ast_create_property_assign(ast_create_identifier("p"), "z", ast_create_number(7.0));
+    interpret_value(add, env);
+    assert(!interpreter_has_error());
+    assert(interpret(missing, env) == 7.0);
+    assert(missing->data.property.cache->count == 2);
+    
+    // the store site cached the transition, so q follows it too
+    ASTNode *add_q = ast_create_property_assign(ast_create_identifier("q"), "z", ast_create_number(8.0));
+    interpret_value(add_q, env);
+    Value p;
+    Value q;
+    assert(env_get_value(env, "p", &p) && env_get_value(env, "q", &q));
+    assert(value_as_record(p)->shape == value_as_record(q)->shape);
+    
+    // more shapes than a cache holds turns the site megamorphic
+    before = interpreter_get_property_cache_stats();
+    ASTNode *read_q = ast_create_property(ast_create_identifier("q"), "x");
+    ASTNode *names[6];
+    for (int i = 0; i < 6; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "n%d", i);
+        names[i] = ast_create_property_assign(ast_create_identifier("q"), name, ast_create_number(i));
+        interpret_value(names[i], env);
+        assert(interpret(read_q, env) == 3.0);
+    }
+    after = interpreter_get_property_cache_stats();
+    assert(after.megamorphic == before.megamorphic + 1);
+    assert(read_q->data.property.cache->megamorphic);
+    assert(read->data.property.cache->count == 1);
+    assert(env_set_value(env, "p", q));
+    for (int i = 0; i < 6; i++) {
+        interpret_value(names[i], env);
+    }
+    assert(interpret(read, env) == 3.0);
+    
+    // only objects have properties
+    ASTNode *number = ast_create_property(ast_create_number(1.0), "x");
+    interpret(number, env);
+    assert(interpreter_has_error());
+    assert(strcmp(interpreter_get_error(), "Cannot read property 'x' of a number") == 0);
+    
+    ast_destroy(literal);
+    ast_destroy(read);
+    ast_destroy(missing);
+    ast_destroy(add);
+    ast_destroy(add_q);
+    ast_destroy(read_q);
+    for (int i = 0; i < 6; i++) {
+        ast_destroy(names[i]);
+    }
+    ast_destroy(number);
+    env_destroy(env);
+    heap_destroy();
+    printf("Object test passed\n");
+}
+
+void test_interpret_collects_garbage() {
+    printf("Testing garbage collection under the interpreter...\n");
+    
+    // let s = ""; then many of: let s = s + "piece"; let a = [s, a, "tmp" + s];
+    heap_set_nursery_size(4096);
+    Environment *env = env_create();
+    assert(env != NULL);
+    ASTNode *program = ast_create_program();
+    ast_program_add_statement(program, ast_create_let_decl("s", ast_create_string("")));
+    ast_program_add_statement(program, ast_create_let_decl("a", ast_create_number(0.0)));
+    for (int i = 0; i < 2000; i++) {
+        ASTNode *append = ast_create_binary_op(ast_create_identifier("s"), '+', ast_create_string("piece"));
+        ast_program_add_statement(program, ast_create_let_decl("s", append));
+        ASTNode **elements = malloc(3 * sizeof(ASTNode*));
+        elements[0] = ast_create_identifier("s");
+        elements[1] = ast_create_identifier("a");
+        elements[2] = ast_create_binary_op(ast_create_string("tmp"), '+', ast_create_identifier("s"));
+        ast_program_add_statement(program, ast_create_let_decl("a", ast_create_array(elements, 3)));
+    }
+    
+    interpret_value(program, env);
+    assert(!interpreter_has_error());
+    assert(heap_root_depth() == 0);
+    HeapStats stats = heap_get_stats();
+    assert(stats.minor_collections > 10);
+    
+    // the string and the chain of arrays came through every collection
+    Value s;
+    assert(env_get_value(env, "s", &s));
+    assert(string_length(s) == 2000 * 5);
+    Value a;
+    assert(env_get_value(env, "a", &a));
+    for (int depth = 0; depth < 2000; depth++) {
+        ArrayObject *array = value_as_array(a);
+        assert(array->length == 3);
+        assert(string_length(array_elements(array)[0].value) == (size_t)(2000 - depth) * 5);
+        assert(string_length(array_elements(array)[2].value) == (size_t)(2000 - depth) * 5 + 3);
+        a = array_elements(array)[1].value;
+    }
+    assert(value_as_int(a) == 0);
+    
+    // a failed statement leaves no roots behind
+    ASTNode *failing = ast_create_binary_op(ast_create_identifier("s"), '+',
+                                            ast_create_identifier("missing"));
+    interpret_value(failing, env);
+    assert(interpreter_has_error());
+    assert(heap_root_depth() == 0);
+    
+    ast_destroy(failing);
+    ast_destroy(program);
+    env_destroy(env);
+    heap_destroy();
+    printf("Garbage collection test passed\n");
+}
+
 int main() {
     printf("Running interpreter core tests...\n\n");
     
@@ -1492,6 +2033,20 @@ int main() {
     test_interpret_if_condition_error();
     test_interpret_if_branch_error();
     
+    printf("\nRunning quickening tests...\n\n");
+    
+    test_interpret_quickening();
+    test_interpret_quickened_division_by_zero();
+    test_interpret_quickening_deopt();
+    test_interpret_integer_fast_path();
+    test_interpret_mixed_numbers();
+    test_interpret_strings();
+    test_interpret_float64_arrays();
+    test_interpret_store_after_transfer();
+    test_interpret_arrays();
+    test_interpret_objects();
+    test_interpret_collects_garbage();
+    
     printf("All interpreter tests passed!\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+/*
+ * test_kernels.c - tests for the whole-array numeric kernels
+ *
+ * every instruction set this cpu supports has to produce the same bits
+ * as the scalar reference, including for lengths that leave a tail and
+ * for the nan and signed zero cases of min and max.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/kernels.h"
+
+#define MAX_LENGTH 300
+
+static double xs[MAX_LENGTH + 1];
+static double ys[MAX_LENGTH + 1];
+
+static int same_bits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// values spread over several magnitudes so the addition order shows
+static void fill_samples(void) {
+    unsigned state = 12345;
+    for (int i = 0; i <= MAX_LENGTH; i++) {
+        state = state * 1103515245u + 12345u;
+        double scale = (state >> 8) % 3 == 0 ? 1e6 : (state >> 8) % 3 == 1 ? 1.0 : 1e-6;
+        xs[i] = ((double)(state >> 16 & 0x7fff) / 16384.0 - 1.0) * scale;
+        state = state * 1103515245u + 12345u;
+        ys[i] = (double)(state >> 16 & 0x7fff) / 8192.0 - 2.0;
+    }
+}
+
+void test_kernels_match_scalar() {
+    printf("Testing kernels against the scalar reference...\n");
+    fill_samples();
+
+    KernelIsa isas[] = { KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (isas[k] > kernel_best_isa()) {
+            printf("  %s not available, skipped\n", kernel_isa_name(isas[k]));
+            continue;
+        }
+        // lengths around the lane count, starting both aligned and not
+        for (size_t n = 0; n <= MAX_LENGTH; n += (n < 40 ? 1 : 37)) {
+            for (size_t offset = 0; offset < 2; offset++) {
+                const double *x = xs + offset;
+                const double *y = ys + offset;
+                if (n + offset > MAX_LENGTH + 1) {
+                    continue;
+                }
+
+                assert(kernel_use_isa(KERNEL_SCALAR));
+                double sum = kernel_sum(x, n);
+                double dot = kernel_dot(x, y, n);
+                double deviations = kernel_deviations(x, 0.25, n);
+                double lowest = n ? kernel_min(x, n) : 0.0;
+                double highest = n ? kernel_max(x, n) : 0.0;
+
+                assert(kernel_use_isa(isas[k]));
+                assert(kernel_current_isa() == isas[k]);
+                assert(same_bits(kernel_sum(x, n), sum));
+                assert(same_bits(kernel_dot(x, y, n), dot));
+                assert(same_bits(kernel_deviations(x, 0.25, n), deviations));
+                if (n) {
+                    assert(same_bits(kernel_min(x, n), lowest));
+                    assert(same_bits(kernel_max(x, n), highest));
+                }
+            }
+        }
+    }
+
+    assert(kernel_use_isa(kernel_best_isa()));
+    printf("Kernel agreement test passed (best: %s)\n", kernel_isa_name(kernel_best_isa()));
+}
+
+void test_kernels_updates() {
+    printf("Testing in-place kernels...\n");
+
+    double x[37], y[37], expected[37];
+    for (int isa = KERNEL_SCALAR; isa <= KERNEL_AVX2; isa++) {
+        if (!kernel_use_isa((KernelIsa)isa)) {
+            continue;
+        }
+        for (int i = 0; i < 37; i++) {
+            x[i] = i * 0.5;
+            y[i] = 100.0 - i;
+            expected[i] = y[i] + 3.0 * x[i];
+        }
+        kernel_axpy(3.0, x, y, 37);
+        kernel_scale(x, -2.0, 37);
+        for (int i = 0; i < 37; i++) {
+            assert(y[i] == expected[i]);
+            assert(x[i] == i * -1.0);
+        }
+    }
+
+    assert(kernel_use_isa(kernel_best_isa()));
+    printf("In-place kernel test passed\n");
+}
+
+void test_kernels_min_max_edges() {
+    printf("Testing min and max edge cases...\n");
+
+    double values[40];
+    for (int isa = KERNEL_SCALAR; isa <= KERNEL_AVX2; isa++) {
+        if (!kernel_use_isa((KernelIsa)isa)) {
+            continue;
+        }
+        // a nan anywhere, in the vector body or the tail, wins
+        for (int where = 0; where < 40; where += 13) {
+            for (int i = 0; i < 40; i++) {
+                values[i] = i;
+            }
+            values[where] = NAN;
+            assert(isnan(kernel_min(values, 40)));
+            assert(isnan(kernel_max(values, 40)));
+        }
+
+        // -0 is below 0 whichever comes first
+        for (int i = 0; i < 40; i++) {
+            values[i] = 1.0;
+        }
+        values[3] = 0.0;
+        values[30] = -0.0;
+        assert(signbit(kernel_min(values, 40)));
+        for (int i = 0; i < 40; i++) {
+            values[i] = -1.0;
+        }
+        values[3] = -0.0;
+        values[30] = 0.0;
+        assert(!signbit(kernel_max(values, 40)));
+        assert(kernel_max(values, 40) == 0.0);
+    }
+
+    assert(kernel_use_isa(kernel_best_isa()));
+    printf("Min and max edge case test passed\n");
+}
+
+int main() {
+    printf("Running kernel tests...\n\n");
+
+    test_kernels_match_scalar();
+    test_kernels_updates();
+    test_kernels_min_max_edges();
+
+    printf("All kernel tests passed!\n");
+    return 0;
+}
@@ -17,6 +17,7 @@ const char* token_type_to_string(TokenType type) {
     switch (type) {
         case TOKEN_NUMBER: return "NUMBER";
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
+        case TOKEN_STRING: return "STRING";
         case TOKEN_LET: return "LET";
         case TOKEN_IF: return "IF";
         case TOKEN_ELSE: return "ELSE";
@@ -27,6 +28,13 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_DIVIDE: return "DIVIDE";
         case TOKEN_LPAREN: return "LPAREN";
         case TOKEN_RPAREN: return "RPAREN";
+        case TOKEN_LBRACKET: return "LBRACKET";
+        case TOKEN_RBRACKET: return "RBRACKET";
+        case TOKEN_LBRACE: return "LBRACE";
+        case TOKEN_RBRACE: return "RBRACE";
+        case TOKEN_COLON: return "COLON";
+        case TOKEN_DOT: return "DOT";
+        case TOKEN_COMMA: return "COMMA";
         case TOKEN_SEMICOLON: return "SEMICOLON";
         case TOKEN_GREATER: return "GREATER";
         case TOKEN_LESS: return "LESS";
@@ -112,6 +120,96 @@ void test_identifiers() {
     printf("Identifier and keyword tests passed\n");
 }
 
+// test string literal tokenization
+void test_strings() {
+    printf("Testing string literal tokenization...\n");
+    
+    Lexer *lexer = lexer_create("\"hello\" 'single' \"tab\\there \\\"q\\\"\" \"\" x");
+    assert(lexer != NULL);
+    
+    Token token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_STRING);
+    assert(strcmp(token.text, "hello") == 0);
+    assert(token.column == 1);
+    free_token(&token);
+    
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_STRING);
+    assert(strcmp(token.text, "single") == 0);
+    free_token(&token);
+    
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_STRING);
+    assert(strcmp(token.text, "tab\there \"q\"") == 0);
+    free_token(&token);
+    
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_STRING);
+    assert(strcmp(token.text, "") == 0);
+    free_token(&token);
+    
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_IDENTIFIER);
+    free_token(&token);
+    
+    lexer_destroy(lexer);
+    
+    // a literal must close on the line it starts
+    lexer = lexer_create("\"unterminated\nprint(1)");
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_ERROR);
+    lexer_destroy(lexer);
+    
+    lexer = lexer_create("'open");
+    token = lexer_next_token(lexer);
+    assert(token.type == TOKEN_ERROR);
+    lexer_destroy(lexer);
+    
+    printf("String literal tests passed\n");
+}
+
+void test_brackets_and_commas() {
+    printf("Testing bracket and comma tokenization...\n");
+    
+    Lexer *lexer = lexer_create("a[i] f(x, y)");
+    TokenType expected[] = {
+        TOKEN_IDENTIFIER, TOKEN_LBRACKET, TOKEN_IDENTIFIER, TOKEN_RBRACKET,
+        TOKEN_IDENTIFIER, TOKEN_LPAREN, TOKEN_IDENTIFIER, TOKEN_COMMA, TOKEN_IDENTIFIER,
+        TOKEN_RPAREN, TOKEN_EOF
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        Token token = lexer_next_token(lexer);
+        assert(token.type == expected[i]);
+        free_token(&token);
+    }
+    lexer_destroy(lexer);
+    
+    printf("Bracket and comma tests passed\n");
+}
+
+void test_object_punctuation() {
+    printf("Testing object punctuation...\n");
+    
+    // .5 is not a number - literals start with a digit
+    Lexer *lexer = lexer_create("{x: 1.5, y: p.x} p.5");
+    TokenType expected[] = {
+        TOKEN_LBRACE, TOKEN_IDENTIFIER, TOKEN_COLON, TOKEN_NUMBER, TOKEN_COMMA,
+        TOKEN_IDENTIFIER, TOKEN_COLON, TOKEN_IDENTIFIER, TOKEN_DOT, TOKEN_IDENTIFIER,
+        TOKEN_RBRACE, TOKEN_IDENTIFIER, TOKEN_DOT, TOKEN_NUMBER, TOKEN_EOF
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        Token token = lexer_next_token(lexer);
+        assert(token.type == expected[i]);
+        if (token.type == TOKEN_NUMBER && i == 3) {
+            assert(token.number == 1.5);
+        }
+        free_token(&token);
+    }
+    lexer_destroy(lexer);
+    
+    printf("Object punctuation tests passed\n");
+}
+
 // test operator tokenization
 void test_operators() {
     printf("Testing operator tokenization...\n");
@@ -814,6 +912,9 @@ int main() {
     
     test_numbers();
     test_identifiers();
+    test_strings();
+    test_brackets_and_commas();
+    test_object_punctuation();
     test_if_else_keywords();
     test_operators();
     test_comparison_operators();
@@ -0,0 +1,207 @@
+/*
+ * test_linalg.c - tests for the matrix kernels
+ *
+ * products are held to the exact bits of the plain triple loop, over
+ * shapes that leave partial tiles and cross the cache blocks, on every
+ * instruction set and split across threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include "../include/linalg.h"
+#include "../include/kernels.h"
+
+static uint64_t state = 88172645463325252ULL;
+
+// small integers and fractions whose products round, so a different
+// summation order would show
+static double random_element(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (double)(state >> 11) / 9007199254740992.0 * 2.0 - 1.0;
+}
+
+static double* random_matrix(size_t rows, size_t cols) {
+    double *m = malloc((rows * cols + 1) * sizeof(double));
+    for (size_t i = 0; i < rows * cols; i++) {
+        m[i] = random_element();
+    }
+    return m;
+}
+
+static void naive_matmul(const double *a, const double *b, double *c, size_t m, size_t k, size_t n) {
+    for (size_t i = 0; i < m * n; i++) {
+        c[i] = 0.0;
+    }
+    for (size_t i = 0; i < m; i++) {
+        for (size_t p = 0; p < k; p++) {
+            for (size_t j = 0; j < n; j++) {
+                c[i * n + j] += a[i * k + p] * b[p * n + j];
+            }
+        }
+    }
+}
+
+// multiplies with the kernels on the given thread count and compares
+// every element with the triple loop's bits
+static void check_product(size_t m, size_t k, size_t n, size_t threads) {
+    double *a = random_matrix(m, k);
+    double *b = random_matrix(k, n);
+    double *want = malloc((m * n + 1) * sizeof(double));
+    double *got = malloc((m * n + 1) * sizeof(double));
+    naive_matmul(a, b, want, m, k, n);
+    for (size_t i = 0; i < m * n; i++) {
+        got[i] = NAN;
+    }
+    size_t used = linalg_matmul(a, b, got, m, k, n, threads);
+    assert(used >= 1);
+    assert(threads == 0 || used <= threads);
+    assert(memcmp(got, want, m * n * sizeof(double)) == 0);
+    free(a);
+    free(b);
+    free(want);
+    free(got);
+}
+
+void test_linalg_matmul() {
+    printf("Testing matmul...\n");
+
+    KernelIsa isas[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++) {
+        if (!kernel_use_isa(isas[i])) {
+            printf("  %s not available, skipped\n", kernel_isa_name(isas[i]));
+            continue;
+        }
+        // every remainder of the register tile
+        for (size_t m = 1; m <= 9; m++) {
+            for (size_t n = 1; n <= 17; n++) {
+                check_product(m, 3, n, 1);
+            }
+        }
+        check_product(70, 70, 70, 1);
+        // past the row, depth and column blocks
+        check_product(67, 300, 13, 1);
+        check_product(5, 7, 1030, 1);
+        check_product(130, 9, 11, 1);
+    }
+    assert(kernel_use_isa(kernel_best_isa()));
+
+    // any split across threads gives the same bits
+    size_t threads[] = { 1, 2, 3, 8, 0 };
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+        check_product(37, 41, 29, threads[i]);
+        check_product(3, 5, 7, threads[i]);
+    }
+
+    // nothing to sum gives zeros, and empty shapes are fine
+    double a[6] = { 1, 2, 3, 4, 5, 6 };
+    double c[4] = { 9, 9, 9, 9 };
+    assert(linalg_matmul(a, a, c, 2, 0, 2, 0) >= 1);
+    for (int i = 0; i < 4; i++) {
+        assert(c[i] == 0.0 && !signbit(c[i]));
+    }
+    assert(linalg_matmul(a, a, c, 0, 3, 2, 0) >= 1);
+    assert(linalg_matmul(a, a, c, 2, 3, 0, 0) >= 1);
+
+    // [1 2 3; 4 5 6] times its transpose
+    double t[6] = { 1, 4, 2, 5, 3, 6 };
+    linalg_matmul(a, t, c, 2, 3, 2, 0);
+    assert(c[0] == 14.0 && c[1] == 32.0 && c[2] == 32.0 && c[3] == 77.0);
+
+    printf("Matmul test passed\n");
+}
+
+void test_linalg_transpose() {
+    printf("Testing transpose...\n");
+
+    size_t shapes[][2] = { { 1, 1 }, { 1, 70 }, { 70, 1 }, { 33, 65 }, { 64, 64 }, { 100, 3 } };
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t rows = shapes[s][0], cols = shapes[s][1];
+        double *a = random_matrix(rows, cols);
+        double *t = malloc(rows * cols * sizeof(double));
+        double *back = malloc(rows * cols * sizeof(double));
+        linalg_transpose(a, t, rows, cols);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                assert(t[j * rows + i] == a[i * cols + j]);
+            }
+        }
+        linalg_transpose(t, back, cols, rows);
+        assert(memcmp(a, back, rows * cols * sizeof(double)) == 0);
+        free(a);
+        free(t);
+        free(back);
+    }
+
+    printf("Transpose test passed\n");
+}
+
+void test_linalg_matvec() {
+    printf("Testing matvec...\n");
+
+    size_t rows = 23, cols = 37;
+    double *a = random_matrix(rows, cols);
+    double *x = random_matrix(1, cols);
+    double y[23];
+    linalg_matvec(a, x, y, rows, cols);
+    for (size_t i = 0; i < rows; i++) {
+        assert(y[i] == kernel_dot(a + i * cols, x, cols));
+    }
+
+    double small[4] = { 1, 2, 3, 4 };
+    double v[2] = { 1, 1 };
+    linalg_matvec(small, v, y, 2, 2);
+    assert(y[0] == 3.0 && y[1] == 7.0);
+    free(a);
+    free(x);
+
+    printf("Matvec test passed\n");
+}
+
+void test_linalg_elementwise() {
+    printf("Testing elementwise...\n");
+
+    double a[13], b[13], out[13];
+    for (int i = 0; i < 13; i++) {
+        a[i] = (double)i;
+        b[i] = (double)(i + 1) * 0.5;
+    }
+    double two = 2.0;
+    linalg_elementwise('+', a, 1, b, 1, out, 13);
+    for (int i = 0; i < 13; i++) {
+        assert(out[i] == a[i] + b[i]);
+    }
+    linalg_elementwise('-', a, 1, &two, 0, out, 13);
+    for (int i = 0; i < 13; i++) {
+        assert(out[i] == a[i] - 2.0);
+    }
+    linalg_elementwise('/', &two, 0, b, 1, out, 13);
+    for (int i = 0; i < 13; i++) {
+        assert(out[i] == 2.0 / b[i]);
+    }
+
+    // in place
+    linalg_elementwise('*', a, 1, a, 1, a, 13);
+    for (int i = 0; i < 13; i++) {
+        assert(a[i] == (double)(i * i));
+    }
+
+    printf("Elementwise test passed\n");
+}
+
+int main() {
+    printf("Running linalg tests...\n\n");
+
+    test_linalg_matmul();
+    test_linalg_transpose();
+    test_linalg_matvec();
+    test_linalg_elementwise();
+
+    printf("All linalg tests passed!\n");
+    return 0;
+}
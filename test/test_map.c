@@ -0,0 +1,264 @@
+/*
+ * test_map.c - tests for maps
+ *
+ * covers which keys count as the same key, insertion order through
+ * deletes, growth and the reuse of deleted slots, maps moving through
+ * the collector, and changing a map while it is marked concurrently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "../include/object.h"
+
+static Value text(const char *chars) {
+    return string_from_chars(chars, strlen(chars));
+}
+
+static int lookup_int(Value map, Value key) {
+    Value value;
+    assert(map_get(map, key, &value));
+    return value_as_int(value);
+}
+
+void test_map_keys() {
+    printf("Testing map keys...\n");
+
+    Value map = map_create();
+    heap_push_root(&map);
+    Value value;
+    assert(value_as_map(map)->count == 0);
+    assert(!map_get(map, value_from_int(1), &value));
+    assert(!map_delete(map, value_from_int(1)));
+
+    // 1 and 1.0 are one key, the string "1" another
+    assert(map_set(map, value_from_int(1), value_from_int(10)));
+    assert(map_set(map, value_from_double(1.0), value_from_int(11)));
+    assert(map_set(map, text("1"), value_from_int(12)));
+    assert(value_as_map(map)->count == 2);
+    assert(lookup_int(map, value_from_int(1)) == 11);
+    assert(lookup_int(map, text("1")) == 12);
+
+    // strings match by contents, not by object
+    assert(lookup_int(map, string_from_chars("1", 1)) == 12);
+
+    // 0 and -0 are one key, and so is every NaN
+    assert(map_set(map, value_from_double(-0.0), value_from_int(20)));
+    assert(lookup_int(map, value_from_int(0)) == 20);
+    assert(map_set(map, value_from_double(NAN), value_from_int(30)));
+    assert(map_set(map, value_from_double(-NAN), value_from_int(31)));
+    assert(lookup_int(map, value_from_double(NAN)) == 31);
+    assert(value_as_map(map)->count == 4);
+
+    // number keys come back canonical
+    assert(map_set(map, value_from_double(2.5), value_from_int(40)));
+    MapObject *object = value_as_map(map);
+    assert(value_is_int(object->entries[0].key) && value_as_int(object->entries[0].key) == 1);
+    assert(value_is_int(object->entries[2].key) && value_as_int(object->entries[2].key) == 0);
+    assert(value_as_double(object->entries[4].key) == 2.5);
+
+    // adding to a missing key starts it from the amount
+    Value total;
+    assert(map_add(map, text("sum"), 2.0, &total) == 1);
+    assert(map_add(map, text("sum"), 3.5, &total) == 1);
+    assert(value_as_double(total) == 5.5);
+    assert(map_set(map, text("word"), text("x")));
+    assert(map_add(map, text("word"), 1.0, &total) == -1);
+
+    assert(map_delete(map, value_from_double(1.0)));
+    assert(!map_get(map, value_from_int(1), &value));
+    assert(!map_delete(map, value_from_int(1)));
+    assert(lookup_int(map, text("1")) == 12);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Map key test passed\n");
+}
+
+void test_map_growth_and_order() {
+    printf("Testing map growth and order...\n");
+
+    Value map = map_create();
+    heap_push_root(&map);
+    for (int i = 0; i < 10000; i++) {
+        assert(map_set(map, value_from_int(i * 7), value_from_int(i)));
+    }
+    MapObject *object = value_as_map(map);
+    assert(object->count == 10000);
+    assert(object->capacity >= 10000 / 7 * 8);
+    assert((object->capacity & (object->capacity - 1)) == 0);
+    for (int i = 0; i < 10000; i++) {
+        assert(lookup_int(map, value_from_int(i * 7)) == i);
+    }
+    Value value;
+    assert(!map_get(map, value_from_int(3), &value));
+
+    // deleting every other key leaves the rest in the order they came
+    for (int i = 0; i < 10000; i += 2) {
+        assert(map_delete(map, value_from_int(i * 7)));
+    }
+    assert(object->count == 5000);
+    int expected = 1;
+    for (size_t i = 0; i < object->entry_count; i++) {
+        if (!value_is_null(object->entries[i].key)) {
+            assert(value_as_int(object->entries[i].value) == expected);
+            expected += 2;
+        }
+    }
+    assert(expected == 10001);
+
+    // a key set again after its delete goes to the end
+    assert(map_set(map, value_from_int(0), value_from_int(-1)));
+    assert(value_as_int(object->entries[object->entry_count - 1].value) == -1);
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Map growth test passed\n");
+}
+
+void test_map_churn() {
+    printf("Testing map churn...\n");
+
+    // a small window of keys moving forever should reuse deleted slots
+    // and pack the holes out of the entries rather than grow
+    Value map = map_create();
+    heap_push_root(&map);
+    for (int i = 0; i < 100000; i++) {
+        assert(map_set(map, value_from_int(i), value_from_int(i)));
+        if (i >= 8) {
+            assert(map_delete(map, value_from_int(i - 8)));
+        }
+    }
+    MapObject *object = value_as_map(map);
+    assert(object->count == 8);
+    assert(object->capacity == MAP_GROUP_WIDTH * 2 || object->capacity == MAP_GROUP_WIDTH);
+    assert(object->entry_capacity <= 32);
+    for (int i = 100000 - 8; i < 100000; i++) {
+        assert(lookup_int(map, value_from_int(i)) == i);
+    }
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Map churn test passed\n");
+}
+
+void test_map_collection() {
+    printf("Testing maps through collections...\n");
+
+    Value map = map_create();
+    heap_push_root(&map);
+    char chars[32];
+    for (int i = 0; i < 500; i++) {
+        int length = snprintf(chars, sizeof(chars), "key-%d", i);
+        Value key = string_from_chars(chars, (size_t)length);
+        heap_push_root(&key);
+        length = snprintf(chars, sizeof(chars), "value-%d", i);
+        Value value = string_from_chars(chars, (size_t)length);
+        assert(map_set(map, key, value));
+        heap_pop_roots(1);
+    }
+
+    heap_collect_minor();
+    MapObject *object = value_as_map(map);
+    assert(object->header.flags & OBJECT_OLD);
+    for (int i = 0; i < 500; i++) {
+        snprintf(chars, sizeof(chars), "key-%d", i);
+        Value value;
+        assert(map_get(map, text(chars), &value));
+        snprintf(chars, sizeof(chars), "value-%d", i);
+        assert(strcmp(string_chars(value), chars) == 0);
+    }
+
+    // young keys and values added to the old map survive the next
+    // nursery collection through the remembered set
+    assert(map_set(map, text("young"), text("fresh")));
+    assert(map_set(map, text("key-3"), text("replaced")));
+    assert(object->header.flags & OBJECT_REMEMBERED);
+    heap_collect_minor();
+    Value value;
+    assert(map_get(map, text("young"), &value));
+    assert(strcmp(string_chars(value), "fresh") == 0);
+    assert(map_get(map, text("key-3"), &value));
+    assert(strcmp(string_chars(value), "replaced") == 0);
+
+    // deleted entries let their strings go
+    size_t before = heap_get_stats().objects;
+    for (int i = 100; i < 200; i++) {
+        snprintf(chars, sizeof(chars), "key-%d", i);
+        assert(map_delete(map, text(chars)));
+    }
+    heap_collect_major();
+    assert(heap_get_stats().objects <= before - 100 * 2);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Map collection test passed\n");
+}
+
+void test_map_concurrent_marking() {
+    printf("Testing maps changing under the markers...\n");
+
+    heap_set_nursery_size(64u << 10);
+    heap_set_concurrent_marking(1);
+    heap_set_mark_threads(3);
+
+    Value map = map_create();
+    heap_push_root(&map);
+    char chars[32];
+    for (int i = 0; i < 2000; i++) {
+        int length = snprintf(chars, sizeof(chars), "k%d", i);
+        Value key = string_from_chars(chars, (size_t)length);
+        heap_push_root(&key);
+        assert(map_set(map, key, value_from_int(i)));
+        heap_pop_roots(1);
+    }
+    heap_collect_minor();
+
+    // replacing values, deleting keys and growing the table while the
+    // old map is traced
+    for (int round = 0; round < 3; round++) {
+        heap_start_major();
+        for (int i = 0; i < 2000; i++) {
+            snprintf(chars, sizeof(chars), "k%d", i);
+            Value key = text(chars);
+            heap_push_root(&key);
+            int length = snprintf(chars, sizeof(chars), "v%d-%d", round, i);
+            Value value = string_from_chars(chars, (size_t)length);
+            if (i % 5 == round) {
+                assert(map_delete(map, key));
+            }
+            assert(map_set(map, key, value));
+            snprintf(chars, sizeof(chars), "extra%d-%d", round, i);
+            key = text(chars);
+            assert(map_set(map, key, value_from_int(i)));
+            heap_pop_roots(1);
+        }
+        heap_collect_major();
+    }
+
+    assert(value_as_map(map)->count == 2000 * 4);
+    for (int i = 0; i < 2000; i++) {
+        snprintf(chars, sizeof(chars), "k%d", i);
+        Value value;
+        assert(map_get(map, text(chars), &value));
+        snprintf(chars, sizeof(chars), "v2-%d", i);
+        assert(strcmp(string_chars(value), chars) == 0);
+    }
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Concurrent map test passed\n");
+}
+
+int main() {
+    printf("Running map tests...\n\n");
+
+    test_map_keys();
+    test_map_growth_and_order();
+    test_map_churn();
+    test_map_collection();
+    test_map_concurrent_marking();
+
+    printf("All map tests passed!\n");
+    return 0;
+}
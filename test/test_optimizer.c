@@ -0,0 +1,430 @@
+/*
+ * test_optimizer.c - tests for the ast optimizer
+ *
+ * tests constant propagation through let and if/else, branch
+ * removal, and that runtime errors are never folded away.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include "../include/runtime.h"
+
+// helper to parse and optimize a source string
+static ASTNode* parse_optimized(const char *source) {
+    Lexer *lexer = lexer_create(source);
+    assert(lexer != NULL);
+
+    Parser *parser = parser_create(lexer);
+    assert(parser != NULL);
+
+    ASTNode *program = parser_parse(parser);
+    assert(program != NULL);
+    assert(!parser_has_error(parser));
+
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+
+    assert(optimizer_run(program));
+    return program;
+}
+
+static ASTNode* statement_at(ASTNode *program, int index) {
+    assert(program->type == AST_PROGRAM);
+    assert(index < program->data.program.count);
+    return program->data.program.statements[index];
+}
+
+void test_optimize_let_propagation() {
+    printf("Testing constant propagation through let...\n");
+
+    ASTNode *program = parse_optimized("let x = 2;\nlet y = x * 3;\nprint(y + 1);");
+    assert(program->data.program.count == 3);
+
+    ASTNode *let_y = statement_at(program, 1);
+    assert(let_y->type == AST_LET_DECL);
+    assert(let_y->data.let_decl.value->type == AST_NUMBER);
+    assert(let_y->data.let_decl.value->data.number == 6.0);
+
+    ASTNode *print = statement_at(program, 2);
+    assert(print->type == AST_PRINT_CALL);
+    assert(print->data.print_arg->type == AST_NUMBER);
+    assert(print->data.print_arg->data.number == 7.0);
+
+    ast_destroy(program);
+    printf("Let propagation test passed\n");
+}
+
+void test_optimize_constant_if_true() {
+    printf("Testing constant if condition (true)...\n");
+
+    ASTNode *program = parse_optimized("let mode = 2;\nif (mode == 2) print(1) else print(2);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *live = statement_at(program, 1);
+    assert(live->type == AST_PRINT_CALL);
+    assert(live->data.print_arg->data.number == 1.0);
+
+    ast_destroy(program);
+    printf("Constant if (true) test passed\n");
+}
+
+void test_optimize_constant_if_false() {
+    printf("Testing constant if condition (false)...\n");
+
+    ASTNode *program = parse_optimized("let mode = 1;\nif (mode == 2) print(1) else print(2);\nif (mode > 5) print(3);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *live = statement_at(program, 1);
+    assert(live->type == AST_PRINT_CALL);
+    assert(live->data.print_arg->data.number == 2.0);
+
+    ast_destroy(program);
+    printf("Constant if (false) test passed\n");
+}
+
+void test_optimize_constant_branch_assignment() {
+    printf("Testing assignments inside constant branches...\n");
+
+    ASTNode *program = parse_optimized("let flag = 1;\nif (flag) let scale = 10; else let scale = 20;\nprint(scale * 2);");
+    assert(program->data.program.count == 3);
+
+    ASTNode *let_scale = statement_at(program, 1);
+    assert(let_scale->type == AST_LET_DECL);
+    assert(strcmp(let_scale->data.let_decl.name, "scale") == 0);
+
+    ASTNode *print = statement_at(program, 2);
+    assert(print->data.print_arg->type == AST_NUMBER);
+    assert(print->data.print_arg->data.number == 20.0);
+
+    ast_destroy(program);
+    printf("Constant branch assignment test passed\n");
+}
+
+void test_optimize_nested_constant_if() {
+    printf("Testing nested constant if statements...\n");
+
+    ASTNode *program = parse_optimized("let a = 3;\nif (a > 1) if (a > 5) print(1) else print(2);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *live = statement_at(program, 1);
+    assert(live->type == AST_PRINT_CALL);
+    assert(live->data.print_arg->data.number == 2.0);
+
+    ast_destroy(program);
+    printf("Nested constant if test passed\n");
+}
+
+void test_optimize_unknown_condition_merge() {
+    printf("Testing merge after an unknown condition...\n");
+
+    // both paths agree on y, they disagree on z
+    ASTNode *program = parse_optimized("if (input) let y = 4; else let y = 4;\nif (input) let z = 1; else let z = 2;\nprint(y);\nprint(z);");
+    assert(program->data.program.count == 4);
+    assert(statement_at(program, 0)->type == AST_IF_STMT);
+    assert(statement_at(program, 1)->type == AST_IF_STMT);
+
+    ASTNode *print_y = statement_at(program, 2);
+    assert(print_y->data.print_arg->type == AST_NUMBER);
+    assert(print_y->data.print_arg->data.number == 4.0);
+
+    ASTNode *print_z = statement_at(program, 3);
+    assert(print_z->data.print_arg->type == AST_IDENTIFIER);
+
+    ast_destroy(program);
+    printf("Unknown condition merge test passed\n");
+}
+
+void test_optimize_maybe_undefined() {
+    printf("Testing variables defined on only one path...\n");
+
+    // y may be undefined, so the lookup (and its error) must stay
+    ASTNode *program = parse_optimized("if (input) let y = 1;\nprint(y);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *print = statement_at(program, 1);
+    assert(print->data.print_arg->type == AST_IDENTIFIER);
+
+    ast_destroy(program);
+    printf("Maybe undefined test passed\n");
+}
+
+void test_optimize_keeps_runtime_errors() {
+    printf("Testing that runtime errors are not folded...\n");
+
+    ASTNode *program = parse_optimized("let zero = 0;\nprint(5 / zero);\nif (1 / 0) print(1);");
+    assert(program->data.program.count == 3);
+
+    ASTNode *print = statement_at(program, 1);
+    assert(print->data.print_arg->type == AST_BINARY_OP);
+    assert(print->data.print_arg->data.binary.right->type == AST_NUMBER);
+    assert(statement_at(program, 2)->type == AST_IF_STMT);
+    assert(!interpreter_has_error());
+
+    Environment *env = env_create();
+    assert(env != NULL);
+    interpret(program, env);
+    assert(interpreter_has_error());
+    assert(strstr(interpreter_get_error(), "Division by zero") != NULL);
+    interpreter_clear_error();
+
+    env_destroy(env);
+    ast_destroy(program);
+    printf("Runtime errors test passed\n");
+}
+
+void test_optimize_empty_branches() {
+    printf("Testing if with branches that optimize away...\n");
+
+    // both branches vanish, only the condition is kept for its errors
+    ASTNode *program = parse_optimized("let a = 1;\nif (input) if (a == 2) print(1) else if (a == 3) print(2);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *remaining = statement_at(program, 1);
+    assert(remaining->type == AST_IDENTIFIER);
+    assert(strcmp(remaining->data.identifier, "input") == 0);
+
+    ast_destroy(program);
+    printf("Empty branches test passed\n");
+}
+
+void test_optimize_shared_subtrees() {
+    printf("Testing folding of shared subtrees...\n");
+
+    // both a + 1 come from one hash-consed node, but only the second
+    // use sees a constant a
+    ASTNode *program = parse_optimized("print(a + 1);\nlet a = 5;\nprint(a + 1);");
+    assert(program->data.program.count == 3);
+
+    ASTNode *before = statement_at(program, 0);
+    assert(before->data.print_arg->type == AST_BINARY_OP);
+    assert(before->data.print_arg->data.binary.left->type == AST_IDENTIFIER);
+
+    ASTNode *after = statement_at(program, 2);
+    assert(after->data.print_arg->type == AST_NUMBER);
+    assert(after->data.print_arg->data.number == 6.0);
+
+    ast_destroy(program);
+    printf("Shared subtrees test passed\n");
+}
+
+// helper to read one rule's counters by name
+static PeepholeStats peephole_rule(const char *name) {
+    PeepholeStats stats[32];
+    int count = optimizer_get_peephole_stats(stats, 32);
+    assert(count <= 32);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(stats[i].name, name) == 0) {
+            return stats[i];
+        }
+    }
+    assert(0 && "unknown peephole rule");
+    return stats[0];
+}
+
+void test_peephole_identities() {
+    printf("Testing peephole arithmetic identities...\n");
+
+    PeepholeStats mul_before = peephole_rule("mul-by-one");
+    PeepholeStats sub_before = peephole_rule("sub-zero");
+
+    ASTNode *program = parse_optimized("print((x - w) * 1 - 0);\nprint((y * v) / 1);\nprint(1 * (z - u));");
+    assert(program->data.program.count == 3);
+    const char operators[] = { '-', '*', '-' };
+    for (int i = 0; i < 3; i++) {
+        ASTNode *arg = statement_at(program, i)->data.print_arg;
+        assert(arg->type == AST_BINARY_OP);
+        assert(arg->data.binary.operator == operators[i]);
+        assert(arg->data.binary.left->type == AST_IDENTIFIER);
+    }
+
+    PeepholeStats mul_after = peephole_rule("mul-by-one");
+    PeepholeStats sub_after = peephole_rule("sub-zero");
+    assert(mul_after.hits == mul_before.hits + 1);
+    assert(mul_after.nodes_removed == mul_before.nodes_removed + 2);
+    assert(sub_after.hits == sub_before.hits + 1);
+
+    ast_destroy(program);
+    printf("Peephole identities test passed\n");
+}
+
+void test_peephole_keeps_inexact_rewrites() {
+    printf("Testing peephole leaves inexact rewrites alone...\n");
+
+    // x + 0 turns -0 into 0 and 0 * x loses nan, so neither may go
+    ASTNode *program = parse_optimized("print(x + 0);\nprint(0 * x);\nprint(x * 2);");
+    for (int i = 0; i < 3; i++) {
+        assert(statement_at(program, i)->data.print_arg->type == AST_BINARY_OP);
+    }
+
+    ast_destroy(program);
+    printf("Inexact rewrites test passed\n");
+}
+
+void test_peephole_needs_numbers() {
+    printf("Testing peephole identities need numeric operands...\n");
+
+    // a variable could hold a string, where x * 1 fails and x - 0 too
+    ASTNode *program = parse_optimized("print(x * 1);\nprint(1 * y);\nprint(s - 0);\nprint((\"a\" + t) / 1);");
+    for (int i = 0; i < 4; i++) {
+        assert(statement_at(program, i)->data.print_arg->type == AST_BINARY_OP);
+    }
+
+    ast_destroy(program);
+    printf("Numeric operand test passed\n");
+}
+
+void test_fold_call_and_index_operands() {
+    printf("Testing folding inside calls and indexes...\n");
+
+    ASTNode *program = parse_optimized("let n = 4;\nlet a = Float64Array(n * 2);\na[n - 1] = n + 0.5;\nprint(a[n - 1] * 1);");
+
+    ASTNode *create = statement_at(program, 1)->data.let_decl.value;
+    assert(create->type == AST_CALL);
+    assert(create->data.call.args[0]->type == AST_NUMBER);
+    assert(create->data.call.args[0]->data.number == 8.0);
+
+    ASTNode *store = statement_at(program, 2);
+    assert(store->type == AST_INDEX_ASSIGN);
+    assert(store->data.index.index->type == AST_NUMBER && store->data.index.index->data.number == 3.0);
+    assert(store->data.index.value->type == AST_NUMBER && store->data.index.value->data.number == 4.5);
+
+    // an element could be anything later, so the identity stays
+    ASTNode *print_arg = statement_at(program, 3)->data.print_arg;
+    assert(print_arg->type == AST_BINARY_OP);
+    assert(print_arg->data.binary.left->type == AST_INDEX);
+
+    ast_destroy(program);
+    printf("Call and index folding test passed\n");
+}
+
+void test_fold_intrinsics() {
+    printf("Testing intrinsic folding...\n");
+
+    ASTNode *program = parse_optimized("let n = 16;\nprint(sqrt(n) + pow(2, n - 6));\nprint(exp(x) + log(n));\nprint(sqrt(x * 2) * 1);\nprint(sqrt(a) * 1);");
+
+    ASTNode *folded = statement_at(program, 1)->data.print_arg;
+    assert(folded->type == AST_NUMBER && folded->data.number == 1028.0);
+
+    // a variable argument stays, its constant neighbours fold
+    ASTNode *partly = statement_at(program, 2)->data.print_arg;
+    assert(partly->data.binary.left->type == AST_INTRINSIC);
+    assert(partly->data.binary.right->type == AST_NUMBER);
+    assert(partly->data.binary.right->data.number == log(16.0));
+
+    // the square root of a number is a number, so * 1 goes; of a
+    // variable that could hold an array, it stays
+    ASTNode *identity = statement_at(program, 3)->data.print_arg;
+    assert(identity->type == AST_INTRINSIC);
+    ASTNode *kept = statement_at(program, 4)->data.print_arg;
+    assert(kept->type == AST_BINARY_OP);
+
+    ast_destroy(program);
+    printf("Intrinsic folding test passed\n");
+}
+
+void test_peephole_comparisons() {
+    printf("Testing peephole comparison tests...\n");
+
+    ASTNode *program = parse_optimized("if ((a > b) != 0) print(1);\nif ((a < b) == 1) print(2);\nif ((a + b) != 0) print(3);");
+
+    ASTNode *first = statement_at(program, 0)->data.if_stmt.condition;
+    assert(first->type == AST_BINARY_OP && first->data.binary.operator == '>');
+
+    ASTNode *second = statement_at(program, 1)->data.if_stmt.condition;
+    assert(second->type == AST_BINARY_OP && second->data.binary.operator == '<');
+
+    // not a comparison, so != 0 still does real work
+    ASTNode *third = statement_at(program, 2)->data.if_stmt.condition;
+    assert(third->data.binary.operator == 'N');
+
+    ast_destroy(program);
+    printf("Peephole comparison test passed\n");
+}
+
+void test_peephole_redundant_test() {
+    printf("Testing peephole redundant nested tests...\n");
+
+    PeepholeStats before = peephole_rule("redundant-test");
+
+    ASTNode *program = parse_optimized("if (a > 1) if (a > 1) print(1) else print(2);\nif (b) print(3) else if (b) print(4) else print(5);");
+    assert(program->data.program.count == 2);
+
+    ASTNode *first = statement_at(program, 0);
+    assert(first->data.if_stmt.if_branch->type == AST_PRINT_CALL);
+    assert(first->data.if_stmt.if_branch->data.print_arg->data.number == 1.0);
+    assert(first->data.if_stmt.else_branch == NULL);
+
+    ASTNode *second = statement_at(program, 1);
+    assert(second->data.if_stmt.else_branch->type == AST_PRINT_CALL);
+    assert(second->data.if_stmt.else_branch->data.print_arg->data.number == 5.0);
+
+    PeepholeStats after = peephole_rule("redundant-test");
+    assert(after.hits == before.hits + 2);
+
+    ast_destroy(program);
+    printf("Redundant nested test passed\n");
+}
+
+void test_peephole_statements() {
+    printf("Testing peephole statement rules...\n");
+
+    ASTNode *program = parse_optimized("let x = x;\n42;\nlet k = 0;\nif (c) print(1) else if (k) print(2);");
+    assert(program->data.program.count == 3);
+
+    // the store is gone but the load (and its undefined error) stays
+    ASTNode *load = statement_at(program, 0);
+    assert(load->type == AST_IDENTIFIER);
+    assert(strcmp(load->data.identifier, "x") == 0);
+
+    assert(statement_at(program, 1)->type == AST_LET_DECL);
+
+    // the dead else branch folded away entirely
+    ASTNode *branch = statement_at(program, 2);
+    assert(branch->type == AST_IF_STMT);
+    assert(branch->data.if_stmt.else_branch == NULL);
+
+    ast_destroy(program);
+    printf("Peephole statement rules test passed\n");
+}
+
+void test_optimize_invalid_input() {
+    printf("Testing optimizer with invalid input...\n");
+
+    assert(!optimizer_run(NULL));
+
+    ASTNode *number = ast_create_number(1.0);
+    assert(!optimizer_run(number));
+    ast_destroy(number);
+
+    printf("Invalid input test passed\n");
+}
+
+int main() {
+    printf("Running optimizer tests...\n\n");
+
+    test_optimize_let_propagation();
+    test_optimize_constant_if_true();
+    test_optimize_constant_if_false();
+    test_optimize_constant_branch_assignment();
+    test_optimize_nested_constant_if();
+    test_optimize_unknown_condition_merge();
+    test_optimize_maybe_undefined();
+    test_optimize_keeps_runtime_errors();
+    test_optimize_empty_branches();
+    test_optimize_shared_subtrees();
+    test_peephole_identities();
+    test_peephole_keeps_inexact_rewrites();
+    test_peephole_needs_numbers();
+    test_fold_call_and_index_operands();
+    test_fold_intrinsics();
+    test_peephole_comparisons();
+    test_peephole_redundant_test();
+    test_peephole_statements();
+    test_optimize_invalid_input();
+
+    printf("All optimizer tests passed!\n");
+    return 0;
+}
@@ -26,6 +26,52 @@ void print_ast(ASTNode *node, int indent) {
         case AST_IDENTIFIER:
             printf("%*sIDENTIFIER: %s\n", indent, "", node->data.identifier);
             break;
+        case AST_STRING:
+            printf("%*sSTRING: \"%s\"\n", indent, "", node->data.string.chars);
+            break;
+        case AST_CALL:
+            printf("%*sCALL: %s\n", indent, "", node->data.call.name);
+            for (int i = 0; i < node->data.call.count; i++) {
+                print_ast(node->data.call.args[i], indent + 2);
+            }
+            break;
+        case AST_INTRINSIC:
+            printf("%*sINTRINSIC: %s\n", indent, "", node->data.intrinsic.intrinsic->name);
+            for (int i = 0; i < node->data.intrinsic.count; i++) {
+                print_ast(node->data.intrinsic.args[i], indent + 2);
+            }
+            break;
+        case AST_ARRAY:
+            printf("%*sARRAY\n", indent, "");
+            for (int i = 0; i < node->data.array.count; i++) {
+                print_ast(node->data.array.elements[i], indent + 2);
+            }
+            break;
+        case AST_OBJECT:
+            printf("%*sOBJECT\n", indent, "");
+            for (int i = 0; i < node->data.object.count; i++) {
+                printf("%*s%s:\n", indent + 2, "", node->data.object.keys[i]);
+                print_ast(node->data.object.values[i], indent + 4);
+            }
+            break;
+        case AST_PROPERTY:
+        case AST_PROPERTY_ASSIGN:
+            printf("%*s%s: %s\n", indent, "", node->type == AST_PROPERTY ? "PROPERTY" : "PROPERTY_ASSIGN",
+                   node->data.property.name);
+            print_ast(node->data.property.object, indent + 2);
+            if (node->data.property.value) {
+                print_ast(node->data.property.value, indent + 2);
+            }
+            break;
+        case AST_INDEX:
+        case AST_INDEX_ASSIGN:
+            printf("%*s%s\n", indent, "", node->type == AST_INDEX ? "INDEX" : "INDEX_ASSIGN");
+            print_ast(node->data.index.object, indent + 2);
+            print_ast(node->data.index.index, indent + 2);
+            if (node->data.index.value) {
+                print_ast(node->data.index.value, indent + 2);
+            }
+            break;
         case AST_BINARY_OP:
             printf("%*sBINARY_OP: %c\n", indent, "", node->data.binary.operator);
             print_ast(node->data.binary.left, indent + 2);
@@ -698,6 +744,293 @@ void test_if_statement_error_handling() {
     printf("If statement error handling test passed!\n\n");
 }
 
+// test that repeated expressions share one subtree
+void test_shared_subtrees() {
+    printf("Testing shared expression subtrees...\n");
+    
+    const char *source = "let a = (x + 1) * y;\nlet b = (x + 1) * y;\nprint(x + 1);";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    assert(ast->data.program.count == 3);
+    
+    ASTNode *a = ast->data.program.statements[0]->data.let_decl.value;
+    ASTNode *b = ast->data.program.statements[1]->data.let_decl.value;
+    ASTNode *c = ast->data.program.statements[2]->data.print_arg;
+    assert(a == b);
+    assert(a->data.binary.left == c);
+    
+    // 3 + 3 + 3 nodes requested, only x, 1, x + 1, y and the product exist
+    ASTConsStats stats = parser_get_cons_stats(parser);
+    assert(stats.requested == 13);
+    assert(stats.unique == 5);
+    
+    // the tree must outlive the parser's table
+    parser_destroy(parser);
+    assert(c->data.binary.right->data.number == 1.0);
+    
+    ast_destroy(ast);
+    lexer_destroy(lexer);
+    
+    printf("Shared expression subtrees test passed!\n\n");
+}
+
+// whole numbers and halves have nothing but zeros in the low bits the
+// table picks a slot from, so without mixing they all collide and every
+// lookup scans one long run
+void test_shared_subtrees_spread() {
+    printf("Testing hash-consing of many literals...\n");
+    
+    const size_t lines = 4000;
+    char *source = malloc(lines * 32);
+    assert(source != NULL);
+    size_t used = 0;
+    for (size_t i = 0; i < lines; i++) {
+        used += (size_t)sprintf(source + used, "print(%zu);\nprint(x + %zu.5);\n", i, i);
+    }
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    assert((size_t)ast->data.program.count == 2 * lines);
+    
+    ASTConsStats stats = parser_get_cons_stats(parser);
+    assert(stats.unique == 3 * lines + 1);
+    // a few slots per lookup at most, not thousands
+    assert(stats.probes < 2 * stats.requested);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    free(source);
+    
+    printf("Hash-consing of many literals test passed!\n\n");
+}
+
+// test string literals in expressions
+void test_string_literals() {
+    printf("Testing string literal parsing...\n");
+    
+    const char *source = "let s = \"a\" + name;\nprint(s + \"a\");";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    
+    ASTNode *concat = ast->data.program.statements[0]->data.let_decl.value;
+    assert(concat->type == AST_BINARY_OP);
+    assert(concat->data.binary.operator == '+');
+    assert(concat->data.binary.left->type == AST_STRING);
+    assert(strcmp(concat->data.binary.left->data.string.chars, "a") == 0);
+    
+    // equal literals are one shared node
+    ASTNode *print_arg = ast->data.program.statements[1]->data.print_arg;
+    assert(print_arg->data.binary.right == concat->data.binary.left);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    
+    printf("String literal parsing test passed!\n\n");
+}
+
+void test_calls_and_indexing() {
+    printf("Testing call and index parsing...\n");
+    
+    const char *source = "let a = Float64Array(n + 1);\na[i * 2] = dot(a, b);\nprint(a[0][1] + sum(a));";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    assert(ast->data.program.count == 3);
+    
+    ASTNode *create = ast->data.program.statements[0]->data.let_decl.value;
+    assert(create->type == AST_CALL);
+    assert(strcmp(create->data.call.name, "Float64Array") == 0);
+    assert(create->data.call.count == 1);
+    assert(create->data.call.args[0]->type == AST_BINARY_OP);
+    
+    ASTNode *store = ast->data.program.statements[1];
+    assert(store->type == AST_INDEX_ASSIGN);
+    assert(store->data.index.index->data.binary.operator == '*');
+    assert(store->data.index.value->type == AST_CALL);
+    assert(store->data.index.value->data.call.count == 2);
+    
+    // suffixes chain left to right and bind tighter than +
+    ASTNode *add = ast->data.program.statements[2]->data.print_arg;
+    assert(add->type == AST_BINARY_OP);
+    assert(add->data.binary.left->type == AST_INDEX);
+    assert(add->data.binary.left->data.index.object->type == AST_INDEX);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    
+    const char *bad[] = {"print(a[1);", "print(f(1, 2);", "print(f(1,));"};
+    for (int i = 0; i < 3; i++) {
+        lexer = lexer_create(bad[i]);
+        parser = parser_create(lexer);
+        ast = parser_parse(parser);
+        assert(ast == NULL);
+        assert(parser_has_error(parser));
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+    }
+    
+    printf("Call and index parsing test passed!\n\n");
+}
+
+void test_intrinsics() {
+    printf("Testing math intrinsics...\n");
+    
+    const char *source = "print(sqrt(x) + pow(2, y));\nprint(log(exp(1)) + sum(x));";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    
+    // math functions are their own nodes, other calls stay calls
+    ASTNode *add = ast->data.program.statements[0]->data.print_arg;
+    assert(add->data.binary.left->type == AST_INTRINSIC);
+    assert(add->data.binary.left->data.intrinsic.intrinsic->kind == INTRINSIC_SQRT);
+    assert(add->data.binary.left->data.intrinsic.count == 1);
+    ASTNode *power = add->data.binary.right;
+    assert(power->type == AST_INTRINSIC);
+    assert(power->data.intrinsic.intrinsic->kind == INTRINSIC_POW);
+    assert(power->data.intrinsic.args[0]->type == AST_NUMBER);
+    assert(power->data.intrinsic.args[1]->type == AST_IDENTIFIER);
+    
+    add = ast->data.program.statements[1]->data.print_arg;
+    assert(add->data.binary.left->type == AST_INTRINSIC);
+    assert(add->data.binary.left->data.intrinsic.args[0]->type == AST_INTRINSIC);
+    assert(add->data.binary.right->type == AST_CALL);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    
+    // the argument count is checked while parsing
+    const char *bad[] = {"print(sqrt());", "print(sqrt(1, 2));", "print(pow(2));"};
+    for (int i = 0; i < 3; i++) {
+        lexer = lexer_create(bad[i]);
+        parser = parser_create(lexer);
+        ast = parser_parse(parser);
+        assert(ast == NULL);
+        assert(parser_has_error(parser));
+        printf("%s error: %s\n", bad[i], parser_get_error(parser));
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+    }
+    
+    printf("Math intrinsics test passed!\n\n");
+}
+
+void test_array_literals() {
+    printf("Testing array literal parsing...\n");
+    
+    const char *source = "let a = [1, \"b\", [x + 1], []];\nprint([2][0]);";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    
+    ASTNode *array = ast->data.program.statements[0]->data.let_decl.value;
+    assert(array->type == AST_ARRAY);
+    assert(array->data.array.count == 4);
+    assert(array->data.array.elements[1]->type == AST_STRING);
+    assert(array->data.array.elements[2]->type == AST_ARRAY);
+    assert(array->data.array.elements[2]->data.array.elements[0]->type == AST_BINARY_OP);
+    assert(array->data.array.elements[3]->data.array.count == 0);
+    
+    // a literal can be indexed straight away
+    ASTNode *index = ast->data.program.statements[1]->data.print_arg;
+    assert(index->type == AST_INDEX);
+    assert(index->data.index.object->type == AST_ARRAY);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    
+    const char *bad[] = {"print([1, 2);", "print([1,]);", "print([,]);"};
+    for (int i = 0; i < 3; i++) {
+        lexer = lexer_create(bad[i]);
+        parser = parser_create(lexer);
+        ast = parser_parse(parser);
+        assert(ast == NULL);
+        assert(parser_has_error(parser));
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+    }
+    
+    printf("Array literal parsing test passed!\n\n");
+}
+
+void test_objects_and_properties() {
+    printf("Testing object literal and property parsing...\n");
+    
+    const char *source = "let p = {x: 1, \"y z\": [2], q: {}};\nprint(p.q.x + p.q.x);\np.x = p.x * 2;";
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    
+    ASTNode *ast = parser_parse(parser);
+    assert(ast != NULL);
+    assert(!parser_has_error(parser));
+    assert(ast->data.program.count == 3);
+    
+    ASTNode *object = ast->data.program.statements[0]->data.let_decl.value;
+    assert(object->type == AST_OBJECT);
+    assert(object->data.object.count == 3);
+    assert(strcmp(object->data.object.keys[1], "y z") == 0);
+    assert(object->data.object.values[1]->type == AST_ARRAY);
+    assert(object->data.object.values[2]->type == AST_OBJECT);
+    assert(object->data.object.values[2]->data.object.count == 0);
+    
+    // repeated reads of a property share one node and its cache
+    ASTNode *sum = ast->data.program.statements[1]->data.print_arg;
+    assert(sum->data.binary.left == sum->data.binary.right);
+    ASTNode *read = sum->data.binary.left;
+    assert(read->type == AST_PROPERTY);
+    assert(strcmp(read->data.property.name, "x") == 0);
+    assert(read->data.property.object->type == AST_PROPERTY);
+    assert(read->data.property.cache != NULL);
+    
+    ASTNode *store = ast->data.program.statements[2];
+    assert(store->type == AST_PROPERTY_ASSIGN);
+    assert(strcmp(store->data.property.name, "x") == 0);
+    assert(store->data.property.object->type == AST_IDENTIFIER);
+    assert(store->data.property.value->data.binary.left->type == AST_PROPERTY);
+    
+    ast_destroy(ast);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    
+    const char *bad[] = {"print({x 1});", "print({x: 1,});", "print({1: 2});", "print(p.);", "print({x: 1);"};
+    for (int i = 0; i < 5; i++) {
+        lexer = lexer_create(bad[i]);
+        parser = parser_create(lexer);
+        ast = parser_parse(parser);
+        assert(ast == NULL);
+        assert(parser_has_error(parser));
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+    }
+    
+    printf("Object literal and property parsing test passed!\n\n");
+}
+
 int main() {
     printf("Running parser tests...\n\n");
     
@@ -715,6 +1048,13 @@ int main() {
     test_if_with_variable_condition();
     test_if_with_different_statements();
     test_if_statement_error_handling();
+    test_shared_subtrees();
+    test_shared_subtrees_spread();
+    test_string_literals();
+    test_calls_and_indexing();
+    test_intrinsics();
+    test_array_literals();
+    test_objects_and_properties();
     
     printf("All parser tests passed!\n");
     return 0;
@@ -0,0 +1,170 @@
+/*
+ * test_pool.c - tests for the runtime's thread pool
+ *
+ * every chunk must run exactly once on any thread count, tasks started
+ * from inside a task must still finish, and reductions must give the
+ * same bits whatever the number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/pool.h"
+#include "../include/vecmath.h"
+#include "../include/kernels.h"
+
+typedef struct {
+    size_t *runs;
+    size_t nested_chunks;
+} CountTask;
+
+static void count_chunk(void *context, size_t chunk) {
+    CountTask *task = context;
+    __atomic_add_fetch(&task->runs[chunk], 1, __ATOMIC_RELAXED);
+    // a bit of uneven work, heavier towards the front
+    volatile double x = 0.0;
+    for (size_t i = 0; i < (chunk % 7) * 1000; i++) {
+        x += (double)i;
+    }
+}
+
+static void nested_chunk(void *context, size_t chunk) {
+    CountTask *task = context;
+    size_t runs[16] = {0};
+    CountTask inner = { runs, 0 };
+    assert(pool_run(count_chunk, &inner, task->nested_chunks, 4) == 1);
+    for (size_t i = 0; i < task->nested_chunks; i++) {
+        assert(runs[i] == 1);
+    }
+    __atomic_add_fetch(&task->runs[chunk], 1, __ATOMIC_RELAXED);
+}
+
+void test_pool_run() {
+    printf("Testing runs...\n");
+
+    size_t chunk_counts[] = { 0, 1, 2, 7, 1000 };
+    size_t threads[] = { 1, 2, 3, 8, 0 };
+    size_t *runs = malloc(1000 * sizeof(size_t));
+    for (size_t c = 0; c < sizeof(chunk_counts) / sizeof(chunk_counts[0]); c++) {
+        for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+            memset(runs, 0, 1000 * sizeof(size_t));
+            CountTask task = { runs, 0 };
+            size_t used = pool_run(count_chunk, &task, chunk_counts[c], threads[t]);
+            assert(used >= 1 && used <= POOL_MAX_THREADS);
+            assert(threads[t] == 0 || used <= threads[t]);
+            for (size_t i = 0; i < chunk_counts[c]; i++) {
+                assert(runs[i] == 1);
+            }
+        }
+    }
+
+    // a task inside a task runs on the thread that started it
+    memset(runs, 0, 1000 * sizeof(size_t));
+    CountTask outer = { runs, 16 };
+    pool_run(nested_chunk, &outer, 12, 3);
+    for (size_t i = 0; i < 12; i++) {
+        assert(runs[i] == 1);
+    }
+
+    // the threads stop, and start again for the next task
+    pool_shutdown();
+    memset(runs, 0, 1000 * sizeof(size_t));
+    CountTask again = { runs, 0 };
+    pool_run(count_chunk, &again, 100, 4);
+    for (size_t i = 0; i < 100; i++) {
+        assert(runs[i] == 1);
+    }
+    free(runs);
+
+    printf("Run test passed\n");
+}
+
+static int same(double a, double b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+void test_pool_reduce() {
+    printf("Testing reductions...\n");
+
+    assert(pool_chunk_size(0) == POOL_CHUNK_MIN);
+    assert(pool_chunk_size(POOL_CHUNK_MIN * POOL_MAX_CHUNKS * 3) == POOL_CHUNK_MIN * 3);
+
+    size_t sizes[] = { 0, 1, 100, POOL_CHUNK_MIN, 3 * POOL_CHUNK_MIN + 5, POOL_CHUNK_MIN * POOL_MAX_CHUNKS + 77 };
+    size_t largest = POOL_CHUNK_MIN * POOL_MAX_CHUNKS + 77;
+    double *x = malloc(largest * sizeof(double));
+    for (size_t i = 0; i < largest; i++) {
+        x[i] = sin((double)i) * 1e3 + 1e-3 * (double)(i % 97);
+    }
+    double *ones = malloc(largest * sizeof(double));
+    for (size_t i = 0; i < largest; i++) {
+        ones[i] = i % 3 == 0 ? 1.0000001 : 0.9999999;
+    }
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        // the documented order: kernel sums of chunks, then of those sums
+        size_t size = pool_chunk_size(n);
+        double partials[POOL_MAX_CHUNKS];
+        size_t chunks = 0;
+        for (size_t start = 0; start < n; start += size) {
+            partials[chunks++] = kernel_sum(x + start, n - start < size ? n - start : size);
+        }
+        double want_sum = chunks <= 1 ? kernel_sum(x, n) : kernel_sum(partials, chunks);
+
+        size_t threads[] = { 1, 2, 3, 8, 0 };
+        for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+            assert(same(pool_reduce(POOL_SUM, x, n, threads[t]), want_sum));
+            assert(same(pool_reduce(POOL_PRODUCT, ones, n, threads[t]), pool_reduce(POOL_PRODUCT, ones, n, 1)));
+            assert(same(pool_reduce(POOL_MIN, x, n, threads[t]), n ? kernel_min(x, n) : INFINITY));
+            assert(same(pool_reduce(POOL_MAX, x, n, threads[t]), n ? kernel_max(x, n) : -INFINITY));
+        }
+    }
+    assert(pool_reduce(POOL_PRODUCT, x, 0, 0) == 1.0);
+    double small[] = { 2, 3, 4 };
+    assert(pool_reduce(POOL_PRODUCT, small, 3, 0) == 24.0);
+    assert(pool_reduce(POOL_SUM, small, 3, 0) == 9.0);
+
+    free(x);
+    free(ones);
+    printf("Reduction test passed\n");
+}
+
+void test_pool_tabulate() {
+    printf("Testing tabulation...\n");
+
+    size_t n = 5 * POOL_CHUNK_MIN + 3;
+    double *index = malloc(n * sizeof(double));
+    double *want = malloc(n * sizeof(double));
+    double *got = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++) {
+        index[i] = 10.0 + (double)i;
+    }
+    vecmath_sqrt(index, want, n);
+
+    size_t threads[] = { 1, 2, 3, 0 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        memset(got, 0, n * sizeof(double));
+        pool_tabulate(vecmath_sqrt, 10.0, got, n, threads[t]);
+        assert(memcmp(got, want, n * sizeof(double)) == 0);
+    }
+    assert(pool_tabulate(vecmath_exp, 0.0, got, 0, 0) == 1);
+
+    free(index);
+    free(want);
+    free(got);
+    printf("Tabulation test passed\n");
+}
+
+int main() {
+    printf("Running pool tests...\n\n");
+
+    test_pool_run();
+    test_pool_reduce();
+    test_pool_tabulate();
+
+    printf("  %zu steals\n", pool_steals());
+    printf("All pool tests passed!\n");
+    return 0;
+}
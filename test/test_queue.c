@@ -0,0 +1,163 @@
+/*
+ * test_queue.c - tests for the message queues between interpreters
+ *
+ * a queue must hold exactly its capacity, keep each producer's messages
+ * in order when several post at once through a small ring, refuse posts
+ * once closed and stop a waiting consumer once nobody can send.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "../include/queue.h"
+
+static Message number_message(double number) {
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.kind = MESSAGE_NUMBER;
+    message.number = number;
+    return message;
+}
+
+void test_queue_order() {
+    printf("Testing order and capacity...\n");
+
+    // rounded up to 8 slots
+    MessageQueue *queue = queue_create(5);
+    assert(queue);
+    Message message;
+    assert(!queue_try_take(queue, &message));
+
+    // several laps round the ring
+    double next_in = 0, next_out = 0;
+    for (int lap = 0; lap < 5; lap++) {
+        for (int i = 0; i < 8; i++) {
+            Message in = number_message(next_in++);
+            assert(queue_try_post(queue, &in));
+        }
+        Message extra = number_message(-1);
+        assert(!queue_try_post(queue, &extra));
+        for (int i = 0; i < 8; i++) {
+            assert(queue_try_take(queue, &message));
+            assert(message.kind == MESSAGE_NUMBER && message.number == next_out++);
+        }
+        assert(!queue_try_take(queue, &message));
+    }
+
+    // half full, then interleaved
+    for (int i = 0; i < 4; i++) {
+        Message in = number_message(next_in++);
+        assert(queue_try_post(queue, &in));
+    }
+    for (int i = 0; i < 20; i++) {
+        Message in = number_message(next_in++);
+        assert(queue_try_post(queue, &in));
+        assert(queue_try_take(queue, &message) && message.number == next_out++);
+    }
+    queue_release(queue);
+
+    printf("Order test passed\n");
+}
+
+void test_queue_close() {
+    printf("Testing closing and senders...\n");
+
+    MessageQueue *queue = queue_create(4);
+    queue_add_sender(queue);
+    Message in = number_message(1);
+    assert(queue_post(queue, &in));
+    queue_remove_sender(queue);
+
+    // what was posted before the last sender left is still taken
+    Message message;
+    assert(queue_take(queue, &message) && message.number == 1);
+    assert(!queue_take(queue, &message));
+
+    queue_close(queue);
+    assert(!queue_try_post(queue, &in));
+    assert(!queue_post(queue, &in));
+
+    // messages left behind are freed with the queue
+    MessageQueue *other = queue_create(4);
+    queue_retain(other);
+    Message text;
+    memset(&text, 0, sizeof(text));
+    text.kind = MESSAGE_STRING;
+    text.data = malloc(6);
+    memcpy(text.data, "hello", 6);
+    text.length = 5;
+    assert(queue_try_post(other, &text));
+    queue_release(other);
+    queue_release(other);
+    queue_release(queue);
+
+    printf("Close test passed\n");
+}
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+
+typedef struct {
+    MessageQueue *queue;
+    int id;
+} Producer;
+
+static void* produce(void *argument) {
+    Producer *producer = argument;
+    for (int i = 0; i < PER_PRODUCER; i++) {
+        Message message = number_message((double)(producer->id * PER_PRODUCER + i));
+        assert(queue_post(producer->queue, &message));
+    }
+    queue_remove_sender(producer->queue);
+    return NULL;
+}
+
+void test_queue_producers() {
+    printf("Testing several producers...\n");
+
+    // a small ring, so producers keep finding it full
+    MessageQueue *queue = queue_create(16);
+    Producer producers[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers[p].queue = queue;
+        producers[p].id = p;
+        queue_add_sender(queue);
+    }
+    for (int p = 0; p < PRODUCERS; p++) {
+        assert(pthread_create(&threads[p], NULL, produce, &producers[p]) == 0);
+    }
+
+    int next[PRODUCERS] = {0};
+    size_t received = 0;
+    Message message;
+    while (queue_take(queue, &message)) {
+        int value = (int)message.number;
+        int p = value / PER_PRODUCER;
+        assert(p >= 0 && p < PRODUCERS);
+        assert(value % PER_PRODUCER == next[p]);
+        next[p]++;
+        received++;
+    }
+    assert(received == (size_t)PRODUCERS * PER_PRODUCER);
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+        assert(next[p] == PER_PRODUCER);
+    }
+    queue_release(queue);
+
+    printf("Producer test passed\n");
+}
+
+int main() {
+    printf("Running queue tests...\n\n");
+
+    test_queue_order();
+    test_queue_close();
+    test_queue_producers();
+
+    printf("All queue tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * test_random.c - tests for the random number generator
+ *
+ * the generator, its seeding and its jumps are checked against numbers
+ * from the reference xoshiro256** and splitmix64. fills must match the
+ * streams they are documented to come from on every instruction set
+ * and thread count.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/random.h"
+#include "../include/kernels.h"
+
+static int same_state(const RandomState *a, const RandomState *b) {
+    return memcmp(a->s, b->s, sizeof(a->s)) == 0;
+}
+
+void test_random_reference() {
+    printf("Testing reference numbers...\n");
+
+    RandomState state = { { 1, 2, 3, 4 } };
+    assert(random_next(&state) == 11520ULL);
+    assert(random_next(&state) == 0ULL);
+    assert(random_next(&state) == 1509978240ULL);
+    assert(random_next(&state) == 1215971899390074240ULL);
+    assert(random_next(&state) == 1216172134540287360ULL);
+
+    random_seed(&state, 0);
+    RandomState zero = { { 0xe220a8397b1dcdafULL, 0x6e789e6aa1b965f4ULL, 0x06c45d188009454fULL, 0xf88bb8a8724c81ecULL } };
+    assert(same_state(&state, &zero));
+    assert(random_next(&state) == 0x99ec5f36cb75f2b4ULL);
+
+    random_seed(&state, 42);
+    assert(random_next(&state) == 0x15780b2e0c2ec716ULL);
+    assert(random_next(&state) == 0x6104d9866d113a7eULL);
+    assert(random_next(&state) == 0xae17533239e499a1ULL);
+
+    // the jumps as 2^128 and 2^192 steps of the generator's linear map
+    RandomState jumped = { { 1, 2, 3, 4 } };
+    RandomState want = { { 0x8c7a153956b5f3d1ULL, 0x701f1a713401d85eULL, 0x6527f66a65469085ULL, 0x8386b786c4408050ULL } };
+    random_jump(&jumped);
+    assert(same_state(&jumped, &want));
+    RandomState long_jumped = { { 1, 2, 3, 4 } };
+    RandomState long_want = { { 0x096a8eb71295a400ULL, 0xdbf84991e50f4516ULL, 0x534ee745810d2a0eULL, 0x31655ca1a2215bf1ULL } };
+    random_long_jump(&long_jumped);
+    assert(same_state(&long_jumped, &long_want));
+
+    // doubles are the top 53 bits
+    random_seed(&state, 7);
+    RandomState copy = state;
+    for (int i = 0; i < 1000; i++) {
+        double x = random_double(&state);
+        assert(x >= 0.0 && x < 1.0);
+        assert(x == (double)(random_next(&copy) >> 11) / 9007199254740992.0);
+    }
+
+    printf("Reference test passed\n");
+}
+
+// what random_fill documents: chunk c from the start jumped 4c + 1 to
+// 4c + 4 times, element i of a chunk from stream i % 4
+static void expected_fill(const RandomState *start, double *out, size_t n) {
+    RandomState state = *start;
+    for (size_t first = 0; first < n; first += RANDOM_CHUNK) {
+        RandomState streams[4];
+        for (int l = 0; l < 4; l++) {
+            random_jump(&state);
+            streams[l] = state;
+        }
+        for (size_t i = first; i < n && i < first + RANDOM_CHUNK; i++) {
+            out[i] = random_double(&streams[(i - first) % 4]);
+        }
+    }
+}
+
+void test_random_fill() {
+    printf("Testing fills...\n");
+
+    size_t sizes[] = { 0, 1, 3, 4, 5, 31, RANDOM_CHUNK - 1, RANDOM_CHUNK + 5, 2 * RANDOM_CHUNK + 7 };
+    size_t largest = 2 * RANDOM_CHUNK + 7;
+    double *want = malloc(largest * sizeof(double));
+    double *got = malloc((largest + 1) * sizeof(double));
+    RandomState start;
+    random_seed(&start, 1234);
+
+    KernelIsa isas[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            printf("  %s not available, skipped\n", kernel_isa_name(isas[k]));
+            continue;
+        }
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t n = sizes[s];
+            expected_fill(&start, want, n);
+            size_t threads[] = { 1, 2, 3, 0 };
+            for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+                RandomState state = start;
+                got[n] = -1.0;
+                size_t used = random_fill(&state, got, n, threads[t]);
+                assert(used >= 1 && (threads[t] == 0 || used <= threads[t]));
+                assert(memcmp(got, want, n * sizeof(double)) == 0);
+                assert(got[n] == -1.0);
+
+                // the generator carries on a long jump past the start
+                RandomState after = start;
+                random_long_jump(&after);
+                assert(same_state(&state, &after));
+            }
+        }
+    }
+    assert(kernel_use_isa(kernel_best_isa()));
+
+    // roughly uniform
+    random_fill(&start, got, largest, 0);
+    double sum = 0.0;
+    size_t low = 0;
+    for (size_t i = 0; i < largest; i++) {
+        assert(got[i] >= 0.0 && got[i] < 1.0);
+        sum += got[i];
+        low += got[i] < 0.25;
+    }
+    assert(sum / (double)largest > 0.49 && sum / (double)largest < 0.51);
+    assert((double)low / (double)largest > 0.24 && (double)low / (double)largest < 0.26);
+
+    free(want);
+    free(got);
+    printf("Fill test passed\n");
+}
+
+int main() {
+    printf("Running random tests...\n\n");
+
+    test_random_reference();
+    test_random_fill();
+
+    printf("All random tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * test_record.c - tests for objects and their shapes
+ *
+ * covers the shape tree and its transitions, slots past the inline
+ * ones, records moving through the collector, and adding properties
+ * while the old generation is marked concurrently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/object.h"
+
+static StringObject* name(const char *chars) {
+    return value_as_string(string_intern(chars, strlen(chars)));
+}
+
+void test_record_shapes() {
+    printf("Testing shape transitions...\n");
+
+    Shape *empty = shape_empty();
+    assert(empty->count == 0);
+    assert(shape_empty() == empty);
+
+    // the same names in the same order lead to the same shape
+    Shape *x = shape_transition(empty, name("x"));
+    Shape *xy = shape_transition(x, name("y"));
+    assert(shape_transition(empty, name("x")) == x);
+    assert(shape_transition(x, name("y")) == xy);
+    assert(xy->count == 2 && xy->parent == x);
+    assert(shape_lookup(xy, name("x")) == 0);
+    assert(shape_lookup(xy, name("y")) == 1);
+    assert(shape_lookup(xy, name("z")) == -1);
+    assert(shape_lookup(empty, name("x")) == -1);
+
+    // another order is another branch of the tree
+    Shape *yx = shape_transition(shape_transition(empty, name("y")), name("x"));
+    assert(yx != xy);
+    assert(shape_lookup(yx, name("x")) == 1);
+    assert(empty->transition_count == 2);
+
+    // records built either way share the shape
+    Value a = record_create(empty);
+    heap_push_root(&a);
+    assert(record_put(a, name("x"), value_from_int(1)));
+    assert(record_put(a, name("y"), value_from_int(2)));
+    Value b = record_create(xy);
+    heap_push_root(&b);
+    record_store(value_as_record(b), 0, value_from_int(3));
+    assert(value_as_record(a)->shape == xy);
+    assert(value_as_record(b)->shape == xy);
+    assert(value_as_int(record_get(a, name("y"))) == 2);
+    assert(value_as_int(record_get(b, name("x"))) == 3);
+    assert(value_is_null(record_get(b, name("z"))));
+
+    // overwriting keeps the shape
+    assert(record_put(a, name("x"), value_from_int(5)));
+    assert(value_as_record(a)->shape == xy);
+    assert(value_as_int(record_get(a, name("x"))) == 5);
+
+    heap_pop_roots(2);
+    heap_destroy();
+    printf("Shape transition test passed\n");
+}
+
+void test_record_overflow_slots() {
+    printf("Testing slots past the inline ones...\n");
+
+    Value record = record_create(shape_empty());
+    heap_push_root(&record);
+    char text[16];
+    for (int i = 0; i < 40; i++) {
+        snprintf(text, sizeof(text), "p%d", i);
+        assert(record_put(record, name(text), value_from_int(i * 10)));
+    }
+    RecordObject *object = value_as_record(record);
+    assert(object->shape->count == 40);
+    assert(object->overflow_capacity >= 40 - RECORD_INLINE_SLOTS);
+    for (int i = 0; i < 40; i++) {
+        snprintf(text, sizeof(text), "p%d", i);
+        assert(value_as_int(record_get(record, name(text))) == i * 10);
+    }
+
+    // a record made for a big shape has its slots from the start
+    Value copy = record_create(object->shape);
+    assert(value_as_record(copy)->overflow_capacity == 40 - RECORD_INLINE_SLOTS);
+    assert(value_as_double(*record_slot(value_as_record(copy), 39)) == 0.0);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Overflow slot test passed\n");
+}
+
+void test_record_collection() {
+    printf("Testing records through collections...\n");
+
+    // a chain of records, each holding a string and the one before
+    Value chain = VALUE_NULL;
+    heap_push_root(&chain);
+    char text[32];
+    for (int i = 0; i < 100; i++) {
+        Value next = record_create(shape_empty());
+        heap_push_root(&next);
+        int length = snprintf(text, sizeof(text), "label-%d", i);
+        Value label = string_from_chars(text, (size_t)length);
+        assert(record_put(next, name("label"), label));
+        assert(record_put(next, name("next"), chain));
+        for (int j = 0; j < 6; j++) {
+            snprintf(text, sizeof(text), "extra%d", j);
+            assert(record_put(next, name(text), value_from_int(i + j)));
+        }
+        chain = next;
+        heap_pop_roots(1);
+    }
+
+    heap_collect_minor();
+    RecordObject *head = value_as_record(chain);
+    assert(head->header.flags & OBJECT_OLD);
+    Value walk = chain;
+    for (int i = 99; i >= 0; i--) {
+        snprintf(text, sizeof(text), "label-%d", i);
+        assert(strcmp(string_chars(record_get(walk, name("label"))), text) == 0);
+        assert(value_as_int(record_get(walk, name("extra5"))) == i + 5);
+        walk = record_get(walk, name("next"));
+    }
+    assert(value_is_null(walk));
+
+    // a young value stored into an old record survives the next
+    // nursery collection through the remembered set
+    Value young = string_from_chars("young", 5);
+    record_store(head, 7, young);
+    assert(head->header.flags & OBJECT_REMEMBERED);
+    Value fresh = record_create(shape_empty());
+    assert(record_put(chain, name("added"), fresh));
+    heap_collect_minor();
+    assert(strcmp(string_chars(*record_slot(head, 7)), "young") == 0);
+    assert(value_is_record(record_get(chain, name("added"))));
+    assert(record_get(chain, name("added")) != fresh);
+
+    // dropping the chain frees records and their overflow buffers
+    size_t before = heap_get_stats().objects;
+    record_store(head, 1, VALUE_NULL);
+    heap_collect_major();
+    assert(heap_get_stats().objects == before - 99 * 2);
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Record collection test passed\n");
+}
+
+void test_record_concurrent_marking() {
+    printf("Testing records changing under the markers...\n");
+
+    heap_set_nursery_size(64u << 10);
+    heap_set_concurrent_marking(1);
+    heap_set_mark_threads(3);
+
+    Value list = array_create(0);
+    heap_push_root(&list);
+    char text[32];
+    for (size_t i = 0; i < 2000; i++) {
+        Value record = record_create(shape_empty());
+        heap_push_root(&record);
+        assert(record_put(record, name("id"), value_from_int((int32_t)i)));
+        array_append(list, record);
+        heap_pop_roots(1);
+    }
+    heap_collect_minor();
+
+    // adding properties grows the overflow buffers and moves strings
+    // from one slot to another while the old records are traced
+    for (int round = 0; round < 3; round++) {
+        heap_start_major();
+        for (size_t i = 0; i < 2000; i++) {
+            Value record = array_get(list, i);
+            heap_push_root(&record);
+            int length = snprintf(text, sizeof(text), "v%d-%zu", round, i);
+            Value label = string_from_chars(text, (size_t)length);
+            snprintf(text, sizeof(text), "r%d", round);
+            assert(record_put(record, name(text), label));
+            if (round > 0) {
+                snprintf(text, sizeof(text), "r%d", round - 1);
+                record_store(value_as_record(record), 0, record_get(record, name(text)));
+                assert(record_put(record, name(text), VALUE_NULL));
+            }
+            heap_pop_roots(1);
+        }
+        heap_collect_major();
+    }
+
+    // every record kept its last label and the one moved into slot 0
+    for (size_t i = 0; i < 2000; i++) {
+        Value record = array_get(list, i);
+        snprintf(text, sizeof(text), "v2-%zu", i);
+        assert(strcmp(string_chars(record_get(record, name("r2"))), text) == 0);
+        snprintf(text, sizeof(text), "v1-%zu", i);
+        assert(strcmp(string_chars(*record_slot(value_as_record(record), 0)), text) == 0);
+    }
+
+    heap_pop_roots(1);
+    heap_destroy();
+    printf("Concurrent record test passed\n");
+}
+
+int main() {
+    printf("Running record tests...\n\n");
+
+    test_record_shapes();
+    test_record_overflow_slots();
+    test_record_collection();
+    test_record_concurrent_marking();
+
+    printf("All record tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * test_shared.c - tests for memory shared between interpreters
+ *
+ * adds from several threads at once must all land, for doubles as well
+ * as integers, and compare-exchange must only store over what it was
+ * told to expect.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+#include "../include/shared.h"
+
+void test_shared_elements() {
+    printf("Testing loads and stores...\n");
+
+    SharedBuffer *ints = shared_buffer_create(SHARED_INT64, 3);
+    SharedBuffer *doubles = shared_buffer_create(SHARED_FLOAT64, 3);
+    assert(ints && doubles);
+    for (size_t i = 0; i < 3; i++) {
+        assert(shared_load(ints, i) == 0.0 && shared_load(doubles, i) == 0.0);
+    }
+
+    shared_store(ints, 1, -7);
+    shared_store(doubles, 1, 2.5);
+    assert(shared_load(ints, 1) == -7.0);
+    assert(shared_load(doubles, 1) == 2.5);
+    assert(shared_add(ints, 1, 10) == -7.0 && shared_load(ints, 1) == 3.0);
+    assert(shared_add(doubles, 1, 0.25) == 2.5 && shared_load(doubles, 1) == 2.75);
+
+    assert(shared_fits(ints, -9007199254740992.0));
+    assert(!shared_fits(ints, 0.5));
+    assert(!shared_fits(ints, 9223372036854775808.0));
+    assert(!shared_fits(ints, NAN));
+    assert(shared_fits(doubles, 0.5) && shared_fits(doubles, NAN));
+
+    shared_buffer_retain(ints);
+    shared_buffer_release(ints);
+    assert(shared_load(ints, 1) == 3.0);
+    shared_buffer_release(ints);
+    shared_buffer_release(doubles);
+
+    printf("Element test passed\n");
+}
+
+void test_shared_compare_exchange() {
+    printf("Testing compare-exchange...\n");
+
+    SharedBuffer *ints = shared_buffer_create(SHARED_INT64, 1);
+    assert(shared_compare_exchange(ints, 0, 1, 5) == 0.0 && shared_load(ints, 0) == 0.0);
+    assert(shared_compare_exchange(ints, 0, 0, 5) == 0.0 && shared_load(ints, 0) == 5.0);
+    shared_buffer_release(ints);
+
+    // doubles compare by their bits
+    SharedBuffer *doubles = shared_buffer_create(SHARED_FLOAT64, 1);
+    shared_store(doubles, 0, NAN);
+    assert(isnan(shared_compare_exchange(doubles, 0, NAN, 1.0)) && shared_load(doubles, 0) == 1.0);
+    shared_store(doubles, 0, 0.0);
+    assert(shared_compare_exchange(doubles, 0, -0.0, 2.0) == 0.0 && shared_load(doubles, 0) == 0.0);
+    shared_buffer_release(doubles);
+
+    printf("Compare-exchange test passed\n");
+}
+
+#define THREADS 4
+#define ADDS 100000
+
+static void* add_repeatedly(void *argument) {
+    SharedBuffer **buffers = argument;
+    for (int i = 0; i < ADDS; i++) {
+        shared_add(buffers[0], 0, 1);
+        shared_add(buffers[1], 0, 0.5);
+        // one slot claimed by whichever thread gets there first
+        shared_compare_exchange(buffers[0], 1, 0, 1);
+    }
+    return NULL;
+}
+
+void test_shared_contention() {
+    printf("Testing adds from several threads...\n");
+
+    SharedBuffer *buffers[2] = {
+        shared_buffer_create(SHARED_INT64, 2),
+        shared_buffer_create(SHARED_FLOAT64, 1)
+    };
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        assert(pthread_create(&threads[t], NULL, add_repeatedly, buffers) == 0);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    // halves are exact, so every add shows in the total
+    assert(shared_load(buffers[0], 0) == (double)THREADS * ADDS);
+    assert(shared_load(buffers[1], 0) == 0.5 * THREADS * ADDS);
+    assert(shared_load(buffers[0], 1) == 1.0);
+    shared_buffer_release(buffers[0]);
+    shared_buffer_release(buffers[1]);
+
+    printf("Contention test passed\n");
+}
+
+int main() {
+    printf("Running shared memory tests...\n\n");
+
+    test_shared_elements();
+    test_shared_compare_exchange();
+    test_shared_contention();
+
+    printf("All shared memory tests passed!\n");
+    return 0;
+}
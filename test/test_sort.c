@@ -0,0 +1,200 @@
+/*
+ * test_sort.c - tests for sorting
+ *
+ * every path - comparison sort, radix sort, and slices on threads
+ * merged together - has to agree bit for bit with qsort under the same
+ * order, on random input and on the patterns that trouble quicksorts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/sort.h"
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint64_t next_random(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static int same_bits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// the reference order: numeric, -0 before 0, NaN last
+static int compare_ascending(const void *a, const void *b) {
+    uint64_t x = sort_key(*(const double*)a);
+    uint64_t y = sort_key(*(const double*)b);
+    return (x > y) - (x < y);
+}
+
+static int compare_descending(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    if (x != x || y != y) {
+        return (x != x) - (y != y);
+    }
+    return compare_ascending(b, a);
+}
+
+static void check_sorted(const double *input, size_t n, int descending, size_t threads) {
+    double *expected = malloc((n + 1) * sizeof(double));
+    double *actual = malloc((n + 1) * sizeof(double));
+    memcpy(expected, input, n * sizeof(double));
+    memcpy(actual, input, n * sizeof(double));
+    qsort(expected, n, sizeof(double), descending ? compare_descending : compare_ascending);
+    assert(sort_doubles(actual, n, descending, threads) >= 1);
+    for (size_t i = 0; i < n; i++) {
+        // every NaN comes back as the one quiet NaN
+        assert(same_bits(actual[i], expected[i]) || (actual[i] != actual[i] && expected[i] != expected[i]));
+    }
+    free(expected);
+    free(actual);
+}
+
+// the input patterns, each over n elements
+static void fill(double *data, size_t n, int pattern) {
+    for (size_t i = 0; i < n; i++) {
+        switch (pattern) {
+            case 0: data[i] = (double)(int64_t)next_random() / 1e9; break;        // random
+            case 1: data[i] = (double)i; break;                                    // sorted
+            case 2: data[i] = (double)(n - i); break;                              // reversed
+            case 3: data[i] = 42.0; break;                                         // all equal
+            case 4: data[i] = (double)(i < n / 2 ? i : n - i); break;              // organ pipe
+            case 5: data[i] = (double)(next_random() % 4); break;                  // few values
+            case 6: data[i] = (double)(i % 17); break;                             // sawtooth
+            case 7: data[i] = i + 1 == n ? -1.0 : (double)i; break;                // sorted, one out
+            default: {
+                // the awkward values among ordinary ones
+                static const double specials[] = { 0.0, -0.0, INFINITY, -INFINITY, 5e-324, -5e-324 };
+                uint64_t r = next_random();
+                data[i] = r % 5 == 0 ? specials[r / 5 % 6] : r % 5 == 1 ? NAN : (double)(int32_t)r;
+                break;
+            }
+        }
+    }
+}
+
+void test_sort_keys() {
+    printf("Testing sort keys...\n");
+
+    const double ordered[] = { -INFINITY, -1e308, -1.0, -5e-324, -0.0, 0.0, 5e-324, 1.0, 1e308, INFINITY };
+    size_t count = sizeof(ordered) / sizeof(ordered[0]);
+    for (size_t i = 0; i + 1 < count; i++) {
+        assert(sort_key(ordered[i]) < sort_key(ordered[i + 1]));
+    }
+    assert(sort_key(INFINITY) < sort_key(NAN));
+    assert(sort_key(NAN) == sort_key(-NAN));
+    for (size_t i = 0; i < count; i++) {
+        assert(same_bits(sort_number(sort_key(ordered[i])), ordered[i]));
+    }
+    assert(isnan(sort_number(sort_key(NAN))));
+    printf("Sort key test passed\n");
+}
+
+void test_sort_doubles() {
+    printf("Testing number sorting...\n");
+
+    static const size_t sizes[] = { 0, 1, 2, 3, 10, 23, 24, 25, 100, 129, 500, 1023, 1024, 1025, 5000, 70000 };
+    double *data = malloc(70000 * sizeof(double));
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int pattern = 0; pattern <= 8; pattern++) {
+            fill(data, sizes[s], pattern);
+            check_sorted(data, sizes[s], 0, 1);
+            check_sorted(data, sizes[s], 1, 1);
+        }
+    }
+    free(data);
+    printf("Number sorting test passed\n");
+}
+
+void test_sort_threads() {
+    printf("Testing sorting on threads...\n");
+
+    // slices and merges give the same bits whatever the thread count
+    size_t n = 200003;
+    double *data = malloc(n * sizeof(double));
+    for (int pattern = 0; pattern <= 8; pattern += 4) {
+        fill(data, n, pattern);
+        for (size_t threads = 2; threads <= 5; threads++) {
+            check_sorted(data, n, 0, threads);
+        }
+        check_sorted(data, n, 1, 3);
+    }
+    double few[3] = { 3.0, 1.0, 2.0 };
+    assert(sort_doubles(few, 3, 0, 8) == 1);
+    assert(few[0] == 1.0 && few[2] == 3.0);
+    free(data);
+    printf("Threaded sorting test passed\n");
+}
+
+static SortRecord number_record(double number, size_t index) {
+    SortRecord record = {0};
+    record.key = sort_key(number);
+    record.index = index;
+    return record;
+}
+
+static SortRecord text_record(const char *chars, size_t index) {
+    SortRecord record = {0};
+    record.is_text = 1;
+    record.chars = chars;
+    record.length = strlen(chars);
+    record.index = index;
+    return record;
+}
+
+void test_sort_records() {
+    printf("Testing record sorting...\n");
+
+    SortRecord records[] = {
+        text_record("pear", 0), number_record(2.0, 1), text_record("apple", 2), number_record(NAN, 3),
+        text_record("app", 4), number_record(-1.0, 5), text_record("pear", 6), number_record(2.0, 7),
+    };
+    size_t n = sizeof(records) / sizeof(records[0]);
+
+    // numbers then text, ties in their first order
+    sort_records(records, n, 0);
+    const size_t ascending[] = { 5, 1, 7, 3, 4, 2, 0, 6 };
+    for (size_t i = 0; i < n; i++) {
+        assert(records[i].index == ascending[i]);
+    }
+
+    // descending still keeps ties in order and NaN last
+    sort_records(records, n, 1);
+    const size_t descending[] = { 1, 7, 5, 3, 0, 6, 2, 4 };
+    for (size_t i = 0; i < n; i++) {
+        assert(records[i].index == descending[i]);
+    }
+
+    // many equal keys stay stable through partitioning
+    size_t big = 5000;
+    SortRecord *many = malloc(big * sizeof(SortRecord));
+    for (size_t i = 0; i < big; i++) {
+        many[i] = number_record((double)(next_random() % 7), i);
+    }
+    sort_records(many, big, 0);
+    for (size_t i = 1; i < big; i++) {
+        assert(many[i - 1].key < many[i].key ||
+               (many[i - 1].key == many[i].key && many[i - 1].index < many[i].index));
+    }
+    free(many);
+    printf("Record sorting test passed\n");
+}
+
+int main() {
+    printf("Running sort tests...\n\n");
+
+    test_sort_keys();
+    test_sort_doubles();
+    test_sort_threads();
+    test_sort_records();
+
+    printf("All sort tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * test_stats.c - tests for the streaming accumulators
+ *
+ * the moments are checked against a plain two-pass computation, the
+ * quantile sketch against the exact quantiles of the sorted values,
+ * and the distinct counter against the true count within a few of its
+ * standard errors. adding an array must agree with adding the same
+ * values one at a time. the histogram is checked against the exact
+ * quantiles too, and merged and encoded histograms against ones that
+ * saw every value.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/stats.h"
+
+static uint64_t state = 88172645463325252ULL;
+
+static uint64_t next_random(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// uniform in [0, 1)
+static double next_unit(void) {
+    return (double)(next_random() >> 11) / 9007199254740992.0;
+}
+
+static int close_to(double actual, double expected, double tolerance) {
+    double scale = fabs(expected) > 1.0 ? fabs(expected) : 1.0;
+    return fabs(actual - expected) <= tolerance * scale;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void test_stats_moments() {
+    printf("Testing moments...\n");
+
+    size_t n = 10007;
+    double *x = malloc(n * sizeof(double));
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        // a large offset is what breaks the sum-of-squares formula
+        x[i] = 1e9 + next_unit() * 100.0;
+        total += x[i];
+    }
+    double mean = total / (double)n;
+    double squares = 0.0;
+    double lowest = x[0], highest = x[0];
+    for (size_t i = 0; i < n; i++) {
+        squares += (x[i] - mean) * (x[i] - mean);
+        lowest = x[i] < lowest ? x[i] : lowest;
+        highest = x[i] > highest ? x[i] : highest;
+    }
+    double variance = squares / (double)(n - 1);
+
+    // one at a time
+    StatsMoments single;
+    stats_moments_init(&single);
+    for (size_t i = 0; i < n; i++) {
+        stats_moments_add(&single, x[i]);
+    }
+    assert(single.count == n);
+    assert(close_to(single.mean, mean, 1e-14));
+    assert(close_to(stats_moments_variance(&single), variance, 1e-8));
+    assert(single.min == lowest && single.max == highest);
+
+    // in uneven batches, with an empty one and a single value among them
+    StatsMoments batched;
+    stats_moments_init(&batched);
+    size_t sizes[] = { 1, 0, 15, 16, 17, 1000, 3 };
+    size_t done = 0;
+    for (size_t k = 0; done < n; k++) {
+        size_t size = sizes[k % 7];
+        size = size < n - done ? size : n - done;
+        stats_moments_add_batch(&batched, x + done, size);
+        done += size;
+    }
+    assert(batched.count == n);
+    assert(close_to(batched.mean, mean, 1e-14));
+    assert(close_to(stats_moments_variance(&batched), variance, 1e-8));
+    assert(batched.min == lowest && batched.max == highest);
+
+    // min and max follow Math.min and Math.max
+    StatsMoments edges;
+    stats_moments_init(&edges);
+    double zeros[] = { 0.0, -0.0 };
+    stats_moments_add_batch(&edges, zeros, 2);
+    assert(edges.min == 0.0 && signbit(edges.min) && !signbit(edges.max));
+    stats_moments_add(&edges, NAN);
+    stats_moments_add(&edges, 5.0);
+    assert(isnan(edges.min) && isnan(edges.max) && isnan(edges.mean));
+
+    free(x);
+    printf("Moments test passed\n");
+}
+
+// every quantile of data within the guaranteed relative error
+static void check_quantiles(const StatsQuantiles *sketch, double *data, size_t n) {
+    qsort(data, n, sizeof(double), compare_doubles);
+    assert(stats_quantiles_quantile(sketch, 0.0) == data[0]);
+    assert(stats_quantiles_quantile(sketch, 1.0) == data[n - 1]);
+    for (int step = 1; step < 1000; step += 7) {
+        double q = step / 1000.0;
+        double expected = data[(size_t)(q * (double)(n - 1))];
+        double actual = stats_quantiles_quantile(sketch, q);
+        assert(fabs(actual - expected) <= sketch->accuracy * fabs(expected) * (1.0 + 1e-12));
+    }
+}
+
+void test_stats_quantiles() {
+    printf("Testing the quantile sketch...\n");
+
+    assert(!stats_quantiles_create(0.0));
+    assert(!stats_quantiles_create(0.3));
+    assert(!stats_quantiles_create(NAN));
+
+    size_t n = 50000;
+    double *data = malloc(n * sizeof(double));
+    double accuracies[] = { STATS_SKETCH_MAX_ACCURACY, STATS_SKETCH_DEFAULT_ACCURACY, STATS_SKETCH_MIN_ACCURACY };
+    for (size_t a = 0; a < 3; a++) {
+        // latencies over six orders of magnitude, with zeros and negatives
+        StatsQuantiles *single = stats_quantiles_create(accuracies[a]);
+        StatsQuantiles *batched = stats_quantiles_create(accuracies[a]);
+        assert(single && batched && single->accuracy <= accuracies[a]);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t r = next_random();
+            double magnitude = next_unit() * (double)(1u << (r % 20));
+            data[i] = r % 50 == 0 ? 0.0 : r % 7 == 0 ? -magnitude : magnitude;
+            assert(stats_quantiles_add(single, data[i]));
+        }
+        assert(stats_quantiles_add_batch(batched, data, 1) == 1);
+        assert(stats_quantiles_add_batch(batched, data + 1, n - 1) == n - 1);
+        assert(single->count == n && batched->count == n);
+        for (int step = 0; step <= 100; step++) {
+            assert(stats_quantiles_quantile(single, step / 100.0) == stats_quantiles_quantile(batched, step / 100.0));
+        }
+        check_quantiles(single, data, n);
+        stats_quantiles_free(single);
+        stats_quantiles_free(batched);
+    }
+
+    // 80 octaves where the window holds 32 - the smallest values merge,
+    // the top third of the distribution keeps its accuracy
+    StatsQuantiles *wide = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = (1.0 + next_unit()) * ldexp(1.0, (int)(next_random() % 80) - 40);
+    }
+    assert(stats_quantiles_add_batch(wide, data, n) == n);
+    qsort(data, n, sizeof(double), compare_doubles);
+    for (int step = 650; step < 1000; step += 13) {
+        double q = step / 1000.0;
+        double expected = data[(size_t)(q * (double)(n - 1))];
+        assert(fabs(stats_quantiles_quantile(wide, q) - expected) <= wide->accuracy * expected * (1.0 + 1e-12));
+    }
+    assert(stats_quantiles_quantile(wide, 0.0) == data[0]);
+
+    // values that cannot be bucketed are refused, a batch all or nothing
+    double awkward[] = { 1.0, 2.0, INFINITY, 3.0 };
+    uint64_t before = wide->count;
+    assert(!stats_quantiles_add(wide, NAN));
+    assert(!stats_quantiles_add(wide, -INFINITY));
+    assert(stats_quantiles_add_batch(wide, awkward, 4) == 2);
+    assert(wide->count == before);
+    // subnormals count as zero
+    assert(stats_quantiles_add(wide, 5e-324));
+    assert(wide->zero_count == 1);
+    stats_quantiles_free(wide);
+
+    // a window that has to move down, then up
+    StatsQuantiles *moving = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    double steps[] = { 1e4, 1e-3, 1e2, 1e-4, 1.0 };
+    for (size_t i = 0; i < 5; i++) {
+        assert(stats_quantiles_add(moving, steps[i]));
+    }
+    for (size_t i = 0; i < 5; i++) {
+        data[i] = steps[i];
+    }
+    check_quantiles(moving, data, 5);
+    stats_quantiles_free(moving);
+
+    free(data);
+    printf("Quantile sketch test passed\n");
+}
+
+void test_stats_distinct() {
+    printf("Testing the distinct counter...\n");
+
+    assert(!stats_distinct_create(STATS_DISTINCT_MIN_PRECISION - 1));
+    assert(!stats_distinct_create(STATS_DISTINCT_MAX_PRECISION + 1));
+
+    // equal numbers hash alike, and strings apart from numbers
+    assert(stats_hash_number(0.0) == stats_hash_number(-0.0));
+    assert(stats_hash_number(NAN) == stats_hash_number(-NAN));
+    assert(stats_hash_number(1.0) != stats_hash_number(2.0));
+    assert(stats_hash_bytes("1", 1) != stats_hash_number(1.0));
+    assert(stats_hash_bytes("ab", 2) == stats_hash_bytes("abc", 2));
+    assert(stats_hash_bytes("", 0) != stats_hash_bytes("a", 1));
+
+    StatsDistinct *empty = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    assert(stats_distinct_estimate(empty) == 0.0);
+    stats_distinct_free(empty);
+
+    size_t counts[] = { 1, 10, 100, 1000, 20000, 40000, 80000, 300000 };
+    double *x = malloc(300000 * sizeof(double));
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        size_t n = counts[c];
+        StatsDistinct *single = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+        StatsDistinct *batched = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+        // each value twice, so duplicates are tested too
+        for (size_t i = 0; i < n; i++) {
+            x[i] = (double)i * 0.5;
+            stats_distinct_add_hash(single, stats_hash_number(x[i]));
+            stats_distinct_add_hash(single, stats_hash_number(x[i]));
+        }
+        stats_distinct_add_numbers(batched, x, n);
+        stats_distinct_add_numbers(batched, x, n);
+        size_t m = (size_t)1 << STATS_DISTINCT_DEFAULT_PRECISION;
+        assert(memcmp(single->registers, batched->registers, m) == 0);
+
+        // 1.04 / sqrt(m) is under 1%, and small counts are nearly exact
+        double estimate = stats_distinct_estimate(single);
+        double error = fabs(estimate - (double)n) / (double)n;
+        assert(n <= 1000 ? error < 0.01 : error < 0.04);
+        stats_distinct_free(single);
+        stats_distinct_free(batched);
+    }
+
+    // strings and the lowest precision
+    StatsDistinct *words = stats_distinct_create(STATS_DISTINCT_MIN_PRECISION);
+    char word[32];
+    for (int i = 0; i < 5; i++) {
+        int length = snprintf(word, sizeof(word), "w%d", i);
+        stats_distinct_add_hash(words, stats_hash_bytes(word, (size_t)length));
+    }
+    assert(fabs(stats_distinct_estimate(words) - 5.0) < 2.0);
+    stats_distinct_free(words);
+
+    free(x);
+    printf("Distinct counter test passed\n");
+}
+
+void test_stats_merge() {
+    printf("Testing merges...\n");
+
+    size_t n = 20000;
+    double *x = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++) {
+        x[i] = next_unit() * (double)(1u << (next_random() % 16));
+    }
+
+    // moments merged from halves agree with moments of the whole
+    StatsMoments whole, left, right;
+    stats_moments_init(&whole);
+    stats_moments_init(&left);
+    stats_moments_init(&right);
+    stats_moments_add_batch(&whole, x, n);
+    stats_moments_add_batch(&left, x, n / 3);
+    stats_moments_add_batch(&right, x + n / 3, n - n / 3);
+    stats_moments_merge(&left, &right);
+    assert(left.count == n && close_to(left.mean, whole.mean, 1e-12));
+    assert(close_to(stats_moments_variance(&left), stats_moments_variance(&whole), 1e-10));
+    assert(left.min == whole.min && left.max == whole.max);
+
+    // sketches merged from halves are the same as one that saw everything
+    StatsQuantiles *all = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    StatsQuantiles *first = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    StatsQuantiles *second = stats_quantiles_create(STATS_SKETCH_DEFAULT_ACCURACY);
+    StatsQuantiles *coarse = stats_quantiles_create(STATS_SKETCH_MAX_ACCURACY);
+    stats_quantiles_add_batch(all, x, n);
+    stats_quantiles_add_batch(first, x, n / 2);
+    stats_quantiles_add_batch(second, x + n / 2, n - n / 2);
+    assert(stats_quantiles_merge(first, second));
+    assert(!stats_quantiles_merge(first, coarse));
+    assert(first->count == n);
+    for (int step = 0; step <= 100; step++) {
+        assert(stats_quantiles_quantile(first, step / 100.0) == stats_quantiles_quantile(all, step / 100.0));
+    }
+    // merging with itself doubles every count
+    assert(stats_quantiles_merge(all, all));
+    assert(all->count == 2 * n && stats_quantiles_quantile(all, 0.5) == stats_quantiles_quantile(first, 0.5));
+    stats_quantiles_free(all);
+    stats_quantiles_free(first);
+    stats_quantiles_free(second);
+    stats_quantiles_free(coarse);
+
+    StatsDistinct *seen = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    StatsDistinct *half = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    StatsDistinct *other = stats_distinct_create(STATS_DISTINCT_DEFAULT_PRECISION);
+    StatsDistinct *small = stats_distinct_create(STATS_DISTINCT_MIN_PRECISION);
+    stats_distinct_add_numbers(seen, x, n);
+    stats_distinct_add_numbers(half, x, n / 2);
+    stats_distinct_add_numbers(other, x + n / 2, n - n / 2);
+    assert(stats_distinct_merge(half, other));
+    assert(!stats_distinct_merge(half, small));
+    assert(memcmp(half->registers, seen->registers, (size_t)1 << STATS_DISTINCT_DEFAULT_PRECISION) == 0);
+    stats_distinct_free(seen);
+    stats_distinct_free(half);
+    stats_distinct_free(other);
+    stats_distinct_free(small);
+
+    free(x);
+    printf("Merge test passed\n");
+}
+
+// every quantile of whole numbers within the histogram's resolution
+static void check_histogram(const StatsHistogram *histogram, double *data, size_t n) {
+    qsort(data, n, sizeof(double), compare_doubles);
+    assert(stats_histogram_quantile(histogram, 0.0) == data[0]);
+    assert(stats_histogram_quantile(histogram, 1.0) == data[n - 1]);
+    double resolution = 1.0;
+    for (int i = 0; i < histogram->digits; i++) {
+        resolution /= 10.0;
+    }
+    for (int step = 1; step < 1000; step += 7) {
+        double q = step / 1000.0;
+        size_t rank = (size_t)(q * (double)n + 0.5);
+        double expected = data[(rank < 1 ? 1 : rank) - 1];
+        double actual = stats_histogram_quantile(histogram, q);
+        // the top of the bucket holding the value, never below it
+        assert(actual >= expected && actual - expected <= expected * resolution);
+    }
+}
+
+void test_stats_histogram() {
+    printf("Testing the histogram...\n");
+
+    assert(!stats_histogram_create(1000.0, 0));
+    assert(!stats_histogram_create(1000.0, STATS_HISTOGRAM_MAX_DIGITS + 1));
+    assert(!stats_histogram_create(1.0, 3));
+    assert(!stats_histogram_create(STATS_HISTOGRAM_MAX_HIGHEST * 2.0, 3));
+    assert(!stats_histogram_create(NAN, 3));
+
+    // every whole number below 2 * 10^digits has a bucket of its own
+    StatsHistogram *exact = stats_histogram_create(100000.0, 3);
+    for (int v = 0; v < 2000; v++) {
+        assert(stats_histogram_add(exact, (double)v + 0.75));
+    }
+    for (int v = 1; v <= 2000; v++) {
+        assert(stats_histogram_quantile(exact, (double)v / 2000.0) == (double)(v - 1));
+    }
+    assert(exact->sum == 1999.0 * 1000.0);
+    stats_histogram_free(exact);
+
+    size_t n = 40000;
+    double *data = malloc(n * sizeof(double));
+    for (int digits = STATS_HISTOGRAM_MIN_DIGITS; digits <= STATS_HISTOGRAM_MAX_DIGITS; digits++) {
+        StatsHistogram *single = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, digits);
+        StatsHistogram *batched = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, digits);
+        assert(single && batched);
+        // latencies from a microsecond to most of an hour
+        for (size_t i = 0; i < n; i++) {
+            data[i] = (double)(uint64_t)(next_unit() * (double)(1u << (next_random() % 31)));
+            assert(stats_histogram_add(single, data[i]));
+        }
+        assert(stats_histogram_add_batch(batched, data, 3) == 3);
+        assert(stats_histogram_add_batch(batched, data + 3, n - 3) == n - 3);
+        assert(single->count == n && batched->count == n && single->sum == batched->sum);
+        assert(memcmp(single->counts, batched->counts, single->length * sizeof(uint64_t)) == 0);
+        check_histogram(single, data, n);
+        stats_histogram_free(single);
+        stats_histogram_free(batched);
+    }
+
+    // values out of range are refused, a batch all or nothing
+    StatsHistogram *small = stats_histogram_create(1000.0, 2);
+    double awkward[] = { 1.0, 1000.5, 1001.0, 2.0 };
+    assert(!stats_histogram_add(small, -1.0));
+    assert(!stats_histogram_add(small, NAN));
+    assert(!stats_histogram_add(small, INFINITY));
+    assert(stats_histogram_add_batch(small, awkward, 4) == 2);
+    assert(small->count == 0 && small->min > small->max);
+    assert(stats_histogram_add_batch(small, awkward, 2) == 2);
+    assert(small->max == 1000);
+
+    // halves merge into the whole, the same settings or not
+    StatsHistogram *whole = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, 3);
+    StatsHistogram *left = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, 3);
+    StatsHistogram *right = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, 3);
+    StatsHistogram *finer = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST * 4.0, 4);
+    stats_histogram_add_batch(whole, data, n);
+    stats_histogram_add_batch(left, data, n / 2);
+    stats_histogram_add_batch(right, data + n / 2, n - n / 2);
+    stats_histogram_add_batch(finer, data + n / 2, n - n / 2);
+    assert(stats_histogram_merge(left, right));
+    assert(memcmp(left->counts, whole->counts, whole->length * sizeof(uint64_t)) == 0);
+    assert(left->count == n && left->min == whole->min && left->max == whole->max);
+    assert(stats_histogram_merge(right, left) && stats_histogram_merge(finer, left));
+    assert(finer->count == n + n / 2 && right->count == finer->count);
+    // other's values above highest
+    assert(!stats_histogram_merge(small, whole));
+    assert(stats_histogram_merge(whole, small));
+    // and itself
+    check_histogram(left, data, n);
+    double median = stats_histogram_quantile(left, 0.5);
+    assert(stats_histogram_merge(left, left));
+    assert(left->count == 2 * n && stats_histogram_quantile(left, 0.5) == median);
+
+    // the encoded form reads back to the same histogram
+    StatsHistogram *histograms[] = { whole, finer, small };
+    for (size_t h = 0; h < 3; h++) {
+        size_t length;
+        char *text = stats_histogram_encode(histograms[h], &length);
+        assert(text && strlen(text) == length);
+        StatsHistogram *back = stats_histogram_decode(text, length);
+        assert(back && back->digits == histograms[h]->digits && back->highest == histograms[h]->highest);
+        assert(back->count == histograms[h]->count && back->sum == histograms[h]->sum);
+        assert(back->min == histograms[h]->min && back->max == histograms[h]->max);
+        assert(memcmp(back->counts, histograms[h]->counts, back->length * sizeof(uint64_t)) == 0);
+        // broken copies are refused rather than misread
+        assert(!stats_histogram_decode(text, length - 1));
+        assert(!stats_histogram_decode(text, length - 4));
+        text[length / 2] = '*';
+        assert(!stats_histogram_decode(text, length));
+        stats_histogram_free(back);
+        free(text);
+    }
+    assert(!stats_histogram_decode("", 0));
+    assert(!stats_histogram_decode("aGVsbG8=", 8));
+
+    // an empty histogram round trips as empty, and is much shorter than
+    // its buckets
+    StatsHistogram *empty = stats_histogram_create(STATS_HISTOGRAM_DEFAULT_HIGHEST, 3);
+    size_t length;
+    char *text = stats_histogram_encode(empty, &length);
+    assert(length < 32);
+    StatsHistogram *back = stats_histogram_decode(text, length);
+    assert(back && back->count == 0 && back->min > back->max);
+    stats_histogram_free(back);
+    free(text);
+    stats_histogram_free(empty);
+
+    stats_histogram_free(whole);
+    stats_histogram_free(left);
+    stats_histogram_free(right);
+    stats_histogram_free(finer);
+    stats_histogram_free(small);
+    free(data);
+    printf("Histogram test passed\n");
+}
+
+int main() {
+    printf("Running stats tests...\n\n");
+
+    test_stats_moments();
+    test_stats_quantiles();
+    test_stats_distinct();
+    test_stats_merge();
+    test_stats_histogram();
+
+    printf("All stats tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * test_string.c - tests for string values
+ *
+ * covers inline and flat storage, rope concatenation and flattening,
+ * interning, comparisons and conversion of other values to strings.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../include/object.h"
+
+void test_string_storage() {
+    printf("Testing string storage...\n");
+
+    Value short_string = string_from_chars("hello", 5);
+    assert(value_is_string(short_string));
+    assert(value_as_string(short_string)->kind == STRING_INLINE);
+    assert(string_length(short_string) == 5);
+    assert(strcmp(string_chars(short_string), "hello") == 0);
+
+    const char *text = "a string too long to be stored inline";
+    Value long_string = string_from_chars(text, strlen(text));
+    assert(value_as_string(long_string)->kind == STRING_FLAT);
+    assert(strcmp(string_chars(long_string), text) == 0);
+
+    Value empty = string_from_chars("", 0);
+    assert(string_length(empty) == 0);
+    assert(!value_is_truthy(empty));
+    assert(value_is_truthy(short_string));
+    assert(strcmp(value_type_name(empty), "string") == 0);
+
+    heap_destroy();
+    printf("String storage test passed\n");
+}
+
+void test_string_concat() {
+    printf("Testing string concatenation...\n");
+
+    // short results are copied into a new inline string
+    Value ab = string_concat(string_from_chars("ab", 2), string_from_chars("cd", 2));
+    assert(value_as_string(ab)->kind == STRING_INLINE);
+    assert(strcmp(string_chars(ab), "abcd") == 0);
+
+    // long results are ropes until somebody reads them
+    Value left = string_from_chars("0123456789abcdef", 16);
+    Value right = string_from_chars("ghijklmnopqrstuv", 16);
+    Value rope = string_concat(left, right);
+    assert(value_as_string(rope)->kind == STRING_ROPE);
+    assert(string_length(rope) == 32);
+    assert(strcmp(string_chars(rope), "0123456789abcdefghijklmnopqrstuv") == 0);
+    assert(value_as_string(rope)->kind == STRING_FLAT);
+
+    // the empty string is an identity
+    Value empty = string_from_chars("", 0);
+    assert(string_concat(empty, left) == left);
+    assert(string_concat(left, empty) == left);
+
+    heap_destroy();
+    printf("String concatenation test passed\n");
+}
+
+void test_string_deep_rope() {
+    printf("Testing deep rope flattening...\n");
+
+    // a rope as deep as a long loop must flatten without recursing
+    // enough pieces to fill the nursery many times over, so both values
+    // are rooted and move as it is collected
+    Value built = string_from_chars("", 0);
+    Value piece = string_from_chars("xy", 2);
+    heap_push_root(&built);
+    heap_push_root(&piece);
+    const int pieces = 200000;
+    for (int i = 0; i < pieces; i++) {
+        built = string_concat(built, piece);
+        assert(!value_is_null(built));
+    }
+    assert(heap_get_stats().minor_collections > 0);
+    assert(string_length(built) == (size_t)pieces * 2);
+
+    const char *chars = string_chars(built);
+    assert(chars != NULL);
+    for (int i = 0; i < pieces * 2; i += 2) {
+        assert(chars[i] == 'x' && chars[i + 1] == 'y');
+    }
+    assert(chars[pieces * 2] == '\0');
+
+    heap_pop_roots(2);
+    heap_destroy();
+    printf("Deep rope test passed\n");
+}
+
+void test_string_intern() {
+    printf("Testing string interning...\n");
+
+    Value first = string_intern("status", 6);
+    Value second = string_intern("status", 6);
+    Value other = string_intern("statue", 6);
+    assert(first == second);
+    assert(first != other);
+    assert(value_as_string(first)->interned);
+
+    // finding never adds
+    assert(string_find_interned("status", 6) == first);
+    assert(value_is_null(string_find_interned("stat", 4)));
+    assert(value_is_null(string_find_interned("stat", 4)));
+
+    // enough distinct strings to grow the table
+    char name[32];
+    for (int i = 0; i < 500; i++) {
+        int length = snprintf(name, sizeof(name), "key-%d", i);
+        assert(!value_is_null(string_intern(name, (size_t)length)));
+    }
+    assert(string_intern("status", 6) == first);
+    assert(string_intern("key-42", 6) == string_intern("key-42", 6));
+
+    heap_destroy();
+    printf("String interning test passed\n");
+}
+
+void test_string_compare() {
+    printf("Testing string comparison...\n");
+
+    Value apple = string_from_chars("apple", 5);
+    Value apple_again = string_concat(string_from_chars("app", 3), string_from_chars("le", 2));
+    Value apricot = string_from_chars("apricot", 7);
+    Value app = string_from_chars("app", 3);
+
+    assert(string_equals(apple, apple_again));
+    assert(!string_equals(apple, apricot));
+    assert(string_hash(apple) == string_hash(apple_again));
+    assert(string_compare(apple, apricot) < 0);
+    assert(string_compare(apricot, apple) > 0);
+    assert(string_compare(app, apple) < 0);
+    assert(string_compare(apple, apple_again) == 0);
+
+    heap_destroy();
+    printf("String comparison test passed\n");
+}
+
+void test_string_from_value() {
+    printf("Testing conversion to strings...\n");
+
+    assert(strcmp(string_chars(string_from_value(value_from_int(-42))), "-42") == 0);
+    assert(strcmp(string_chars(string_from_value(value_from_double(2.5))), "2.5") == 0);
+    assert(strcmp(string_chars(string_from_value(value_from_double(-0.0))), "-0") == 0);
+    assert(strcmp(string_chars(string_from_value(VALUE_TRUE)), "true") == 0);
+    assert(strcmp(string_chars(string_from_value(VALUE_NULL)), "null") == 0);
+
+    Value same = string_from_chars("same", 4);
+    assert(string_from_value(same) == same);
+
+    // and back to numbers for the numeric entry points
+    assert(value_to_number(string_from_chars("12.5", 4)) == 12.5);
+    assert(value_to_number(string_from_chars("", 0)) == 0.0);
+    double bad = value_to_number(string_from_chars("12abc", 5));
+    assert(bad != bad);
+
+    heap_destroy();
+    printf("Conversion to strings test passed\n");
+}
+
+void test_heap_stats() {
+    printf("Testing heap statistics...\n");
+
+    heap_destroy();
+    assert(heap_get_stats().objects == 0);
+
+    string_from_chars("one", 3);
+    string_from_chars("two", 3);
+    HeapStats stats = heap_get_stats();
+    assert(stats.objects == 2);
+    assert(stats.bytes >= 2 * sizeof(StringObject));
+
+    heap_destroy();
+    assert(heap_get_stats().objects == 0);
+    printf("Heap statistics test passed\n");
+}
+
+int main() {
+    printf("Running string tests...\n\n");
+
+    test_string_storage();
+    test_string_concat();
+    test_string_deep_rope();
+    test_string_intern();
+    test_string_compare();
+    test_string_from_value();
+    test_heap_stats();
+
+    printf("All string tests passed!\n");
+    return 0;
+}
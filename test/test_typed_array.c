@@ -0,0 +1,123 @@
+/*
+ * test_typed_array.c - tests for Float64Array and Matrix storage
+ *
+ * covers allocated arrays, arrays mapped read-only from files and
+ * matrices.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "../include/object.h"
+
+static const char *data_path = "test_typed_array.bin";
+
+static void write_file(const char *path, const void *bytes, size_t size) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    assert(fwrite(bytes, 1, size, file) == size);
+    fclose(file);
+}
+
+void test_float64_array_create() {
+    printf("Testing Float64Array allocation...\n");
+
+    Value value = float64_array_create(37);
+    assert(value_is_float64_array(value));
+    assert(!value_is_string(value));
+    assert(strcmp(value_type_name(value), "Float64Array") == 0);
+
+    Float64ArrayObject *array = value_as_float64_array(value);
+    assert(array->length == 37);
+    assert(!array->mapped);
+    assert((uintptr_t)array->data % FLOAT64_ARRAY_ALIGNMENT == 0);
+    for (size_t i = 0; i < array->length; i++) {
+        assert(array->data[i] == 0.0);
+    }
+
+    Value empty = float64_array_create(0);
+    assert(value_as_float64_array(empty)->length == 0);
+    assert(value_as_float64_array(empty)->data == NULL);
+
+    heap_destroy();
+    printf("Float64Array allocation test passed\n");
+}
+
+void test_float64_array_map() {
+    printf("Testing mapped Float64Arrays...\n");
+
+    double values[] = { 1.5, -2.0, 1e300, 0.125 };
+    write_file(data_path, values, sizeof(values));
+
+    char error[256];
+    Value value = float64_array_map(data_path, error, sizeof(error));
+    assert(value_is_float64_array(value));
+    Float64ArrayObject *array = value_as_float64_array(value);
+    assert(array->mapped);
+    assert(array->length == 4);
+    assert(memcmp(array->data, values, sizeof(values)) == 0);
+
+    // an empty file is an empty array, not an error
+    write_file(data_path, values, 0);
+    value = float64_array_map(data_path, error, sizeof(error));
+    assert(value_is_float64_array(value));
+    assert(value_as_float64_array(value)->length == 0);
+
+    // sizes that aren't whole doubles and missing files are refused
+    write_file(data_path, values, 12);
+    assert(value_is_null(float64_array_map(data_path, error, sizeof(error))));
+    assert(strstr(error, "not a file of 8-byte doubles") != NULL);
+    unlink(data_path);
+    assert(value_is_null(float64_array_map(data_path, error, sizeof(error))));
+    assert(strstr(error, "cannot open") != NULL);
+
+    // the heap unmaps what it mapped
+    heap_destroy();
+    assert(heap_get_stats().objects == 0);
+    printf("Mapped Float64Array test passed\n");
+}
+
+void test_matrix_create() {
+    printf("Testing Matrix allocation...\n");
+
+    Value value = matrix_create(3, 5);
+    assert(value_is_matrix(value));
+    assert(!value_is_float64_array(value));
+    assert(strcmp(value_type_name(value), "Matrix") == 0);
+
+    MatrixObject *matrix = value_as_matrix(value);
+    assert(matrix->rows == 3 && matrix->cols == 5);
+    assert((uintptr_t)matrix->data % FLOAT64_ARRAY_ALIGNMENT == 0);
+    for (size_t i = 0; i < 15; i++) {
+        assert(matrix->data[i] == 0.0);
+    }
+    char text[64];
+    value_format(value, text, sizeof(text));
+    assert(strcmp(text, "[object Matrix]") == 0);
+
+    Value empty = matrix_create(0, 4);
+    assert(value_as_matrix(empty)->cols == 4);
+    assert(value_as_matrix(empty)->data == NULL);
+
+    // more elements than memory can hold
+    assert(value_is_null(matrix_create(SIZE_MAX / 2, 4)));
+
+    heap_destroy();
+    assert(heap_get_stats().objects == 0);
+    printf("Matrix allocation test passed\n");
+}
+
+int main() {
+    printf("Running typed array tests...\n\n");
+
+    test_float64_array_create();
+    test_float64_array_map();
+    test_matrix_create();
+
+    printf("All typed array tests passed!\n");
+    return 0;
+}
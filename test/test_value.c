@@ -0,0 +1,184 @@
+/*
+ * test_value.c - tests for nan-boxed runtime values
+ *
+ * verifies the encoding round-trips every kind of value, that doubles
+ * stay unboxed, and that nans can never be confused with tagged values.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/value.h"
+#include "../include/object.h"
+
+void test_value_doubles() {
+    printf("Testing double values...\n");
+
+    double samples[] = { 0.0, -0.0, 1.5, -42.25, 1e308, -1e-308, INFINITY, -INFINITY };
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        Value value = value_from_double(samples[i]);
+        assert(value_is_double(value));
+        assert(value_is_number(value));
+        assert(!value_is_int(value));
+        assert(!value_is_pointer(value));
+
+        // doubles are stored bit for bit
+        double back = value_as_double(value);
+        assert(memcmp(&back, &samples[i], sizeof(double)) == 0);
+    }
+
+    printf("Double values test passed\n");
+}
+
+void test_value_nan_canonical() {
+    printf("Testing nan canonicalization...\n");
+
+    // a nan whose bits land in the tagged range must still be a double
+    uint64_t hostile_bits = 0xfffb123456789abcULL;
+    double hostile;
+    memcpy(&hostile, &hostile_bits, sizeof(hostile));
+    assert(hostile != hostile);
+
+    Value value = value_from_double(hostile);
+    assert(value_is_double(value));
+    assert(!value_is_pointer(value));
+    assert(isnan(value_as_double(value)));
+
+    Value quiet = value_from_double(NAN);
+    assert(value_is_double(quiet));
+    assert(isnan(value_to_number(quiet)));
+
+    printf("Nan canonicalization test passed\n");
+}
+
+void test_value_ints() {
+    printf("Testing small integer values...\n");
+
+    int32_t samples[] = { 0, 1, -1, 123456, INT32_MAX, INT32_MIN };
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        Value value = value_from_int(samples[i]);
+        assert(value_is_int(value));
+        assert(value_is_number(value));
+        assert(!value_is_double(value));
+        assert(value_as_int(value) == samples[i]);
+        assert(value_as_number(value) == (double)samples[i]);
+    }
+
+    printf("Small integer values test passed\n");
+}
+
+void test_value_from_number() {
+    printf("Testing number representation choice...\n");
+
+    // exact int32s become ints
+    assert(value_is_int(value_from_number(0.0)));
+    assert(value_as_int(value_from_number(-7.0)) == -7);
+    assert(value_as_int(value_from_number(2147483647.0)) == INT32_MAX);
+    assert(value_as_int(value_from_number(-2147483648.0)) == INT32_MIN);
+
+    // everything else stays a double
+    assert(value_is_double(value_from_number(-0.0)));
+    assert(value_is_double(value_from_number(0.5)));
+    assert(value_is_double(value_from_number(2147483648.0)));
+    assert(value_is_double(value_from_number(-2147483649.0)));
+    assert(value_is_double(value_from_number(NAN)));
+    assert(value_is_double(value_from_number(INFINITY)));
+
+    printf("Number representation test passed\n");
+}
+
+void test_value_specials() {
+    printf("Testing null and boolean values...\n");
+
+    assert(value_is_null(VALUE_NULL));
+    assert(!value_is_number(VALUE_NULL));
+    assert(value_is_bool(VALUE_TRUE));
+    assert(value_is_bool(VALUE_FALSE));
+    assert(value_from_bool(5) == VALUE_TRUE);
+    assert(value_from_bool(0) == VALUE_FALSE);
+
+    assert(value_to_number(VALUE_TRUE) == 1.0);
+    assert(value_to_number(VALUE_FALSE) == 0.0);
+    assert(value_to_number(VALUE_NULL) == 0.0);
+
+    assert(value_is_truthy(VALUE_TRUE));
+    assert(!value_is_truthy(VALUE_FALSE));
+    assert(!value_is_truthy(VALUE_NULL));
+    assert(value_is_truthy(value_from_double(0.5)));
+    assert(!value_is_truthy(value_from_double(0.0)));
+    assert(!value_is_truthy(value_from_int(0)));
+
+    assert(strcmp(value_type_name(VALUE_TRUE), "boolean") == 0);
+    assert(strcmp(value_type_name(VALUE_NULL), "null") == 0);
+    assert(strcmp(value_type_name(value_from_int(3)), "number") == 0);
+
+    printf("Null and boolean values test passed\n");
+}
+
+void test_value_pointers() {
+    printf("Testing pointer values...\n");
+
+    int target = 7;
+    Value value = value_from_pointer(&target);
+    assert(value_is_pointer(value));
+    assert(!value_is_number(value));
+    assert(value_as_pointer(value) == &target);
+
+    // truthiness and conversion look at the object, so they need real
+    // ones. objects are true, except the empty string.
+    Value array = float64_array_create(0);
+    assert(value_is_truthy(array));
+    assert(isnan(value_to_number(array)));
+    assert(value_is_truthy(string_from_chars("a", 1)));
+    assert(!value_is_truthy(string_from_chars("", 0)));
+    heap_destroy();
+
+    printf("Pointer values test passed\n");
+}
+
+void test_value_print() {
+    printf("Testing value printing...\n");
+
+    char buffer[128];
+    FILE *out = fmemopen(buffer, sizeof(buffer), "w");
+    assert(out != NULL);
+
+    value_print(value_from_double(3.14), out);
+    fputc(' ', out);
+    value_print(value_from_int(-12), out);
+    fputc(' ', out);
+    value_print(VALUE_TRUE, out);
+    fputc(' ', out);
+    value_print(VALUE_NULL, out);
+    fputc(' ', out);
+    value_print(value_from_int(INT32_MIN), out);
+    fputc(' ', out);
+    value_print(value_from_double(-0.0), out);
+    fputc(' ', out);
+    value_print(value_from_double(4096.0), out);
+    fputc(' ', out);
+    value_print(value_from_double(1e15), out);
+    fclose(out);
+
+    assert(strcmp(buffer, "3.14 -12 true null -2147483648 -0 4096 1e+15") == 0);
+
+    printf("Value printing test passed\n");
+}
+
+int main() {
+    printf("Running value tests...\n\n");
+
+    test_value_doubles();
+    test_value_nan_canonical();
+    test_value_ints();
+    test_value_from_number();
+    test_value_specials();
+    test_value_pointers();
+    test_value_print();
+
+    printf("All value tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * test_vecmath.c - tests for the vectorized math functions
+ *
+ * each function is measured against a long double reference over the
+ * ranges scripts use and held to the bound documented in vecmath.h.
+ * special values must come out as libm's, and every instruction set
+ * must give the same bits wherever an element sits in the array.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+#include <assert.h>
+#include <math.h>
+#include "../include/vecmath.h"
+#include "../include/kernels.h"
+
+#define COUNT 20000
+
+// where long double is no wider than double the references carry their
+// own rounding error
+#if LDBL_MANT_DIG > 53
+#define SLACK 0.0
+#else
+#define SLACK 1.0
+#endif
+
+static uint64_t state = 88172645463325252ULL;
+
+// uniform in [low, high)
+static double random_between(double low, double high) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return low + (high - low) * ((double)(state >> 11) / 9007199254740992.0);
+}
+
+// how many units in the last place got is from want
+static double ulps(double got, long double want) {
+    if (isnan(got) && isnan((double)want)) {
+        return 0.0;
+    }
+    if (isinf(got) || isinf((double)want)) {
+        return got == (double)want ? 0.0 : INFINITY;
+    }
+    int exponent;
+    frexpl(want, &exponent);
+    long double ulp = ldexpl(1.0L, exponent - 53 < -1074 ? -1074 : exponent - 53);
+    return (double)(fabsl((long double)got - want) / ulp);
+}
+
+typedef struct {
+    const char *name;
+    void (*vector)(const double *x, double *out, size_t n);
+    long double (*reference)(long double x);
+    double low, high;
+    int exponential;   // x is e to a number between low and high
+    double bound;
+} UnaryCase;
+
+static void check_unary(const UnaryCase *c, double *x, double *out) {
+    for (size_t i = 0; i < COUNT; i++) {
+        double r = random_between(c->low, c->high);
+        x[i] = c->exponential ? exp(r) : r;
+    }
+    c->vector(x, out, COUNT);
+    double worst = 0.0;
+    for (size_t i = 0; i < COUNT; i++) {
+        worst = fmax(worst, ulps(out[i], c->reference(x[i])));
+    }
+    printf("  %-6s [%g, %g]%s: %.3f ulp\n", c->name, c->low, c->high, c->exponential ? " exponents" : "", worst);
+    assert(worst < c->bound + SLACK);
+}
+
+void test_vecmath_accuracy() {
+    printf("Testing accuracy...\n");
+
+    double *x = malloc(COUNT * sizeof(double));
+    double *y = malloc(COUNT * sizeof(double));
+    double *out = malloc(COUNT * sizeof(double));
+    UnaryCase cases[] = {
+        { "exp", vecmath_exp, expl, -708.0, 709.0, 0, 1.0 },
+        { "exp", vecmath_exp, expl, -2.0, 2.0, 0, 1.0 },
+        { "log", vecmath_log, logl, -700.0, 700.0, 1, 0.52 },
+        { "log", vecmath_log, logl, 0.5, 1.5, 0, 0.52 },
+        { "log", vecmath_log, logl, 1.0 - 1e-6, 1.0 + 1e-6, 0, 0.52 },
+        { "log", vecmath_log, logl, 0.0, 1e-310, 0, 0.52 },
+        { "sin", vecmath_sin, sinl, -0.7, 0.7, 0, 1.0 },
+        { "sin", vecmath_sin, sinl, -1000.0, 1000.0, 0, 1.0 },
+        { "sin", vecmath_sin, sinl, -800000.0, 800000.0, 0, 1.0 },
+        { "cos", vecmath_cos, cosl, -0.7, 0.7, 0, 1.0 },
+        { "cos", vecmath_cos, cosl, -1000.0, 1000.0, 0, 1.0 },
+        { "cos", vecmath_cos, cosl, -800000.0, 800000.0, 0, 1.0 },
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        check_unary(&cases[c], x, out);
+    }
+
+    // pow over results from tiny to huge, and near 1 with large powers
+    double worst = 0.0;
+    for (size_t i = 0; i < COUNT; i++) {
+        x[i] = exp(random_between(-20.0, 20.0));
+        y[i] = random_between(-35.0, 35.0);
+    }
+    vecmath_pow(x, 1, y, 1, out, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        worst = fmax(worst, ulps(out[i], powl(x[i], y[i])));
+    }
+    for (size_t i = 0; i < COUNT; i++) {
+        x[i] = random_between(0.7, 1.3);
+        y[i] = random_between(-2000.0, 2000.0);
+    }
+    vecmath_pow(x, 1, y, 1, out, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        worst = fmax(worst, ulps(out[i], powl(x[i], y[i])));
+    }
+    printf("  pow: %.3f ulp\n", worst);
+    assert(worst < 1.0 + SLACK);
+
+    // sqrt is exact
+    for (size_t i = 0; i < COUNT; i++) {
+        x[i] = random_between(0.0, 1e6);
+    }
+    vecmath_sqrt(x, out, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        assert(out[i] == sqrt(x[i]));
+        assert(vecmath_sqrt_scalar(x[i]) == sqrt(x[i]));
+    }
+
+    free(x);
+    free(y);
+    free(out);
+    printf("Accuracy test passed\n");
+}
+
+static int same(double a, double b) {
+    return (isnan(a) && isnan(b)) || (a == b && signbit(a) == signbit(b));
+}
+
+void test_vecmath_special_values() {
+    printf("Testing special values...\n");
+
+    double x[] = { 0.0, -0.0, 1.0, -1.0, INFINITY, -INFINITY, NAN, 1e-320, 710.0, -746.0, 1e300, -1e300, 0x1p1023 };
+    size_t n = sizeof(x) / sizeof(x[0]);
+    double out[sizeof(x) / sizeof(x[0])];
+
+    vecmath_sqrt(x, out, n);
+    for (size_t i = 0; i < n; i++) {
+        assert(same(out[i], sqrt(x[i])));
+    }
+    vecmath_exp(x, out, n);
+    for (size_t i = 0; i < n; i++) {
+        assert(same(out[i], exp(x[i])) || ulps(out[i], expl(x[i])) < 2.0);
+    }
+    vecmath_log(x, out, n);
+    for (size_t i = 0; i < n; i++) {
+        assert(same(out[i], log(x[i])) || ulps(out[i], logl(x[i])) < 2.0);
+    }
+    vecmath_sin(x, out, n);
+    for (size_t i = 0; i < n; i++) {
+        assert(same(out[i], sin(x[i])) || ulps(out[i], sinl(x[i])) < 2.0);
+    }
+    vecmath_cos(x, out, n);
+    for (size_t i = 0; i < n; i++) {
+        assert(same(out[i], cos(x[i])) || ulps(out[i], cosl(x[i])) < 2.0);
+    }
+    assert(same(out[0], 1.0));
+
+    // pow with every pairing, the C99 rules for zeros, infinities and
+    // negative bases included
+    double y[] = { 0.0, -0.0, 1.0, -1.0, 2.0, 3.0, -3.0, 0.5, INFINITY, -INFINITY, NAN, 1e300 };
+    size_t m = sizeof(y) / sizeof(y[0]);
+    for (size_t i = 0; i < n; i++) {
+        double row[sizeof(y) / sizeof(y[0])];
+        vecmath_pow(&x[i], 0, y, 1, row, m);
+        for (size_t j = 0; j < m; j++) {
+            assert(same(row[j], pow(x[i], y[j])) || ulps(row[j], powl(x[i], y[j])) < 2.0);
+        }
+    }
+
+    printf("Special values test passed\n");
+}
+
+void test_vecmath_isas() {
+    printf("Testing instruction sets...\n");
+
+    double x[67], y[67];
+    for (int i = 0; i < 67; i++) {
+        x[i] = i % 11 == 0 ? -0.0 : i % 13 == 0 ? NAN : i % 17 == 0 ? INFINITY : (double)i * 1.37 - 30.0;
+        y[i] = (double)(i % 7) * 0.75 - 2.0;
+    }
+    double positive[67];
+    for (int i = 0; i < 67; i++) {
+        positive[i] = fabs(x[i]) + 0.125;
+    }
+
+    // what the scalar build gives, for each function
+    double expected[6][67];
+    assert(kernel_use_isa(KERNEL_SCALAR));
+    vecmath_sqrt(positive, expected[0], 67);
+    vecmath_exp(x, expected[1], 67);
+    vecmath_log(positive, expected[2], 67);
+    vecmath_sin(x, expected[3], 67);
+    vecmath_cos(x, expected[4], 67);
+    vecmath_pow(positive, 1, y, 1, expected[5], 67);
+
+    KernelIsa isas[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (!kernel_use_isa(isas[k])) {
+            printf("  %s not available, skipped\n", kernel_isa_name(isas[k]));
+            continue;
+        }
+        for (size_t length = 0; length <= 67; length++) {
+            for (size_t offset = 0; offset < 2 && offset + length <= 67; offset++) {
+                double out[6][67];
+                vecmath_sqrt(positive + offset, out[0], length);
+                vecmath_exp(x + offset, out[1], length);
+                vecmath_log(positive + offset, out[2], length);
+                vecmath_sin(x + offset, out[3], length);
+                vecmath_cos(x + offset, out[4], length);
+                vecmath_pow(positive + offset, 1, y + offset, 1, out[5], length);
+                for (int f = 0; f < 6; f++) {
+                    for (size_t i = 0; i < length; i++) {
+                        assert(same(out[f][i], expected[f][offset + i]));
+                    }
+                }
+            }
+        }
+
+        // in place, and with a broadcast exponent
+        double copy[67];
+        for (int i = 0; i < 67; i++) {
+            copy[i] = x[i];
+        }
+        vecmath_sin(copy, copy, 67);
+        for (int i = 0; i < 67; i++) {
+            assert(same(copy[i], expected[3][i]));
+        }
+        double half = 0.5;
+        vecmath_pow(positive, 1, &half, 0, copy, 67);
+        for (int i = 0; i < 67; i++) {
+            double one;
+            vecmath_pow(&positive[i], 0, &half, 0, &one, 1);
+            assert(same(copy[i], one));
+        }
+    }
+    assert(kernel_use_isa(kernel_best_isa()));
+
+    printf("Instruction set test passed\n");
+}
+
+int main() {
+    printf("Running vecmath tests...\n\n");
+
+    test_vecmath_accuracy();
+    test_vecmath_special_values();
+    test_vecmath_isas();
+
+    printf("All vecmath tests passed!\n");
+    return 0;
+}
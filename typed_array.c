@@ -0,0 +1,165 @@
+/*
+ * typed_array.c - Float64Array, Matrix and shared array values for shardjs
+ *
+ * the elements live in their own buffer, zero-filled and aligned to
+ * FLOAT64_ARRAY_ALIGNMENT bytes so the simd kernels can load whole
+ * vectors from the start of any array. arrays can also be mapped
+ * straight from a file of doubles, in which case the page cache is the
+ * storage and nothing is copied or allocated per element. a matrix
+ * keeps its elements the same way, a row after another. a shared array
+ * is only a handle on a buffer shared.c owns.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/object.h"
+
+// a zero-filled buffer of doubles for an array or matrix, NULL for none.
+// 0 when out of memory.
+static int allocate_elements(size_t length, double **data) {
+    *data = NULL;
+    if (length == 0) {
+        return 1;
+    }
+    if (length > SIZE_MAX / sizeof(double)) {
+        return 0;
+    }
+    void *memory;
+    if (posix_memalign(&memory, FLOAT64_ARRAY_ALIGNMENT, length * sizeof(double)) != 0) {
+        return 0;
+    }
+    memset(memory, 0, length * sizeof(double));
+    *data = memory;
+    return 1;
+}
+
+Value float64_array_create(size_t length) {
+    double *data;
+    if (!allocate_elements(length, &data)) {
+        return VALUE_NULL;
+    }
+
+    Float64ArrayObject *array = heap_allocate(OBJ_FLOAT64_ARRAY, sizeof(Float64ArrayObject));
+    if (!array) {
+        free(data);
+        return VALUE_NULL;
+    }
+    array->length = length;
+    array->data = data;
+    return value_from_pointer(array);
+}
+
+Value float64_array_adopt(double *data, size_t length) {
+    Float64ArrayObject *array = heap_allocate(OBJ_FLOAT64_ARRAY, sizeof(Float64ArrayObject));
+    if (!array) {
+        return VALUE_NULL;
+    }
+    array->length = length;
+    array->data = length > 0 ? data : NULL;
+    if (length == 0) {
+        free(data);
+    }
+    return value_from_pointer(array);
+}
+
+Value float64_array_map(const char *path, char *error, size_t error_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(error, error_size, "cannot open '%s': %s", path, strerror(errno));
+        return VALUE_NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        snprintf(error, error_size, "cannot stat '%s': %s", path, strerror(errno));
+        close(fd);
+        return VALUE_NULL;
+    }
+    if (!S_ISREG(info.st_mode) || info.st_size % (off_t)sizeof(double) != 0) {
+        snprintf(error, error_size, "'%s' is not a file of 8-byte doubles", path);
+        close(fd);
+        return VALUE_NULL;
+    }
+
+    size_t bytes = (size_t)info.st_size;
+    double *data = NULL;
+    if (bytes > 0) {
+        void *mapping = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            snprintf(error, error_size, "cannot map '%s': %s", path, strerror(errno));
+            close(fd);
+            return VALUE_NULL;
+        }
+        // reductions read front to back once, so let the kernel read
+        // ahead aggressively and drop pages behind the scan
+        posix_madvise(mapping, bytes, POSIX_MADV_SEQUENTIAL);
+        data = mapping;
+    }
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    Float64ArrayObject *array = heap_allocate(OBJ_FLOAT64_ARRAY, sizeof(Float64ArrayObject));
+    if (!array) {
+        if (data) {
+            munmap(data, bytes);
+        }
+        snprintf(error, error_size, "out of memory");
+        return VALUE_NULL;
+    }
+    array->mapped = 1;
+    array->length = bytes / sizeof(double);
+    array->data = data;
+    return value_from_pointer(array);
+}
+
+void float64_array_release(Float64ArrayObject *array) {
+    if (array->mapped) {
+        if (array->data) {
+            munmap(array->data, array->length * sizeof(double));
+        }
+        return;
+    }
+    free(array->data);
+}
+
+Value matrix_create(size_t rows, size_t cols) {
+    double *data;
+    if ((cols != 0 && rows > SIZE_MAX / cols) || !allocate_elements(rows * cols, &data)) {
+        return VALUE_NULL;
+    }
+
+    MatrixObject *matrix = heap_allocate(OBJ_MATRIX, sizeof(MatrixObject));
+    if (!matrix) {
+        free(data);
+        return VALUE_NULL;
+    }
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->data = data;
+    return value_from_pointer(matrix);
+}
+
+void matrix_release(MatrixObject *matrix) {
+    free(matrix->data);
+}
+
+Value shared_array_adopt(SharedBuffer *buffer) {
+    SharedArrayObject *array = heap_allocate(OBJ_SHARED_ARRAY, sizeof(SharedArrayObject));
+    if (!array) {
+        return VALUE_NULL;
+    }
+    array->buffer = buffer;
+    return value_from_pointer(array);
+}
+
+void shared_array_release(SharedArrayObject *array) {
+    shared_buffer_release(array->buffer);
+}
@@ -0,0 +1,370 @@
+/*
+ * value.c - runtime value helpers for shardjs
+ * 
+ * conversions, truthiness and printing for nan-boxed values.
+ * the encoding itself lives in include/value.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "include/value.h"
+#include "include/object.h"
+
+// longer arrays print their first elements and a count of the rest
+#define VALUE_PRINT_MAX_ELEMENTS 100
+
+// numeric view of any value - non-numbers follow javascript loosely
+double value_to_number(Value value) {
+    if (value_is_double(value)) {
+        return value_as_double(value);
+    }
+    if (value_is_int(value)) {
+        return (double)value_as_int(value);
+    }
+    if (value == VALUE_TRUE) {
+        return 1.0;
+    }
+    if (value == VALUE_FALSE || value == VALUE_NULL) {
+        return 0.0;
+    }
+    if (value_is_string(value)) {
+        // the whole string has to be a number, blank means 0
+        const char *chars = string_chars(value);
+        if (!chars) {
+            return NAN;
+        }
+        char *end;
+        double number = strtod(chars, &end);
+        while (*end == ' ' || *end == '\t' || *end == '\n') {
+            end++;
+        }
+        if (end == chars) {
+            return string_length(value) == 0 ? 0.0 : NAN;
+        }
+        return *end == '\0' ? number : NAN;
+    }
+    return NAN;
+}
+
+// conditions treat any non-zero number as true
+int value_is_truthy(Value value) {
+    if (value_is_double(value)) {
+        return value_as_double(value) != 0.0;
+    }
+    if (value_is_int(value)) {
+        return value_as_int(value) != 0;
+    }
+    if (value_is_string(value)) {
+        return string_length(value) != 0;
+    }
+    if (value_is_pointer(value)) {
+        return 1;
+    }
+    return value == VALUE_TRUE;
+}
+
+const char* value_type_name(Value value) {
+    if (value_is_number(value)) {
+        return "number";
+    }
+    if (value_is_bool(value)) {
+        return "boolean";
+    }
+    if (value_is_null(value)) {
+        return "null";
+    }
+    if (value_is_string(value)) {
+        return "string";
+    }
+    if (value_is_float64_array(value)) {
+        return "Float64Array";
+    }
+    if (value_is_array(value)) {
+        return "Array";
+    }
+    if (value_is_map(value)) {
+        return "Map";
+    }
+    if (value_is_matrix(value)) {
+        return "Matrix";
+    }
+    if (value_is_worker(value)) {
+        return "Worker";
+    }
+    if (value_is_shared_array(value)) {
+        return value_as_shared_array(value)->buffer->kind == SHARED_INT64 ? "SharedInt64Array" : "SharedFloat64Array";
+    }
+    if (value_is_sketch(value)) {
+        return sketch_kind_name((SketchKind)value_as_sketch(value)->kind);
+    }
+    return "object";
+}
+
+// integers are formatted by hand - no printf and no float conversion
+static size_t format_integer(int64_t number, char *buffer) {
+    char digits[24];
+    char *cursor = digits + sizeof(digits);
+    uint64_t magnitude = number < 0 ? 0 - (uint64_t)number : (uint64_t)number;
+    
+    do {
+        *--cursor = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    
+    if (number < 0) {
+        *--cursor = '-';
+    }
+    size_t length = (size_t)(digits + sizeof(digits) - cursor);
+    memcpy(buffer, cursor, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+// text of any non-string value the way print() shows it. size should
+// be at least 32 bytes. returns the length written.
+size_t value_format(Value value, char *buffer, size_t size) {
+    if (value_is_int(value)) {
+        return format_integer(value_as_int(value), buffer);
+    }
+    if (value_is_double(value)) {
+        double number = value_as_double(value);
+        // whole doubles below 1e15 print exactly as %.15g would show them,
+        // except -0 which keeps its sign through the slow path
+        if (number > -1e15 && number < 1e15 && number == (double)(int64_t)number &&
+            (number != 0.0 || value == 0)) {
+            return format_integer((int64_t)number, buffer);
+        }
+        int length = snprintf(buffer, size, "%.15g", number);
+        return length > 0 ? (size_t)length : 0;
+    }
+    
+    const char *text;
+    if (value_is_bool(value)) {
+        text = value == VALUE_TRUE ? "true" : "false";
+    } else if (value_is_null(value)) {
+        text = "null";
+    } else if (value_is_float64_array(value)) {
+        text = "[object Float64Array]";
+    } else if (value_is_array(value)) {
+        text = "[object Array]";
+    } else if (value_is_record(value)) {
+        text = "[object Object]";
+    } else if (value_is_map(value)) {
+        text = "[object Map]";
+    } else if (value_is_matrix(value)) {
+        text = "[object Matrix]";
+    } else if (value_is_worker(value)) {
+        text = "[object Worker]";
+    } else if (value_is_shared_array(value)) {
+        text = value_as_shared_array(value)->buffer->kind == SHARED_INT64 ? "[object SharedInt64Array]"
+                                                                          : "[object SharedFloat64Array]";
+    } else if (value_is_sketch_kind(value, SKETCH_STATS)) {
+        text = "[object Stats]";
+    } else if (value_is_sketch_kind(value, SKETCH_QUANTILES)) {
+        text = "[object Quantiles]";
+    } else if (value_is_sketch_kind(value, SKETCH_DISTINCT)) {
+        text = "[object Distinct]";
+    } else if (value_is_sketch_kind(value, SKETCH_HISTOGRAM)) {
+        text = "[object Histogram]";
+    } else {
+        text = "[object]";
+    }
+    size_t length = strlen(text);
+    memcpy(buffer, text, length + 1);
+    return length;
+}
+
+// nested arrays and objects deeper than this print as [...] and {...},
+// which also stops one that contains itself
+#define VALUE_PRINT_MAX_DEPTH 4
+
+static void print_value(Value value, FILE *out, int depth, int quote_strings);
+
+// properties in the order they were added - the shape chain runs newest
+// first, so print the parent's properties before this one
+static void print_properties(RecordObject *record, const Shape *shape, FILE *out, int depth) {
+    if (!shape->name) {
+        return;
+    }
+    print_properties(record, shape->parent, out, depth);
+    if (shape->count > 1) {
+        fputs(", ", out);
+    }
+    Value name = value_from_pointer(shape->name);
+    fwrite(string_chars(name), 1, string_length(name), out);
+    fputs(": ", out);
+    print_value(*record_slot(record, shape->count - 1), out, depth + 1, 1);
+}
+
+static void print_value(Value value, FILE *out, int depth, int quote_strings) {
+    if (value_is_string(value)) {
+        const char *chars = string_chars(value);
+        if (quote_strings) {
+            fputc('"', out);
+        }
+        if (chars) {
+            fwrite(chars, 1, string_length(value), out);
+        }
+        if (quote_strings) {
+            fputc('"', out);
+        }
+        return;
+    }
+    
+    char buffer[64];
+    if (value_is_float64_array(value)) {
+        Float64ArrayObject *array = value_as_float64_array(value);
+        size_t shown = array->length < VALUE_PRINT_MAX_ELEMENTS ? array->length : VALUE_PRINT_MAX_ELEMENTS;
+        fprintf(out, "Float64Array(%zu) [", array->length);
+        for (size_t i = 0; i < shown; i++) {
+            size_t length = value_format(value_from_double(array->data[i]), buffer, sizeof(buffer));
+            if (i > 0) {
+                fputs(", ", out);
+            }
+            fwrite(buffer, 1, length, out);
+        }
+        if (shown < array->length) {
+            fprintf(out, ", ... %zu more", array->length - shown);
+        }
+        fputc(']', out);
+        return;
+    }
+    
+    // elements read one at a time, while other threads may be changing them
+    if (value_is_shared_array(value)) {
+        SharedBuffer *shared = value_as_shared_array(value)->buffer;
+        size_t shown = shared->length < VALUE_PRINT_MAX_ELEMENTS ? shared->length : VALUE_PRINT_MAX_ELEMENTS;
+        fprintf(out, "%s(%zu) [", value_type_name(value), shared->length);
+        for (size_t i = 0; i < shown; i++) {
+            size_t length = value_format(value_from_double(shared_load(shared, i)), buffer, sizeof(buffer));
+            if (i > 0) {
+                fputs(", ", out);
+            }
+            fwrite(buffer, 1, length, out);
+        }
+        if (shown < shared->length) {
+            fprintf(out, ", ... %zu more", shared->length - shown);
+        }
+        fputc(']', out);
+        return;
+    }
+    
+    // a row per bracket, each cut short like a Float64Array
+    if (value_is_matrix(value)) {
+        MatrixObject *matrix = value_as_matrix(value);
+        size_t rows = matrix->rows < VALUE_PRINT_MAX_ELEMENTS ? matrix->rows : VALUE_PRINT_MAX_ELEMENTS;
+        size_t cols = matrix->cols < VALUE_PRINT_MAX_ELEMENTS ? matrix->cols : VALUE_PRINT_MAX_ELEMENTS;
+        fprintf(out, "Matrix(%zux%zu) [", matrix->rows, matrix->cols);
+        for (size_t i = 0; i < rows; i++) {
+            fputs(i > 0 ? ", [" : "[", out);
+            for (size_t j = 0; j < cols; j++) {
+                size_t length = value_format(value_from_double(matrix->data[i * matrix->cols + j]),
+                                             buffer, sizeof(buffer));
+                if (j > 0) {
+                    fputs(", ", out);
+                }
+                fwrite(buffer, 1, length, out);
+            }
+            if (cols < matrix->cols) {
+                fprintf(out, ", ... %zu more", matrix->cols - cols);
+            }
+            fputc(']', out);
+        }
+        if (rows < matrix->rows) {
+            fprintf(out, ", ... %zu more", matrix->rows - rows);
+        }
+        fputc(']', out);
+        return;
+    }
+    
+    if (value_is_array(value)) {
+        ArrayObject *array = value_as_array(value);
+        if (depth >= VALUE_PRINT_MAX_DEPTH) {
+            fputs(array->length ? "[...]" : "[]", out);
+            return;
+        }
+        size_t shown = array->length < VALUE_PRINT_MAX_ELEMENTS ? array->length : VALUE_PRINT_MAX_ELEMENTS;
+        fputc('[', out);
+        for (size_t i = 0; i < shown; i++) {
+            if (i > 0) {
+                fputs(", ", out);
+            }
+            print_value(array_get(value, i), out, depth + 1, 1);
+        }
+        if (shown < array->length) {
+            fprintf(out, ", ... %zu more", array->length - shown);
+        }
+        fputc(']', out);
+        return;
+    }
+    
+    if (value_is_record(value)) {
+        RecordObject *record = value_as_record(value);
+        if (record->shape->count == 0) {
+            fputs("{}", out);
+        } else if (depth >= VALUE_PRINT_MAX_DEPTH) {
+            fputs("{...}", out);
+        } else {
+            fputc('{', out);
+            print_properties(record, record->shape, out, depth);
+            fputc('}', out);
+        }
+        return;
+    }
+    
+    // entries in insertion order, skipping the holes deletes left
+    if (value_is_map(value)) {
+        MapObject *map = value_as_map(value);
+        fprintf(out, "Map(%zu) ", map->count);
+        if (map->count == 0) {
+            fputs("{}", out);
+            return;
+        }
+        if (depth >= VALUE_PRINT_MAX_DEPTH) {
+            fputs("{...}", out);
+            return;
+        }
+        size_t shown = 0;
+        fputc('{', out);
+        for (size_t i = 0; i < map->entry_count && shown < VALUE_PRINT_MAX_ELEMENTS; i++) {
+            MapEntry *entry = &map->entries[i];
+            if (value_is_null(entry->key)) {
+                continue;
+            }
+            if (shown++ > 0) {
+                fputs(", ", out);
+            }
+            print_value(entry->key, out, depth + 1, 1);
+            fputs(" => ", out);
+            print_value(entry->value, out, depth + 1, 1);
+        }
+        if (shown < map->count) {
+            fprintf(out, ", ... %zu more", map->count - shown);
+        }
+        fputc('}', out);
+        return;
+    }
+    
+    // accumulators show how much they have seen
+    if (value_is_sketch(value)) {
+        SketchObject *sketch = value_as_sketch(value);
+        uint64_t count = sketch->kind == SKETCH_STATS ? sketch->as.moments.count :
+                         sketch->kind == SKETCH_QUANTILES ? sketch->as.quantiles->count :
+                         sketch->kind == SKETCH_HISTOGRAM ? sketch->as.histogram->count :
+                         (uint64_t)(stats_distinct_estimate(sketch->as.distinct) + 0.5);
+        fprintf(out, "%s(%s%llu)", sketch_kind_name((SketchKind)sketch->kind),
+                sketch->kind == SKETCH_DISTINCT ? "~" : "", (unsigned long long)count);
+        return;
+    }
+    
+    size_t length = value_format(value, buffer, sizeof(buffer));
+    fwrite(buffer, 1, length, out);
+}
+
+// write a value the way print() shows it, without a newline. strings
+// inside arrays are quoted so ["1"] and [1] look different.
+void value_print(Value value, FILE *out) {
+    print_value(value, out, 0, 0);
+}
@@ -0,0 +1,599 @@
+/*
+ * vecmath.c - vectorized math functions for shardjs
+ *
+ * each function works on four doubles at a time through gcc's vector
+ * extensions and is compiled twice: for the baseline instruction set,
+ * where four lanes are two sse2 registers, and for avx2, where they are
+ * one. lanes never mix, the last few elements of an array are padded
+ * out to four, and iso c never fuses a multiply into an add, so both
+ * builds round every lane identically.
+ *
+ * exp takes x = k ln 2 + r with |r| <= ln 2 / 2 and uses fdlibm's
+ * rational form of e^r before scaling by 2^k. log takes x = 2^k z with
+ * z in [0.6875, 1.375), looks up 1/c and -log(1/c) for the nearest
+ * multiple c of 1/128 and sums the series of log(1 + r), r = z/c - 1,
+ * carrying the leading terms in two doubles. pow multiplies that log,
+ * good to about 2^-66, by y in two doubles as well and hands both
+ * parts to exp. sin and cos take away the nearest multiple of pi/2 in
+ * three exact steps and use fdlibm's kernels on what is left.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include "include/vecmath.h"
+#include "include/kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECMATH_X86 1
+#include <immintrin.h>
+#endif
+
+#define LANES 4
+
+typedef double vd __attribute__((vector_size(32)));
+typedef int64_t vi __attribute__((vector_size(32)));
+typedef uint64_t vu __attribute__((vector_size(32)));
+
+// helpers are always inlined, so each build compiles them for its own
+// instruction set, and take vectors by pointer - passing 32-byte
+// vectors by value would change with whether avx is enabled
+#define INLINE static inline __attribute__((always_inline))
+
+#define SPLAT(c) ((vd){ (c), (c), (c), (c) })
+#define SELECT(mask, a, b) ((vd)(((mask) & (vi)(a)) | (~(mask) & (vi)(b))))
+#define ANY(mask) (((mask)[0] | (mask)[1] | (mask)[2] | (mask)[3]) != 0)
+
+// lane masks come from the bits rather than from comparing doubles,
+// which gcc only vectorizes with avx: the sign bit spread over the
+// lane, and |x| < c as the sign of their difference, both magnitudes
+// being below 2^63. nan is never below anything.
+#define MAGNITUDE(x) ((vu)(x) & 0x7fffffffffffffffULL)
+#define NEGATIVE(x) ((vi)-((vu)(x) >> 63))
+#define BELOW(x, c) NEGATIVE(MAGNITUDE(x) - (vu)SPLAT(c))
+#define IS_NAN(x) NEGATIVE((vu)SPLAT(INFINITY) - MAGNITUDE(x))
+
+// error-free transformations: s + e is exactly a + b, p + e exactly
+// a * b. the arguments must be plain variables.
+#define TWO_SUM(s, e, a, b) do {                         \
+        vd sum_ = (a) + (b);                             \
+        vd part_ = sum_ - (a);                           \
+        (e) = ((a) - (sum_ - part_)) + ((b) - part_);    \
+        (s) = sum_;                                      \
+    } while (0)
+
+#define SPLIT(hi, lo, a) do {                            \
+        vd scaled_ = (a) * 134217729.0;                  \
+        (hi) = scaled_ - (scaled_ - (a));                \
+        (lo) = (a) - (hi);                               \
+    } while (0)
+
+#define TWO_PRODUCT(p, e, a, b) do {                                     \
+        vd a_hi_, a_lo_, b_hi_, b_lo_;                                   \
+        SPLIT(a_hi_, a_lo_, a);                                          \
+        SPLIT(b_hi_, b_lo_, b);                                          \
+        (p) = (a) * (b);                                                 \
+        (e) = ((a_hi_ * b_hi_ - (p)) + a_hi_ * b_lo_ + a_lo_ * b_hi_) + a_lo_ * b_lo_; \
+    } while (0)
+
+// adding and then taking away 1.5 * 2^52 rounds to an integer and
+// leaves it in the low bits
+#define SHIFTER 0x1.8p52
+
+// fdlibm's ln 2 in two parts, the first short enough that k * LN2_HI is
+// exact for any exponent k, and its coefficients for e^r
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+#define INV_LN2 1.44269504088896338700e+00
+#define EXP_P1 1.66666666666666019037e-01
+#define EXP_P2 -2.77777777770155933842e-03
+#define EXP_P3 6.61375632143793436117e-05
+#define EXP_P4 -1.65339022054652515390e-06
+#define EXP_P5 4.13813679705723846039e-08
+
+// e^(hi + lo), lo much smaller than hi
+INLINE void exp_lanes(vd *out, const vd *x_hi, const vd *x_lo) {
+    // past 710 or -746 the result is inf or 0 anyway, and clamping
+    // keeps k in range
+    vd hi = *x_hi;
+    vi negative = NEGATIVE(hi);
+    vd clamped = SELECT(~negative & ~BELOW(hi, 710.0), SPLAT(710.0), hi);
+    clamped = SELECT(negative & ~BELOW(hi, 746.0), SPLAT(-746.0), clamped);
+
+    vd shifted = clamped * INV_LN2 + SHIFTER;
+    vd k = shifted - SHIFTER;
+    vi k_bits = (vi)((vu)shifted - (vu)SPLAT(SHIFTER));
+    vd r_hi = clamped - k * LN2_HI;
+    vd r_lo = k * LN2_LO - *x_lo;
+    vd r = r_hi - r_lo;
+    vd t = r * r;
+    vd c = r - t * (EXP_P1 + t * (EXP_P2 + t * (EXP_P3 + t * (EXP_P4 + t * EXP_P5))));
+    vd y = 1.0 - ((r_lo - (r * c) / (2.0 - c)) - r_hi);
+
+    // 2^k as two factors, so neither leaves the exponent range even
+    // when the result is about to overflow or go subnormal
+    // k runs from -1076 to 1025 and is halved offset to be positive,
+    // avx2 having no arithmetic shift of 64-bit lanes
+    vu k1 = (((vu)k_bits + 1076) >> 1) - 538;
+    vu k2 = (vu)k_bits - k1;
+    vd scale1 = (vd)((k1 + 1023) << 52);
+    vd scale2 = (vd)((k2 + 1023) << 52);
+    y = y * scale1 * scale2;
+
+    *out = SELECT(IS_NAN(hi), hi, y);
+}
+
+// for each c = i/128 from 88/128 to 176/128, 1/c rounded to 20 bits
+// and -log of that rounded 1/c as a double and the rest, computed to 60
+// digits with python's decimal module
+#define LOG_TABLE_FIRST 88
+
+static const struct {
+    double inverse;
+    double log_hi;
+    double log_lo;
+} log_table[89] = {
+    { 0x1.745d200000000p+0, -0x1.7fafbbbd8109cp-2, 0x1.207024b1e3b75p-58 },
+    { 0x1.702e000000000p+0, -0x1.741d776c679b1p-2, -0x1.848f98dac402dp-56 },
+    { 0x1.6c16c00000000p+0, -0x1.68ac7fe9c69f4p-2, -0x1.a64d5881e9c23p-58 },
+    { 0x1.6816800000000p+0, -0x1.5d5bd9f595f10p-2, 0x1.654169e2111f8p-56 },
+    { 0x1.642c800000000p+0, -0x1.522ad0738a1d8p-2, 0x1.8fa945e3d1424p-57 },
+    { 0x1.6058200000000p+0, -0x1.4718f9271bd89p-2, -0x1.97a52bcbd6569p-60 },
+    { 0x1.5c98800000000p+0, -0x1.3c251f7333104p-2, 0x1.2ad528fb57971p-56 },
+    { 0x1.58ed200000000p+0, -0x1.314f151d35c42p-2, 0x1.3d6d5c9e62a60p-56 },
+    { 0x1.5555600000000p+0, -0x1.269641134d392p-2, -0x1.e19a588085ad7p-56 },
+    { 0x1.51d0800000000p+0, -0x1.1bf99a35a6b75p-2, 0x1.12ae0d979ef79p-57 },
+    { 0x1.4e5e000000000p+0, -0x1.1178c8227dc7cp-2, 0x1.0fb8fb4d71be9p-57 },
+    { 0x1.4afd600000000p+0, -0x1.07136704d50e0p-2, -0x1.cd16457c0dddep-56 },
+    { 0x1.47ae200000000p+0, -0x1.f9920ecb39f39p-3, -0x1.f84b0662c78a7p-57 },
+    { 0x1.446f800000000p+0, -0x1.e530c7fe709d2p-3, -0x1.2128aec50baebp-59 },
+    { 0x1.4141400000000p+0, -0x1.d103772655e3bp-3, -0x1.6061e7979bef7p-57 },
+    { 0x1.3e22c00000000p+0, -0x1.bd082783bc21dp-3, -0x1.cb58b440627f0p-60 },
+    { 0x1.3b13c00000000p+0, -0x1.a93f33c8ab5e3p-3, -0x1.c12fa9b61721cp-57 },
+    { 0x1.3813800000000p+0, -0x1.95a5a5cf7013fp-3, -0x1.142afb2a614e8p-58 },
+    { 0x1.3521c00000000p+0, -0x1.823bae5517982p-3, 0x1.17eb795331a50p-57 },
+    { 0x1.323e400000000p+0, -0x1.6f0174b75542cp-3, 0x1.8baa06dc7498fp-57 },
+    { 0x1.2f68400000000p+0, -0x1.5bf3b6b5424b2p-3, 0x1.4905f0a40a32ep-61 },
+    { 0x1.2c9fc00000000p+0, -0x1.4914243339ed1p-3, 0x1.08deda083577bp-58 },
+    { 0x1.29e4200000000p+0, -0x1.3660270156f06p-3, -0x1.852cef6c97929p-58 },
+    { 0x1.2735000000000p+0, -0x1.23d6c2a49a902p-3, 0x1.70d2c0ce8481ep-57 },
+    { 0x1.2492400000000p+0, -0x1.1178a8227d47cp-3, 0x1.110e50aac7142p-58 },
+    { 0x1.21fb800000000p+0, -0x1.fe89839dbbce6p-4, 0x1.aad5ecca04e3bp-58 },
+    { 0x1.1f70400000000p+0, -0x1.da72063842e22p-4, -0x1.3e5651b87cac0p-58 },
+    { 0x1.1cf0600000000p+0, -0x1.b6abecdad2b94p-4, 0x1.09ff8f18641e2p-59 },
+    { 0x1.1a7ba00000000p+0, -0x1.933675d592109p-4, 0x1.43be8589edcabp-58 },
+    { 0x1.1811800000000p+0, -0x1.700d20aeac061p-4, 0x1.72610cbd807b0p-61 },
+    { 0x1.15b1e00000000p+0, -0x1.4d30bdd206f8cp-4, -0x1.75c16d6e9bc76p-58 },
+    { 0x1.135c800000000p+0, -0x1.2aa03a4471725p-4, 0x1.d15e8e285094cp-58 },
+    { 0x1.1111200000000p+0, -0x1.085a6b59dd807p-4, 0x1.cf255f7b9141ep-58 },
+    { 0x1.0ecf600000000p+0, -0x1.ccb854ddd663cp-5, 0x1.dd953b288548ap-59 },
+    { 0x1.0c97200000000p+0, -0x1.894bf149f4503p-5, -0x1.c0dc96a81dea0p-60 },
+    { 0x1.0a68200000000p+0, -0x1.466cc542d0a5ap-5, 0x1.ac69841116b38p-59 },
+    { 0x1.0842200000000p+0, -0x1.0417b89e66344p-5, -0x1.e384f04bd174bp-59 },
+    { 0x1.0624e00000000p+0, -0x1.8493028c8bb9fp-6, 0x1.d123e5b7d9bfcp-60 },
+    { 0x1.0410400000000p+0, -0x1.0205258935647p-6, -0x1.27c392ec151cap-60 },
+    { 0x1.0204000000000p+0, -0x1.00fd57587de71p-7, -0x1.1bbb8196d23bfp-62 },
+    { 0x1.0000000000000p+0, 0x0.0p+0, 0x0.0p+0 },
+    { 0x1.fc08000000000p-1, 0x1.fdfaa6b126789p-8, -0x1.ce682ce31a038p-65 },
+    { 0x1.f81f800000000p-1, 0x1.fc0b0b0fc07e4p-7, -0x1.82f3d703fed4cp-62 },
+    { 0x1.f446600000000p-1, 0x1.7b90e87d5c4a3p-6, -0x1.5c02ed7767837p-60 },
+    { 0x1.f07c200000000p-1, 0x1.f82990e783380p-6, 0x1.33e345a474878p-60 },
+    { 0x1.ecc0800000000p-1, 0x1.39e82b9fec3a0p-5, -0x1.5c243e29b1a65p-59 },
+    { 0x1.e913200000000p-1, 0x1.774537632e48cp-5, 0x1.189c5532d6361p-59 },
+    { 0x1.e573a00000000p-1, 0x1.b42eab1199da3p-5, -0x1.e5888c4dc1676p-60 },
+    { 0x1.e1e1e00000000p-1, 0x1.f0a32c01163a6p-5, 0x1.85f5d07068577p-59 },
+    { 0x1.de5d600000000p-1, 0x1.1653e8ea397f3p-4, -0x1.709ddbaca6cd7p-60 },
+    { 0x1.dae6000000000p-1, 0x1.341db961bd9d1p-4, -0x1.b5449cd169766p-58 },
+    { 0x1.d77b600000000p-1, 0x1.51b0a1f061c61p-4, 0x1.a4bde8f74265bp-58 },
+    { 0x1.d41d400000000p-1, 0x1.6f0d38ae56bccp-4, -0x1.906c43c2f543dp-58 },
+    { 0x1.d0cb600000000p-1, 0x1.8c341f631a2a3p-4, -0x1.4cd620018bdf8p-61 },
+    { 0x1.cd85600000000p-1, 0x1.a9271fa4ae0abp-4, 0x1.94be2e01c350fp-58 },
+    { 0x1.ca4b400000000p-1, 0x1.c5e4bcf5bed8bp-4, 0x1.4f6c94a902b1fp-60 },
+    { 0x1.c71c800000000p-1, 0x1.e26ff6e2b12e6p-4, -0x1.6c022a6c8ac26p-60 },
+    { 0x1.c3f9000000000p-1, 0x1.fec8831dc133bp-4, -0x1.5b12b97e7a378p-58 },
+    { 0x1.c0e0800000000p-1, 0x1.0d779fcd0a299p-3, 0x1.9877c5f5d38a6p-57 },
+    { 0x1.bdd2c00000000p-1, 0x1.1b728b52f6c24p-3, 0x1.47c9c89dc86d9p-58 },
+    { 0x1.bacfa00000000p-1, 0x1.2954eb8200733p-3, 0x1.2e7e07238f390p-57 },
+    { 0x1.b7d6c00000000p-1, 0x1.371fd401e90b8p-3, 0x1.de7be62b0b2b0p-58 },
+    { 0x1.b4e8200000000p-1, 0x1.44d2a0ccb7f02p-3, 0x1.9f4187eea93bap-57 },
+    { 0x1.b203600000000p-1, 0x1.526e713a1b5a1p-3, -0x1.74670a4f0b95cp-57 },
+    { 0x1.af28600000000p-1, 0x1.5ff33f0a7a014p-3, -0x1.ba979a5110a16p-58 },
+    { 0x1.ac57000000000p-1, 0x1.6d6106719d25dp-3, -0x1.caad7be421ecep-57 },
+    { 0x1.a98f000000000p-1, 0x1.7ab860210e209p-3, 0x1.bbf6b2e0c0605p-59 },
+    { 0x1.a6d0200000000p-1, 0x1.87f9eb520cbeap-3, -0x1.bf997cf9c7fa2p-57 },
+    { 0x1.a41a400000000p-1, 0x1.9525b1cf456f4p-3, 0x1.d9056c7f8e0d0p-57 },
+    { 0x1.a16d400000000p-1, 0x1.a23bbffe2b567p-3, 0x1.9371105cfef01p-59 },
+    { 0x1.9ec8e00000000p-1, 0x1.af3cc2e80c837p-3, -0x1.388f848751cc9p-58 },
+    { 0x1.9c2d200000000p-1, 0x1.bc283042d98a7p-3, 0x1.4e1d2fa680548p-58 },
+    { 0x1.9999a00000000p-1, 0x1.c8ff5c79a9e22p-3, -0x1.4f934a2e5eabcp-57 },
+    { 0x1.970e400000000p-1, 0x1.d5c264b4fd355p-3, 0x1.70ae1da98b451p-57 },
+    { 0x1.948b000000000p-1, 0x1.e270c6e2b0be6p-3, -0x1.56ecd50915690p-59 },
+    { 0x1.920fc00000000p-1, 0x1.ef0aa2bdc665ap-3, 0x1.47656c00ec33dp-57 },
+    { 0x1.8f9c200000000p-1, 0x1.fb9162d5e433bp-3, -0x1.cae7a64e54a4bp-57 },
+    { 0x1.8d30200000000p-1, 0x1.040246cb4d2edp-2, 0x1.6b68f5189fa7bp-56 },
+    { 0x1.8acba00000000p-1, 0x1.0a32272739cc5p-2, 0x1.7c9aea8934f83p-56 },
+    { 0x1.886e600000000p-1, 0x1.1058bd1ae4ae2p-2, -0x1.9d819228227f2p-56 },
+    { 0x1.8618600000000p-1, 0x1.1675cebaba62ep-2, 0x1.ce6e9563361c2p-61 },
+    { 0x1.83c9800000000p-1, 0x1.1c89761699dc3p-2, -0x1.11d3b7f6fad9ep-60 },
+    { 0x1.8181800000000p-1, 0x1.229423bcf7986p-2, -0x1.76f595b40cf5ap-56 },
+    { 0x1.7f40600000000p-1, 0x1.2895a0bde86a4p-2, -0x1.0a5b682d74d38p-57 },
+    { 0x1.7d06000000000p-1, 0x1.2e8e0bae12531p-2, -0x1.8ff7863c968a5p-56 },
+    { 0x1.7ad2200000000p-1, 0x1.347ddb2987d59p-2, 0x1.5915a1bfb7318p-56 },
+    { 0x1.78a4c00000000p-1, 0x1.3a64db56949b2p-2, -0x1.c61766e7eb650p-57 },
+    { 0x1.767dc00000000p-1, 0x1.40432f686b3c6p-2, -0x1.0a9ac1ff59ae5p-56 },
+    { 0x1.745d200000000p-1, 0x1.4618a421c6342p-2, 0x1.f3e5ece010f1cp-56 }
+};
+
+#define LOG_OFFSET 0x3fe6000000000000ULL   // 0.6875
+#define ROUND_128THS 0x1.8p45               // whose last bit is worth 1/128
+
+// log(x) as hi + lo, to about 2^-66 of its size, for positive finite x
+INLINE void log_lanes(vd *out_hi, vd *out_lo, const vd *x_in) {
+    vd x = *x_in;
+    vi tiny = BELOW(x, 0x1p-1022);
+    x = SELECT(tiny, x * 0x1p54, x);
+
+    // x = 2^k z, z in [0.6875, 1.375)
+    vu bits = (vu)x;
+    vu offset = bits - LOG_OFFSET;
+    // k is the top 12 bits of offset as a signed number, read through
+    // the low bits of a double
+    vd k = (vd)(((offset >> 52) ^ 0x800) | (vu)SPLAT(0x1p52)) - (0x1p52 + 2048.0);
+    k = k - (vd)(tiny & (vi)SPLAT(54.0));
+    vd z = (vd)(bits - (offset & 0xfff0000000000000ULL));
+
+    vu index = (vu)(z + ROUND_128THS) - (vu)SPLAT(ROUND_128THS) - LOG_TABLE_FIRST;
+#define GATHER(field) ((vd){ log_table[index[0]].field, log_table[index[1]].field, \
+                              log_table[index[2]].field, log_table[index[3]].field })
+    vd inverse = GATHER(inverse);
+    vd c_hi = GATHER(log_hi);
+    vd c_lo = GATHER(log_lo);
+#undef GATHER
+
+    // r = z/c - 1 exactly as r + r_err: z is split so that both parts
+    // times the 20-bit 1/c are exact, and z_hi / c - 1 is near 0
+    vd z_hi = (vd)((vu)z & ~0xfffffULL);
+    vd z_lo = z - z_hi;
+    vd a = z_hi * inverse - 1.0;
+    vd b = z_lo * inverse;
+    vd r, r_err;
+    TWO_SUM(r, r_err, a, b);
+
+    // log(1 + r) = r - r^2/2 + r^3 (1/3 - r/4 + ... + r^6/9), |r| < 1/176,
+    // the square taken exactly and the rest in estrin's order
+    vd square, square_err, r_hi, r_lo;
+    SPLIT(r_hi, r_lo, r);
+    square = r * r;
+    square_err = ((r_hi * r_hi - square) + 2.0 * r_hi * r_lo) + r_lo * r_lo;
+    vd fourth = square * square;
+    vd series = r * square * ((1.0 / 3 - r * (1.0 / 4)) + square * (1.0 / 5 - r * (1.0 / 6)) +
+                              fourth * ((1.0 / 7 - r * (1.0 / 8)) + square * (1.0 / 9)));
+
+    // the large terms added exactly, the small ones after
+    vd s1, e1, s2, e2, s3, e3;
+    vd k_hi = k * LN2_HI;
+    TWO_SUM(s1, e1, k_hi, c_hi);
+    TWO_SUM(s2, e2, s1, r);
+    vd half_square = -0.5 * square;
+    TWO_SUM(s3, e3, s2, half_square);
+    vd small = k * LN2_LO + c_lo + r_err - r * r_err - 0.5 * square_err + series + e1 + e2 + e3;
+
+    vd hi = s3 + small;
+    *out_hi = hi;
+    *out_lo = small - (hi - s3);
+}
+
+// fdlibm's pi/2 in three 33-bit parts and the rest, so n times each
+// part is exact for n up to 2^20, and its kernels on [-pi/4, pi/4]
+#define INV_PIO2 6.36619772367581382433e-01
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624871116645580e-21
+#define PIO2_3T 8.47842766036889956997e-32
+#define SIN_LIMIT (0x1p19 * 1.57079632679489661923)
+
+#define S1 -1.66666666666666324348e-01
+#define S2 8.33333333332248946124e-03
+#define S3 -1.98412698298579493134e-04
+#define S4 2.75573137070700676789e-06
+#define S5 -2.50507602534068634195e-08
+#define S6 1.58969099521155010221e-10
+
+#define C1 4.16666666666666019037e-02
+#define C2 -1.38888888888741095749e-03
+#define C3 2.48015872894767294178e-05
+#define C4 -2.75573143513906633035e-07
+#define C5 2.08757232129817482790e-09
+#define C6 -1.13596475577881948265e-11
+
+// sin and cos of y + y_err, |y| <= pi/4
+INLINE void kernel_sin(vd *out, const vd *y_in, const vd *y_err_in) {
+    vd x = *y_in, y = *y_err_in;
+    vd z = x * x;
+    vd v = z * x;
+    vd r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+    *out = x - ((z * (0.5 * y - v * r) - y) - v * S1);
+}
+
+INLINE void kernel_cos(vd *out, const vd *y_in, const vd *y_err_in) {
+    vd x = *y_in, y = *y_err_in;
+    vd z = x * x;
+    vd w = z * z;
+    vd r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+    vd half = 0.5 * z;
+    vd one_less = 1.0 - half;
+    *out = one_less + (((1.0 - one_less) - half) + (z * r - x * y));
+}
+
+// sin of the lanes when quadrant is 0, cos when it is 1
+INLINE void sin_block(const double *in, double *out, uint64_t quadrant) {
+    vd x;
+    memcpy(&x, in, sizeof(x));
+    vi large = ~BELOW(x, SIN_LIMIT);
+    vd safe = SELECT(large, SPLAT(0.0), x);
+
+    vd shifted = safe * INV_PIO2 + SHIFTER;
+    vd n = shifted - SHIFTER;
+    vu q = (vu)shifted + quadrant;
+
+    // x - n pi/2 as y + y_err. the first step is exact outright, the
+    // other two are made exact by keeping their rounding errors.
+    vd a = safe - n * PIO2_1;
+    vd b = -(n * PIO2_2);
+    vd r2, e2, c, r3, e3;
+    TWO_SUM(r2, e2, a, b);
+    c = -(n * PIO2_3);
+    TWO_SUM(r3, e3, r2, c);
+    vd tail = (e2 + e3) - n * PIO2_3T;
+    vd y = r3 + tail;
+    vd y_err = tail - (y - r3);
+    // nothing to take away, which also keeps the sign of -0
+    vi whole = BELOW(n, 0.5);
+    y = SELECT(whole, safe, y);
+    y_err = SELECT(whole, SPLAT(0.0), y_err);
+
+    vd s, co;
+    kernel_sin(&s, &y, &y_err);
+    kernel_cos(&co, &y, &y_err);
+    vd result = SELECT(-(vi)(q & 1), co, s);
+    result = (vd)((vu)result ^ ((q & 2) << 62));
+
+    memcpy(out, &result, sizeof(result));
+    if (ANY(large)) {
+        for (int l = 0; l < LANES; l++) {
+            if (large[l]) {
+                out[l] = quadrant ? cos(x[l]) : sin(x[l]);
+            }
+        }
+    }
+}
+
+INLINE void exp_block(const double *in, double *out) {
+    vd x, result;
+    vd zero = SPLAT(0.0);
+    memcpy(&x, in, sizeof(x));
+    exp_lanes(&result, &x, &zero);
+    memcpy(out, &result, sizeof(result));
+}
+
+INLINE void log_block(const double *in, double *out) {
+    vd x, hi, lo;
+    memcpy(&x, in, sizeof(x));
+    // zero, negatives, infinity and nan are answered apart
+    vi zero = BELOW(x, 0x1p-1074);
+    vi finite = BELOW(x, INFINITY);
+    vi negative = NEGATIVE(x);
+    vd safe = SELECT(negative | zero | ~finite, SPLAT(1.0), x);
+    log_lanes(&hi, &lo, &safe);
+    hi = SELECT(zero, SPLAT(-INFINITY), hi);
+    hi = SELECT(negative & ~zero, SPLAT(NAN), hi);
+    hi = SELECT(~negative & ~finite, x, hi);
+    memcpy(out, &hi, sizeof(hi));
+}
+
+INLINE void pow_lanes(vd *out, const vd *x_in, const vd *y_in) {
+    vd x = *x_in, y = *y_in;
+    // x <= 0 depends on whether y is an integer, and y past 2^900 could
+    // overflow the split below, so those lanes go to libm
+    vi special = NEGATIVE(x) | BELOW(x, 0x1p-1074) | ~BELOW(x, INFINITY) | ~BELOW(y, 0x1p900);
+    vd safe_x = SELECT(special, SPLAT(1.0), x);
+    vd safe_y = SELECT(special, SPLAT(1.0), y);
+
+    vd log_hi, log_lo, hi, hi_err, result;
+    log_lanes(&log_hi, &log_lo, &safe_x);
+    TWO_PRODUCT(hi, hi_err, safe_y, log_hi);
+    vd lo = hi_err + safe_y * log_lo;
+    exp_lanes(&result, &hi, &lo);
+
+    if (ANY(special)) {
+        for (int l = 0; l < LANES; l++) {
+            if (special[l]) {
+                result[l] = pow(x[l], y[l]);
+            }
+        }
+    }
+    *out = result;
+}
+
+INLINE void cos_block(const double *in, double *out) {
+    sin_block(in, out, 1);
+}
+
+INLINE void sine_block(const double *in, double *out) {
+    sin_block(in, out, 0);
+}
+
+// whole blocks of four, then the rest padded with ones
+#define UNARY_LOOP(block, x, out, n) do {                                \
+        size_t i_ = 0;                                                   \
+        for (; i_ + LANES <= (n); i_ += LANES) {                         \
+            block((x) + i_, (out) + i_);                                 \
+        }                                                                \
+        if (i_ < (n)) {                                                  \
+            double in_[LANES] = { 1.0, 1.0, 1.0, 1.0 }, result_[LANES];  \
+            memcpy(in_, (x) + i_, ((n) - i_) * sizeof(double));          \
+            block(in_, result_);                                         \
+            memcpy((out) + i_, result_, ((n) - i_) * sizeof(double));    \
+        }                                                                \
+    } while (0)
+
+// four lanes from p, or one number four times when step is 0
+#define LOAD(v, p, step) do {                  \
+        if (step) {                            \
+            memcpy(&(v), (p), sizeof(v));      \
+        } else {                               \
+            (v) = SPLAT(*(p));                 \
+        }                                      \
+    } while (0)
+
+INLINE void pow_loop(const double *x, size_t x_step, const double *y, size_t y_step, double *out, size_t n) {
+    vd xs, ys, result;
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        LOAD(xs, x + i * x_step, x_step);
+        LOAD(ys, y + i * y_step, y_step);
+        pow_lanes(&result, &xs, &ys);
+        memcpy(out + i, &result, sizeof(result));
+    }
+    if (i < n) {
+        xs = SPLAT(1.0);
+        ys = SPLAT(1.0);
+        for (size_t l = 0; i + l < n; l++) {
+            xs[l] = x[(i + l) * x_step];
+            ys[l] = y[(i + l) * y_step];
+        }
+        pow_lanes(&result, &xs, &ys);
+        memcpy(out + i, &result, (n - i) * sizeof(double));
+    }
+}
+
+static void exp_generic(const double *x, double *out, size_t n) {
+    UNARY_LOOP(exp_block, x, out, n);
+}
+
+static void log_generic(const double *x, double *out, size_t n) {
+    UNARY_LOOP(log_block, x, out, n);
+}
+
+static void sin_generic(const double *x, double *out, size_t n) {
+    UNARY_LOOP(sine_block, x, out, n);
+}
+
+static void cos_generic(const double *x, double *out, size_t n) {
+    UNARY_LOOP(cos_block, x, out, n);
+}
+
+static void pow_generic(const double *x, size_t x_step, const double *y, size_t y_step, double *out, size_t n) {
+    pow_loop(x, x_step, y, y_step, out, n);
+}
+
+static void sqrt_generic(const double *x, double *out, size_t n) {
+    size_t i = 0;
+#ifdef VECMATH_X86
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_loadu_pd(x + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = vecmath_sqrt_scalar(x[i]);
+    }
+}
+
+#ifdef VECMATH_X86
+// the same code again, each helper inlined and compiled for avx2
+__attribute__((target("avx2")))
+static void exp_avx2(const double *x, double *out, size_t n) {
+    UNARY_LOOP(exp_block, x, out, n);
+}
+
+__attribute__((target("avx2")))
+static void log_avx2(const double *x, double *out, size_t n) {
+    UNARY_LOOP(log_block, x, out, n);
+}
+
+__attribute__((target("avx2")))
+static void sin_avx2(const double *x, double *out, size_t n) {
+    UNARY_LOOP(sine_block, x, out, n);
+}
+
+__attribute__((target("avx2")))
+static void cos_avx2(const double *x, double *out, size_t n) {
+    UNARY_LOOP(cos_block, x, out, n);
+}
+
+__attribute__((target("avx2")))
+static void pow_avx2(const double *x, size_t x_step, const double *y, size_t y_step, double *out, size_t n) {
+    pow_loop(x, x_step, y, y_step, out, n);
+}
+
+__attribute__((target("avx2")))
+static void sqrt_avx2(const double *x, double *out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+    }
+    for (; i < n; i++) {
+        out[i] = vecmath_sqrt_scalar(x[i]);
+    }
+}
+
+#endif
+
+void vecmath_sqrt(const double *x, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        sqrt_avx2(x, out, n);
+        return;
+    }
+#endif
+    sqrt_generic(x, out, n);
+}
+
+void vecmath_exp(const double *x, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        exp_avx2(x, out, n);
+        return;
+    }
+#endif
+    exp_generic(x, out, n);
+}
+
+void vecmath_log(const double *x, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        log_avx2(x, out, n);
+        return;
+    }
+#endif
+    log_generic(x, out, n);
+}
+
+void vecmath_sin(const double *x, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        sin_avx2(x, out, n);
+        return;
+    }
+#endif
+    sin_generic(x, out, n);
+}
+
+void vecmath_cos(const double *x, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        cos_avx2(x, out, n);
+        return;
+    }
+#endif
+    cos_generic(x, out, n);
+}
+
+void vecmath_pow(const double *x, size_t x_step, const double *y, size_t y_step, double *out, size_t n) {
+#ifdef VECMATH_X86
+    if (kernel_current_isa() == KERNEL_AVX2) {
+        pow_avx2(x, x_step, y, y_step, out, n);
+        return;
+    }
+#endif
+    pow_generic(x, x_step, y, y_step, out, n);
+}
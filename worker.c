@@ -0,0 +1,397 @@
+/*
+ * worker.c - workers for shardjs
+ *
+ * everything an interpreter keeps between statements - the heap, the
+ * intern table, shapes, the error state - is thread-local, so a worker's
+ * thread starts with none of it and builds its own as it runs. what
+ * interpreters share is their inboxes. each one knows its own and, in a
+ * worker, its parent's; a parent keeps a table of the workers it
+ * started, which a Worker object indexes. the source is read before the
+ * thread starts, so a missing script fails in the caller.
+ *
+ * a worker's inbox counts its parent as a sender until the parent shuts
+ * down, and the parent's counts every worker until it finishes, so a
+ * receive that nothing can satisfy returns instead of waiting forever.
+ * a worker whose script fails posts the error, which the parent's next
+ * receive reports. one the parent never receives, or can no longer be
+ * posted, is reported when the parent shuts down, so a failed worker
+ * always fails the program.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "include/worker.h"
+#include "include/queue.h"
+#include "include/runtime.h"
+#include "include/object.h"
+#include "include/kernels.h"
+
+typedef struct {
+    char *path;
+    char *source;          // until the thread has parsed it
+    MessageQueue *inbox;   // the worker's own
+    MessageQueue *parent;  // the inbox of the interpreter that started it
+    size_t mark_threads;   // the parent's collector settings
+    int concurrent_marking;
+    char *error;           // why the script failed, when that couldn't be posted
+    pthread_t thread;
+} WorkerThread;
+
+static __thread MessageQueue *inbox = NULL;
+static __thread MessageQueue *parent_inbox = NULL;   // NULL outside a worker
+static __thread WorkerThread **workers = NULL;
+static __thread size_t worker_count = 0;
+static __thread size_t worker_capacity = 0;
+
+static MessageQueue* own_inbox(void) {
+    if (!inbox) {
+        inbox = queue_create(WORKER_QUEUE_CAPACITY);
+    }
+    return inbox;
+}
+
+static char* read_source(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    char *source = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            source = malloc((size_t)size + 1);
+            if (source) {
+                source[fread(source, 1, (size_t)size, file)] = '\0';
+            }
+        }
+    }
+    fclose(file);
+    return source;
+}
+
+// parse, optimize and run a script the way main does - 0 with the
+// reason in error when it fails
+static int run_script(const char *path, const char *source, char *error, size_t error_size) {
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = lexer ? parser_create(lexer) : NULL;
+    ASTNode *ast = parser ? parser_parse(parser) : NULL;
+    Environment *env = NULL;
+    int ok = 0;
+    if (!parser) {
+        snprintf(error, error_size, "%s: out of memory", path);
+    } else if (!ast || parser_has_error(parser)) {
+        snprintf(error, error_size, "%s: parse error: %s", path,
+                 parser_has_error(parser) ? parser_get_error(parser) : "unknown parsing failure");
+    } else if (!optimizer_run(ast) || !(env = env_create())) {
+        snprintf(error, error_size, "%s: out of memory", path);
+    } else {
+        interpreter_clear_error();
+        interpret(ast, env);
+        if (interpreter_has_error()) {
+            snprintf(error, error_size, "%s: %s", path, interpreter_get_error());
+        } else {
+            ok = 1;
+        }
+    }
+    if (env) env_destroy(env);
+    if (ast) ast_destroy(ast);
+    if (parser) parser_destroy(parser);
+    if (lexer) lexer_destroy(lexer);
+    return ok;
+}
+
+static void* worker_main(void *argument) {
+    WorkerThread *worker = argument;
+    inbox = worker->inbox;
+    parent_inbox = worker->parent;
+    heap_set_mark_threads(worker->mark_threads);
+    heap_set_concurrent_marking(worker->concurrent_marking);
+
+    char error[512];
+    int ok = run_script(worker->path, worker->source, error, sizeof(error));
+    free(worker->source);
+    worker->source = NULL;
+    // the workers this one started finish first, and their failures
+    // are its own
+    if (worker_shutdown() && ok) {
+        snprintf(error, sizeof(error), "%s: a worker it started failed", worker->path);
+        ok = 0;
+    }
+    if (!ok) {
+        Message message = { MESSAGE_ERROR, 0, 0.0, strdup(error), strlen(error), 0 };
+        if (!message.data || !queue_post(worker->parent, &message)) {
+            // the parent has stopped receiving; it reports this after joining
+            message_free(&message);
+            worker->error = strdup(error);
+            if (!worker->error) {
+                fprintf(stderr, "Worker error: %s\n", error);
+            }
+        }
+    }
+
+    heap_destroy();
+    queue_remove_sender(worker->parent);
+    return NULL;
+}
+
+static void worker_free(WorkerThread *worker) {
+    if (worker->inbox) {
+        queue_release(worker->inbox);
+    }
+    queue_release(worker->parent);
+    free(worker->source);
+    free(worker->error);
+    free(worker->path);
+    free(worker);
+}
+
+static int reserve_worker(void) {
+    if (worker_count < worker_capacity) {
+        return 1;
+    }
+    size_t capacity = worker_capacity ? worker_capacity * 2 : 4;
+    WorkerThread **grown = realloc(workers, capacity * sizeof(WorkerThread*));
+    if (!grown) {
+        return 0;
+    }
+    workers = grown;
+    worker_capacity = capacity;
+    return 1;
+}
+
+Value worker_create(const char *path, char *error, size_t error_size) {
+    char *source = read_source(path);
+    if (!source) {
+        snprintf(error, error_size, "cannot read '%s'", path);
+        return VALUE_NULL;
+    }
+    MessageQueue *own = own_inbox();
+    WorkerThread *worker = own && reserve_worker() ? calloc(1, sizeof(WorkerThread)) : NULL;
+    if (!worker) {
+        snprintf(error, error_size, "out of memory");
+        free(source);
+        return VALUE_NULL;
+    }
+    worker->source = source;
+    worker->path = strdup(path);
+    worker->inbox = queue_create(WORKER_QUEUE_CAPACITY);
+    worker->parent = own;
+    worker->mark_threads = heap_mark_threads();
+    worker->concurrent_marking = heap_concurrent_marking();
+    queue_retain(own);
+    WorkerObject *object = worker->path && worker->inbox ? heap_allocate(OBJ_WORKER, sizeof(WorkerObject)) : NULL;
+    if (!object) {
+        snprintf(error, error_size, "out of memory");
+        worker_free(worker);
+        return VALUE_NULL;
+    }
+
+    queue_add_sender(worker->inbox);
+    queue_add_sender(own);
+    // the kernels pick an instruction set on first use; do that before
+    // there is a second thread to race with
+    kernel_current_isa();
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+        snprintf(error, error_size, "cannot start a thread for '%s'", path);
+        queue_remove_sender(own);
+        worker_free(worker);
+        return VALUE_NULL;
+    }
+    object->index = worker_count;
+    workers[worker_count++] = worker;
+    return value_from_pointer(object);
+}
+
+// a message holding value - arrays hand their elements over and are
+// left empty, while a shared array hands over another reference
+static int message_from_value(Value value, Message *message, char *error, size_t error_size) {
+    memset(message, 0, sizeof(Message));
+    if (value_is_number(value)) {
+        message->kind = MESSAGE_NUMBER;
+        message->number = value_as_number(value);
+    } else if (value_is_bool(value)) {
+        message->kind = MESSAGE_BOOL;
+        message->number = value == VALUE_TRUE;
+    } else if (value_is_null(value)) {
+        message->kind = MESSAGE_NULL;
+    } else if (value_is_string(value)) {
+        const char *chars = string_chars(value);
+        size_t length = string_length(value);
+        char *copy = chars ? malloc(length + 1) : NULL;
+        if (!copy) {
+            snprintf(error, error_size, "Out of memory copying a message");
+            return 0;
+        }
+        memcpy(copy, chars, length);
+        copy[length] = '\0';
+        message->kind = MESSAGE_STRING;
+        message->data = copy;
+        message->length = length;
+    } else if (value_is_float64_array(value)) {
+        Float64ArrayObject *array = value_as_float64_array(value);
+        message->kind = MESSAGE_FLOAT64_ARRAY;
+        message->mapped = array->mapped;
+        message->data = array->data;
+        message->length = array->length;
+        array->data = NULL;
+        array->length = 0;
+        array->mapped = 0;
+    } else if (value_is_shared_array(value)) {
+        message->kind = MESSAGE_SHARED;
+        message->data = value_as_shared_array(value)->buffer;
+        shared_buffer_retain(message->data);
+    } else if (value_is_array(value) && value_as_array(value)->kind == ARRAY_NUMBERS) {
+        ArrayElement *buffer;
+        if (!array_take_numbers(value, &buffer, &message->length, &message->capacity)) {
+            snprintf(error, error_size, "Out of memory moving a message");
+            return 0;
+        }
+        message->kind = MESSAGE_NUMBERS;
+        message->data = buffer;
+    } else {
+        snprintf(error, error_size,
+                 "postMessage can send numbers, strings, booleans, null, Float64Arrays, shared arrays and arrays of numbers, got %s",
+                 value_type_name(value));
+        return 0;
+    }
+    return 1;
+}
+
+// the value a message carries, taking over its buffers - 0 when out of
+// memory, with the message freed
+static int value_from_message(Message *message, Value *value) {
+    switch (message->kind) {
+        case MESSAGE_NULL:
+            *value = VALUE_NULL;
+            return 1;
+        case MESSAGE_BOOL:
+            *value = value_from_bool(message->number != 0.0);
+            return 1;
+        case MESSAGE_NUMBER:
+            *value = value_from_number(message->number);
+            return 1;
+        case MESSAGE_STRING:
+            *value = string_from_chars(message->data, message->length);
+            message_free(message);
+            return !value_is_null(*value);
+        case MESSAGE_FLOAT64_ARRAY: {
+            Float64ArrayObject *array = heap_allocate(OBJ_FLOAT64_ARRAY, sizeof(Float64ArrayObject));
+            if (!array) {
+                message_free(message);
+                return 0;
+            }
+            array->mapped = (uint8_t)message->mapped;
+            array->length = message->length;
+            array->data = message->data;
+            *value = value_from_pointer(array);
+            return 1;
+        }
+        case MESSAGE_NUMBERS:
+            *value = array_adopt_numbers(message->data, message->length, message->capacity);
+            if (value_is_null(*value)) {
+                message_free(message);
+                return 0;
+            }
+            return 1;
+        case MESSAGE_SHARED:
+            *value = shared_array_adopt(message->data);
+            if (value_is_null(*value)) {
+                message_free(message);
+                return 0;
+            }
+            return 1;
+        case MESSAGE_ERROR:
+            break;
+    }
+    message_free(message);
+    return 0;
+}
+
+int worker_post(Value worker, Value value, char *error, size_t error_size) {
+    Message message;
+    if (!message_from_value(value, &message, error, error_size)) {
+        return 0;
+    }
+    if (!queue_post(workers[value_as_worker(worker)->index]->inbox, &message)) {
+        message_free(&message);
+    }
+    return 1;
+}
+
+int worker_post_parent(Value value, char *error, size_t error_size) {
+    Message message;
+    if (!message_from_value(value, &message, error, error_size)) {
+        return 0;
+    }
+    if (!queue_post(parent_inbox, &message)) {
+        message_free(&message);
+    }
+    return 1;
+}
+
+int worker_is_worker(void) {
+    return parent_inbox != NULL;
+}
+
+int worker_receive(Value *value, char *error, size_t error_size) {
+    MessageQueue *own = own_inbox();
+    if (!own) {
+        snprintf(error, error_size, "Out of memory receiving a message");
+        return 0;
+    }
+    Message message;
+    if (!queue_take(own, &message)) {
+        snprintf(error, error_size, "receiveMessage waited for a message, but nothing is left to send one");
+        return 0;
+    }
+    if (message.kind == MESSAGE_ERROR) {
+        snprintf(error, error_size, "Worker failed: %s", (const char*)message.data);
+        message_free(&message);
+        return 0;
+    }
+    if (!value_from_message(&message, value)) {
+        snprintf(error, error_size, "Out of memory receiving a message");
+        return 0;
+    }
+    return 1;
+}
+
+int worker_shutdown(void) {
+    int failed = 0;
+    // workers still posting to this interpreter give up rather than wait
+    if (inbox) {
+        queue_close(inbox);
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        queue_remove_sender(workers[i]->inbox);
+        pthread_join(workers[i]->thread, NULL);
+        if (workers[i]->error) {
+            fprintf(stderr, "Worker error: %s\n", workers[i]->error);
+            failed++;
+        }
+        worker_free(workers[i]);
+    }
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+    worker_capacity = 0;
+    // every worker has finished, so whatever they posted is here
+    Message message;
+    while (inbox && queue_try_take(inbox, &message)) {
+        if (message.kind == MESSAGE_ERROR) {
+            fprintf(stderr, "Worker error: %s\n", (const char*)message.data);
+            failed++;
+        }
+        message_free(&message);
+    }
+    // a worker's inbox belongs to its parent's table
+    if (inbox && !parent_inbox) {
+        queue_release(inbox);
+    }
+    inbox = NULL;
+    parent_inbox = NULL;
+    return failed;
+}